@@ -4,6 +4,9 @@
 #include <mutex>
 #include <unordered_map>
 
+#include "fast_time.hpp"
+#include "parallel_executor.hpp"
+
 // I keep these declaration here because of following error:
 // error: there are no arguments to ‘increment_outgoing_counters’ that depend on a template parameter, so a declaration
 // of ‘increment_outgoing_counters’ must be available [-fpermissive]
@@ -22,13 +25,20 @@ void build_average_speed_counters_from_speed_counters(subnet_counter_t* current_
                                                       subnet_counter_t& new_speed_element,
                                                       double exp_value,
                                                       double exp_power);
+void build_windowed_speed_counters(subnet_counter_t* current_speed_element, subnet_counter_t& new_speed_element, double speed_calc_period);
 
 // Class for abstract per key counters
+// Packet processing threads increment counter_map under counter_map_mutex. Recalculation swaps it with
+// inactive_counter_map and reads counters without blocking packet processing threads
 template <typename T> class abstract_subnet_counters_t {
     public:
     std::unordered_map<T, subnet_counter_t> counter_map;
     std::mutex counter_map_mutex;
 
+    // Protects speed_map, average_speed_map and inactive_counter_map
+    // When we need both locks we take this one first
+    std::mutex speed_maps_mutex;
+
     std::unordered_map<T, subnet_counter_t> speed_map;
     std::unordered_map<T, subnet_counter_t> average_speed_map;
 
@@ -50,22 +60,33 @@ template <typename T> class abstract_subnet_counters_t {
 
 
     uint64_t purge_old_data(unsigned int automatic_data_cleanup_threshold) {
+        std::lock_guard<std::mutex> speed_maps_lock_guard(this->speed_maps_mutex);
         std::lock_guard<std::mutex> lock_guard(this->counter_map_mutex);
 
-        std::vector<T> keys_to_remove;
+        // Same clock as we use for packets, in offline mode it's time from dump
+        time_t current_time = get_fast_time_seconds();
 
-        time_t current_time = 0;
+        // Key could be in both generations and we use latest update time
+        std::unordered_map<T, time_t> last_update_times;
 
-        time(&current_time);
+        for (auto counters : { &this->counter_map, &this->inactive_counter_map }) {
+            for (auto itr = counters->begin(); itr != counters->end(); ++itr) {
+                time_t& last_update_time = last_update_times[itr->first];
+                last_update_time         = std::max(last_update_time, itr->second.last_update_time);
+            }
+        }
+
+        std::vector<T> keys_to_remove;
 
-        for (auto itr = this->counter_map.begin(); itr != this->counter_map.end(); ++itr) {
-            if ((int64_t)itr->second.last_update_time < int64_t((int64_t)current_time - (int64_t)automatic_data_cleanup_threshold)) {
-                keys_to_remove.push_back(itr->first);
+        for (const auto& last_update_time : last_update_times) {
+            if ((int64_t)last_update_time.second < int64_t((int64_t)current_time - (int64_t)automatic_data_cleanup_threshold)) {
+                keys_to_remove.push_back(last_update_time.first);
             }
         }
 
         for (const auto& key : keys_to_remove) {
             counter_map.erase(key);
+            inactive_counter_map.erase(key);
             speed_map.erase(key);
             average_speed_map.erase(key);
         }
@@ -74,33 +95,33 @@ template <typename T> class abstract_subnet_counters_t {
         return keys_to_remove.size();
     }
 
-    void recalculate_speed(double speed_calc_period,
-                           double average_calculation_time_for_subnets,
-                           std::function<void(T*, subnet_counter_t*)> speed_check_callback) {
+    // Removes all counters for specified key
+    void remove_key(T key) {
+        std::lock_guard<std::mutex> speed_maps_lock_guard(this->speed_maps_mutex);
         std::lock_guard<std::mutex> lock_guard(this->counter_map_mutex);
 
-        for (auto itr = this->counter_map.begin(); itr != this->counter_map.end(); ++itr) {
-            T current_key                    = itr->first;
-            subnet_counter_t* subnet_traffic = &itr->second;
+        counter_map.erase(key);
+        inactive_counter_map.erase(key);
+        speed_map.erase(key);
+        average_speed_map.erase(key);
+    }
 
-            subnet_counter_t new_speed_element;
+    void recalculate_speed(double speed_calc_period,
+                           double average_calculation_time_for_subnets,
+                           std::function<void(T*, subnet_counter_t*)> speed_check_callback) {
+        std::lock_guard<std::mutex> speed_maps_lock_guard(this->speed_maps_mutex);
 
-            build_speed_counters_from_packet_counters(new_speed_element, subnet_traffic, speed_calc_period);
+        swap_generations();
 
-            /* Moving average recalculation for subnets */
-            /* http://en.wikipedia.org/wiki/Moving_average#Application_to_measuring_computer_performance
-             */
-            double exp_power_subnet = -speed_calc_period / average_calculation_time_for_subnets;
-            double exp_value_subnet = exp(exp_power_subnet);
+        double exp_power_subnet = -speed_calc_period / average_calculation_time_for_subnets;
+        double exp_value_subnet = exp(exp_power_subnet);
 
-            subnet_counter_t* current_average_speed_element = &average_speed_map[current_key];
+        for (auto itr = this->average_speed_map.begin(); itr != this->average_speed_map.end(); ++itr) {
+            T current_key = itr->first;
 
-            build_average_speed_counters_from_speed_counters(current_average_speed_element, new_speed_element,
-                                                             exp_value_subnet, exp_power_subnet);
+            subnet_counter_t* current_average_speed_element = &itr->second;
 
-            // Update speed calculation structure in single step
-            this->speed_map[current_key] = new_speed_element;
-            subnet_traffic->zeroify();
+            recalculate_speed_for_key(current_key, current_average_speed_element, speed_calc_period, exp_value_subnet, exp_power_subnet);
 
             // Check thresholds
             if (speed_check_callback != nullptr) {
@@ -109,9 +130,52 @@ template <typename T> class abstract_subnet_counters_t {
         }
     }
 
+    // Same as recalculate_speed but we split buckets of map between workers of executor
+    // We call speed_check_callback from calling thread and only for elements with non zero average speed
+    void recalculate_speed_parallel(parallel_executor_t& executor,
+                                    double speed_calc_period,
+                                    double average_calculation_time_for_subnets,
+                                    std::function<void(T*, subnet_counter_t*)> speed_check_callback) {
+        std::lock_guard<std::mutex> speed_maps_lock_guard(this->speed_maps_mutex);
+
+        swap_generations();
+
+        double exp_power_subnet = -speed_calc_period / average_calculation_time_for_subnets;
+        double exp_value_subnet = exp(exp_power_subnet);
+
+        const size_t buckets_per_task = 1024;
+        size_t number_of_tasks        = (average_speed_map.bucket_count() + buckets_per_task - 1) / buckets_per_task;
+
+        std::vector<std::vector<T>> non_zero_keys(executor.get_number_of_workers());
+
+        executor.run(number_of_tasks, [&](size_t task_index, size_t worker_index) {
+            size_t last_bucket = std::min(average_speed_map.bucket_count(), (task_index + 1) * buckets_per_task);
+
+            for (size_t bucket = task_index * buckets_per_task; bucket < last_bucket; bucket++) {
+                for (auto itr = this->average_speed_map.begin(bucket); itr != this->average_speed_map.end(bucket); ++itr) {
+                    recalculate_speed_for_key(itr->first, &itr->second, speed_calc_period, exp_value_subnet, exp_power_subnet);
+
+                    if (!itr->second.is_zero()) {
+                        non_zero_keys[worker_index].push_back(itr->first);
+                    }
+                }
+            }
+        });
+
+        if (speed_check_callback == nullptr) {
+            return;
+        }
+
+        for (const auto& worker_keys : non_zero_keys) {
+            for (T current_key : worker_keys) {
+                speed_check_callback(&current_key, &this->average_speed_map.find(current_key)->second);
+            }
+        }
+    }
+
     // Returns all non zero average speed elements
     void get_all_non_zero_average_speed_elements_as_pairs(std::vector<std::pair<T, subnet_counter_t>>& all_elements) {
-        std::lock_guard<std::mutex> lock_guard(this->counter_map_mutex);
+        std::lock_guard<std::mutex> lock_guard(this->speed_maps_mutex);
 
         for (auto itr = this->average_speed_map.begin(); itr != this->average_speed_map.end(); ++itr) {
             if (itr->second.is_zero()) {
@@ -123,7 +187,7 @@ template <typename T> class abstract_subnet_counters_t {
     }
 
     void get_sorted_average_speed(std::vector<std::pair<T, subnet_counter_t>>& vector_for_sort, sort_type_t sorter_type, direction_t sort_direction) {
-        std::lock_guard<std::mutex> lock_guard(this->counter_map_mutex);
+        std::lock_guard<std::mutex> lock_guard(this->speed_maps_mutex);
 
         vector_for_sort.reserve(average_speed_map.size());
         std::copy(average_speed_map.begin(), average_speed_map.end(), std::back_inserter(vector_for_sort));
@@ -134,7 +198,7 @@ template <typename T> class abstract_subnet_counters_t {
 
     // Retrieves average speed for specified key with all locks
     bool get_average_speed_subnet(T key, subnet_counter_t& average_speed_element) {
-        std::lock_guard<std::mutex> lock_guard(this->counter_map_mutex);
+        std::lock_guard<std::mutex> lock_guard(this->speed_maps_mutex);
 
         auto average_speed_itr = this->average_speed_map.find(key);
 
@@ -149,10 +213,60 @@ template <typename T> class abstract_subnet_counters_t {
     // Please create vector_for_sort this way on callers side: top_four(4);
     void get_top_k_average_speed(std::vector<std::pair<T, subnet_counter_t>>& vector_for_sort, sort_type_t sorter_type, direction_t sort_direction) {
 
-        std::lock_guard<std::mutex> lock_guard(this->counter_map_mutex);
+        std::lock_guard<std::mutex> lock_guard(this->speed_maps_mutex);
 
         std::partial_sort_copy(average_speed_map.begin(), average_speed_map.end(), vector_for_sort.begin(),
                                vector_for_sort.end(),
                                TrafficComparatorClass<std::pair<T, subnet_counter_t>>(sort_direction, sorter_type));
     }
+
+    private:
+    // Counters from previous period, only recalculation reads them and it holds speed_maps_mutex
+    std::unordered_map<T, subnet_counter_t> inactive_counter_map;
+
+    // Should be called with speed_maps_mutex
+    void swap_generations() {
+        {
+            std::lock_guard<std::mutex> lock_guard(this->counter_map_mutex);
+
+            // Both maps keep their keys and writers insert new keys only for new hosts
+            std::swap(this->counter_map, this->inactive_counter_map);
+        }
+
+        // Keys from average_speed_map define which elements we recalculate
+        for (auto itr = this->inactive_counter_map.begin(); itr != this->inactive_counter_map.end(); ++itr) {
+            this->speed_map[itr->first];
+            this->average_speed_map[itr->first];
+        }
+    }
+
+    // Could be called in parallel for different keys because it does not insert anything
+    void recalculate_speed_for_key(const T& current_key,
+                                   subnet_counter_t* current_average_speed_element,
+                                   double speed_calc_period,
+                                   double exp_value_subnet,
+                                   double exp_power_subnet) {
+        // Host could have no traffic in this generation
+        subnet_counter_t zero_counter_element{};
+
+        auto counter_itr = this->inactive_counter_map.find(current_key);
+
+        subnet_counter_t* subnet_traffic =
+            counter_itr == this->inactive_counter_map.end() ? &zero_counter_element : &counter_itr->second;
+
+        subnet_counter_t new_speed_element;
+
+        build_speed_counters_from_packet_counters(new_speed_element, subnet_traffic, speed_calc_period);
+
+        /* Moving average recalculation for subnets */
+        /* http://en.wikipedia.org/wiki/Moving_average#Application_to_measuring_computer_performance
+         */
+        build_average_speed_counters_from_speed_counters(current_average_speed_element, new_speed_element,
+                                                         exp_value_subnet, exp_power_subnet);
+
+        build_windowed_speed_counters(&this->speed_map.find(current_key)->second, new_speed_element, speed_calc_period);
+
+        // Writers will use this element only after next swap
+        subnet_traffic->zeroify();
+    }
 };
@@ -0,0 +1,329 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include "all_logcpp_libraries.hpp"
+#include "fastnetmon_types.hpp"
+
+extern log4cpp::Category& logger;
+
+// Backends which we call from ban and unban handlers
+enum class action_backend_t : unsigned int {
+    Script  = 0,
+    ExaBGP  = 1,
+    GoBGP   = 2,
+    Redis   = 3,
+    MongoDB = 4,
+};
+
+const unsigned int number_of_action_backends = 5;
+
+inline std::string get_action_backend_name(action_backend_t backend) {
+    switch (backend) {
+    case action_backend_t::Script:
+        return "script";
+    case action_backend_t::ExaBGP:
+        return "exabgp";
+    case action_backend_t::GoBGP:
+        return "gobgp";
+    case action_backend_t::Redis:
+        return "redis";
+    case action_backend_t::MongoDB:
+        return "mongodb";
+    }
+
+    return "unknown";
+}
+
+// Announce and withdrawal for same prefix must reach BGP daemon in same order as we created them
+// Otherwise withdrawal could overtake announce and we will keep blackhole after unban
+inline bool is_ordered_action_backend(action_backend_t backend) {
+    return backend == action_backend_t::ExaBGP || backend == action_backend_t::GoBGP;
+}
+
+// Element which could be merged with other elements for same backend into single request
+class action_batch_element_t {
+    public:
+    action_batch_element_t() = default;
+    action_batch_element_t(const std::string& key, const std::string& value) : key(key), value(value) {
+    }
+
+    std::string key;
+    std::string value;
+};
+
+class action_t {
+    public:
+    action_backend_t backend = action_backend_t::Script;
+
+    // Batched actions are executed by batch handler registered for backend
+    bool batched = false;
+
+    std::function<void()> handler;
+    action_batch_element_t batch_element;
+
+    std::chrono::steady_clock::time_point enqueue_time;
+};
+
+// Bounded queues of actions with fixed number of workers
+// It replaces thread per action approach which creates hundreds of threads during attacks on many hosts
+// Each backend has own queue and workers and slow or hung notify scripts do not delay BGP announces
+class action_dispatcher_t {
+    public:
+    typedef std::function<void(const std::vector<action_batch_element_t>&)> batch_handler_t;
+
+    void set_queue_capacity(size_t queue_capacity) {
+        this->queue_capacity = queue_capacity;
+    }
+
+    void set_maximum_batch_size(size_t maximum_batch_size) {
+        // We need at least one element in batch
+        if (maximum_batch_size == 0) {
+            maximum_batch_size = 1;
+        }
+
+        this->maximum_batch_size = maximum_batch_size;
+    }
+
+    // Should be called before we start workers
+    void set_number_of_workers(action_backend_t backend, unsigned int number_of_workers) {
+        if (number_of_workers == 0) {
+            number_of_workers = 1;
+        }
+
+        if (is_ordered_action_backend(backend) && number_of_workers != 1) {
+            logger << log4cpp::Priority::WARN << "Actions for " << get_action_backend_name(backend)
+                   << " must be executed in order, we will use single worker for them";
+            number_of_workers = 1;
+        }
+
+        get_backend_queue(backend).number_of_workers = number_of_workers;
+    }
+
+    unsigned int get_number_of_workers(action_backend_t backend) {
+        return get_backend_queue(backend).number_of_workers;
+    }
+
+    // Should be called before we start workers
+    void register_batch_handler(action_backend_t backend, batch_handler_t batch_handler) {
+        batch_handlers[backend] = batch_handler;
+    }
+
+    bool enqueue(action_backend_t backend, std::function<void()> handler) {
+        action_t action;
+        action.backend = backend;
+        action.handler = handler;
+
+        return enqueue_action(action);
+    }
+
+    bool enqueue_batched(action_backend_t backend, const action_batch_element_t& batch_element) {
+        action_t action;
+        action.backend       = backend;
+        action.batched       = true;
+        action.batch_element = batch_element;
+
+        return enqueue_action(action);
+    }
+
+    // Worker loop for backend, it could be stopped only with boost::thread::interrupt()
+    void run_worker(action_backend_t backend) {
+        backend_queue_t& backend_queue = get_backend_queue(backend);
+
+        while (true) {
+            std::vector<action_t> actions;
+
+            {
+                boost::unique_lock<boost::mutex> lock(backend_queue.queue_mutex);
+
+                // It's interruption point for boost threads
+                while (backend_queue.queue.empty()) {
+                    backend_queue.queue_condition.wait(lock);
+                }
+
+                actions.push_back(backend_queue.queue.front());
+                backend_queue.queue.pop_front();
+
+                // Pick following batched elements, we take them only from head of queue to keep order of actions
+                if (actions.front().batched) {
+                    while (!backend_queue.queue.empty() && backend_queue.queue.front().batched &&
+                           actions.size() < maximum_batch_size) {
+                        actions.push_back(backend_queue.queue.front());
+                        backend_queue.queue.pop_front();
+                    }
+                }
+
+                backend_queue.queue_depth = backend_queue.queue.size();
+            }
+
+            // Producers of ordered backends may wait for space in queue
+            backend_queue.space_condition.notify_all();
+
+            execute_actions(actions);
+        }
+    }
+
+    std::vector<system_counter_t> get_statistics() const {
+        std::vector<system_counter_t> system_counters;
+
+        uint64_t queue_depth = 0;
+
+        for (const auto& backend_queue : backend_queues) {
+            queue_depth += backend_queue.queue_depth.load();
+        }
+
+        system_counters.push_back(system_counter_t("action_queue_depth", queue_depth, metric_type_t::gauge,
+                                                   "Number of ban and unban actions waiting in queues"));
+
+        for (unsigned int backend_index = 0; backend_index < number_of_action_backends; backend_index++) {
+            std::string backend_name = get_action_backend_name(action_backend_t(backend_index));
+
+            system_counters.push_back(system_counter_t("action_queue_depth_" + backend_name,
+                                                       backend_queues[backend_index].queue_depth.load(), metric_type_t::gauge,
+                                                       "Number of actions waiting in " + backend_name + " queue"));
+        }
+
+        system_counters.push_back(system_counter_t("action_queue_dropped", actions_dropped.load(), metric_type_t::counter,
+                                                   "Number of actions dropped because queue was full"));
+        system_counters.push_back(system_counter_t("action_queue_blocked", actions_blocked.load(), metric_type_t::counter,
+                                                   "Number of BGP actions which waited for space in full queue"));
+        system_counters.push_back(system_counter_t("actions_executed", actions_executed.load(), metric_type_t::counter,
+                                                   "Number of executed ban and unban actions"));
+        system_counters.push_back(system_counter_t("action_batches_executed", action_batches_executed.load(),
+                                                   metric_type_t::counter, "Number of batches passed to batch handlers"));
+        system_counters.push_back(system_counter_t("action_latency_microseconds_total", action_latency_microseconds_total.load(),
+                                                   metric_type_t::counter, "Total time from enqueue to completion of actions"));
+        system_counters.push_back(system_counter_t("action_maximum_latency_microseconds",
+                                                   action_maximum_latency_microseconds.load(), metric_type_t::gauge,
+                                                   "Maximum time from enqueue to completion of action"));
+
+        return system_counters;
+    }
+
+    private:
+    class backend_queue_t {
+        public:
+        unsigned int number_of_workers = 1;
+
+        boost::mutex queue_mutex;
+        boost::condition_variable queue_condition;
+
+        // Signaled when worker took actions from queue
+        boost::condition_variable space_condition;
+        std::deque<action_t> queue;
+
+        std::atomic<uint64_t> queue_depth{ 0 };
+    };
+
+    backend_queue_t& get_backend_queue(action_backend_t backend) {
+        return backend_queues[(unsigned int)backend];
+    }
+
+    bool enqueue_action(action_t& action) {
+        action.enqueue_time = std::chrono::steady_clock::now();
+
+        backend_queue_t& backend_queue = get_backend_queue(action.backend);
+
+        {
+            boost::unique_lock<boost::mutex> lock(backend_queue.queue_mutex);
+
+            if (backend_queue.queue.size() >= queue_capacity) {
+                // Lost withdrawal keeps blackhole announced and we never drop BGP actions, we wait for worker instead
+                if (is_ordered_action_backend(action.backend)) {
+                    actions_blocked++;
+
+                    logger << log4cpp::Priority::WARN << "Action queue for " << get_action_backend_name(action.backend)
+                           << " is full with " << backend_queue.queue.size() << " elements, we wait for space in it";
+
+                    while (backend_queue.queue.size() >= queue_capacity) {
+                        backend_queue.space_condition.wait(lock);
+                    }
+                } else {
+                    actions_dropped++;
+
+                    logger << log4cpp::Priority::ERROR << "Action queue for " << get_action_backend_name(action.backend)
+                           << " is full with " << backend_queue.queue.size() << " elements, we drop action";
+                    return false;
+                }
+            }
+
+            backend_queue.queue.push_back(action);
+            backend_queue.queue_depth = backend_queue.queue.size();
+        }
+
+        backend_queue.queue_condition.notify_one();
+
+        return true;
+    }
+
+    void execute_actions(const std::vector<action_t>& actions) {
+        try {
+            if (actions.front().batched) {
+                auto batch_handler = batch_handlers.find(actions.front().backend);
+
+                if (batch_handler == batch_handlers.end()) {
+                    logger << log4cpp::Priority::ERROR << "We have no batch handler for backend "
+                           << get_action_backend_name(actions.front().backend);
+                } else {
+                    std::vector<action_batch_element_t> batch_elements;
+
+                    for (const auto& action : actions) {
+                        batch_elements.push_back(action.batch_element);
+                    }
+
+                    batch_handler->second(batch_elements);
+                    action_batches_executed++;
+                }
+            } else {
+                actions.front().handler();
+            }
+        } catch (const boost::thread_interrupted&) {
+            throw;
+        } catch (const std::exception& e) {
+            logger << log4cpp::Priority::ERROR << "Action for backend " << get_action_backend_name(actions.front().backend)
+                   << " failed with exception: " << e.what();
+        } catch (...) {
+            logger << log4cpp::Priority::ERROR << "Action for backend " << get_action_backend_name(actions.front().backend)
+                   << " failed with unknown exception";
+        }
+
+        auto now = std::chrono::steady_clock::now();
+
+        for (const auto& action : actions) {
+            uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(now - action.enqueue_time).count();
+
+            action_latency_microseconds_total += latency;
+
+            // Keep maximum without locks
+            uint64_t current_maximum = action_maximum_latency_microseconds.load();
+
+            while (latency > current_maximum && !action_maximum_latency_microseconds.compare_exchange_weak(current_maximum, latency)) {
+            }
+        }
+
+        actions_executed += actions.size();
+    }
+
+    size_t queue_capacity     = 8192;
+    size_t maximum_batch_size = 256;
+
+    std::array<backend_queue_t, number_of_action_backends> backend_queues;
+
+    std::map<action_backend_t, batch_handler_t> batch_handlers;
+
+    std::atomic<uint64_t> actions_dropped{ 0 };
+    std::atomic<uint64_t> actions_blocked{ 0 };
+    std::atomic<uint64_t> actions_executed{ 0 };
+    std::atomic<uint64_t> action_batches_executed{ 0 };
+    std::atomic<uint64_t> action_latency_microseconds_total{ 0 };
+    std::atomic<uint64_t> action_maximum_latency_microseconds{ 0 };
+};
@@ -17,49 +17,86 @@ extern bool exabgp_announce_whole_subnet;
 
 extern log4cpp::Category& logger;
 
-// Low level ExaBGP ban management
-void exabgp_prefix_ban_manage(std::string action, std::string prefix_as_string_with_mask, std::string exabgp_next_hop, std::string exabgp_community) {
-
-    /* Buffer for BGP message */
-    char bgp_message[256];
-
+// Builds ExaBGP API command for announce or withdrawal of prefix
+std::string exabgp_prefix_ban_message(std::string action, std::string prefix_as_string_with_mask, std::string exabgp_next_hop, std::string exabgp_community) {
     if (action == "ban") {
-        sprintf(bgp_message, "announce route %s next-hop %s community %s\n", prefix_as_string_with_mask.c_str(),
-                exabgp_next_hop.c_str(), exabgp_community.c_str());
+        return "announce route " + prefix_as_string_with_mask + " next-hop " + exabgp_next_hop + " community " +
+               exabgp_community + "\n";
     } else {
-        sprintf(bgp_message, "withdraw route %s next-hop %s\n", prefix_as_string_with_mask.c_str(), exabgp_next_hop.c_str());
+        return "withdraw route " + prefix_as_string_with_mask + " next-hop " + exabgp_next_hop + "\n";
+    }
+}
+
+// Writes all messages to ExaBGP pipe with single write call
+bool exabgp_write_messages(const std::vector<std::string>& messages) {
+    std::string bgp_messages;
+
+    for (const auto& message : messages) {
+        logger << log4cpp::Priority::INFO << "ExaBGP announce message: " << message;
+
+        bgp_messages += message;
     }
 
-    logger << log4cpp::Priority::INFO << "ExaBGP announce message: " << bgp_message;
+    if (bgp_messages.empty()) {
+        return true;
+    }
 
     int exabgp_pipe = open(exabgp_command_pipe.c_str(), O_WRONLY);
 
     if (exabgp_pipe <= 0) {
         logger << log4cpp::Priority::ERROR << "Can't open ExaBGP pipe " << exabgp_command_pipe << " Ban is not executed";
-        return;
+        return false;
     }
 
-    int wrote_bytes = write(exabgp_pipe, bgp_message, strlen(bgp_message));
+    ssize_t wrote_bytes = write(exabgp_pipe, bgp_messages.c_str(), bgp_messages.size());
 
-    if (wrote_bytes != strlen(bgp_message)) {
+    close(exabgp_pipe);
+
+    if (wrote_bytes != (ssize_t)bgp_messages.size()) {
         logger << log4cpp::Priority::ERROR << "Can't write message to ExaBGP pipe";
+        return false;
     }
 
-    close(exabgp_pipe);
+    return true;
 }
 
-void exabgp_ban_manage(std::string action, std::string ip_as_string, attack_details_t current_attack) {
+// Low level ExaBGP ban management
+void exabgp_prefix_ban_manage(std::string action, std::string prefix_as_string_with_mask, std::string exabgp_next_hop, std::string exabgp_community) {
+    exabgp_write_messages({ exabgp_prefix_ban_message(action, prefix_as_string_with_mask, exabgp_next_hop, exabgp_community) });
+}
+
+// Returns all ExaBGP messages which we need for ban or unban of host
+std::vector<std::string> exabgp_ban_messages(std::string action, std::string ip_as_string, attack_details_t current_attack) {
+    std::vector<std::string> messages;
+
     // We will announce whole subent here
     if (exabgp_announce_whole_subnet) {
         std::string subnet_as_string_with_mask = convert_subnet_to_string(current_attack.customer_network);
 
-        exabgp_prefix_ban_manage(action, subnet_as_string_with_mask, exabgp_next_hop, exabgp_community_subnet);
+        messages.push_back(exabgp_prefix_ban_message(action, subnet_as_string_with_mask, exabgp_next_hop, exabgp_community_subnet));
     }
 
     // And we could announce single host here (/32)
     if (exabgp_announce_host) {
         std::string ip_as_string_with_mask = ip_as_string + "/32";
 
-        exabgp_prefix_ban_manage(action, ip_as_string_with_mask, exabgp_next_hop, exabgp_community_host);
+        messages.push_back(exabgp_prefix_ban_message(action, ip_as_string_with_mask, exabgp_next_hop, exabgp_community_host));
+    }
+
+    return messages;
+}
+
+// Returns ExaBGP messages for announce or withdrawal of flow spec rules
+std::vector<std::string> exabgp_flow_spec_messages(std::string action, const std::vector<flow_spec_rule_t>& flow_spec_rules) {
+    std::vector<std::string> messages;
+
+    for (const auto& flow_spec_rule : flow_spec_rules) {
+        messages.push_back(serialize_flow_spec_rule_for_exabgp(flow_spec_rule, action != "ban"));
     }
+
+    return messages;
+}
+
+void exabgp_ban_manage(std::string action, std::string ip_as_string, attack_details_t current_attack) {
+    exabgp_write_messages(exabgp_ban_messages(action, ip_as_string, current_attack));
 }
@@ -1,4 +1,9 @@
+#include "../bgp_protocol.hpp"
 #include "../fastnetmon_types.hpp"
 #include <string>
+#include <vector>
 
 void exabgp_ban_manage(std::string action, std::string ip_as_string, attack_details_t current_attack);
+std::vector<std::string> exabgp_ban_messages(std::string action, std::string ip_as_string, attack_details_t current_attack);
+bool exabgp_write_messages(const std::vector<std::string>& messages);
+std::vector<std::string> exabgp_flow_spec_messages(std::string action, const std::vector<flow_spec_rule_t>& flow_spec_rules);
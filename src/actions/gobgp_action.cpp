@@ -23,95 +23,259 @@
 #endif // __GNUC__
 
 
+#include <boost/thread.hpp>
+
+#include <atomic>
+#include <deque>
+
 unsigned int gobgp_client_connection_timeout = 5;
 
+// We collect announces and withdrawals for this time and send them in single request
+unsigned int gobgp_announce_batch_window_milliseconds = 50;
+
+// Number of attempts to send batch to GoBGP before we drop announces from it, withdrawals are queued again
+unsigned int gobgp_announce_attempts = 5;
+
+// Delay before first retry, it's doubled after each failed attempt
+unsigned int gobgp_announce_retry_delay_milliseconds = 100;
+
+// We do not increase delay between retries above this value
+unsigned int gobgp_announce_maximum_retry_delay_milliseconds = 5000;
+
+// Thread which sends paths with gobgp_client
+boost::thread* gobgp_announce_thread_handle = NULL;
+
+std::string gobgp_paths_announced_desc = "Number of paths accepted by GoBGP";
+std::atomic<uint64_t> gobgp_paths_announced{ 0 };
+
+std::string gobgp_paths_failed_desc = "Number of announces we dropped after all retries to GoBGP failed";
+std::atomic<uint64_t> gobgp_paths_failed{ 0 };
+
+std::string gobgp_withdrawals_requeued_desc = "Number of withdrawals we queued again after all retries to GoBGP failed";
+std::atomic<uint64_t> gobgp_withdrawals_requeued{ 0 };
+
+std::string gobgp_stream_requests_desc = "Number of batched path stream requests sent to GoBGP";
+std::atomic<uint64_t> gobgp_stream_requests{ 0 };
+
+std::string gobgp_stream_retries_desc = "Number of retries for path stream requests to GoBGP";
+std::atomic<uint64_t> gobgp_stream_retries{ 0 };
+
+std::string gobgp_announce_latency_microseconds_total_desc = "Total time from detection to path accepted by GoBGP";
+std::atomic<uint64_t> gobgp_announce_latency_microseconds_total{ 0 };
+
+std::string gobgp_announce_maximum_latency_microseconds_desc = "Maximum time from detection to path accepted by GoBGP";
+std::atomic<uint64_t> gobgp_announce_maximum_latency_microseconds{ 0 };
+
 using grpc::Channel;
 using grpc::ClientContext;
 using grpc::Status;
 
 using gobgpapi::GobgpApi;
 
-class GrpcClient {
+// Path waiting for announce or withdrawal
+class gobgp_pending_path_t {
     public:
-    GrpcClient(std::shared_ptr<Channel> channel) : stub_(GobgpApi::NewStub(channel)) {
+    gobgpapi::Path path;
+
+    // Time when we've got request for announce
+    std::chrono::steady_clock::time_point request_time;
+};
+
+// Creates unicast path for announce or withdrawal
+gobgpapi::Path build_unicast_path(bool ipv6,
+                                  const std::string& announced_address,
+                                  unsigned int cidr_mask,
+                                  const std::string& announced_prefix_nexthop,
+                                  bool is_withdrawal,
+                                  uint32_t community_as_32bit_int) {
+    gobgpapi::Path current_path;
+
+    auto gobgp_unicast_route_family = new gobgpapi::Family;
+
+    if (ipv6) {
+        gobgp_unicast_route_family->set_afi(gobgpapi::Family::AFI_IP6);
+    } else {
+        gobgp_unicast_route_family->set_afi(gobgpapi::Family::AFI_IP);
     }
 
-    bool AnnounceUnicastPrefixIPv4(std::string announced_address,
-                                   std::string announced_prefix_nexthop,
-                                   bool is_withdrawal,
-                                   unsigned int cidr_mask,
-                                   uint32_t community_as_32bit_int) {
-        grpc::ClientContext context;
+    gobgp_unicast_route_family->set_safi(gobgpapi::Family::SAFI_UNICAST);
 
-        // Set timeout for API
-        std::chrono::system_clock::time_point deadline =
-            std::chrono::system_clock::now() + std::chrono::seconds(gobgp_client_connection_timeout);
-        context.set_deadline(deadline);
+    current_path.set_allocated_family(gobgp_unicast_route_family);
 
-        auto gobgp_ipv4_unicast_route_family = new gobgpapi::Family;
-        gobgp_ipv4_unicast_route_family->set_afi(gobgpapi::Family::AFI_IP);
-        gobgp_ipv4_unicast_route_family->set_safi(gobgpapi::Family::SAFI_UNICAST);
+    if (is_withdrawal) {
+        current_path.set_is_withdraw(true);
+    }
 
-        gobgpapi::AddPathRequest request;
-        request.set_table_type(gobgpapi::TableType::GLOBAL);
+    // Configure required announce
+    google::protobuf::Any* current_nlri = new google::protobuf::Any;
+    gobgpapi::IPAddressPrefix current_ipaddrprefix;
+    current_ipaddrprefix.set_prefix(announced_address);
+    current_ipaddrprefix.set_prefix_len(cidr_mask);
+
+    current_nlri->PackFrom(current_ipaddrprefix);
+    current_path.set_allocated_nlri(current_nlri);
+
+    // Updating OriginAttribute info for current_path
+    google::protobuf::Any* current_origin = current_path.add_pattrs();
+    gobgpapi::OriginAttribute current_origin_t;
+    current_origin_t.set_origin(0);
+    current_origin->PackFrom(current_origin_t);
+
+    // Updating NextHopAttribute info for current_path
+    google::protobuf::Any* current_next_hop = current_path.add_pattrs();
+    gobgpapi::NextHopAttribute current_next_hop_t;
+    current_next_hop_t.set_next_hop(announced_prefix_nexthop);
+    current_next_hop->PackFrom(current_next_hop_t);
+
+    // Updating CommunitiesAttribute for current_path
+    google::protobuf::Any* current_communities = current_path.add_pattrs();
+    gobgpapi::CommunitiesAttribute current_communities_t;
+    current_communities_t.add_communities(community_as_32bit_int);
+    current_communities->PackFrom(current_communities_t);
+
+    return current_path;
+}
 
-        gobgpapi::Path* current_path = new gobgpapi::Path;
+// Flow spec component types and operators from RFC 5575
+const uint32_t flow_spec_component_destination_prefix = 1;
+const uint32_t flow_spec_component_protocol           = 3;
+const uint32_t flow_spec_component_destination_port   = 5;
+const uint32_t flow_spec_component_source_port        = 6;
+const uint32_t flow_spec_component_packet_length      = 10;
+const uint32_t flow_spec_component_fragment           = 12;
+
+const uint32_t flow_spec_numeric_operator_and              = 0x40;
+const uint32_t flow_spec_numeric_operator_equal            = 0x01;
+const uint32_t flow_spec_numeric_operator_greater_or_equal = 0x03;
+const uint32_t flow_spec_numeric_operator_less_or_equal    = 0x05;
+const uint32_t flow_spec_bitmask_operator_match            = 0x01;
+
+const uint64_t flow_spec_fragment_is_fragment = 0x02;
+
+// Adds component which matches any of specified values
+void add_flow_spec_numeric_component(gobgpapi::FlowSpecNLRI& flow_spec_nlri, uint32_t type, const std::vector<uint64_t>& values) {
+    if (values.empty()) {
+        return;
+    }
 
-        current_path->set_allocated_family(gobgp_ipv4_unicast_route_family);
+    gobgpapi::FlowSpecComponent component;
+    component.set_type(type);
 
-        if (is_withdrawal) {
-            current_path->set_is_withdraw(true);
-        }
+    for (auto value : values) {
+        gobgpapi::FlowSpecComponentItem* item = component.add_items();
+        item->set_op(flow_spec_numeric_operator_equal);
+        item->set_value(value);
+    }
 
-        // Configure required announce
-        google::protobuf::Any* current_nlri = new google::protobuf::Any;
-        gobgpapi::IPAddressPrefix current_ipaddrprefix;
-        current_ipaddrprefix.set_prefix(announced_address);
-        current_ipaddrprefix.set_prefix_len(cidr_mask);
+    flow_spec_nlri.add_rules()->PackFrom(component);
+}
 
-        current_nlri->PackFrom(current_ipaddrprefix);
-        current_path->set_allocated_nlri(current_nlri);
+// Creates flow spec path for announce or withdrawal
+gobgpapi::Path build_flow_spec_path(const flow_spec_rule_t& flow_spec_rule, bool is_withdrawal) {
+    gobgpapi::Path current_path;
 
-        // Updating OriginAttribute info for current_path
-        google::protobuf::Any* current_origin = current_path->add_pattrs();
-        gobgpapi::OriginAttribute current_origin_t;
-        current_origin_t.set_origin(0);
-        current_origin->PackFrom(current_origin_t);
+    auto gobgp_flow_spec_route_family = new gobgpapi::Family;
+    gobgp_flow_spec_route_family->set_afi(gobgpapi::Family::AFI_IP);
+    gobgp_flow_spec_route_family->set_safi(gobgpapi::Family::SAFI_FLOW_SPEC_UNICAST);
 
-        // Updating NextHopAttribute info for current_path
-        google::protobuf::Any* current_next_hop = current_path->add_pattrs();
-        gobgpapi::NextHopAttribute current_next_hop_t;
-        current_next_hop_t.set_next_hop(announced_prefix_nexthop);
-        current_next_hop->PackFrom(current_next_hop_t);
+    current_path.set_allocated_family(gobgp_flow_spec_route_family);
 
-        // Updating CommunitiesAttribute for current_path
-        google::protobuf::Any* current_communities = current_path->add_pattrs();
-        gobgpapi::CommunitiesAttribute current_communities_t;
-        current_communities_t.add_communities(community_as_32bit_int);
-        current_communities->PackFrom(current_communities_t);
+    if (is_withdrawal) {
+        current_path.set_is_withdraw(true);
+    }
 
-        request.set_allocated_path(current_path);
+    gobgpapi::FlowSpecNLRI flow_spec_nlri;
 
-        gobgpapi::AddPathResponse response;
+    if (flow_spec_rule.is_destination_subnet_used()) {
+        gobgpapi::FlowSpecIPPrefix destination_prefix;
+        destination_prefix.set_type(flow_spec_component_destination_prefix);
+        destination_prefix.set_prefix(convert_ip_as_uint_to_string(flow_spec_rule.get_destination_subnet().subnet_address));
+        destination_prefix.set_prefix_len(flow_spec_rule.get_destination_subnet().cidr_prefix_length);
 
-        // Don't be confused by name, it also can withdraw announces
-        auto status = stub_->AddPath(&context, request, &response);
+        flow_spec_nlri.add_rules()->PackFrom(destination_prefix);
+    }
 
-        if (!status.ok()) {
-            logger << log4cpp::Priority::ERROR << "AddPath request to BGP daemon failed with code: " << status.error_code()
-                   << " message " << status.error_message();
+    std::vector<uint64_t> protocols;
 
-            return false;
+    for (auto protocol : flow_spec_rule.get_protocols()) {
+        protocols.push_back(convert_flow_spec_protocol_to_ip_protocol(protocol));
+    }
+
+    add_flow_spec_numeric_component(flow_spec_nlri, flow_spec_component_protocol, protocols);
+
+    add_flow_spec_numeric_component(flow_spec_nlri, flow_spec_component_destination_port,
+                                    std::vector<uint64_t>(flow_spec_rule.get_destination_ports().begin(),
+                                                          flow_spec_rule.get_destination_ports().end()));
+
+    add_flow_spec_numeric_component(flow_spec_nlri, flow_spec_component_source_port,
+                                    std::vector<uint64_t>(flow_spec_rule.get_source_ports().begin(),
+                                                          flow_spec_rule.get_source_ports().end()));
+
+    // We support only ranges of lengths here as generator does not produce exact lengths
+    for (const auto& packet_length_range : flow_spec_rule.get_packet_length_ranges()) {
+        gobgpapi::FlowSpecComponent packet_length;
+        packet_length.set_type(flow_spec_component_packet_length);
+
+        gobgpapi::FlowSpecComponentItem* minimum_length = packet_length.add_items();
+        minimum_length->set_op(flow_spec_numeric_operator_greater_or_equal);
+        minimum_length->set_value(packet_length_range.first);
+
+        gobgpapi::FlowSpecComponentItem* maximum_length = packet_length.add_items();
+        maximum_length->set_op(flow_spec_numeric_operator_and | flow_spec_numeric_operator_less_or_equal);
+        maximum_length->set_value(packet_length_range.second);
+
+        flow_spec_nlri.add_rules()->PackFrom(packet_length);
+    }
+
+    for (auto fragmentation_flag : flow_spec_rule.get_fragmentation_flags()) {
+        if (fragmentation_flag != FLOW_SPEC_IS_A_FRAGMENT) {
+            logger << log4cpp::Priority::WARN << "We support only is-fragment flag for GoBGP flow spec";
+            continue;
         }
 
+        gobgpapi::FlowSpecComponent fragment;
+        fragment.set_type(flow_spec_component_fragment);
 
-        return true;
+        gobgpapi::FlowSpecComponentItem* fragment_item = fragment.add_items();
+        fragment_item->set_op(flow_spec_bitmask_operator_match);
+        fragment_item->set_value(flow_spec_fragment_is_fragment);
+
+        flow_spec_nlri.add_rules()->PackFrom(fragment);
     }
 
-    bool AnnounceUnicastPrefixIPv6(const subnet_ipv6_cidr_mask_t& client_ipv6,
-                                   const subnet_ipv6_cidr_mask_t& ipv6_next_hop,
-                                   bool is_withdrawal,
-                                   uint32_t community_as_32bit_int) {
+    google::protobuf::Any* current_nlri = new google::protobuf::Any;
+    current_nlri->PackFrom(flow_spec_nlri);
+    current_path.set_allocated_nlri(current_nlri);
+
+    google::protobuf::Any* current_origin = current_path.add_pattrs();
+    gobgpapi::OriginAttribute current_origin_t;
+    current_origin_t.set_origin(0);
+    current_origin->PackFrom(current_origin_t);
+
+    // Traffic rate with zero rate is discard, accept has no extended community
+    const bgp_flow_spec_action_t& action = flow_spec_rule.get_action();
+
+    if (action.get_type() == FLOW_SPEC_ACTION_DISCARD or action.get_type() == FLOW_SPEC_ACTION_RATE_LIMIT) {
+        gobgpapi::TrafficRateExtended traffic_rate;
+        traffic_rate.set_as(0);
+        traffic_rate.set_rate(action.get_type() == FLOW_SPEC_ACTION_DISCARD ? 0 : action.get_rate_limit());
+
+        gobgpapi::ExtendedCommunitiesAttribute extended_communities;
+        extended_communities.add_communities()->PackFrom(traffic_rate);
+
+        current_path.add_pattrs()->PackFrom(extended_communities);
+    }
+
+    return current_path;
+}
+
+class GrpcClient {
+    public:
+    GrpcClient(std::shared_ptr<Channel> channel) : stub_(GobgpApi::NewStub(channel)) {
+    }
+
+    // Sends all paths over single client stream
+    bool AddPathStream(const std::vector<gobgp_pending_path_t>& pending_paths) {
         grpc::ClientContext context;
 
         // Set timeout for API
@@ -119,71 +283,46 @@ class GrpcClient {
             std::chrono::system_clock::now() + std::chrono::seconds(gobgp_client_connection_timeout);
         context.set_deadline(deadline);
 
-        auto gobgp_ipv6_unicast_route_family = new gobgpapi::Family;
-        gobgp_ipv6_unicast_route_family->set_afi(gobgpapi::Family::AFI_IP6);
-        gobgp_ipv6_unicast_route_family->set_safi(gobgpapi::Family::SAFI_UNICAST);
-
-        gobgpapi::AddPathRequest request;
+        gobgpapi::AddPathStreamRequest request;
         request.set_table_type(gobgpapi::TableType::GLOBAL);
 
-        gobgpapi::Path* current_path = new gobgpapi::Path;
-
-        current_path->set_allocated_family(gobgp_ipv6_unicast_route_family);
-
-        if (is_withdrawal) {
-            current_path->set_is_withdraw(true);
+        for (const auto& pending_path : pending_paths) {
+            *request.add_paths() = pending_path.path;
         }
 
-        // Configure required announce
-        google::protobuf::Any* current_nlri = new google::protobuf::Any;
-        gobgpapi::IPAddressPrefix current_ipaddrprefix;
-        current_ipaddrprefix.set_prefix(print_ipv6_address(client_ipv6.subnet_address));
-        current_ipaddrprefix.set_prefix_len(client_ipv6.cidr_prefix_length);
+        google::protobuf::Empty response;
 
-        current_nlri->PackFrom(current_ipaddrprefix);
-        current_path->set_allocated_nlri(current_nlri);
-
-        // Updating OriginAttribute info for current_path
-        google::protobuf::Any* current_origin = current_path->add_pattrs();
-        gobgpapi::OriginAttribute current_origin_t;
-        current_origin_t.set_origin(0);
-        current_origin->PackFrom(current_origin_t);
-
-        // Updating NextHopAttribute info for current_path
-        google::protobuf::Any* current_next_hop = current_path->add_pattrs();
-        gobgpapi::NextHopAttribute current_next_hop_t;
-        current_next_hop_t.set_next_hop(print_ipv6_address(ipv6_next_hop.subnet_address));
-        current_next_hop->PackFrom(current_next_hop_t);
-
-        // Updating CommunitiesAttribute for current_path
-        google::protobuf::Any* current_communities = current_path->add_pattrs();
-        gobgpapi::CommunitiesAttribute current_communities_t;
-        current_communities_t.add_communities(community_as_32bit_int);
-        current_communities->PackFrom(current_communities_t);
+        // Don't be confused by name, it also can withdraw announces
+        std::unique_ptr<grpc::ClientWriterInterface<gobgpapi::AddPathStreamRequest>> writer =
+            stub_->AddPathStream(&context, &response);
 
-        request.set_allocated_path(current_path);
+        if (!writer->Write(request)) {
+            logger << log4cpp::Priority::ERROR << "Cannot write paths to GoBGP stream";
+        }
 
-        gobgpapi::AddPathResponse response;
+        writer->WritesDone();
 
-        // Don't be confused by name, it also can withdraw announces
-        auto status = stub_->AddPath(&context, request, &response);
+        auto status = writer->Finish();
 
         if (!status.ok()) {
-            logger << log4cpp::Priority::ERROR << "AddPath request to BGP daemon failed with code: " << status.error_code()
+            logger << log4cpp::Priority::ERROR << "AddPathStream request to BGP daemon failed with code: " << status.error_code()
                    << " message " << status.error_message();
 
             return false;
         }
 
-
         return true;
     }
 
-
     private:
     std::unique_ptr<GobgpApi::Stub> stub_;
 };
 
+// Paths waiting for announce thread
+boost::mutex gobgp_pending_paths_mutex;
+boost::condition_variable gobgp_pending_paths_condition;
+std::deque<gobgp_pending_path_t> gobgp_pending_paths;
+
 GrpcClient* gobgp_client         = NULL;
 std::string gobgp_nexthop        = "0.0.0.0";
 bool gobgp_announce_whole_subnet = false;
@@ -204,7 +343,44 @@ subnet_ipv6_cidr_mask_t ipv6_next_hop;
 
 void gobgp_action_init() {
     logger << log4cpp::Priority::INFO << "GoBGP action module loaded";
-    gobgp_client = new GrpcClient(grpc::CreateChannel("localhost:50051", grpc::InsecureChannelCredentials()));
+
+    // We keep single channel for whole life of daemon and keepalives help us to detect broken connection before announce
+    grpc::ChannelArguments channel_arguments;
+    channel_arguments.SetInt(GRPC_ARG_KEEPALIVE_TIME_MS, 10000);
+    channel_arguments.SetInt(GRPC_ARG_KEEPALIVE_PERMIT_WITHOUT_CALLS, 1);
+
+    gobgp_client = new GrpcClient(grpc::CreateCustomChannel("localhost:50051", grpc::InsecureChannelCredentials(), channel_arguments));
+
+    if (configuration_map.count("gobgp_announce_batch_window_milliseconds")) {
+        gobgp_announce_batch_window_milliseconds =
+            convert_string_to_integer(configuration_map["gobgp_announce_batch_window_milliseconds"]);
+    }
+
+    if (configuration_map.count("gobgp_announce_attempts")) {
+        gobgp_announce_attempts = convert_string_to_integer(configuration_map["gobgp_announce_attempts"]);
+    }
+
+    if (configuration_map.count("gobgp_announce_retry_delay_milliseconds")) {
+        gobgp_announce_retry_delay_milliseconds =
+            convert_string_to_integer(configuration_map["gobgp_announce_retry_delay_milliseconds"]);
+    }
+
+    if (configuration_map.count("gobgp_announce_maximum_retry_delay_milliseconds")) {
+        gobgp_announce_maximum_retry_delay_milliseconds =
+            convert_string_to_integer(configuration_map["gobgp_announce_maximum_retry_delay_milliseconds"]);
+    }
+
+    // With zero attempts we will never send anything to GoBGP
+    if (gobgp_announce_attempts < 1) {
+        logger << log4cpp::Priority::ERROR << "gobgp_announce_attempts must be at least 1, we will use 1";
+        gobgp_announce_attempts = 1;
+    }
+
+    if (gobgp_announce_maximum_retry_delay_milliseconds < gobgp_announce_retry_delay_milliseconds) {
+        logger << log4cpp::Priority::ERROR << "gobgp_announce_maximum_retry_delay_milliseconds cannot be lower than "
+               << "gobgp_announce_retry_delay_milliseconds, we will use " << gobgp_announce_retry_delay_milliseconds;
+        gobgp_announce_maximum_retry_delay_milliseconds = gobgp_announce_retry_delay_milliseconds;
+    }
 
     if (configuration_map.count("gobgp_next_hop")) {
         gobgp_nexthop = configuration_map["gobgp_next_hop"];
@@ -301,10 +477,41 @@ void gobgp_action_init() {
            << bgp_community_subnet_ipv6.community_number;
 }
 
+// Starts thread which sends announces and withdrawals to GoBGP over persistent channel
+void gobgp_start_announce_thread() {
+    gobgp_announce_thread_handle = new boost::thread(gobgp_announce_thread);
+    set_boost_process_name(gobgp_announce_thread_handle, "gobgp");
+}
+
 void gobgp_action_shutdown() {
+    // Announce thread uses client and we should stop it before we remove client
+    if (gobgp_announce_thread_handle != NULL) {
+        gobgp_announce_thread_handle->interrupt();
+        gobgp_announce_thread_handle->join();
+
+        delete gobgp_announce_thread_handle;
+        gobgp_announce_thread_handle = NULL;
+    }
+
     delete gobgp_client;
+    gobgp_client = NULL;
+}
+
+// Adds path to queue of announce thread
+void gobgp_queue_path(const gobgpapi::Path& path) {
+    gobgp_pending_path_t pending_path;
+    pending_path.path         = path;
+    pending_path.request_time = std::chrono::steady_clock::now();
+
+    {
+        boost::lock_guard<boost::mutex> lock_guard(gobgp_pending_paths_mutex);
+        gobgp_pending_paths.push_back(pending_path);
+    }
+
+    gobgp_pending_paths_condition.notify_one();
 }
 
+// It does not block and only queues paths for gobgp_announce_thread
 void gobgp_ban_manage(std::string action, bool ipv6, std::string ip_as_string, subnet_ipv6_cidr_mask_t client_ipv6, attack_details_t current_attack) {
     bool is_withdrawal = false;
 
@@ -328,11 +535,12 @@ void gobgp_ban_manage(std::string action, bool ipv6, std::string ip_as_string, s
             uint32_t community_as_32bit_int =
                 uint32_t(bgp_community_host_ipv6.asn_number << 16 | bgp_community_host_ipv6.community_number);
 
-            gobgp_client->AnnounceUnicastPrefixIPv6(client_ipv6, ipv6_next_hop, is_withdrawal, community_as_32bit_int);
+            gobgp_queue_path(build_unicast_path(true, print_ipv6_address(client_ipv6.subnet_address), client_ipv6.cidr_prefix_length,
+                                                print_ipv6_address(ipv6_next_hop.subnet_address), is_withdrawal,
+                                                community_as_32bit_int));
         }
     } else {
         if (gobgp_announce_whole_subnet) {
-            std::string subnet_as_string_with_mask = convert_subnet_to_string(current_attack.customer_network);
             logger << log4cpp::Priority::INFO << action_name << " "
                    << convert_subnet_to_string(current_attack.customer_network) << " to GoBGP";
 
@@ -340,9 +548,9 @@ void gobgp_ban_manage(std::string action, bool ipv6, std::string ip_as_string, s
             uint32_t community_as_32bit_int =
                 uint32_t(bgp_community_subnet.asn_number << 16 | bgp_community_subnet.community_number);
 
-            gobgp_client->AnnounceUnicastPrefixIPv4(convert_ip_as_uint_to_string(current_attack.customer_network.subnet_address),
-                                                    gobgp_nexthop, is_withdrawal,
-                                                    current_attack.customer_network.cidr_prefix_length, community_as_32bit_int);
+            gobgp_queue_path(build_unicast_path(false, convert_ip_as_uint_to_string(current_attack.customer_network.subnet_address),
+                                                current_attack.customer_network.cidr_prefix_length, gobgp_nexthop,
+                                                is_withdrawal, community_as_32bit_int));
         }
 
         if (gobgp_announce_host) {
@@ -352,7 +560,145 @@ void gobgp_ban_manage(std::string action, bool ipv6, std::string ip_as_string, s
 
             uint32_t community_as_32bit_int = uint32_t(bgp_community_host.asn_number << 16 | bgp_community_host.community_number);
 
-            gobgp_client->AnnounceUnicastPrefixIPv4(ip_as_string, gobgp_nexthop, is_withdrawal, 32, community_as_32bit_int);
+            gobgp_queue_path(build_unicast_path(false, ip_as_string, 32, gobgp_nexthop, is_withdrawal, community_as_32bit_int));
         }
     }
 }
+
+// Queues flow spec rules for announce thread, we support only IPv4 rules
+void gobgp_flow_spec_manage(std::string action, const std::vector<flow_spec_rule_t>& flow_spec_rules) {
+    bool is_withdrawal = action != "ban";
+
+    logger << log4cpp::Priority::INFO << (is_withdrawal ? "withdraw " : "announce ") << flow_spec_rules.size()
+           << " flow spec rules to GoBGP";
+
+    for (const auto& flow_spec_rule : flow_spec_rules) {
+        gobgp_queue_path(build_flow_spec_path(flow_spec_rule, is_withdrawal));
+    }
+}
+
+// Sends queued paths to GoBGP in batches over persistent channel
+void gobgp_announce_thread() {
+    while (true) {
+        std::vector<gobgp_pending_path_t> pending_paths;
+
+        {
+            boost::unique_lock<boost::mutex> lock(gobgp_pending_paths_mutex);
+
+            // It's interruption point for boost threads
+            while (gobgp_pending_paths.empty()) {
+                gobgp_pending_paths_condition.wait(lock);
+            }
+        }
+
+        // Wait a bit to collect paths for all hosts affected by same attack
+        if (gobgp_announce_batch_window_milliseconds > 0) {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(gobgp_announce_batch_window_milliseconds));
+        }
+
+        {
+            boost::lock_guard<boost::mutex> lock_guard(gobgp_pending_paths_mutex);
+
+            pending_paths.assign(gobgp_pending_paths.begin(), gobgp_pending_paths.end());
+            gobgp_pending_paths.clear();
+        }
+
+        unsigned int retry_delay = gobgp_announce_retry_delay_milliseconds;
+        bool announce_result     = false;
+
+        for (unsigned int attempt = 0; attempt < gobgp_announce_attempts; attempt++) {
+            if (attempt > 0) {
+                gobgp_stream_retries++;
+
+                logger << log4cpp::Priority::WARN << "Retry announce of " << pending_paths.size()
+                       << " paths to GoBGP in " << retry_delay << " milliseconds";
+
+                boost::this_thread::sleep(boost::posix_time::milliseconds(retry_delay));
+
+                // Keep delay reasonable for long outages
+                retry_delay = std::max(std::min(retry_delay * 2, gobgp_announce_maximum_retry_delay_milliseconds),
+                                       gobgp_announce_retry_delay_milliseconds);
+            }
+
+            gobgp_stream_requests++;
+
+            announce_result = gobgp_client->AddPathStream(pending_paths);
+
+            if (announce_result) {
+                break;
+            }
+        }
+
+        if (!announce_result) {
+            // Lost withdrawal leaves blackhole for unbanned host in place and we will never remove it
+            // We put withdrawals in front of paths which came during retries to keep order of operations
+            std::vector<gobgp_pending_path_t> failed_withdrawals;
+
+            for (const auto& pending_path : pending_paths) {
+                if (pending_path.path.is_withdraw()) {
+                    failed_withdrawals.push_back(pending_path);
+                }
+            }
+
+            uint64_t dropped_paths = pending_paths.size() - failed_withdrawals.size();
+
+            logger << log4cpp::Priority::ERROR << "Cannot send " << pending_paths.size() << " paths to GoBGP after "
+                   << gobgp_announce_attempts << " attempts, we dropped " << dropped_paths << " announces and will retry "
+                   << failed_withdrawals.size() << " withdrawals in " << gobgp_announce_maximum_retry_delay_milliseconds
+                   << " milliseconds";
+
+            gobgp_paths_failed += dropped_paths;
+            gobgp_withdrawals_requeued += failed_withdrawals.size();
+
+            if (!failed_withdrawals.empty()) {
+                boost::lock_guard<boost::mutex> lock_guard(gobgp_pending_paths_mutex);
+
+                gobgp_pending_paths.insert(gobgp_pending_paths.begin(), failed_withdrawals.begin(), failed_withdrawals.end());
+            }
+
+            // GoBGP is not available for long time and we do not want to hammer it with requests
+            boost::this_thread::sleep(boost::posix_time::milliseconds(gobgp_announce_maximum_retry_delay_milliseconds));
+
+            continue;
+        }
+
+        gobgp_paths_announced += pending_paths.size();
+
+        auto now = std::chrono::steady_clock::now();
+
+        for (const auto& pending_path : pending_paths) {
+            uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(now - pending_path.request_time).count();
+
+            gobgp_announce_latency_microseconds_total += latency;
+
+            uint64_t current_maximum = gobgp_announce_maximum_latency_microseconds.load();
+
+            while (latency > current_maximum &&
+                   !gobgp_announce_maximum_latency_microseconds.compare_exchange_weak(current_maximum, latency)) {
+            }
+        }
+    }
+}
+
+std::vector<system_counter_t> get_gobgp_stats() {
+    std::vector<system_counter_t> system_counter;
+
+    system_counter.push_back(system_counter_t("gobgp_paths_announced", gobgp_paths_announced.load(),
+                                              metric_type_t::counter, gobgp_paths_announced_desc));
+    system_counter.push_back(system_counter_t("gobgp_paths_failed", gobgp_paths_failed.load(), metric_type_t::counter,
+                                              gobgp_paths_failed_desc));
+    system_counter.push_back(system_counter_t("gobgp_withdrawals_requeued", gobgp_withdrawals_requeued.load(),
+                                              metric_type_t::counter, gobgp_withdrawals_requeued_desc));
+    system_counter.push_back(system_counter_t("gobgp_stream_requests", gobgp_stream_requests.load(),
+                                              metric_type_t::counter, gobgp_stream_requests_desc));
+    system_counter.push_back(system_counter_t("gobgp_stream_retries", gobgp_stream_retries.load(),
+                                              metric_type_t::counter, gobgp_stream_retries_desc));
+    system_counter.push_back(system_counter_t("gobgp_announce_latency_microseconds_total",
+                                              gobgp_announce_latency_microseconds_total.load(), metric_type_t::counter,
+                                              gobgp_announce_latency_microseconds_total_desc));
+    system_counter.push_back(system_counter_t("gobgp_announce_maximum_latency_microseconds",
+                                              gobgp_announce_maximum_latency_microseconds.load(), metric_type_t::gauge,
+                                              gobgp_announce_maximum_latency_microseconds_desc));
+
+    return system_counter;
+}
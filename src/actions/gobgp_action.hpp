@@ -1,11 +1,17 @@
 #ifndef GOBGP_ACTION_H
 #define GOBGP_ACTION_H
 
+#include "../bgp_protocol.hpp"
 #include "../fastnetmon_types.hpp"
 #include <string>
+#include <vector>
 
 void gobgp_action_init();
 void gobgp_action_shutdown();
+void gobgp_start_announce_thread();
 void gobgp_ban_manage(std::string action, bool ipv6, std::string ip_as_string, subnet_ipv6_cidr_mask_t client_ipv6, attack_details_t current_attack);
+void gobgp_flow_spec_manage(std::string action, const std::vector<flow_spec_rule_t>& flow_spec_rules);
+void gobgp_announce_thread();
+std::vector<system_counter_t> get_gobgp_stats();
 
 #endif
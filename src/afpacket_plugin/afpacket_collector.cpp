@@ -43,7 +43,7 @@ bool afpacket_read_packet_length_from_ip_header = false;
 extern log4cpp::Category& logger;
 
 // Pass unparsed packets number to main programme
-extern uint64_t total_unparsed_packets;
+extern per_thread_counter_t total_unparsed_packets;
 
 // Global configuration map
 extern std::map<std::string, std::string> configuration_map;
@@ -60,14 +60,15 @@ uint64_t socket_dropped_packets         = 0;
 std::string blocks_read_desc = "Number of blocks we read from kernel, each block has multiple packets";
 uint64_t blocks_read         = 0;
 
+// We have capture thread for each CPU and each of them increments own copy of counters
 std::string af_packet_packets_raw_desc = "Number of packets read by AF_PACKET before parsing";
-uint64_t af_packet_packets_raw         = 0;
+per_thread_counter_t af_packet_packets_raw;
 
 std::string af_packet_packets_parsed_desc = "Number of parsed packets";
-uint64_t af_packet_packets_parsed         = 0;
+per_thread_counter_t af_packet_packets_parsed;
 
 std::string af_packet_packets_unparsed_desc = "Number of not parsed packets";
-uint64_t af_packet_packets_unparsed         = 0;
+per_thread_counter_t af_packet_packets_unparsed;
 
 // Default sampling rate
 uint32_t mirror_af_packet_custom_sampling_rate = 1;
@@ -132,6 +133,8 @@ void walk_block(struct block_desc* pbd, const int block_num) {
     struct tpacket3_hdr* ppd;
 
     ppd = (struct tpacket3_hdr*)((uint8_t*)pbd + pbd->h1.offset_to_first_pkt);
+
+    af_packet_packets_raw.increment(num_pkts);
     for (i = 0; i < num_pkts; ++i) {
         bytes += ppd->tp_snaplen;
 
@@ -142,6 +145,11 @@ void walk_block(struct block_desc* pbd, const int block_num) {
 
         simple_packet_t packet;
 
+        // Kernel sets timestamp for each packet in ring and we do not need to read clock
+        packet.ts.tv_sec    = ppd->tp_sec;
+        packet.ts.tv_usec   = ppd->tp_nsec / 1000;
+        packet.arrival_time = ppd->tp_sec;
+
         // Override default sample rate by rate specified in configuration
         if (mirror_af_packet_custom_sampling_rate > 1) {
             packet.sample_ratio = mirror_af_packet_custom_sampling_rate;
@@ -155,13 +163,12 @@ void walk_block(struct block_desc* pbd, const int block_num) {
                                                                 afpacket_read_packet_length_from_ip_header);
 
         if (result != network_data_stuctures::parser_code_t::success) {
-            // This counter resets for speed calculation every second
-            total_unparsed_packets++;
-            af_packet_packets_unparsed++;
+            total_unparsed_packets.increment();
+            af_packet_packets_unparsed.increment();
 
             logger << log4cpp::Priority::DEBUG << "Cannot parse packet using ng parser: " << parser_code_to_string(result);
         } else {
-            af_packet_packets_parsed++;
+            af_packet_packets_parsed.increment();
             afpacket_process_func_ptr(packet);
         }
 
@@ -435,3 +442,16 @@ void start_af_packet_capture_for_interface(std::string capture_interface, int fa
         packet_receiver_thread_group.join_all();
     }
 }
+
+std::vector<system_counter_t> get_afpacket_stats() {
+    std::vector<system_counter_t> system_counter;
+
+    system_counter.push_back(system_counter_t("af_packet_packets_raw", af_packet_packets_raw.get(), metric_type_t::counter,
+                                              af_packet_packets_raw_desc));
+    system_counter.push_back(system_counter_t("af_packet_packets_parsed", af_packet_packets_parsed.get(),
+                                              metric_type_t::counter, af_packet_packets_parsed_desc));
+    system_counter.push_back(system_counter_t("af_packet_packets_unparsed", af_packet_packets_unparsed.get(),
+                                              metric_type_t::counter, af_packet_packets_unparsed_desc));
+
+    return system_counter;
+}
@@ -4,8 +4,11 @@ Status FastnetmonApiServiceImpl::GetBanlist(::grpc::ServerContext* context,
                                             ::grpc::ServerWriter<::fastmitigation::BanListReply>* writer) {
     logger << log4cpp::Priority::INFO << "API we asked for banlist";
 
-    for (std::map<uint32_t, banlist_item_t>::iterator itr = ban_list.begin(); itr != ban_list.end(); ++itr) {
-        std::string client_ip_as_string = convert_ip_as_uint_to_string(itr->first);
+    std::vector<uint32_t> blackholed_hosts;
+    ban_list.get_blackholed_hosts(blackholed_hosts);
+
+    for (auto client_ip : blackholed_hosts) {
+        std::string client_ip_as_string = convert_ip_as_uint_to_string(client_ip);
 
         BanListReply reply;
         reply.set_ip_address(client_ip_as_string + "/32");
@@ -65,15 +68,15 @@ Status FastnetmonApiServiceImpl::ExecuteBan(ServerContext* context,
     if (ipv4) {
         client_ip = convert_ip_as_string_to_uint(request->ip_address());
 
-        {
-            std::lock_guard<std::mutex> lock_guard(ban_list_mutex);
-            ban_list[client_ip] = current_attack;
-        }
+        ban_list.add_to_blackhole(client_ip, current_attack);
 
         {
             std::lock_guard<std::mutex> lock_guard(ban_list_details_mutex);
             ban_list_details[client_ip] = std::vector<simple_packet_t>();
+            publish_hosts_under_collection();
         }
+
+        start_attack_fingerprint_collection(client_ip);
     } else {
         bool parsed_ipv6 = read_ipv6_host_from_string(request->ip_address(), ipv6_address.subnet_address);
 
@@ -82,7 +85,8 @@ Status FastnetmonApiServiceImpl::ExecuteBan(ServerContext* context,
             return grpc::Status(grpc::StatusCode::INVALID_ARGUMENT, "Can't parse IPv6 address");
         }
 
-        bool in_our_networks_list = ip_belongs_to_patricia_tree_ipv6(lookup_tree_ipv6, ipv6_address.subnet_address);
+        bool in_our_networks_list =
+            ip_belongs_to_patricia_tree_ipv6(our_networks_lookup.get()->lookup_tree_ipv6, ipv6_address.subnet_address);
 
         if (!in_our_networks_list) {
             logger << log4cpp::Priority::ERROR << "IP address " << request->ip_address() << " is not belongs to our networks.";
@@ -129,22 +133,14 @@ Status FastnetmonApiServiceImpl::ExecuteUnBan(ServerContext* context,
     if (ipv4) {
         client_ip = convert_ip_as_string_to_uint(request->ip_address());
 
-        if (ban_list.count(client_ip) == 0) {
+        logger << log4cpp::Priority::INFO << "API: remove IP from ban list";
+
+        if (!ban_list.remove_from_blackhole_and_keep_copy(client_ip, current_attack)) {
             logger << log4cpp::Priority::ERROR << "API: Could not find IP in ban list";
             return Status::CANCELLED;
         }
 
-        current_attack = ban_list[client_ip];
-
         logger << log4cpp::Priority::INFO << "API: call unban handlers";
-
-        logger << log4cpp::Priority::INFO << "API: remove IP from ban list";
-
-        {
-            std::lock_guard<std::mutex> lock_guard(ban_list_mutex);
-            ;
-            ban_list.erase(client_ip);
-        }
     } else {
         bool parsed_ipv6 = read_ipv6_host_from_string(request->ip_address(), ipv6_address.subnet_address);
 
@@ -171,5 +167,53 @@ Status FastnetmonApiServiceImpl::ExecuteUnBan(ServerContext* context,
 
     call_unban_handlers(client_ip, ipv6_address, ipv6, current_attack, attack_detection_source_t::Automatic);
 
+    // Unban handlers report fingerprint and we stop its collection only after them
+    if (ipv4) {
+        stop_attack_fingerprint_collection(client_ip);
+    }
+
+    return Status::OK;
+}
+
+Status FastnetmonApiServiceImpl::ReloadNetworks(ServerContext* context,
+                                                const fastmitigation::ReloadNetworksRequest* request,
+                                                fastmitigation::ReloadNetworksReply* reply) {
+    logger << log4cpp::Priority::INFO << "API: We asked for reload of networks list and host groups";
+
+    // Reload thread will apply it in background in same way as for SIGHUP
+    networks_reload_requested = true;
+
+    reply->set_result(true);
+
+    return Status::OK;
+}
+
+Status FastnetmonApiServiceImpl::GetStageLatency(ServerContext* context,
+                                                 const fastmitigation::StageLatencyRequest* request,
+                                                 ::grpc::ServerWriter<fastmitigation::StageLatencyReply>* writer) {
+    logger << log4cpp::Priority::INFO << "API: We asked for stage latency histograms";
+
+    if (!stage_latency_registry.is_enabled()) {
+        return grpc::Status(grpc::StatusCode::FAILED_PRECONDITION, "Please enable stage_latency_metrics in configuration");
+    }
+
+    for (const auto& histogram : stage_latency_registry.get_histograms()) {
+        fastmitigation::StageLatencyReply reply;
+
+        reply.set_stage(get_latency_stage_name(histogram.stage));
+        reply.set_packet_processing_stage(is_packet_processing_stage(histogram.stage));
+        reply.set_samples(histogram.samples);
+        reply.set_total_nanoseconds(histogram.total_nanoseconds);
+        reply.set_p50_nanoseconds(histogram.get_percentile(0.5));
+        reply.set_p90_nanoseconds(histogram.get_percentile(0.9));
+        reply.set_p99_nanoseconds(histogram.get_percentile(0.99));
+
+        for (auto bucket : histogram.buckets) {
+            reply.add_buckets(bucket);
+        }
+
+        writer->Write(reply);
+    }
+
     return Status::OK;
 }
@@ -0,0 +1,604 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "fastnetmon_simple_packet.hpp"
+
+// Single element of heavy hitters sketch
+template <typename TemplateKeyType> class heavy_hitter_element_t {
+    public:
+    TemplateKeyType key{};
+
+    // Estimated number of packets for this key
+    uint64_t count = 0;
+
+    // Maximum overestimation for this key, real value is between count - error and count
+    uint64_t error = 0;
+};
+
+// Copy of sketch content which could be merged with copies of other sketches
+template <typename TemplateKeyType> class heavy_hitters_snapshot_t {
+    public:
+    std::vector<heavy_hitter_element_t<TemplateKeyType>> elements;
+
+    // Smallest counter of full sketch, any key which is not tracked could have up to this number of packets
+    // It's zero when sketch still has free space
+    uint64_t minimal_count = 0;
+
+    uint64_t total_weight = 0;
+};
+
+// Space-Saving algorithm by Metwally, Agrawal and El Abbadi
+// It tracks most frequent elements in stream with fixed amount of memory and guarantees that any element with
+// frequency above total / capacity will be present in sketch
+//
+// We use Stream-Summary structure from same paper: counters are grouped in buckets with same count and buckets are
+// kept in list sorted by count. Counter with smallest value is always first counter in first bucket and increment
+// moves counter only to one of next buckets. For our keys we use fixed size hash table with open addressing
+// and we do not allocate memory after set_capacity()
+template <typename TemplateKeyType> class space_saving_sketch_t {
+    public:
+    space_saving_sketch_t(unsigned int capacity = 128) {
+        set_capacity(capacity);
+    }
+
+    void set_capacity(unsigned int capacity) {
+        // We need at least one element to operate
+        if (capacity == 0) {
+            capacity = 1;
+        }
+
+        this->capacity = capacity;
+
+        counters.clear();
+        counters.reserve(capacity);
+
+        buckets.clear();
+        buckets.reserve(capacity);
+
+        free_buckets.clear();
+        free_buckets.reserve(capacity);
+
+        // Keep load factor below 0.5 to keep probe chains short
+        size_t number_of_slots = 16;
+
+        while (number_of_slots < capacity * 2) {
+            number_of_slots *= 2;
+        }
+
+        index_slots.assign(number_of_slots, empty_position);
+        index_mask = number_of_slots - 1;
+
+        first_bucket = empty_position;
+        total_weight = 0;
+    }
+
+    void add(const TemplateKeyType& key, uint64_t weight) {
+        // It does not change any counters
+        if (weight == 0) {
+            return;
+        }
+
+        total_weight += weight;
+
+        int32_t counter_position = find_counter(key);
+
+        if (counter_position != empty_position) {
+            increment_counter(counter_position, weight);
+            return;
+        }
+
+        // We still have free space
+        if (counters.size() < capacity) {
+            counter_t new_counter;
+            new_counter.element.key = key;
+
+            counters.push_back(new_counter);
+            counter_position = counters.size() - 1;
+
+            insert_to_index(counter_position);
+            attach_counter_to_bucket_after(counter_position, empty_position, weight);
+
+            return;
+        }
+
+        // Replace element with smallest counter
+        counter_position = buckets[first_bucket].first_counter;
+
+        remove_from_index(counter_position);
+
+        counter_t& minimal_counter = counters[counter_position];
+
+        minimal_counter.element.key   = key;
+        minimal_counter.element.error = minimal_counter.element.count;
+
+        insert_to_index(counter_position);
+        increment_counter(counter_position, weight);
+    }
+
+    // Returns up to number_of_elements elements ordered by count in descending order
+    std::vector<heavy_hitter_element_t<TemplateKeyType>> get_top(unsigned int number_of_elements) const {
+        std::vector<heavy_hitter_element_t<TemplateKeyType>> top_elements;
+        top_elements.reserve(counters.size());
+
+        for (const auto& counter : counters) {
+            top_elements.push_back(counter.element);
+        }
+
+        sort_and_truncate_heavy_hitters(top_elements, number_of_elements);
+
+        return top_elements;
+    }
+
+    heavy_hitters_snapshot_t<TemplateKeyType> get_snapshot() const {
+        heavy_hitters_snapshot_t<TemplateKeyType> snapshot;
+
+        snapshot.elements.reserve(counters.size());
+
+        for (const auto& counter : counters) {
+            snapshot.elements.push_back(counter.element);
+        }
+
+        snapshot.minimal_count = get_minimal_count();
+        snapshot.total_weight  = total_weight;
+
+        return snapshot;
+    }
+
+    // Smallest count among tracked elements when sketch is full and zero otherwise
+    uint64_t get_minimal_count() const {
+        if (counters.size() < capacity || first_bucket == empty_position) {
+            return 0;
+        }
+
+        return buckets[first_bucket].count;
+    }
+
+    uint64_t get_total_weight() const {
+        return total_weight;
+    }
+
+    static void sort_and_truncate_heavy_hitters(std::vector<heavy_hitter_element_t<TemplateKeyType>>& elements,
+                                                unsigned int number_of_elements) {
+        std::sort(elements.begin(), elements.end(),
+                  [](const heavy_hitter_element_t<TemplateKeyType>& a, const heavy_hitter_element_t<TemplateKeyType>& b) {
+                      return a.count > b.count;
+                  });
+
+        if (elements.size() > number_of_elements) {
+            elements.resize(number_of_elements);
+        }
+    }
+
+    private:
+    static constexpr int32_t empty_position = -1;
+
+    class counter_t {
+        public:
+        heavy_hitter_element_t<TemplateKeyType> element;
+
+        int32_t bucket = empty_position;
+
+        // Neighbours in list of counters of same bucket
+        int32_t previous = empty_position;
+        int32_t next     = empty_position;
+    };
+
+    class bucket_t {
+        public:
+        uint64_t count        = 0;
+        int32_t first_counter = empty_position;
+
+        // Neighbours in list of buckets sorted by count in ascending order
+        int32_t previous = empty_position;
+        int32_t next     = empty_position;
+    };
+
+    // Moves counter to bucket with count increased by weight
+    // For uniform weights it's next bucket or new bucket right after current one
+    void increment_counter(int32_t counter_position, uint64_t weight) {
+        int32_t current_bucket = counters[counter_position].bucket;
+        uint64_t new_count     = buckets[current_bucket].count + weight;
+
+        int32_t previous_bucket = current_bucket;
+
+        while (buckets[previous_bucket].next != empty_position && buckets[buckets[previous_bucket].next].count < new_count) {
+            previous_bucket = buckets[previous_bucket].next;
+        }
+
+        detach_counter_from_bucket(counter_position);
+
+        // When bucket becomes empty we free it and continue search from its predecessor
+        if (previous_bucket == current_bucket && buckets[current_bucket].first_counter == empty_position) {
+            previous_bucket = unlink_bucket(current_bucket);
+        } else if (buckets[current_bucket].first_counter == empty_position) {
+            unlink_bucket(current_bucket);
+        }
+
+        attach_counter_to_bucket_after(counter_position, previous_bucket, new_count);
+    }
+
+    // Attaches counter to bucket with specified count which starts search right after previous_bucket
+    // or from first bucket when previous_bucket is empty
+    void attach_counter_to_bucket_after(int32_t counter_position, int32_t previous_bucket, uint64_t count) {
+        int32_t next_bucket = previous_bucket == empty_position ? first_bucket : buckets[previous_bucket].next;
+
+        while (next_bucket != empty_position && buckets[next_bucket].count < count) {
+            previous_bucket = next_bucket;
+            next_bucket     = buckets[next_bucket].next;
+        }
+
+        int32_t target_bucket = next_bucket;
+
+        if (target_bucket == empty_position || buckets[target_bucket].count != count) {
+            target_bucket = allocate_bucket(count);
+
+            buckets[target_bucket].previous = previous_bucket;
+            buckets[target_bucket].next     = next_bucket;
+
+            if (previous_bucket == empty_position) {
+                first_bucket = target_bucket;
+            } else {
+                buckets[previous_bucket].next = target_bucket;
+            }
+
+            if (next_bucket != empty_position) {
+                buckets[next_bucket].previous = target_bucket;
+            }
+        }
+
+        counter_t& counter     = counters[counter_position];
+        counter.element.count = count;
+        counter.bucket        = target_bucket;
+        counter.previous      = empty_position;
+        counter.next          = buckets[target_bucket].first_counter;
+
+        if (counter.next != empty_position) {
+            counters[counter.next].previous = counter_position;
+        }
+
+        buckets[target_bucket].first_counter = counter_position;
+    }
+
+    void detach_counter_from_bucket(int32_t counter_position) {
+        counter_t& counter = counters[counter_position];
+
+        if (counter.previous == empty_position) {
+            buckets[counter.bucket].first_counter = counter.next;
+        } else {
+            counters[counter.previous].next = counter.next;
+        }
+
+        if (counter.next != empty_position) {
+            counters[counter.next].previous = counter.previous;
+        }
+
+        counter.bucket   = empty_position;
+        counter.previous = empty_position;
+        counter.next     = empty_position;
+    }
+
+    int32_t allocate_bucket(uint64_t count) {
+        int32_t bucket_position = empty_position;
+
+        if (free_buckets.empty()) {
+            buckets.push_back(bucket_t());
+            bucket_position = buckets.size() - 1;
+        } else {
+            bucket_position = free_buckets.back();
+            free_buckets.pop_back();
+
+            buckets[bucket_position] = bucket_t();
+        }
+
+        buckets[bucket_position].count = count;
+
+        return bucket_position;
+    }
+
+    // Removes empty bucket from list and returns its predecessor
+    int32_t unlink_bucket(int32_t bucket_position) {
+        bucket_t& bucket = buckets[bucket_position];
+
+        if (bucket.previous == empty_position) {
+            first_bucket = bucket.next;
+        } else {
+            buckets[bucket.previous].next = bucket.next;
+        }
+
+        if (bucket.next != empty_position) {
+            buckets[bucket.next].previous = bucket.previous;
+        }
+
+        int32_t previous_bucket = bucket.previous;
+
+        free_buckets.push_back(bucket_position);
+
+        return previous_bucket;
+    }
+
+    // Multiplicative hashing spreads addresses and ports which are close to each other over whole table
+    size_t get_index_slot(const TemplateKeyType& key) const {
+        return (size_t)((uint64_t(key) * 0x9E3779B97F4A7C15ULL) >> 32) & index_mask;
+    }
+
+    int32_t find_counter(const TemplateKeyType& key) const {
+        for (size_t slot = get_index_slot(key);; slot = (slot + 1) & index_mask) {
+            if (index_slots[slot] == empty_position) {
+                return empty_position;
+            }
+
+            if (counters[index_slots[slot]].element.key == key) {
+                return index_slots[slot];
+            }
+        }
+    }
+
+    void insert_to_index(int32_t counter_position) {
+        size_t slot = get_index_slot(counters[counter_position].element.key);
+
+        while (index_slots[slot] != empty_position) {
+            slot = (slot + 1) & index_mask;
+        }
+
+        index_slots[slot] = counter_position;
+    }
+
+    // We use backward shift deletion to keep probe chains correct without tombstones
+    void remove_from_index(int32_t counter_position) {
+        size_t slot = get_index_slot(counters[counter_position].element.key);
+
+        while (index_slots[slot] != counter_position) {
+            slot = (slot + 1) & index_mask;
+        }
+
+        index_slots[slot] = empty_position;
+
+        for (size_t next_slot = (slot + 1) & index_mask; index_slots[next_slot] != empty_position;
+             next_slot        = (next_slot + 1) & index_mask) {
+            size_t desired_slot = get_index_slot(counters[index_slots[next_slot]].element.key);
+
+            // Move element back when its desired slot is not between freed slot and current position
+            if (((next_slot - desired_slot) & index_mask) >= ((next_slot - slot) & index_mask)) {
+                index_slots[slot]      = index_slots[next_slot];
+                index_slots[next_slot] = empty_position;
+                slot                   = next_slot;
+            }
+        }
+    }
+
+    unsigned int capacity = 0;
+
+    // Sum of all weights we've seen
+    uint64_t total_weight = 0;
+
+    std::vector<counter_t> counters;
+
+    std::vector<bucket_t> buckets;
+    std::vector<int32_t> free_buckets;
+
+    // Bucket with smallest count
+    int32_t first_bucket = empty_position;
+
+    // Positions of counters in counters vector
+    std::vector<int32_t> index_slots;
+    size_t index_mask = 0;
+};
+
+// Merges snapshots of sketches which observed different parts of same stream
+// For each sketch which does not track key we add its minimal count to both count and error of key,
+// so count stays upper bound and count - error stays lower bound for real value
+template <typename TemplateKeyType>
+std::vector<heavy_hitter_element_t<TemplateKeyType>>
+merge_heavy_hitters_snapshots(const std::vector<heavy_hitters_snapshot_t<TemplateKeyType>>& snapshots, unsigned int number_of_elements) {
+    class merged_element_t {
+        public:
+        heavy_hitter_element_t<TemplateKeyType> element;
+
+        // Sum of minimal counts of sketches which track this key
+        uint64_t minimal_counts_of_trackers = 0;
+    };
+
+    uint64_t sum_of_minimal_counts = 0;
+
+    std::unordered_map<TemplateKeyType, merged_element_t> merged_elements;
+
+    for (const auto& snapshot : snapshots) {
+        sum_of_minimal_counts += snapshot.minimal_count;
+
+        for (const auto& element : snapshot.elements) {
+            merged_element_t& merged_element = merged_elements[element.key];
+
+            merged_element.element.key = element.key;
+            merged_element.element.count += element.count;
+            merged_element.element.error += element.error;
+            merged_element.minimal_counts_of_trackers += snapshot.minimal_count;
+        }
+    }
+
+    std::vector<heavy_hitter_element_t<TemplateKeyType>> top_elements;
+    top_elements.reserve(merged_elements.size());
+
+    for (auto& merged_element : merged_elements) {
+        uint64_t untracked_estimation = sum_of_minimal_counts - merged_element.second.minimal_counts_of_trackers;
+
+        merged_element.second.element.count += untracked_estimation;
+        merged_element.second.element.error += untracked_estimation;
+
+        top_elements.push_back(merged_element.second.element);
+    }
+
+    space_saving_sketch_t<TemplateKeyType>::sort_and_truncate_heavy_hitters(top_elements, number_of_elements);
+
+    return top_elements;
+}
+
+// Top elements of all sketches of fingerprint
+class attack_fingerprint_summary_t {
+    public:
+    uint64_t total_packets = 0;
+
+    // Peer IPs in network byte order
+    std::vector<heavy_hitter_element_t<uint32_t>> top_peer_ips;
+    std::vector<heavy_hitter_element_t<uint32_t>> top_peer_asns;
+    std::vector<heavy_hitter_element_t<uint16_t>> top_source_ports;
+    std::vector<heavy_hitter_element_t<uint16_t>> top_destination_ports;
+    std::vector<heavy_hitter_element_t<uint32_t>> top_protocols;
+};
+
+// Sketches for all fields of fingerprint
+// We use remote side of packet (source for incoming and destination for outgoing traffic) as peer
+class attack_fingerprint_sketches_t {
+    public:
+    attack_fingerprint_sketches_t(unsigned int capacity) {
+        peer_ips.set_capacity(capacity);
+        peer_asns.set_capacity(capacity);
+        source_ports.set_capacity(capacity);
+        destination_ports.set_capacity(capacity);
+        protocols.set_capacity(capacity);
+    }
+
+    void add_packet(const simple_packet_t& packet, uint64_t sampled_number_of_packets) {
+        if (packet.packet_direction == OUTGOING) {
+            peer_ips.add(packet.dst_ip, sampled_number_of_packets);
+            peer_asns.add(packet.dst_asn, sampled_number_of_packets);
+        } else {
+            peer_ips.add(packet.src_ip, sampled_number_of_packets);
+            peer_asns.add(packet.src_asn, sampled_number_of_packets);
+        }
+
+        // Ports make sense only for TCP and UDP
+        if (packet.protocol == IPPROTO_TCP or packet.protocol == IPPROTO_UDP) {
+            source_ports.add(packet.source_port, sampled_number_of_packets);
+            destination_ports.add(packet.destination_port, sampled_number_of_packets);
+        }
+
+        protocols.add(packet.protocol, sampled_number_of_packets);
+    }
+
+    space_saving_sketch_t<uint32_t> peer_ips;
+    space_saving_sketch_t<uint32_t> peer_asns;
+    space_saving_sketch_t<uint16_t> source_ports;
+    space_saving_sketch_t<uint16_t> destination_ports;
+    space_saving_sketch_t<uint32_t> protocols;
+};
+
+// Number of copies of sketches in each fingerprint
+// Threads above this number share copies with other threads
+const unsigned int attack_fingerprint_thread_slots = 64;
+
+// Sequential number of thread which we use to select copy of sketches
+inline std::atomic<unsigned int> attack_fingerprint_number_of_threads{ 0 };
+inline thread_local unsigned int attack_fingerprint_thread_slot =
+    attack_fingerprint_number_of_threads++ % attack_fingerprint_thread_slots;
+
+// Fingerprint of attack traffic for single host
+// Each capture thread updates own copy of sketches and readers merge all copies
+class attack_fingerprint_t {
+    public:
+    attack_fingerprint_t(unsigned int capacity = 128) : capacity(capacity) {
+    }
+
+    ~attack_fingerprint_t() {
+        for (auto& thread_slot : thread_slots) {
+            delete thread_slot.load(std::memory_order_relaxed);
+        }
+    }
+
+    attack_fingerprint_t(const attack_fingerprint_t&) = delete;
+    attack_fingerprint_t& operator=(const attack_fingerprint_t&) = delete;
+
+    void add_packet(const simple_packet_t& packet, uint64_t sampled_number_of_packets) {
+        thread_sketches_t* thread_sketches = get_thread_sketches();
+
+        // It's not contended unless we have more threads than slots, readers take it only to copy sketches
+        std::lock_guard<std::mutex> lock_guard(thread_sketches->sketches_mutex);
+        thread_sketches->sketches.add_packet(packet, sampled_number_of_packets);
+    }
+
+    // Merges copies of all threads
+    attack_fingerprint_summary_t get_summary(unsigned int number_of_elements) const {
+        std::vector<heavy_hitters_snapshot_t<uint32_t>> peer_ips;
+        std::vector<heavy_hitters_snapshot_t<uint32_t>> peer_asns;
+        std::vector<heavy_hitters_snapshot_t<uint16_t>> source_ports;
+        std::vector<heavy_hitters_snapshot_t<uint16_t>> destination_ports;
+        std::vector<heavy_hitters_snapshot_t<uint32_t>> protocols;
+
+        for (const auto& thread_slot : thread_slots) {
+            thread_sketches_t* thread_sketches = thread_slot.load(std::memory_order_acquire);
+
+            if (thread_sketches == nullptr) {
+                continue;
+            }
+
+            std::lock_guard<std::mutex> lock_guard(thread_sketches->sketches_mutex);
+
+            peer_ips.push_back(thread_sketches->sketches.peer_ips.get_snapshot());
+            peer_asns.push_back(thread_sketches->sketches.peer_asns.get_snapshot());
+            source_ports.push_back(thread_sketches->sketches.source_ports.get_snapshot());
+            destination_ports.push_back(thread_sketches->sketches.destination_ports.get_snapshot());
+            protocols.push_back(thread_sketches->sketches.protocols.get_snapshot());
+        }
+
+        attack_fingerprint_summary_t summary;
+
+        // We add protocol for each packet
+        for (const auto& snapshot : protocols) {
+            summary.total_packets += snapshot.total_weight;
+        }
+
+        summary.top_peer_ips          = merge_heavy_hitters_snapshots(peer_ips, number_of_elements);
+        summary.top_peer_asns         = merge_heavy_hitters_snapshots(peer_asns, number_of_elements);
+        summary.top_source_ports      = merge_heavy_hitters_snapshots(source_ports, number_of_elements);
+        summary.top_destination_ports = merge_heavy_hitters_snapshots(destination_ports, number_of_elements);
+        summary.top_protocols         = merge_heavy_hitters_snapshots(protocols, number_of_elements);
+
+        return summary;
+    }
+
+    private:
+    class alignas(64) thread_sketches_t {
+        public:
+        thread_sketches_t(unsigned int capacity) : sketches(capacity) {
+        }
+
+        std::mutex sketches_mutex;
+        attack_fingerprint_sketches_t sketches;
+    };
+
+    thread_sketches_t* get_thread_sketches() {
+        std::atomic<thread_sketches_t*>& thread_slot = thread_slots[attack_fingerprint_thread_slot];
+
+        thread_sketches_t* thread_sketches = thread_slot.load(std::memory_order_acquire);
+
+        if (thread_sketches != nullptr) {
+            return thread_sketches;
+        }
+
+        // First packet from this thread, we allocate sketches only for threads which see attack traffic
+        thread_sketches_t* new_thread_sketches = new thread_sketches_t(capacity);
+
+        if (!thread_slot.compare_exchange_strong(thread_sketches, new_thread_sketches, std::memory_order_acq_rel)) {
+            // Another thread which shares this slot was faster
+            delete new_thread_sketches;
+            return thread_sketches;
+        }
+
+        return new_thread_sketches;
+    }
+
+    unsigned int capacity = 0;
+
+    std::array<std::atomic<thread_sketches_t*>, attack_fingerprint_thread_slots> thread_slots{};
+};
+
+// Immutable copy of fingerprints for lookups from process_packet
+// We publish it with rcu_pointer_t and retired copies keep fingerprints alive for grace period after unban
+typedef std::unordered_map<uint32_t, std::shared_ptr<attack_fingerprint_t>> attack_fingerprints_index_t;
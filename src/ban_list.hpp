@@ -1,14 +1,25 @@
 #pragma once
 
+#include <functional>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
 
+#include "fast_time.hpp"
+#include "timer_wheel.hpp"
 
 // This class stores blocked with blackhole hosts
+// Hosts with enabled unban are scheduled in timer wheel and we do not need to scan whole list to find expired bans
 template <typename TemplateKeyType> class blackhole_ban_list_t {
     public:
     blackhole_ban_list_t() {
+        unban_timer_wheel.set_current_time(get_fast_time_seconds());
     }
 
     // Is this host blackholed?
@@ -23,16 +34,13 @@ template <typename TemplateKeyType> class blackhole_ban_list_t {
     bool is_blackholed_by_uuid(boost::uuids::uuid mitigation_uuid, TemplateKeyType& client_id) {
         std::lock_guard<std::mutex> lock_guard(structure_mutex);
 
-        auto itr = std::find_if(ban_list_storage.begin(), ban_list_storage.end(),
-                                [mitigation_uuid](const std::pair<const TemplateKeyType, attack_details_t>& pair) {
-                                    return pair.second.attack_uuid == mitigation_uuid;
-                                });
+        auto itr = uuid_index.find(mitigation_uuid);
 
-        if (itr == ban_list_storage.end()) {
+        if (itr == uuid_index.end()) {
             return false;
         }
 
-        client_id = itr->first;
+        client_id = itr->second;
         return true;
     }
 
@@ -40,14 +48,14 @@ template <typename TemplateKeyType> class blackhole_ban_list_t {
     bool add_to_blackhole(TemplateKeyType client_id, attack_details_t current_attack) {
         std::lock_guard<std::mutex> lock_guard(structure_mutex);
 
-        ban_list_storage[client_id] = current_attack;
+        add_to_blackhole_without_lock(client_id, current_attack);
         return true;
     }
 
     bool remove_from_blackhole(TemplateKeyType client_id) {
         std::lock_guard<std::mutex> lock_guard(structure_mutex);
 
-        ban_list_storage.erase(client_id);
+        remove_from_blackhole_without_lock(client_id);
 
         return true;
     }
@@ -55,26 +63,96 @@ template <typename TemplateKeyType> class blackhole_ban_list_t {
     bool remove_from_blackhole_and_keep_copy(TemplateKeyType client_id, attack_details_t& current_attack) {
         std::lock_guard<std::mutex> lock_guard(structure_mutex);
 
+        auto itr = ban_list_storage.find(client_id);
+
         // Confirm that we still have this element in storage
-        if (ban_list_storage.count(client_id) == 0) {
+        if (itr == ban_list_storage.end()) {
             return false;
         }
 
         // Copy current value
-        current_attack = ban_list_storage[client_id];
+        current_attack = itr->second;
 
         // Remove it
-        ban_list_storage.erase(client_id);
+        remove_from_blackhole_without_lock(client_id);
+
+        return true;
+    }
+
+    // Calls function for blackhole details under lock, returns false when we have no such host
+    bool modify_blackhole_details(TemplateKeyType client_id, std::function<void(banlist_item_t&)> modify_function) {
+        std::lock_guard<std::mutex> lock_guard(structure_mutex);
+
+        auto itr = ban_list_storage.find(client_id);
+
+        if (itr == ban_list_storage.end()) {
+            return false;
+        }
+
+        modify_function(itr->second);
+        return true;
+    }
+
+    // Returns copies of all bans with ban time ended before or at current_time
+    // They stay in list and caller should remove them or schedule another check with reschedule_unban
+    bool get_expired_blackholes(time_t current_time, std::vector<std::pair<TemplateKeyType, banlist_item_t>>& expired_blackholes) {
+        std::lock_guard<std::mutex> lock_guard(structure_mutex);
+
+        // Clock may be moved back when we switch to time from packets in offline mode and we restart empty wheel from it
+        if (unban_timer_wheel.size() == 0 && current_time < unban_timer_wheel.get_current_time()) {
+            unban_timer_wheel.set_current_time(current_time);
+            return true;
+        }
+
+        std::vector<std::pair<TemplateKeyType, time_t>> expired_elements;
+        unban_timer_wheel.advance(current_time, expired_elements);
+
+        for (auto& expired_element : expired_elements) {
+            auto itr = ban_list_storage.find(expired_element.first);
+
+            auto unban_time_itr = scheduled_unban_times.find(expired_element.first);
+
+            // Host was unbanned or banned again with another ban time
+            if (itr == ban_list_storage.end() || unban_time_itr == scheduled_unban_times.end() ||
+                unban_time_itr->second != expired_element.second) {
+                continue;
+            }
+
+            expired_blackholes.push_back({ itr->first, itr->second });
+        }
+
+        return true;
+    }
+
+    // Check this ban again later
+    bool reschedule_unban(TemplateKeyType client_id, time_t check_time) {
+        std::lock_guard<std::mutex> lock_guard(structure_mutex);
+
+        if (ban_list_storage.count(client_id) == 0) {
+            return false;
+        }
+
+        schedule_unban(client_id, check_time);
 
         return true;
     }
 
+    size_t size() {
+        std::lock_guard<std::mutex> lock_guard(structure_mutex);
+
+        return ban_list_storage.size();
+    }
+
     // Add blackholed hosts from external storage to internal
     bool set_whole_banlist(std::map<TemplateKeyType, banlist_item_t>& ban_list_param) {
         std::lock_guard<std::mutex> lock_guard(structure_mutex);
 
         // Copy whole content of passed list to current list
-        ban_list_storage.insert(ban_list_param.begin(), ban_list_param.end());
+        for (auto& elem : ban_list_param) {
+            if (ban_list_storage.count(elem.first) == 0) {
+                add_to_blackhole_without_lock(elem.first, elem.second);
+            }
+        }
 
         return true;
     }
@@ -113,6 +191,72 @@ template <typename TemplateKeyType> class blackhole_ban_list_t {
     }
 
     private:
+    // We unban host when we passed ban_time after ban_timestamp
+    static time_t get_unban_time(const banlist_item_t& banlist_item) {
+        return banlist_item.ban_timestamp + banlist_item.ban_time + 1;
+    }
+
+    void add_to_blackhole_without_lock(TemplateKeyType client_id, const attack_details_t& current_attack) {
+        auto itr = ban_list_storage.find(client_id);
+
+        if (itr != ban_list_storage.end()) {
+            remove_from_uuid_index(client_id, itr->second.attack_uuid);
+        }
+
+        ban_list_storage[client_id] = current_attack;
+
+        // Not all bans have uuid
+        if (!current_attack.attack_uuid.is_nil()) {
+            uuid_index[current_attack.attack_uuid] = client_id;
+        }
+
+        if (current_attack.unban_enabled) {
+            schedule_unban(client_id, get_unban_time(current_attack));
+        } else {
+            scheduled_unban_times.erase(client_id);
+        }
+    }
+
+    void schedule_unban(TemplateKeyType client_id, time_t unban_time) {
+        // Empty wheel could use time from another clock, we restart it from clock we use for bans
+        if (unban_timer_wheel.size() == 0) {
+            unban_timer_wheel.set_current_time(get_fast_time_seconds());
+        }
+
+        // Wheel may return time of next tick for time in past
+        if (unban_time <= unban_timer_wheel.get_current_time()) {
+            unban_time = unban_timer_wheel.get_current_time() + 1;
+        }
+
+        scheduled_unban_times[client_id] = unban_time;
+        unban_timer_wheel.insert(client_id, unban_time);
+    }
+
+    // We do not remove element from timer wheel, it will be ignored when expires
+    void remove_from_blackhole_without_lock(TemplateKeyType client_id) {
+        auto itr = ban_list_storage.find(client_id);
+
+        if (itr == ban_list_storage.end()) {
+            return;
+        }
+
+        remove_from_uuid_index(client_id, itr->second.attack_uuid);
+        scheduled_unban_times.erase(client_id);
+        ban_list_storage.erase(itr);
+    }
+
+    void remove_from_uuid_index(TemplateKeyType client_id, boost::uuids::uuid attack_uuid) {
+        auto itr = uuid_index.find(attack_uuid);
+
+        // Another host may use same uuid, we compare keys with operator< as we need only it for std::map
+        if (itr != uuid_index.end() && !(itr->second < client_id) && !(client_id < itr->second)) {
+            uuid_index.erase(itr);
+        }
+    }
+
     std::map<TemplateKeyType, banlist_item_t> ban_list_storage;
+    std::unordered_map<boost::uuids::uuid, TemplateKeyType, boost::hash<boost::uuids::uuid>> uuid_index;
+    std::map<TemplateKeyType, time_t> scheduled_unban_times;
+    timer_wheel_t<TemplateKeyType> unban_timer_wheel;
     std::mutex structure_mutex;
 };
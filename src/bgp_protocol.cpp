@@ -114,3 +114,83 @@ bool is_bgp_community_valid(std::string community_as_string) {
 
     return read_bgp_community_from_string(community_as_string, bgp_community_attribute_element);
 }
+
+bool convert_ip_protocol_to_flow_spec_protocol(uint32_t protocol, bgp_flow_spec_protocol_t& flow_spec_protocol) {
+    if (protocol == IPPROTO_UDP) {
+        flow_spec_protocol = FLOW_SPEC_PROTOCOL_UDP;
+    } else if (protocol == IPPROTO_TCP) {
+        flow_spec_protocol = FLOW_SPEC_PROTOCOL_TCP;
+    } else if (protocol == IPPROTO_ICMP) {
+        flow_spec_protocol = FLOW_SPEC_PROTOCOL_ICMP;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+uint32_t convert_flow_spec_protocol_to_ip_protocol(bgp_flow_spec_protocol_t flow_spec_protocol) {
+    if (flow_spec_protocol == FLOW_SPEC_PROTOCOL_UDP) {
+        return IPPROTO_UDP;
+    } else if (flow_spec_protocol == FLOW_SPEC_PROTOCOL_TCP) {
+        return IPPROTO_TCP;
+    } else {
+        return IPPROTO_ICMP;
+    }
+}
+
+// Example: announce flow route { match { destination 10.0.0.1/32; protocol [ udp ]; source-port [ =123 ]; } then { discard; } }
+std::string serialize_flow_spec_rule_for_exabgp(const flow_spec_rule_t& flow_spec_rule, bool is_withdrawal) {
+    std::ostringstream output_buffer;
+
+    output_buffer << (is_withdrawal ? "withdraw" : "announce") << " flow route { match { ";
+
+    if (flow_spec_rule.is_source_subnet_used()) {
+        output_buffer << "source " << convert_subnet_to_string(flow_spec_rule.get_source_subnet()) << "; ";
+    }
+
+    if (flow_spec_rule.is_destination_subnet_used()) {
+        output_buffer << "destination " << convert_subnet_to_string(flow_spec_rule.get_destination_subnet()) << "; ";
+    }
+
+    if (!flow_spec_rule.get_protocols().empty()) {
+        output_buffer << "protocol [ " << serialize_vector_by_string(flow_spec_rule.get_protocols(), " ") << " ]; ";
+    }
+
+    if (!flow_spec_rule.get_source_ports().empty()) {
+        output_buffer << "source-port [ "
+                      << serialize_vector_by_string_with_prefix(flow_spec_rule.get_source_ports(), " ", "=") << " ]; ";
+    }
+
+    if (!flow_spec_rule.get_destination_ports().empty()) {
+        output_buffer << "destination-port [ "
+                      << serialize_vector_by_string_with_prefix(flow_spec_rule.get_destination_ports(), " ", "=") << " ]; ";
+    }
+
+    std::vector<std::string> packet_length_conditions;
+
+    for (auto packet_length : flow_spec_rule.get_packet_lengths()) {
+        packet_length_conditions.push_back("=" + convert_int_to_string(packet_length));
+    }
+
+    for (const auto& packet_length_range : flow_spec_rule.get_packet_length_ranges()) {
+        packet_length_conditions.push_back(">=" + convert_int_to_string(packet_length_range.first) + "&<=" +
+                                           convert_int_to_string(packet_length_range.second));
+    }
+
+    if (!packet_length_conditions.empty()) {
+        output_buffer << "packet-length [ " << serialize_vector_by_string(packet_length_conditions, " ") << " ]; ";
+    }
+
+    if (!flow_spec_rule.get_fragmentation_flags().empty()) {
+        output_buffer << "fragment [ " << serialize_vector_by_string(flow_spec_rule.get_fragmentation_flags(), " ") << " ]; ";
+    }
+
+    if (!flow_spec_rule.get_tcp_flags().empty()) {
+        output_buffer << "tcp-flags [ " << serialize_vector_by_string(flow_spec_rule.get_tcp_flags(), " ") << " ]; ";
+    }
+
+    output_buffer << "} then { " << flow_spec_rule.get_action().serialize() << " } }\n";
+
+    return output_buffer.str();
+}
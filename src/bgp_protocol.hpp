@@ -2,6 +2,7 @@
 
 #include <stdint.h>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "fast_library.hpp"
@@ -102,11 +103,19 @@ class bgp_flow_spec_action_t {
         this->rate_limit = rate_limit;
     }
 
+    bgp_flow_spec_action_types_t get_type() const {
+        return this->action_type;
+    }
+
+    unsigned int get_rate_limit() const {
+        return this->rate_limit;
+    }
+
     void set_sentence_separator(std::string sentence_separator) {
         this->sentence_separator = sentence_separator;
     }
 
-    std::string serialize() {
+    std::string serialize() const {
         if (this->action_type == FLOW_SPEC_ACTION_ACCEPT) {
             return "accept" + sentence_separator;
         } else if (this->action_type == FLOW_SPEC_ACTION_DISCARD) {
@@ -166,6 +175,11 @@ class flow_spec_rule_t {
         this->packet_lengths.push_back(packet_length);
     }
 
+    // Matches lengths from minimum to maximum inclusive
+    void add_packet_length_range(uint16_t minimum_packet_length, uint16_t maximum_packet_length) {
+        this->packet_length_ranges.push_back(std::make_pair(minimum_packet_length, maximum_packet_length));
+    }
+
     void add_protocol(bgp_flow_spec_protocol_t protocol) {
         this->protocols.push_back(protocol);
     }
@@ -193,6 +207,54 @@ class flow_spec_rule_t {
         this->action = action;
     }
 
+    bool is_source_subnet_used() const {
+        return source_subnet_used;
+    }
+
+    const subnet_cidr_mask_t& get_source_subnet() const {
+        return source_subnet;
+    }
+
+    bool is_destination_subnet_used() const {
+        return destination_subnet_used;
+    }
+
+    const subnet_cidr_mask_t& get_destination_subnet() const {
+        return destination_subnet;
+    }
+
+    const std::vector<uint16_t>& get_source_ports() const {
+        return source_ports;
+    }
+
+    const std::vector<uint16_t>& get_destination_ports() const {
+        return destination_ports;
+    }
+
+    const std::vector<uint16_t>& get_packet_lengths() const {
+        return packet_lengths;
+    }
+
+    const std::vector<std::pair<uint16_t, uint16_t>>& get_packet_length_ranges() const {
+        return packet_length_ranges;
+    }
+
+    const std::vector<bgp_flow_spec_protocol_t>& get_protocols() const {
+        return protocols;
+    }
+
+    const std::vector<flow_spec_fragmentation_types_t>& get_fragmentation_flags() const {
+        return fragmentation_flags;
+    }
+
+    const std::vector<flow_spec_tcp_flags_t>& get_tcp_flags() const {
+        return tcp_flags;
+    }
+
+    const bgp_flow_spec_action_t& get_action() const {
+        return action;
+    }
+
     protected:
     // Only IPv4 supported
     subnet_cidr_mask_t source_subnet;
@@ -204,6 +266,7 @@ class flow_spec_rule_t {
     std::vector<uint16_t> source_ports;
     std::vector<uint16_t> destination_ports;
     std::vector<uint16_t> packet_lengths;
+    std::vector<std::pair<uint16_t, uint16_t>> packet_length_ranges;
     std::vector<bgp_flow_spec_protocol_t> protocols;
     std::vector<flow_spec_fragmentation_types_t> fragmentation_flags;
     std::vector<flow_spec_tcp_flags_t> tcp_flags;
@@ -213,3 +276,10 @@ class flow_spec_rule_t {
 
 bool read_bgp_community_from_string(std::string community_as_string, bgp_community_attribute_element_t& bgp_community_attribute_element);
 bool is_bgp_community_valid(std::string community_as_string);
+
+// Flow spec has no values for other protocols
+bool convert_ip_protocol_to_flow_spec_protocol(uint32_t protocol, bgp_flow_spec_protocol_t& flow_spec_protocol);
+uint32_t convert_flow_spec_protocol_to_ip_protocol(bgp_flow_spec_protocol_t flow_spec_protocol);
+
+// Builds ExaBGP API command for announce or withdrawal of flow spec rule
+std::string serialize_flow_spec_rule_for_exabgp(const flow_spec_rule_t& flow_spec_rule, bool is_withdrawal);
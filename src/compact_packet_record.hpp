@@ -0,0 +1,140 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <boost/lockfree/spsc_queue.hpp>
+
+#include "fastnetmon_simple_packet.hpp"
+
+// Fields of packet which capture threads pass to other threads, full simple_packet_t is more than twice larger
+// We use it for pipeline mode and Kafka export. Payload belongs to capture engine and will be gone before we read record
+class compact_packet_record_t {
+    public:
+    uint64_t length            = 0;
+    uint64_t ip_length         = 0;
+    uint64_t number_of_packets = 1;
+
+    time_t arrival_time = 0;
+    struct timeval ts   = { 0, 0 };
+
+    // IPv4 addresses are stored in first 4 bytes
+    in6_addr src_address{};
+    in6_addr dst_address{};
+
+    uint32_t sample_ratio     = 1;
+    uint32_t src_asn          = 0;
+    uint32_t dst_asn          = 0;
+    uint32_t input_interface  = 0;
+    uint32_t output_interface = 0;
+    uint32_t protocol         = 0;
+    uint32_t agent_ip_address = 0;
+    uint32_t vlan             = 0;
+
+    uint16_t source_port      = 0;
+    uint16_t destination_port = 0;
+
+    char src_country[2]{};
+    char dst_country[2]{};
+
+    uint8_t ip_protocol_version = 4;
+    uint8_t ttl                 = 0;
+    uint8_t flags               = 0;
+    bool ip_fragmented          = false;
+    bool ip_more_fragments      = false;
+    bool ip_dont_fragment       = false;
+
+    source_t source                       = UNKNOWN;
+    forwarding_status_t forwarding_status = forwarding_status_t::unknown;
+    direction_t packet_direction          = OTHER;
+};
+
+inline void convert_simple_packet_to_compact_record(const simple_packet_t& packet, compact_packet_record_t& record) {
+    record.length            = packet.length;
+    record.ip_length         = packet.ip_length;
+    record.number_of_packets = packet.number_of_packets;
+    record.arrival_time      = packet.arrival_time;
+    record.ts                = packet.ts;
+
+    if (packet.ip_protocol_version == 6) {
+        record.src_address = packet.src_ipv6;
+        record.dst_address = packet.dst_ipv6;
+    } else {
+        memcpy(&record.src_address, &packet.src_ip, sizeof(packet.src_ip));
+        memcpy(&record.dst_address, &packet.dst_ip, sizeof(packet.dst_ip));
+    }
+
+    record.sample_ratio     = packet.sample_ratio;
+    record.src_asn          = packet.src_asn;
+    record.dst_asn          = packet.dst_asn;
+    record.input_interface  = packet.input_interface;
+    record.output_interface = packet.output_interface;
+    record.protocol         = packet.protocol;
+    record.agent_ip_address = packet.agent_ip_address;
+    record.vlan             = packet.vlan;
+
+    record.source_port      = packet.source_port;
+    record.destination_port = packet.destination_port;
+
+    memcpy(record.src_country, packet.src_country.data(), packet.src_country.size());
+    memcpy(record.dst_country, packet.dst_country.data(), packet.dst_country.size());
+
+    record.ip_protocol_version = packet.ip_protocol_version;
+    record.ttl                 = packet.ttl;
+    record.flags               = packet.flags;
+    record.ip_fragmented       = packet.ip_fragmented;
+    record.ip_more_fragments   = packet.ip_more_fragments;
+    record.ip_dont_fragment    = packet.ip_dont_fragment;
+
+    record.source            = packet.source;
+    record.forwarding_status = packet.forwarding_status;
+    record.packet_direction  = packet.packet_direction;
+}
+
+inline void convert_compact_record_to_simple_packet(const compact_packet_record_t& record, simple_packet_t& packet) {
+    packet = simple_packet_t{};
+
+    packet.length            = record.length;
+    packet.ip_length         = record.ip_length;
+    packet.number_of_packets = record.number_of_packets;
+    packet.arrival_time      = record.arrival_time;
+    packet.ts                = record.ts;
+
+    if (record.ip_protocol_version == 6) {
+        packet.src_ipv6 = record.src_address;
+        packet.dst_ipv6 = record.dst_address;
+    } else {
+        memcpy(&packet.src_ip, &record.src_address, sizeof(packet.src_ip));
+        memcpy(&packet.dst_ip, &record.dst_address, sizeof(packet.dst_ip));
+    }
+
+    packet.sample_ratio     = record.sample_ratio;
+    packet.src_asn          = record.src_asn;
+    packet.dst_asn          = record.dst_asn;
+    packet.input_interface  = record.input_interface;
+    packet.output_interface = record.output_interface;
+    packet.protocol         = record.protocol;
+    packet.agent_ip_address = record.agent_ip_address;
+    packet.vlan             = record.vlan;
+
+    packet.source_port      = record.source_port;
+    packet.destination_port = record.destination_port;
+
+    packet.src_country.assign(record.src_country, strnlen(record.src_country, sizeof(record.src_country)));
+    packet.dst_country.assign(record.dst_country, strnlen(record.dst_country, sizeof(record.dst_country)));
+
+    packet.ip_protocol_version = record.ip_protocol_version;
+    packet.ttl                 = record.ttl;
+    packet.flags               = record.flags;
+    packet.ip_fragmented       = record.ip_fragmented;
+    packet.ip_more_fragments   = record.ip_more_fragments;
+    packet.ip_dont_fragment    = record.ip_dont_fragment;
+
+    packet.source            = record.source;
+    packet.forwarding_status = record.forwarding_status;
+    packet.packet_direction  = record.packet_direction;
+}
+
+// Lock free queue between single capture thread and single reader of records
+// Number of elements is approximate when we read it from threads other than consumer
+typedef boost::lockfree::spsc_queue<compact_packet_record_t> compact_packet_record_queue_t;
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <atomic>
+#include <new>
+#include <stdint.h>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#endif
+
+// Page types which we could use for per host counters
+enum class counters_huge_pages_t : unsigned int { Off = 0, Transparent = 1, HugePages2MB = 2, HugePages1GB = 3 };
+
+// Settings and statistics for memory of per host counters
+// Settings should be changed only before we allocate any counters
+class counters_memory_t {
+    public:
+    counters_huge_pages_t huge_pages = counters_huge_pages_t::Transparent;
+
+    // NUMA node for counters memory, -1 means that we do not bind it
+    int numa_node = -1;
+
+    std::atomic<uint64_t> huge_pages_bytes{ 0 };
+    std::atomic<uint64_t> transparent_huge_pages_bytes{ 0 };
+    std::atomic<uint64_t> regular_bytes{ 0 };
+    std::atomic<uint64_t> huge_pages_allocation_failures{ 0 };
+    std::atomic<uint64_t> numa_bind_failures{ 0 };
+
+    // Number of blocks allocated on demand for sparse counters
+    std::atomic<uint64_t> sparse_blocks{ 0 };
+
+    // Number of sparse blocks which we freed after long time without traffic
+    std::atomic<uint64_t> sparse_blocks_retired{ 0 };
+};
+
+inline counters_memory_t& get_counters_memory() {
+    static counters_memory_t counters_memory;
+
+    return counters_memory;
+}
+
+inline std::string get_counters_huge_pages_name(counters_huge_pages_t huge_pages) {
+    switch (huge_pages) {
+    case counters_huge_pages_t::Off:
+        return "off";
+    case counters_huge_pages_t::Transparent:
+        return "transparent";
+    case counters_huge_pages_t::HugePages2MB:
+        return "2mb";
+    case counters_huge_pages_t::HugePages1GB:
+        return "1gb";
+    }
+
+    return "unknown";
+}
+
+inline bool get_counters_huge_pages_by_name(const std::string& name, counters_huge_pages_t& huge_pages) {
+    if (name == "off") {
+        huge_pages = counters_huge_pages_t::Off;
+    } else if (name == "transparent") {
+        huge_pages = counters_huge_pages_t::Transparent;
+    } else if (name == "2mb") {
+        huge_pages = counters_huge_pages_t::HugePages2MB;
+    } else if (name == "1gb") {
+        huge_pages = counters_huge_pages_t::HugePages1GB;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+// Allocator for large arrays of per host counters
+// Arrays smaller than half of huge page go to default allocator because we will waste most of page for them
+// Large arrays get own mapping backed by huge pages and bound to NUMA node. When system has no free huge pages
+// we fall back to regular pages with transparent huge pages hint
+template <typename TemplateElementType> class counters_allocator_t {
+    public:
+    typedef TemplateElementType value_type;
+
+    counters_allocator_t() noexcept {
+    }
+
+    template <typename TemplateOtherElementType>
+    counters_allocator_t(const counters_allocator_t<TemplateOtherElementType>&) noexcept {
+    }
+
+    TemplateElementType* allocate(size_t number_of_elements) {
+        size_t number_of_bytes = number_of_elements * sizeof(TemplateElementType);
+
+        if (!use_separate_mapping(number_of_bytes)) {
+            get_counters_memory().regular_bytes += number_of_bytes;
+
+            return static_cast<TemplateElementType*>(::operator new(number_of_bytes));
+        }
+
+        void* memory = allocate_mapping(number_of_bytes);
+
+        if (memory == nullptr) {
+            throw std::bad_alloc();
+        }
+
+        return static_cast<TemplateElementType*>(memory);
+    }
+
+    void deallocate(TemplateElementType* pointer, size_t number_of_elements) noexcept {
+        size_t number_of_bytes = number_of_elements * sizeof(TemplateElementType);
+
+        if (!use_separate_mapping(number_of_bytes)) {
+            get_counters_memory().regular_bytes -= number_of_bytes;
+
+            ::operator delete(pointer);
+            return;
+        }
+
+        // We keep page size of mapping in its first bytes because we may fall back from huge pages
+        uint8_t* mapping = reinterpret_cast<uint8_t*>(pointer) - header_size;
+
+        mapping_header_t header = *reinterpret_cast<mapping_header_t*>(mapping);
+
+        size_t mapping_size = round_up(number_of_bytes + header_size, header.page_size);
+
+        if (header.explicit_huge_pages) {
+            get_counters_memory().huge_pages_bytes -= mapping_size;
+        } else {
+            get_counters_memory().transparent_huge_pages_bytes -= mapping_size;
+        }
+
+        munmap(mapping, mapping_size);
+    }
+
+    private:
+    class mapping_header_t {
+        public:
+        size_t page_size         = 0;
+        bool explicit_huge_pages = false;
+    };
+
+    // We keep arrays aligned to cache line
+    static const size_t header_size = 64;
+
+    static const size_t huge_page_2mb = 2 * 1024 * 1024;
+    static const size_t huge_page_1gb = 1024 * 1024 * 1024;
+
+    static bool use_separate_mapping(size_t number_of_bytes) {
+        if (get_counters_memory().huge_pages == counters_huge_pages_t::Off) {
+            return false;
+        }
+
+        return number_of_bytes >= huge_page_2mb / 2;
+    }
+
+    // We use 1GB pages only for arrays which fill most of such page
+    static size_t get_mapping_page_size(size_t number_of_bytes) {
+        if (get_counters_memory().huge_pages == counters_huge_pages_t::HugePages1GB && number_of_bytes >= huge_page_1gb / 2) {
+            return huge_page_1gb;
+        }
+
+        return huge_page_2mb;
+    }
+
+    static size_t round_up(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    static void* allocate_mapping(size_t number_of_bytes) {
+        counters_memory_t& counters_memory = get_counters_memory();
+
+        size_t page_size = get_mapping_page_size(number_of_bytes);
+
+        mapping_header_t header;
+        header.page_size = page_size;
+
+        void* mapping = MAP_FAILED;
+
+        size_t mapping_size = round_up(number_of_bytes + header_size, page_size);
+
+#ifdef MAP_HUGETLB
+        if (counters_memory.huge_pages == counters_huge_pages_t::HugePages2MB ||
+            counters_memory.huge_pages == counters_huge_pages_t::HugePages1GB) {
+            int page_size_flag = page_size == huge_page_1gb ? (30 << MAP_HUGE_SHIFT) : (21 << MAP_HUGE_SHIFT);
+
+            mapping = mmap(NULL, mapping_size, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | page_size_flag, -1, 0);
+
+            if (mapping == MAP_FAILED) {
+                // Usually it means that vm.nr_hugepages is too small
+                counters_memory.huge_pages_allocation_failures++;
+            } else {
+                header.explicit_huge_pages = true;
+            }
+        }
+#endif
+
+        if (mapping == MAP_FAILED) {
+            // Transparent huge pages need 2MB aligned range and we allocate more and trim it
+            header.page_size = huge_page_2mb;
+            mapping_size     = round_up(number_of_bytes + header_size, huge_page_2mb);
+
+            void* unaligned_mapping =
+                mmap(NULL, mapping_size + huge_page_2mb, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+            if (unaligned_mapping == MAP_FAILED) {
+                return nullptr;
+            }
+
+            uintptr_t unaligned_address = reinterpret_cast<uintptr_t>(unaligned_mapping);
+            uintptr_t aligned_address   = round_up(unaligned_address, huge_page_2mb);
+
+            if (aligned_address > unaligned_address) {
+                munmap(unaligned_mapping, aligned_address - unaligned_address);
+            }
+
+            size_t tail_size = unaligned_address + huge_page_2mb - aligned_address;
+
+            if (tail_size > 0) {
+                munmap(reinterpret_cast<void*>(aligned_address + mapping_size), tail_size);
+            }
+
+            mapping = reinterpret_cast<void*>(aligned_address);
+
+#ifdef MADV_HUGEPAGE
+            madvise(mapping, mapping_size, MADV_HUGEPAGE);
+#endif
+        }
+
+#ifdef __linux__
+        // We bind memory before first touch, then kernel allocates pages on our node
+        if (counters_memory.numa_node >= 0 && counters_memory.numa_node < int(sizeof(unsigned long) * 8)) {
+            unsigned long node_mask = 1UL << counters_memory.numa_node;
+
+            if (syscall(SYS_mbind, mapping, mapping_size, MPOL_PREFERRED, &node_mask, sizeof(node_mask) * 8, 0) != 0) {
+                counters_memory.numa_bind_failures++;
+            }
+        }
+#endif
+
+        if (header.explicit_huge_pages) {
+            counters_memory.huge_pages_bytes += mapping_size;
+        } else {
+            counters_memory.transparent_huge_pages_bytes += mapping_size;
+        }
+
+        *reinterpret_cast<mapping_header_t*>(mapping) = header;
+
+        return reinterpret_cast<uint8_t*>(mapping) + header_size;
+    }
+};
+
+template <typename TemplateFirstType, typename TemplateSecondType>
+bool operator==(const counters_allocator_t<TemplateFirstType>&, const counters_allocator_t<TemplateSecondType>&) noexcept {
+    return true;
+}
+
+template <typename TemplateFirstType, typename TemplateSecondType>
+bool operator!=(const counters_allocator_t<TemplateFirstType>&, const counters_allocator_t<TemplateSecondType>&) noexcept {
+    return false;
+}
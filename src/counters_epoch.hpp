@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+
+// We keep two generations of per host counters which we increment without locks
+// Packet processing threads increment counters of active generation. Recalculation thread flips epoch, waits until all
+// writers leave previous generation and reads it without races with increments
+class counters_epoch_t {
+    public:
+    // Returns generation which writer should increment, writer must call leave() for it after increments
+    unsigned int enter() {
+        writers_shard_t& writers_shard = get_writers_shard();
+
+        while (true) {
+            unsigned int generation = current_generation.load(std::memory_order_acquire);
+
+            // Flip could not miss us because both sides use sequentially consistent operations
+            writers_shard.writers[generation].fetch_add(1, std::memory_order_seq_cst);
+
+            if (current_generation.load(std::memory_order_seq_cst) == generation) {
+                return generation;
+            }
+
+            // Epoch was flipped in same time and we retry with new generation
+            writers_shard.writers[generation].fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    void leave(unsigned int generation) {
+        get_writers_shard().writers[generation].fetch_sub(1, std::memory_order_release);
+    }
+
+    // Switches writers to another generation and returns previous generation when nobody writes to it
+    // Only one thread should call it
+    unsigned int flip() {
+        unsigned int previous_generation = current_generation.load(std::memory_order_relaxed);
+
+        current_generation.store(previous_generation ^ 1, std::memory_order_seq_cst);
+
+        for (auto& writers_shard : writers_shards) {
+            // Writers spend nanoseconds between enter and leave
+            while (writers_shard.writers[previous_generation].load(std::memory_order_seq_cst) != 0) {
+                std::this_thread::yield();
+            }
+        }
+
+        return previous_generation;
+    }
+
+    private:
+    // Writers from different threads use different cache lines
+    class alignas(64) writers_shard_t {
+        public:
+        std::atomic<uint64_t> writers[2]{};
+    };
+
+    static const size_t number_of_writers_shards = 64;
+
+    writers_shard_t& get_writers_shard() {
+        thread_local size_t writers_shard_index = next_writers_shard_index.fetch_add(1, std::memory_order_relaxed);
+
+        return writers_shards[writers_shard_index % number_of_writers_shards];
+    }
+
+    std::atomic<unsigned int> current_generation{ 0 };
+    std::atomic<size_t> next_writers_shard_index{ 0 };
+
+    writers_shard_t writers_shards[number_of_writers_shards];
+};
+
+// Leaves generation on all paths of writer
+class counters_epoch_guard_t {
+    public:
+    counters_epoch_guard_t(counters_epoch_t& counters_epoch) : counters_epoch(counters_epoch) {
+        generation = counters_epoch.enter();
+    }
+
+    ~counters_epoch_guard_t() {
+        leave();
+    }
+
+    counters_epoch_guard_t(const counters_epoch_guard_t&) = delete;
+    counters_epoch_guard_t& operator=(const counters_epoch_guard_t&) = delete;
+
+    unsigned int get_generation() const {
+        return generation;
+    }
+
+    // We should leave generation as soon as possible
+    void leave() {
+        if (left) {
+            return;
+        }
+
+        counters_epoch.leave(generation);
+        left = true;
+    }
+
+    private:
+    counters_epoch_t& counters_epoch;
+    unsigned int generation = 0;
+    bool left               = false;
+};
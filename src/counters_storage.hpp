@@ -0,0 +1,330 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <new>
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+#include "counters_allocator.hpp"
+
+// Per host counters for single network
+// In dense mode we allocate counters for all hosts at once
+// In sparse mode we split network into blocks of 256 hosts (/24) and allocate block on first traffic to it
+// Blocks idle for long time could be retired, readers could use pointers to them during grace period and then we free them
+template <typename TemplateElementType> class counters_storage_t {
+    public:
+    static constexpr size_t block_size = 256;
+
+    counters_storage_t() {
+    }
+
+    counters_storage_t(size_t number_of_elements, bool sparse) : number_of_elements(number_of_elements), sparse(sparse) {
+        number_of_blocks = (number_of_elements + block_size - 1) / block_size;
+
+        blocks.reset(new std::atomic<TemplateElementType*>[number_of_blocks]);
+        active_blocks.reset(new std::atomic<uint64_t>[(number_of_blocks + 63) / 64]);
+
+        for (size_t block_index = 0; block_index < number_of_blocks; block_index++) {
+            blocks[block_index] = nullptr;
+        }
+
+        for (size_t word_index = 0; word_index < (number_of_blocks + 63) / 64; word_index++) {
+            active_blocks[word_index] = 0;
+        }
+
+        if (sparse) {
+            idle_periods.reset(new uint32_t[number_of_blocks]());
+            return;
+        }
+
+        // Single array allows us to use huge pages for it
+        dense_elements.resize(number_of_elements);
+
+        for (size_t block_index = 0; block_index < number_of_blocks; block_index++) {
+            blocks[block_index] = dense_elements.data() + block_index * block_size;
+        }
+    }
+
+    counters_storage_t(const counters_storage_t&) = delete;
+    counters_storage_t& operator=(const counters_storage_t&) = delete;
+
+    counters_storage_t(counters_storage_t&& other) noexcept {
+        swap(other);
+    }
+
+    counters_storage_t& operator=(counters_storage_t&& other) noexcept {
+        counters_storage_t new_storage(std::move(other));
+        swap(new_storage);
+
+        return *this;
+    }
+
+    ~counters_storage_t() {
+        if (!sparse || blocks == nullptr) {
+            return;
+        }
+
+        for (size_t block_index = 0; block_index < number_of_blocks; block_index++) {
+            TemplateElementType* block = blocks[block_index].load();
+
+            if (block != nullptr) {
+                free_block(block, get_block_length(block_index));
+                get_counters_memory().sparse_blocks--;
+            }
+        }
+
+        for (auto& retired_block : retired_blocks) {
+            free_block(retired_block.block, retired_block.block_length);
+            get_counters_memory().sparse_blocks--;
+        }
+    }
+
+    size_t size() const {
+        return number_of_elements;
+    }
+
+    bool is_sparse() const {
+        return sparse;
+    }
+
+    size_t get_number_of_blocks() const {
+        return number_of_blocks;
+    }
+
+    // Last block of networks smaller than /24 is shorter than block_size
+    size_t get_block_length(size_t block_index) const {
+        return std::min(block_size, number_of_elements - block_index * block_size);
+    }
+
+    // Returns nullptr when block was not allocated yet
+    TemplateElementType* get_block(size_t block_index) const {
+        return blocks[block_index].load(std::memory_order_acquire);
+    }
+
+    // Returns nullptr only when we have no memory
+    TemplateElementType* get_or_allocate_block(size_t block_index) {
+        TemplateElementType* block = blocks[block_index].load(std::memory_order_acquire);
+
+        if (block != nullptr) {
+            return block;
+        }
+
+        block = allocate_block(get_block_length(block_index));
+
+        if (block == nullptr) {
+            return nullptr;
+        }
+
+        TemplateElementType* expected_block = nullptr;
+
+        // Another thread could allocate same block in same time and we use its copy
+        if (!blocks[block_index].compare_exchange_strong(expected_block, block, std::memory_order_acq_rel,
+                                                         std::memory_order_acquire)) {
+            free_block(block, get_block_length(block_index));
+            return expected_block;
+        }
+
+        get_counters_memory().sparse_blocks++;
+
+        return block;
+    }
+
+    // Returns nullptr when block for this element was not allocated yet
+    TemplateElementType* get(size_t index) const {
+        TemplateElementType* block = get_block(index / block_size);
+
+        if (block == nullptr) {
+            return nullptr;
+        }
+
+        return block + index % block_size;
+    }
+
+    // Should be used by packet processing threads because it marks block as active
+    TemplateElementType* get_or_allocate(size_t index) {
+        size_t block_index = index / block_size;
+
+        TemplateElementType* block = get_or_allocate_block(block_index);
+
+        if (block == nullptr) {
+            return nullptr;
+        }
+
+        mark_block_active(block_index);
+
+        return block + index % block_size;
+    }
+
+    void mark_block_active(size_t block_index) {
+        std::atomic<uint64_t>& word = active_blocks[block_index / 64];
+        uint64_t mask               = uint64_t(1) << (block_index % 64);
+
+        // Block is active most of time and we avoid writes to shared cache line for it
+        if ((word.load(std::memory_order_relaxed) & mask) == 0) {
+            word.fetch_or(mask, std::memory_order_relaxed);
+        }
+    }
+
+    bool is_block_active(size_t block_index) const {
+        uint64_t mask = uint64_t(1) << (block_index % 64);
+
+        return (active_blocks[block_index / 64].load(std::memory_order_relaxed) & mask) != 0;
+    }
+
+    // Clears activity flag and returns its previous value
+    bool clear_block_activity(size_t block_index) {
+        std::atomic<uint64_t>& word = active_blocks[block_index / 64];
+        uint64_t mask               = uint64_t(1) << (block_index % 64);
+
+        if ((word.load(std::memory_order_relaxed) & mask) == 0) {
+            return false;
+        }
+
+        return (word.fetch_and(~mask, std::memory_order_relaxed) & mask) != 0;
+    }
+
+    void set_block_activity(size_t block_index, bool active) {
+        if (active) {
+            mark_block_active(block_index);
+        } else {
+            clear_block_activity(block_index);
+        }
+    }
+
+    // Number of recalculation periods when block had no traffic and zero averages, only for sparse mode
+    uint32_t increment_idle_periods(size_t block_index) {
+        return ++idle_periods[block_index];
+    }
+
+    void reset_idle_periods(size_t block_index) {
+        idle_periods[block_index] = 0;
+    }
+
+    // Detaches block in sparse mode, next traffic to it allocates new block
+    // Readers which already got pointer to block could use it during grace period
+    // Only single thread should retire and free blocks
+    bool retire_block(size_t block_index) {
+        if (!sparse) {
+            return false;
+        }
+
+        TemplateElementType* block = blocks[block_index].exchange(nullptr, std::memory_order_acq_rel);
+
+        if (block == nullptr) {
+            return false;
+        }
+
+        idle_periods[block_index] = 0;
+        get_counters_memory().sparse_blocks_retired++;
+
+        retired_blocks.push_back({ block, get_block_length(block_index), std::chrono::steady_clock::now() });
+
+        return true;
+    }
+
+    // Frees retired blocks when nobody could use them anymore
+    void free_retired_blocks(std::chrono::steady_clock::time_point now) {
+        if (retired_blocks.empty()) {
+            return;
+        }
+
+        std::vector<retired_block_t> still_retired_blocks;
+
+        for (auto& retired_block : retired_blocks) {
+            if (now - retired_block.retire_time > grace_period) {
+                free_block(retired_block.block, retired_block.block_length);
+                get_counters_memory().sparse_blocks--;
+            } else {
+                still_retired_blocks.push_back(retired_block);
+            }
+        }
+
+        retired_blocks = still_retired_blocks;
+    }
+
+    size_t get_number_of_retired_blocks() const {
+        return retired_blocks.size();
+    }
+
+    // Calls callback with index and reference for all elements in allocated blocks
+    template <typename TemplateCallbackType> void for_each_allocated_element(TemplateCallbackType callback) {
+        for (size_t block_index = 0; block_index < number_of_blocks; block_index++) {
+            TemplateElementType* block = get_block(block_index);
+
+            if (block == nullptr) {
+                continue;
+            }
+
+            size_t block_length = get_block_length(block_index);
+
+            for (size_t index_in_block = 0; index_in_block < block_length; index_in_block++) {
+                callback(block_index * block_size + index_in_block, block[index_in_block]);
+            }
+        }
+    }
+
+    private:
+    class retired_block_t {
+        public:
+        TemplateElementType* block = nullptr;
+        size_t block_length        = 0;
+        std::chrono::steady_clock::time_point retire_time;
+    };
+
+    // Packet processing threads keep pointer to block for nanoseconds
+    static constexpr std::chrono::seconds grace_period{ 5 };
+
+    void swap(counters_storage_t& other) noexcept {
+        std::swap(number_of_elements, other.number_of_elements);
+        std::swap(number_of_blocks, other.number_of_blocks);
+        std::swap(sparse, other.sparse);
+        std::swap(blocks, other.blocks);
+        std::swap(active_blocks, other.active_blocks);
+        std::swap(idle_periods, other.idle_periods);
+        std::swap(retired_blocks, other.retired_blocks);
+        std::swap(dense_elements, other.dense_elements);
+    }
+
+    static TemplateElementType* allocate_block(size_t block_length) {
+        counters_allocator_t<TemplateElementType> allocator;
+
+        TemplateElementType* block = nullptr;
+
+        try {
+            block = allocator.allocate(block_length);
+        } catch (std::bad_alloc& ba) {
+            return nullptr;
+        }
+
+        std::uninitialized_value_construct_n(block, block_length);
+
+        return block;
+    }
+
+    static void free_block(TemplateElementType* block, size_t block_length) {
+        counters_allocator_t<TemplateElementType> allocator;
+
+        std::destroy_n(block, block_length);
+        allocator.deallocate(block, block_length);
+    }
+
+    size_t number_of_elements = 0;
+    size_t number_of_blocks   = 0;
+    bool sparse               = false;
+
+    std::unique_ptr<std::atomic<TemplateElementType*>[]> blocks;
+
+    // Flags for blocks which need recalculation: traffic counters set them on traffic and averages keep them while
+    // averages are not zero
+    std::unique_ptr<std::atomic<uint64_t>[]> active_blocks;
+
+    // Only recalculation thread uses them
+    std::unique_ptr<uint32_t[]> idle_periods;
+    std::vector<retired_block_t> retired_blocks;
+
+    std::vector<TemplateElementType, counters_allocator_t<TemplateElementType>> dense_elements;
+};
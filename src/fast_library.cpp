@@ -17,6 +17,7 @@
 #include <sys/utsname.h>
 
 #include "all_logcpp_libraries.hpp"
+#include "fast_time.hpp"
 
 #include <boost/asio.hpp>
 
@@ -43,6 +44,11 @@ int convert_string_to_integer(std::string line) {
     return atoi(line.c_str());
 }
 
+// convert string to double, we use it for fractional periods
+double convert_string_to_double(std::string line) {
+    return atof(line.c_str());
+}
+
 uint32_t convert_ip_as_string_to_uint(std::string ip) {
     struct in_addr ip_addr;
     inet_aton(ip.c_str(), &ip_addr);
@@ -512,10 +518,9 @@ std::string print_simple_packet(simple_packet_t packet) {
     std::stringstream buffer;
 
     if (packet.ts.tv_sec == 0) {
-        // Netmap does not generate timestamp for all packets because it's very CPU
-        // intensive operation
+        // Some plugins do not generate timestamp for all packets
         // But we want pretty attack report and fill it there
-        gettimeofday(&packet.ts, NULL);
+        get_fast_time(packet.ts);
     }
 
     buffer << convert_timeval_to_date(packet.ts) << " ";
@@ -80,6 +80,7 @@ unsigned int get_cidr_mask_from_network_as_string(std::string network_cidr_forma
 void copy_networks_from_string_form_to_binary(std::vector<std::string> networks_list_as_string,
                                               std::vector<subnet_cidr_mask_t>& our_networks);
 int convert_string_to_integer(std::string line);
+double convert_string_to_double(std::string line);
 
 bool print_pid_to_file(pid_t pid, std::string pid_path);
 bool read_pid_from_file(pid_t& pid, std::string pid_path);
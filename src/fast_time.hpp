@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include <sys/time.h>
+#include <time.h>
+
+// Cheap wall clock for timestamps of packets, bucket timing and pcap headers
+// Coarse clocks are served from vDSO without system call and without reading of clock source, they return time of last
+// timer tick and resolution is 1-4 milliseconds depending on kernel configuration
+
+#if defined(CLOCK_REALTIME_COARSE)
+#define FASTNETMON_FAST_CLOCK CLOCK_REALTIME_COARSE
+#elif defined(CLOCK_REALTIME_FAST)
+// FreeBSD
+#define FASTNETMON_FAST_CLOCK CLOCK_REALTIME_FAST
+#else
+#define FASTNETMON_FAST_CLOCK CLOCK_REALTIME
+#endif
+
+// In offline mode we use time from packets instead of wall clock, zero means that override is disabled
+inline std::atomic<int64_t> fast_time_override_microseconds{ 0 };
+
+inline void set_fast_time_override(const timeval& current_time) {
+    fast_time_override_microseconds.store(int64_t(current_time.tv_sec) * 1000000 + current_time.tv_usec, std::memory_order_relaxed);
+}
+
+inline void disable_fast_time_override() {
+    fast_time_override_microseconds.store(0, std::memory_order_relaxed);
+}
+
+inline void get_fast_time(timeval& current_time) {
+    int64_t override_microseconds = fast_time_override_microseconds.load(std::memory_order_relaxed);
+
+    if (override_microseconds != 0) {
+        current_time.tv_sec  = override_microseconds / 1000000;
+        current_time.tv_usec = override_microseconds % 1000000;
+        return;
+    }
+
+    struct timespec current_timespec = { 0, 0 };
+    clock_gettime(FASTNETMON_FAST_CLOCK, &current_timespec);
+
+    current_time.tv_sec  = current_timespec.tv_sec;
+    current_time.tv_usec = current_timespec.tv_nsec / 1000;
+}
+
+inline time_t get_fast_time_seconds() {
+    timeval current_time;
+    get_fast_time(current_time);
+
+    return current_time.tv_sec;
+}
+
+inline int64_t get_fast_time_milliseconds() {
+    timeval current_time;
+    get_fast_time(current_time);
+
+    return int64_t(current_time.tv_sec) * 1000 + current_time.tv_usec / 1000;
+}
+
+inline std::chrono::system_clock::time_point get_fast_time_point() {
+    timeval current_time;
+    get_fast_time(current_time);
+
+    return std::chrono::system_clock::time_point(std::chrono::seconds(current_time.tv_sec) +
+                                                 std::chrono::microseconds(current_time.tv_usec));
+}
+
+// Returns resolution of clock in nanoseconds, we print it on start
+inline int64_t get_fast_time_resolution() {
+    struct timespec resolution = { 0, 0 };
+
+    if (clock_getres(FASTNETMON_FAST_CLOCK, &resolution) != 0) {
+        return 0;
+    }
+
+    return int64_t(resolution.tv_sec) * 1000000000 + resolution.tv_nsec;
+}
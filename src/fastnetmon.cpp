@@ -31,6 +31,7 @@
 
 // Here we store variables which differs for different paltforms
 #include "fast_platform.hpp"
+#include "fast_time.hpp"
 
 #include "fastnetmon_logic.hpp"
 
@@ -76,12 +77,17 @@
 // Yes, maybe it's not an good idea but with this we can guarantee working code in example plugin
 #include "example_plugin/example_collector.hpp"
 
+#include "traffic_generator_plugin/traffic_generator_collector.hpp"
+
 #include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <set>
 
 #include <filesystem>
+#include <shared_mutex>
 #include <sstream>
 #include <utility>
 #include <vector>
@@ -115,6 +121,28 @@
 
 #include "ban_list.hpp"
 
+#include "attack_fingerprint.hpp"
+#include "flow_spec_generator.hpp"
+
+#include "ipv4_host_set.hpp"
+
+#include "networks_lookup.hpp"
+#include "counters_epoch.hpp"
+#include "packet_pipeline.hpp"
+
+#include "offline_pcap_ingestion.hpp"
+#include "parallel_executor.hpp"
+#include "rcu_pointer.hpp"
+#include "stage_latency.hpp"
+
+#ifdef FASTNETMON_REPLAY_BENCH
+#include "replay_bench.hpp"
+#endif
+
+#include "action_dispatcher.hpp"
+
+#include "actions/exabgp_action.hpp"
+
 #include "metrics/graphite.hpp"
 #include "metrics/influxdb.hpp"
 
@@ -146,6 +174,18 @@ std::string kafka_traffic_export_topic                    = "fastnetmon";
 kafka_traffic_export_format_t kafka_traffic_export_format = kafka_traffic_export_format_t::JSON;
 std::vector<std::string> kafka_traffic_export_brokers;
 
+// Size of per thread ring with records waiting for export
+unsigned int kafka_traffic_export_ring_size = 65536;
+
+// We pack many records into single Kafka message
+unsigned int kafka_traffic_export_records_per_message = 1000;
+
+// Maximum time we keep records before sending incomplete batch
+unsigned int kafka_traffic_export_linger_milliseconds = 100;
+
+// Maximum number of our messages librdkafka packs into single request to broker
+unsigned int kafka_traffic_export_batch_num_messages = 1000;
+
 std::chrono::steady_clock::time_point last_call_of_traffic_recalculation;
 
 std::string cli_stats_file_path = "/tmp/fastnetmon.dat";
@@ -166,13 +206,23 @@ std::string backtrace_path = "/var/log/fastnetmon_backtrace.dump";
 // Each this seconds we will check about available data in bucket
 unsigned int check_for_availible_for_processing_packets_buckets = 1;
 
-// Current time with pretty low precision, we use separate thread to update it
-time_t current_inaccurate_time = 0;
-
 // This is thread safe storage for captured from the wire packets for IPv6 traffic
 packet_buckets_storage_t<subnet_ipv6_cidr_mask_t> packet_buckets_ipv6_storage;
 
-unsigned int recalculate_speed_timeout = 1;
+// Shared memory for raw packets captured by all packet buckets
+packet_capture_slab_t packet_capture_slab;
+
+// Memory for raw packets of hosts under attack in megabytes, we allocate it once on start
+unsigned int packet_capture_memory_budget = 16;
+
+// We store only first bytes of each raw packet
+unsigned int packet_capture_snaplen = 2048;
+
+// Delay between traffic recalculations in seconds, it could be fractional for sub second detection
+double recalculate_speed_timeout = 1;
+
+// We smooth speed over this window (seconds) when we recalculate it more often
+double speed_calculation_window = 1;
 
 // We will remove all packet buckets which runs longer than this time. This value used only for one shot buckets.
 // Infinite bucket's will not removed
@@ -205,8 +255,28 @@ std::string prometheus_host = "127.0.0.1";
 // If customer uses ban_time smaller than this value we will use ban_time/2 as unban_iteration_sleep_time
 int unban_iteration_sleep_time = 60;
 
+// Periodic checkpoint of moving averages and bans which we load on start
+bool state_checkpoint                  = false;
+std::string state_checkpoint_path      = "/var/tmp/fastnetmon_state.dat";
+unsigned int state_checkpoint_interval = 60;
+
+// We do not restore averages from checkpoint older than this number of seconds
+unsigned int state_checkpoint_max_age = 600;
+
 bool unban_enabled = true;
 
+// Queue for ban and unban actions
+action_dispatcher_t action_dispatcher;
+
+// Number of threads which execute notify script calls
+unsigned int action_worker_threads = 4;
+
+// Maximum number of actions waiting for execution in queue of each backend
+unsigned int action_queue_capacity = 8192;
+
+// Maximum number of ExaBGP messages or Redis keys which we pass to backend in single request
+unsigned int action_maximum_batch_size = 256;
+
 #ifdef ENABLE_GOBGP
 bool gobgp_enabled = false;
 #endif
@@ -275,17 +345,51 @@ void init_global_ban_settings() {
 
 bool enable_connection_tracking = true;
 
-bool enable_afpacket_collection         = false;
-bool enable_af_xdp_collection           = false;
-bool enable_data_collection_from_mirror = true;
-bool enable_netmap_collection           = false;
-bool enable_sflow_collection            = false;
-bool enable_netflow_collection          = false;
-bool enable_pcap_collection             = false;
+bool enable_afpacket_collection          = false;
+bool enable_af_xdp_collection            = false;
+bool enable_data_collection_from_mirror  = true;
+bool enable_netmap_collection            = false;
+bool enable_sflow_collection             = false;
+bool enable_netflow_collection           = false;
+bool enable_pcap_collection              = false;
+bool enable_traffic_generator_collection = false;
+
+// Offline mode: we process pcap or pcapng dumps instead of live traffic and use time from packets for speed calculation
+bool pcap_offline = false;
+
+// List of dumps separated by comma
+std::string pcap_offline_files;
+
+// Number of threads which parse and process packets from dumps
+unsigned int pcap_offline_threads = 4;
+
+offline_pcap_ingestion_t offline_pcap_ingestion;
 
 std::string speed_calculation_time_desc = "Time consumed by recalculation for all IPs";
 struct timeval speed_calculation_time;
 
+std::string recalculated_hosts_desc = "Number of IPv4 hosts processed by last speed recalculation";
+uint64_t recalculated_hosts         = 0;
+
+// Number of threads for speed recalculation including main recalculation thread
+unsigned int speed_calculation_threads = 4;
+
+parallel_executor_t speed_calculation_executor;
+
+// In pipeline mode capture threads only push packets to rings and separate threads process them
+bool packet_pipeline_enabled = false;
+
+// Number of processing threads for pipeline mode
+unsigned int packet_pipeline_threads = 2;
+
+// Size of ring between each capture thread and each processing thread
+unsigned int packet_pipeline_ring_size = 16384;
+
+packet_pipeline_t packet_pipeline;
+
+// We set averages of hosts without traffic to zero when they decay below this speed in packets per second
+unsigned int average_speed_floor_pps = 1;
+
 // Time consumed by drawing stats for all IPs
 struct timeval drawing_thread_execution_time;
 
@@ -303,11 +407,49 @@ unsigned int total_number_of_hosts_in_our_networks     = 0;
 GeoIP* geo_ip = NULL;
 #endif
 
-// IPv4 lookup trees
-patricia_tree_t *lookup_tree_ipv4, *whitelist_tree_ipv4;
+// IPv4 whitelist tree
+patricia_tree_t* whitelist_tree_ipv4;
+
+// IPv6 whitelist tree
+patricia_tree_t* whitelist_tree_ipv6;
+
+// Lookup trees for our networks, we replace them as whole on reload
+rcu_pointer_t<networks_lookup_t> our_networks_lookup;
+
+// Protects structure of SubnetVectorMap, SubnetVectorMapSpeed, SubnetVectorMapSpeedAverage and SubnetVectorMapFlow
+// Packet processing threads do not use it and access counters via our_networks_lookup
+std::shared_mutex subnet_vector_maps_mutex;
+
+// Set from SIGHUP handler and API
+std::atomic<bool> networks_reload_requested{ false };
+
+// How long we keep counters for networks removed from networks list
+unsigned int removed_networks_grace_period = 60;
+
+// Removed networks and time when we should free their counters
+std::map<subnet_cidr_mask_t, time_t> retired_networks;
+
+std::string networks_reloads_desc = "Number of successful reloads of networks list and host groups";
+uint64_t networks_reloads         = 0;
+
+std::string networks_reload_errors_desc = "Number of failed reloads of networks list and host groups";
+uint64_t networks_reload_errors         = 0;
+
+std::string networks_added_on_reload_desc = "Number of networks added on reloads";
+uint64_t networks_added_on_reload         = 0;
 
-// IPv6 lookup trees
-patricia_tree_t *lookup_tree_ipv6, *whitelist_tree_ipv6;
+std::string networks_removed_on_reload_desc = "Number of networks removed on reloads";
+uint64_t networks_removed_on_reload         = 0;
+
+// NUMA node for per host counters: auto, off or number of node
+// auto means node of first interface from interfaces option
+std::string counters_numa_node = "auto";
+
+// Allocate per host counters by /24 blocks on first traffic instead of allocation for whole networks on start
+bool sparse_counters = false;
+
+// We free /24 block of sparse counters after this number of recalculation periods without traffic, zero disables it
+unsigned int sparse_counters_idle_periods = 600;
 
 bool DEBUG = 0;
 
@@ -338,6 +480,23 @@ unsigned int ban_details_records_count = 50;
 // We haven't option for configure it with configuration file
 unsigned int number_of_packets_for_pcap_attack_dump = 500;
 
+// Track top peers, ports and protocols for hosts under attack
+bool collect_attack_fingerprints = true;
+
+// Number of elements tracked by each heavy hitters sketch
+unsigned int attack_fingerprint_sketch_size = 128;
+
+// Number of top elements we report in attack details
+unsigned int attack_fingerprint_top_elements = 20;
+
+// Announce flow spec rules built from traffic samples of hosts under attack
+bool flow_spec_announces = false;
+
+flow_spec_generator_configuration_t flow_spec_generator_configuration;
+
+// Action for traffic matched by flow spec rules, we set it to discard on start
+bgp_flow_spec_action_t flow_spec_action;
+
 // log file
 log4cpp::Category& logger = log4cpp::Category::getRoot();
 
@@ -347,23 +506,28 @@ log4cpp::Category& logger = log4cpp::Category::getRoot();
 total_speed_counters_t total_counters_ipv4;
 total_speed_counters_t total_counters_ipv6;
 
+// Capture threads update own copies of these counters and recalculation moves traffic from them to total_counters_ipv4
+// and total_counters_ipv6
+total_traffic_counters_t total_traffic_counters_ipv4;
+total_traffic_counters_t total_traffic_counters_ipv6;
+
 std::string total_unparsed_packets_desc = "Total number of packets we failed to parse";
-uint64_t total_unparsed_packets         = 0;
+per_thread_counter_t total_unparsed_packets;
 
 std::string total_unparsed_packets_speed_desc = "Number of packets we fail to parse per second";
 uint64_t total_unparsed_packets_speed         = 0;
 
 std::string total_ipv4_packets_desc = "Total number of IPv4 simple packets processed";
-uint64_t total_ipv4_packets         = 0;
+per_thread_counter_t total_ipv4_packets;
 
 std::string total_ipv6_packets_desc = "Total number of IPv6 simple packets processed";
-uint64_t total_ipv6_packets         = 0;
+per_thread_counter_t total_ipv6_packets;
 
 std::string unknown_ip_version_packets_desc = "Non IPv4 and non IPv6 packets";
-uint64_t unknown_ip_version_packets         = 0;
+per_thread_counter_t unknown_ip_version_packets;
 
 std::string total_simple_packets_processed_desc = "Total number of simple packets processed";
-uint64_t total_simple_packets_processed         = 0;
+per_thread_counter_t total_simple_packets_processed;
 
 // IPv6 traffic which belongs to our own networks
 uint64_t our_ipv6_packets = 0;
@@ -371,7 +535,10 @@ uint64_t our_ipv6_packets = 0;
 uint64_t incoming_total_flows_speed = 0;
 uint64_t outgoing_total_flows_speed = 0;
 
-map_of_vector_counters_t SubnetVectorMap;
+// Traffic counters for two generations, packet processing threads increment active generation of
+// ipv4_host_counters_epoch and recalculation thread reads another one
+map_of_vector_counters_t SubnetVectorMap[2];
+counters_epoch_t ipv4_host_counters_epoch;
 
 // Network counters for IPv6
 abstract_subnet_counters_t<subnet_ipv6_cidr_mask_t> ipv6_subnet_counters;
@@ -393,7 +560,6 @@ int64_t sflow_raw_packet_headers_total_speed          = 0;
 
 /* End of our data structs */
 std::mutex ban_list_details_mutex;
-std::mutex ban_list_mutex;
 std::mutex flow_counter;
 
 // map for flows
@@ -413,15 +579,26 @@ map_for_counters GeoIpCounter;
 blackhole_ban_list_t<subnet_ipv6_cidr_mask_t> ban_list_ipv6_ng;
 
 // In ddos info we store attack power and direction
-std::map<uint32_t, banlist_item_t> ban_list;
+blackhole_ban_list_t<uint32_t> ban_list;
 std::map<uint32_t, std::vector<simple_packet_t>> ban_list_details;
 
-host_group_map_t host_groups;
+// Heavy hitters for IPv4 hosts under attack
+std::map<uint32_t, std::shared_ptr<attack_fingerprint_t>> attack_fingerprints;
+std::mutex attack_fingerprints_mutex;
+
+// Flow spec rules announced for IPv4 hosts, we withdraw them on unban
+std::map<uint32_t, std::vector<flow_spec_rule_t>> flow_spec_announced_rules;
+std::mutex flow_spec_announced_rules_mutex;
+
+// Lock free copies of ban_list_details and attack_fingerprints keys for lookups from process_packet
+rcu_ipv4_host_set_t hosts_under_collection;
+rcu_ipv4_host_set_t hosts_under_fingerprinting;
 
-// Here we store assignment from subnet to certain host group for fast lookup
-subnet_to_host_group_map_t subnet_to_host_groups;
+// Lock free copy of attack_fingerprints for process_packet
+rcu_pointer_t<attack_fingerprints_index_t> attack_fingerprints_index;
 
-host_group_ban_settings_map_t host_group_ban_settings_map;
+// Host groups with their ban settings
+rcu_pointer_t<host_groups_configuration_t> host_groups_configuration;
 
 std::vector<subnet_cidr_mask_t> our_networks;
 std::vector<subnet_cidr_mask_t> whitelist_networks;
@@ -550,7 +727,7 @@ std::vector<std::string> read_file_to_vector(std::string file_name) {
     return data;
 }
 
-void parse_hostgroups(std::string name, std::string value) {
+void parse_hostgroups(std::string name, std::string value, host_groups_configuration_t& host_groups_configuration) {
     // We are creating new host group of subnets
     if (name != "hostgroup") {
         return;
@@ -571,7 +748,7 @@ void parse_hostgroups(std::string name, std::string value) {
 
     std::string host_group_name = splitted_new_host_group[0];
 
-    if (host_groups.count(host_group_name) > 0) {
+    if (host_groups_configuration.host_groups.count(host_group_name) > 0) {
         logger << log4cpp::Priority::WARN << "We already have this host group (" << host_group_name << "). Please check!";
         return;
     }
@@ -581,27 +758,29 @@ void parse_hostgroups(std::string name, std::string value) {
     for (std::vector<std::string>::iterator itr = hostgroup_subnets.begin(); itr != hostgroup_subnets.end(); ++itr) {
         subnet_cidr_mask_t subnet = convert_subnet_from_string_to_binary_with_cidr_format(*itr);
 
-        host_groups[host_group_name].push_back(subnet);
+        host_groups_configuration.host_groups[host_group_name].push_back(subnet);
 
         logger << log4cpp::Priority::WARN << "We add subnet " << convert_subnet_to_string(subnet) << " to host group " << host_group_name;
 
         // And add to subnet to host group lookup hash
-        if (subnet_to_host_groups.count(subnet) > 0) {
+        if (host_groups_configuration.subnet_to_host_groups.count(subnet) > 0) {
             // Huston, we have problem! Subnet to host group mapping should map single subnet to single group!
             logger << log4cpp::Priority::WARN << "Seems you have specified single subnet " << *itr
                    << " to multiple host groups, please fix it, it's prohibited";
         } else {
-            subnet_to_host_groups[subnet] = host_group_name;
+            host_groups_configuration.subnet_to_host_groups[subnet] = host_group_name;
         }
     }
 
     logger << log4cpp::Priority::INFO << "We have created host group " << host_group_name << " with "
-           << host_groups[host_group_name].size() << " subnets";
+           << host_groups_configuration.host_groups[host_group_name].size() << " subnets";
 }
 
-// Load configuration
-bool load_configuration_file() {
-    std::ifstream config_file(fastnetmon_platform_configuration.global_config_path.c_str());
+// Reads all options from configuration file and host groups defined in it
+bool read_configuration_file(const std::string& file_path,
+                             configuration_map_t& configuration_map,
+                             host_groups_configuration_t& host_groups_configuration) {
+    std::ifstream config_file(file_path.c_str());
     std::string line;
 
     if (!config_file.is_open()) {
@@ -627,12 +806,39 @@ bool load_configuration_file() {
             configuration_map[parsed_config[0]] = parsed_config[1];
 
             // Well, we parse host groups here
-            parse_hostgroups(parsed_config[0], parsed_config[1]);
+            parse_hostgroups(parsed_config[0], parsed_config[1], host_groups_configuration);
         } else {
             logger << log4cpp::Priority::ERROR << "Can't parse config line: '" << line << "'";
         }
     }
 
+    return true;
+}
+
+// Read host group ban settings
+void read_host_groups_ban_settings(const configuration_map_t& configuration_map, host_groups_configuration_t& host_groups_configuration) {
+    for (auto hostgroup_itr = host_groups_configuration.host_groups.begin();
+         hostgroup_itr != host_groups_configuration.host_groups.end(); ++hostgroup_itr) {
+        std::string host_group_name = hostgroup_itr->first;
+
+        logger << log4cpp::Priority::INFO << "We will read ban settings for " << host_group_name;
+
+        host_groups_configuration.host_group_ban_settings_map[host_group_name] = read_ban_settings(configuration_map, host_group_name);
+
+        // logger << log4cpp::Priority::INFO << "We read " << host_group_name << " ban settings "
+        //    << print_ban_thresholds(host_groups_configuration.host_group_ban_settings_map[ host_group_name ]);
+    }
+}
+
+// Load configuration
+bool load_configuration_file() {
+    std::unique_ptr<host_groups_configuration_t> new_host_groups_configuration(new host_groups_configuration_t);
+
+    if (!read_configuration_file(fastnetmon_platform_configuration.global_config_path, configuration_map,
+                                 *new_host_groups_configuration)) {
+        return false;
+    }
+
     if (configuration_map.count("enable_connection_tracking")) {
         if (configuration_map["enable_connection_tracking"] == "on") {
             enable_connection_tracking = true;
@@ -674,12 +880,68 @@ bool load_configuration_file() {
         graphite_prefix = configuration_map["graphite_prefix"];
     }
 
+    if (configuration_map.count("state_checkpoint") != 0) {
+        state_checkpoint = configuration_map["state_checkpoint"] == "on";
+    }
+
+    if (configuration_map.count("state_checkpoint_path") != 0) {
+        state_checkpoint_path = configuration_map["state_checkpoint_path"];
+    }
+
+    if (configuration_map.count("state_checkpoint_interval") != 0) {
+        state_checkpoint_interval = convert_string_to_integer(configuration_map["state_checkpoint_interval"]);
+
+        if (state_checkpoint_interval == 0) {
+            logger << log4cpp::Priority::ERROR << "state_checkpoint_interval should be positive, we will use 60 seconds";
+            state_checkpoint_interval = 60;
+        }
+    }
+
+    if (configuration_map.count("state_checkpoint_max_age") != 0) {
+        state_checkpoint_max_age = convert_string_to_integer(configuration_map["state_checkpoint_max_age"]);
+    }
+
     if (configuration_map.count("average_calculation_time") != 0) {
-        average_calculation_amount = convert_string_to_integer(configuration_map["average_calculation_time"]);
+        average_calculation_amount = convert_string_to_double(configuration_map["average_calculation_time"]);
+
+        if (average_calculation_amount <= 0) {
+            logger << log4cpp::Priority::ERROR << "average_calculation_time should be positive, we will use 15 seconds";
+            average_calculation_amount = 15;
+        }
+    }
+
+    if (configuration_map.count("average_speed_floor_pps") != 0) {
+        average_speed_floor_pps = convert_string_to_integer(configuration_map["average_speed_floor_pps"]);
+    }
+
+    if (configuration_map.count("speed_calculation_threads") != 0) {
+        speed_calculation_threads = convert_string_to_integer(configuration_map["speed_calculation_threads"]);
+    }
+
+    if (configuration_map.count("packet_pipeline") != 0) {
+        packet_pipeline_enabled = configuration_map["packet_pipeline"] == "on";
+    }
+
+    if (configuration_map.count("packet_pipeline_threads") != 0) {
+        packet_pipeline_threads = convert_string_to_integer(configuration_map["packet_pipeline_threads"]);
+    }
+
+    if (configuration_map.count("packet_pipeline_ring_size") != 0) {
+        packet_pipeline_ring_size = convert_string_to_integer(configuration_map["packet_pipeline_ring_size"]);
     }
 
     if (configuration_map.count("speed_calculation_delay") != 0) {
-        recalculate_speed_timeout = convert_string_to_integer(configuration_map["speed_calculation_delay"]);
+        recalculate_speed_timeout = convert_string_to_double(configuration_map["speed_calculation_delay"]);
+
+        // Recalculation of all hosts could not run more often
+        if (recalculate_speed_timeout < 0.05) {
+            logger << log4cpp::Priority::ERROR << "speed_calculation_delay should be at least 0.05 seconds, we will use 1 second";
+            recalculate_speed_timeout = 1;
+        }
+    }
+
+    if (configuration_map.count("speed_calculation_window") != 0) {
+        speed_calculation_window = convert_string_to_double(configuration_map["speed_calculation_window"]);
     }
 
     if (configuration_map.count("monitor_local_ip_addresses") != 0) {
@@ -690,12 +952,47 @@ bool load_configuration_file() {
         monitor_openvz_vps_ip_addresses = configuration_map["monitor_openvz_vps_ip_addresses"] == "on" ? true : false;
     }
 
+    if (configuration_map.count("removed_networks_grace_period") != 0) {
+        removed_networks_grace_period = convert_string_to_integer(configuration_map["removed_networks_grace_period"]);
+    }
+
+    if (configuration_map.count("counters_huge_pages") != 0) {
+        if (!get_counters_huge_pages_by_name(configuration_map["counters_huge_pages"], get_counters_memory().huge_pages)) {
+            logger << log4cpp::Priority::ERROR << "Unknown value for counters_huge_pages: " << configuration_map["counters_huge_pages"]
+                   << " we will use transparent huge pages";
+        }
+    }
+
+    if (configuration_map.count("sparse_counters") != 0) {
+        sparse_counters = configuration_map["sparse_counters"] == "on";
+    }
+
+    if (configuration_map.count("sparse_counters_idle_periods") != 0) {
+        sparse_counters_idle_periods = convert_string_to_integer(configuration_map["sparse_counters_idle_periods"]);
+    }
+
+    if (configuration_map.count("counters_numa_node") != 0) {
+        counters_numa_node = configuration_map["counters_numa_node"];
+    }
+
 #ifdef FASTNETMON_API
     if (configuration_map.count("enable_api") != 0) {
         enable_api = configuration_map["enable_api"] == "on";
     }
 #endif
 
+    if (configuration_map.count("action_worker_threads") != 0) {
+        action_worker_threads = convert_string_to_integer(configuration_map["action_worker_threads"]);
+    }
+
+    if (configuration_map.count("action_queue_capacity") != 0) {
+        action_queue_capacity = convert_string_to_integer(configuration_map["action_queue_capacity"]);
+    }
+
+    if (configuration_map.count("action_maximum_batch_size") != 0) {
+        action_maximum_batch_size = convert_string_to_integer(configuration_map["action_maximum_batch_size"]);
+    }
+
 #ifdef ENABLE_GOBGP
     // GoBGP configuration
     if (configuration_map.count("gobgp") != 0) {
@@ -902,6 +1199,36 @@ bool load_configuration_file() {
         }
     }
 
+    if (configuration_map.count("traffic_generator") != 0) {
+        enable_traffic_generator_collection = configuration_map["traffic_generator"] == "on";
+    }
+
+    if (configuration_map.count("pcap_offline") != 0) {
+        pcap_offline = configuration_map["pcap_offline"] == "on";
+    }
+
+    if (configuration_map.count("pcap_offline_files") != 0) {
+        pcap_offline_files = configuration_map["pcap_offline_files"];
+    }
+
+    if (configuration_map.count("pcap_offline_threads") != 0) {
+        pcap_offline_threads = convert_string_to_integer(configuration_map["pcap_offline_threads"]);
+    }
+
+    if (configuration_map.count("stage_latency_metrics") != 0 && configuration_map["stage_latency_metrics"] == "on") {
+        unsigned int stage_latency_sampling_rate = 1024;
+
+        if (configuration_map.count("stage_latency_sampling_rate") != 0) {
+            stage_latency_sampling_rate = convert_string_to_integer(configuration_map["stage_latency_sampling_rate"]);
+        }
+
+        stage_latency_registry.enable(stage_latency_sampling_rate);
+
+        logger << log4cpp::Priority::INFO << "Stage latency metrics enabled, we measure one of "
+               << stage_latency_registry.get_sampling_rate() << " packets, time stamp counter tick is "
+               << stage_latency_registry.get_nanoseconds_per_tick() << " nanoseconds";
+    }
+
     // Read global ban configuration
     global_ban_settings = read_ban_settings(configuration_map, "");
 
@@ -909,17 +1236,9 @@ bool load_configuration_file() {
 
     // logger << log4cpp::Priority::INFO << "We read global ban settings: " << print_ban_thresholds(global_ban_settings);
 
-    // Read host group ban settings
-    for (host_group_map_t::iterator hostgroup_itr = host_groups.begin(); hostgroup_itr != host_groups.end(); ++hostgroup_itr) {
-        std::string host_group_name = hostgroup_itr->first;
-
-        logger << log4cpp::Priority::INFO << "We will read ban settings for " << host_group_name;
-
-        host_group_ban_settings_map[host_group_name] = read_ban_settings(configuration_map, host_group_name);
+    read_host_groups_ban_settings(configuration_map, *new_host_groups_configuration);
 
-        // logger << log4cpp::Priority::INFO << "We read " << host_group_name << " ban settings "
-        //    << print_ban_thresholds(host_group_ban_settings_map[ host_group_name ]);
-    }
+    host_groups_configuration.publish(new_host_groups_configuration.release());
 
     if (configuration_map.count("white_list_path") != 0) {
         fastnetmon_platform_configuration.white_list_path = configuration_map["white_list_path"];
@@ -984,6 +1303,25 @@ bool load_configuration_file() {
         boost::split(kafka_traffic_export_brokers, brokers_list_raw, boost::is_any_of(","), boost::token_compress_on);
     }
 
+    if (configuration_map.count("kafka_traffic_export_ring_size") != 0) {
+        kafka_traffic_export_ring_size = convert_string_to_integer(configuration_map["kafka_traffic_export_ring_size"]);
+    }
+
+    if (configuration_map.count("kafka_traffic_export_records_per_message") != 0) {
+        kafka_traffic_export_records_per_message =
+            convert_string_to_integer(configuration_map["kafka_traffic_export_records_per_message"]);
+    }
+
+    if (configuration_map.count("kafka_traffic_export_linger_milliseconds") != 0) {
+        kafka_traffic_export_linger_milliseconds =
+            convert_string_to_integer(configuration_map["kafka_traffic_export_linger_milliseconds"]);
+    }
+
+    if (configuration_map.count("kafka_traffic_export_batch_num_messages") != 0) {
+        kafka_traffic_export_batch_num_messages =
+            convert_string_to_integer(configuration_map["kafka_traffic_export_batch_num_messages"]);
+    }
+
     if (configuration_map.count("kafka_traffic_export_format") != 0) {
         std::string kafka_traffic_export_format_raw = configuration_map["kafka_traffic_export_format"];
 
@@ -1026,6 +1364,71 @@ bool load_configuration_file() {
         ban_details_records_count = convert_string_to_integer(configuration_map["ban_details_records_count"]);
     }
 
+    if (configuration_map.count("packet_capture_memory_budget") != 0) {
+        packet_capture_memory_budget = convert_string_to_integer(configuration_map["packet_capture_memory_budget"]);
+    }
+
+    if (configuration_map.count("packet_capture_snaplen") != 0) {
+        packet_capture_snaplen = convert_string_to_integer(configuration_map["packet_capture_snaplen"]);
+    }
+
+    if (configuration_map.count("collect_attack_fingerprints") != 0) {
+        collect_attack_fingerprints = configuration_map["collect_attack_fingerprints"] == "on";
+    }
+
+    if (configuration_map.count("attack_fingerprint_sketch_size") != 0) {
+        attack_fingerprint_sketch_size = convert_string_to_integer(configuration_map["attack_fingerprint_sketch_size"]);
+    }
+
+    if (configuration_map.count("attack_fingerprint_top_elements") != 0) {
+        attack_fingerprint_top_elements = convert_string_to_integer(configuration_map["attack_fingerprint_top_elements"]);
+    }
+
+    if (configuration_map.count("flow_spec_announces") != 0) {
+        flow_spec_announces = configuration_map["flow_spec_announces"] == "on";
+    }
+
+    flow_spec_action.set_type(FLOW_SPEC_ACTION_DISCARD);
+
+    if (configuration_map.count("flow_spec_action") != 0) {
+        if (configuration_map["flow_spec_action"] == "discard") {
+            flow_spec_action.set_type(FLOW_SPEC_ACTION_DISCARD);
+        } else if (configuration_map["flow_spec_action"] == "rate-limit") {
+            flow_spec_action.set_type(FLOW_SPEC_ACTION_RATE_LIMIT);
+        } else {
+            logger << log4cpp::Priority::ERROR << "Unknown flow spec action " << configuration_map["flow_spec_action"]
+                   << ", we will use discard";
+        }
+    }
+
+    if (configuration_map.count("flow_spec_rate_limit") != 0) {
+        flow_spec_action.set_rate_limit(convert_string_to_integer(configuration_map["flow_spec_rate_limit"]));
+    }
+
+    if (configuration_map.count("flow_spec_max_rules") != 0) {
+        flow_spec_generator_configuration.maximum_number_of_rules =
+            convert_string_to_integer(configuration_map["flow_spec_max_rules"]);
+    }
+
+    if (configuration_map.count("flow_spec_traffic_coverage") != 0) {
+        flow_spec_generator_configuration.traffic_coverage =
+            convert_string_to_integer(configuration_map["flow_spec_traffic_coverage"]) / 100.0;
+    }
+
+    if (configuration_map.count("flow_spec_dominant_port_share") != 0) {
+        flow_spec_generator_configuration.dominant_port_share =
+            convert_string_to_integer(configuration_map["flow_spec_dominant_port_share"]) / 100.0;
+    }
+
+    if (configuration_map.count("flow_spec_match_packet_length") != 0) {
+        flow_spec_generator_configuration.match_packet_length = configuration_map["flow_spec_match_packet_length"] == "on";
+    }
+
+    if (flow_spec_announces && ban_details_records_count == 0) {
+        logger << log4cpp::Priority::ERROR << "We need traffic samples for flow spec rules, please set ban_details_records_count above zero";
+        flow_spec_announces = false;
+    }
+
     if (configuration_map.count("check_period") != 0) {
         check_period = convert_string_to_integer(configuration_map["check_period"]);
     }
@@ -1079,76 +1482,59 @@ void enable_core_dumps() {
     }
 }
 
-void subnet_vectors_allocator(prefix_t* prefix, void* data) {
-    // Network byte order
-    uint32_t subnet_as_integer = prefix->add.sin.s_addr;
-
-    u_short bitlen          = prefix->bitlen;
+// Allocates counters for subnet
+// We allocate memory before taking lock to keep threads which iterate over counters running
+bool allocate_counters_for_subnet(const subnet_cidr_mask_t& current_subnet) {
     double base             = 2;
-    int network_size_in_ips = pow(base, 32 - bitlen);
-    // logger<< log4cpp::Priority::INFO<<"Subnet: "<<prefix->add.sin.s_addr<<" network size:
-    // "<<network_size_in_ips;
-    logger << log4cpp::Priority::INFO << "I will allocate " << network_size_in_ips << " records for subnet "
-           << subnet_as_integer << " cidr mask: " << bitlen;
+    int network_size_in_ips = pow(base, 32 - current_subnet.cidr_prefix_length);
 
-    subnet_cidr_mask_t current_subnet(subnet_as_integer, bitlen);
+    logger << log4cpp::Priority::INFO << "I will allocate " << network_size_in_ips << " records for subnet "
+           << current_subnet.subnet_address << " cidr mask: " << current_subnet.cidr_prefix_length;
 
-    subnet_counter_t zero_map_element{};
+    vector_of_counters counters[2];
+    vector_of_counters speed_counters;
+    vector_of_counters average_speed_counters;
+    vector_of_flow_counters_t flow_counters;
 
-    // Initilize our counters with fill constructor
+    // On creating they are initialized by zeros
+    // In sparse mode we allocate only index of blocks here
     try {
-        SubnetVectorMap[current_subnet]             = vector_of_counters(network_size_in_ips, zero_map_element);
-        SubnetVectorMapSpeed[current_subnet]        = vector_of_counters(network_size_in_ips, zero_map_element);
-        SubnetVectorMapSpeedAverage[current_subnet] = vector_of_counters(network_size_in_ips, zero_map_element);
+        counters[0]            = vector_of_counters(network_size_in_ips, sparse_counters);
+        counters[1]            = vector_of_counters(network_size_in_ips, sparse_counters);
+        speed_counters         = vector_of_counters(network_size_in_ips, sparse_counters);
+        average_speed_counters = vector_of_counters(network_size_in_ips, sparse_counters);
+        flow_counters          = vector_of_flow_counters_t(network_size_in_ips, sparse_counters);
     } catch (std::bad_alloc& ba) {
         logger << log4cpp::Priority::ERROR << "Can't allocate memory for counters";
-        exit(1);
+        return false;
     }
 
-    // Initilize map element
-    SubnetVectorMapFlow[current_subnet] = vector_of_flow_counters_t(network_size_in_ips);
+    std::unique_lock<std::shared_mutex> lock(subnet_vector_maps_mutex);
 
-    // On creating it initializes by zeros
-    conntrack_main_struct_t zero_conntrack_main_struct;
-    std::fill(SubnetVectorMapFlow[current_subnet].begin(), SubnetVectorMapFlow[current_subnet].end(), zero_conntrack_main_struct);
+    SubnetVectorMap[0][current_subnet]          = std::move(counters[0]);
+    SubnetVectorMap[1][current_subnet]          = std::move(counters[1]);
+    SubnetVectorMapSpeed[current_subnet]        = std::move(speed_counters);
+    SubnetVectorMapSpeedAverage[current_subnet] = std::move(average_speed_counters);
+    SubnetVectorMapFlow[current_subnet]         = std::move(flow_counters);
+
+    return true;
 }
 
 void zeroify_all_counters() {
     subnet_counter_t zero_map_element{};
 
-    for (map_of_vector_counters_t::iterator itr = SubnetVectorMap.begin(); itr != SubnetVectorMap.end(); ++itr) {
-        // logger<< log4cpp::Priority::INFO<<"Zeroify "<<itr->first;
-        std::fill(itr->second.begin(), itr->second.end(), zero_map_element);
-    }
-}
-
-bool load_our_networks_list() {
-    if (file_exists(fastnetmon_platform_configuration.white_list_path)) {
-        unsigned int network_entries                      = 0;
-        std::vector<std::string> network_list_from_config = read_file_to_vector(fastnetmon_platform_configuration.white_list_path);
-
-        for (std::vector<std::string>::iterator ii = network_list_from_config.begin(); ii != network_list_from_config.end(); ++ii) {
-            std::string text_subnet = *ii;
-            if (text_subnet.empty()) {
-                continue;
-            }
-            if (is_v4_host(text_subnet)) {
-                logger << log4cpp::Priority::INFO << "Assuming /32 netmask for " << text_subnet;
-                text_subnet += "/32";
-            } else if (!is_cidr_subnet(text_subnet)) {
-                logger << log4cpp::Priority::ERROR << "Can't parse line from whitelist: " << text_subnet;
-                continue;
-            }
-            network_entries++;
-            make_and_lookup(whitelist_tree_ipv4, text_subnet.c_str());
+    for (auto& generation_counters : SubnetVectorMap) {
+        for (map_of_vector_counters_t::iterator itr = generation_counters.begin(); itr != generation_counters.end(); ++itr) {
+            // logger<< log4cpp::Priority::INFO<<"Zeroify "<<itr->first;
+            itr->second.for_each_allocated_element(
+                [&zero_map_element](size_t, subnet_counter_t& counter) { counter = zero_map_element; });
         }
-
-        logger << log4cpp::Priority::INFO << "We loaded " << network_entries << " networks from whitelist file";
     }
+}
 
-    std::vector<std::string> networks_list_ipv4_as_string;
-    std::vector<std::string> networks_list_ipv6_as_string;
-
+// Reads list of our networks from networks list file, OpenVZ and local interfaces
+void read_our_networks_list(std::vector<std::string>& networks_list_ipv4_as_string,
+                            std::vector<std::string>& networks_list_ipv6_as_string) {
     // We can build list of our subnets automatically here
     if (monitor_openvz_vps_ip_addresses && file_exists("/proc/vz/version")) {
         logger << log4cpp::Priority::INFO << "We found OpenVZ";
@@ -1224,15 +1610,16 @@ bool load_our_networks_list() {
 
         logger << log4cpp::Priority::INFO << "We loaded " << network_list_from_config.size() << " networks from networks file";
     }
+}
 
-    // Some consistency checks
-    assert(convert_ip_as_string_to_uint("255.255.255.0") == convert_cidr_to_binary_netmask(24));
-    assert(convert_ip_as_string_to_uint("255.255.255.255") == convert_cidr_to_binary_netmask(32));
-
-    logger << log4cpp::Priority::INFO << "Totally we have " << networks_list_ipv4_as_string.size() << " IPv4 subnets";
-    logger << log4cpp::Priority::INFO << "Totally we have " << networks_list_ipv6_as_string.size() << " IPv6 subnets";
+// Builds lookup trees for our networks and returns list of IPv4 subnets and number of hosts in them
+networks_lookup_t* build_networks_lookup(const std::vector<std::string>& networks_list_ipv4_as_string,
+                                         const std::vector<std::string>& networks_list_ipv6_as_string,
+                                         std::set<subnet_cidr_mask_t>& ipv4_subnets,
+                                         uint64_t& number_of_hosts) {
+    networks_lookup_t* networks_lookup = new networks_lookup_t;
 
-    for (std::vector<std::string>::iterator ii = networks_list_ipv4_as_string.begin();
+    for (std::vector<std::string>::const_iterator ii = networks_list_ipv4_as_string.begin();
          ii != networks_list_ipv4_as_string.end(); ++ii) {
 
         if (!is_cidr_subnet(*ii)) {
@@ -1245,9 +1632,6 @@ bool load_our_networks_list() {
         unsigned int cidr_mask      = get_cidr_mask_from_network_as_string(network_address_in_cidr_form);
         std::string network_address = get_net_address_from_network_as_string(network_address_in_cidr_form);
 
-        double base = 2;
-        total_number_of_hosts_in_our_networks += pow(base, 32 - cidr_mask);
-
         // Make sure it's "subnet address" and not an host address
         uint32_t subnet_address_as_uint        = convert_ip_as_string_to_uint(network_address);
         uint32_t subnet_address_netmask_binary = convert_cidr_to_binary_netmask(cidr_mask);
@@ -1263,37 +1647,356 @@ bool load_our_networks_list() {
             network_address_in_cidr_form = new_network_address_as_string;
         }
 
-        make_and_lookup(lookup_tree_ipv4, network_address_in_cidr_form.c_str());
+        patricia_node_t* node = make_and_lookup(networks_lookup->lookup_tree_ipv4, network_address_in_cidr_form.c_str());
+
+        if (node == NULL) {
+            logger << log4cpp::Priority::ERROR << "Can't add subnet " << network_address_in_cidr_form << " to lookup tree";
+            continue;
+        }
+
+        subnet_cidr_mask_t subnet(node->prefix->add.sin.s_addr, node->prefix->bitlen);
+
+        // Same subnet may be listed multiple times
+        if (ipv4_subnets.insert(subnet).second) {
+            double base = 2;
+            number_of_hosts += pow(base, 32 - cidr_mask);
+        }
     }
 
-    for (std::vector<std::string>::iterator ii = networks_list_ipv6_as_string.begin();
+    for (std::vector<std::string>::const_iterator ii = networks_list_ipv6_as_string.begin();
          ii != networks_list_ipv6_as_string.end(); ++ii) {
 
         // TODO: add IPv6 subnet format validation
-        make_and_lookup_ipv6(lookup_tree_ipv6, (char*)ii->c_str());
+        make_and_lookup_ipv6(networks_lookup->lookup_tree_ipv6, (char*)ii->c_str());
+    }
+
+    return networks_lookup;
+}
+
+// Makes counters allocated for subnets available from lookup
+void link_networks_lookup_with_counters(networks_lookup_t& networks_lookup, const std::set<subnet_cidr_mask_t>& ipv4_subnets) {
+    std::shared_lock<std::shared_mutex> lock(subnet_vector_maps_mutex);
+
+    for (const auto& subnet : ipv4_subnets) {
+        auto counters_itr        = SubnetVectorMap[0].find(subnet);
+        auto next_generation_itr = SubnetVectorMap[1].find(subnet);
+        auto flow_counters_itr   = SubnetVectorMapFlow.find(subnet);
+
+        if (counters_itr == SubnetVectorMap[0].end() || next_generation_itr == SubnetVectorMap[1].end() ||
+            flow_counters_itr == SubnetVectorMapFlow.end()) {
+            logger << log4cpp::Priority::ERROR << "We have no counters for subnet " << convert_subnet_to_string(subnet);
+            continue;
+        }
+
+        networks_lookup.counters[0][subnet]   = &counters_itr->second;
+        networks_lookup.counters[1][subnet]   = &next_generation_itr->second;
+        networks_lookup.flow_counters[subnet] = &flow_counters_itr->second;
+    }
+}
+
+// Selects NUMA node for per host counters, it should be called before we allocate any counters
+void select_numa_node_for_counters() {
+    if (counters_numa_node == "off") {
+        get_counters_memory().numa_node = -1;
+        return;
+    }
+
+    if (counters_numa_node != "auto") {
+        int numa_node = -1;
+
+        if (!convert_string_to_any_integer_safe(counters_numa_node, numa_node) || numa_node < 0) {
+            logger << log4cpp::Priority::ERROR << "Cannot parse counters_numa_node: " << counters_numa_node;
+            return;
+        }
+
+        get_counters_memory().numa_node = numa_node;
+        return;
+    }
+
+    // Capture threads run close to NIC and counters should be there too
+    if (configuration_map.count("interfaces") == 0 || configuration_map["interfaces"].empty()) {
+        return;
+    }
+
+    std::vector<std::string> interfaces;
+    boost::split(interfaces, configuration_map["interfaces"], boost::is_any_of(","), boost::token_compress_on);
+
+    std::string interface_name = interfaces[0];
+    boost::algorithm::trim(interface_name);
+
+    int numa_node = -1;
+
+    // Virtual interfaces have no such file and on single node systems it contains -1
+    if (!read_integer_from_file("/sys/class/net/" + interface_name + "/device/numa_node", numa_node)) {
+        logger << log4cpp::Priority::DEBUG << "Cannot get NUMA node for interface " << interface_name;
+        return;
+    }
+
+    get_counters_memory().numa_node = numa_node;
+}
+
+bool load_our_networks_list() {
+    if (file_exists(fastnetmon_platform_configuration.white_list_path)) {
+        unsigned int network_entries                      = 0;
+        std::vector<std::string> network_list_from_config = read_file_to_vector(fastnetmon_platform_configuration.white_list_path);
+
+        for (std::vector<std::string>::iterator ii = network_list_from_config.begin(); ii != network_list_from_config.end(); ++ii) {
+            std::string text_subnet = *ii;
+            if (text_subnet.empty()) {
+                continue;
+            }
+            if (is_v4_host(text_subnet)) {
+                logger << log4cpp::Priority::INFO << "Assuming /32 netmask for " << text_subnet;
+                text_subnet += "/32";
+            } else if (!is_cidr_subnet(text_subnet)) {
+                logger << log4cpp::Priority::ERROR << "Can't parse line from whitelist: " << text_subnet;
+                continue;
+            }
+            network_entries++;
+            make_and_lookup(whitelist_tree_ipv4, text_subnet.c_str());
+        }
+
+        logger << log4cpp::Priority::INFO << "We loaded " << network_entries << " networks from whitelist file";
     }
 
+    std::vector<std::string> networks_list_ipv4_as_string;
+    std::vector<std::string> networks_list_ipv6_as_string;
+
+    read_our_networks_list(networks_list_ipv4_as_string, networks_list_ipv6_as_string);
+
+    // Some consistency checks
+    assert(convert_ip_as_string_to_uint("255.255.255.0") == convert_cidr_to_binary_netmask(24));
+    assert(convert_ip_as_string_to_uint("255.255.255.255") == convert_cidr_to_binary_netmask(32));
+
+    logger << log4cpp::Priority::INFO << "Totally we have " << networks_list_ipv4_as_string.size() << " IPv4 subnets";
+    logger << log4cpp::Priority::INFO << "Totally we have " << networks_list_ipv6_as_string.size() << " IPv6 subnets";
+
+    std::set<subnet_cidr_mask_t> ipv4_subnets;
+    uint64_t number_of_hosts = 0;
+
+    std::unique_ptr<networks_lookup_t> new_networks_lookup(
+        build_networks_lookup(networks_list_ipv4_as_string, networks_list_ipv6_as_string, ipv4_subnets, number_of_hosts));
+
+    total_number_of_hosts_in_our_networks = number_of_hosts;
+
     logger << log4cpp::Priority::INFO
            << "Total number of monitored hosts (total size of all networks): " << total_number_of_hosts_in_our_networks;
 
-    // 3 - speed counter, average speed counter and data counter
-    uint64_t memory_requirements = 3 * sizeof(subnet_counter_t) * total_number_of_hosts_in_our_networks / 1024 / 1024;
+    // 4 - speed counter, average speed counter and two generations of data counter, plus flow counters
+    uint64_t memory_requirements =
+        (4 * sizeof(subnet_counter_t) + sizeof(conntrack_main_struct_t)) * total_number_of_hosts_in_our_networks / 1024 / 1024;
+
+    if (sparse_counters) {
+        logger << log4cpp::Priority::INFO << "We will allocate counters for /24 blocks of your networks on first traffic, for "
+               << "all hosts we would need " << memory_requirements << " MB of memory";
+    } else {
+        logger << log4cpp::Priority::INFO << "We need " << memory_requirements << " MB of memory for storing counters for your networks";
+    }
 
-    logger << log4cpp::Priority::INFO << "We need " << memory_requirements << " MB of memory for storing counters for your networks";
+    select_numa_node_for_counters();
+
+    counters_memory_t& counters_memory = get_counters_memory();
+
+    logger << log4cpp::Priority::INFO << "We will use " << get_counters_huge_pages_name(counters_memory.huge_pages)
+           << " huge pages for counters";
+
+    if (counters_memory.numa_node >= 0) {
+        logger << log4cpp::Priority::INFO << "We will place counters on NUMA node " << counters_memory.numa_node;
+    }
 
     /* Preallocate data structures */
-    patricia_process(lookup_tree_ipv4, subnet_vectors_allocator);
+    for (const auto& subnet : ipv4_subnets) {
+        if (!allocate_counters_for_subnet(subnet)) {
+            exit(1);
+        }
+    }
 
     logger << log4cpp::Priority::INFO << "We start total zerofication of counters";
     zeroify_all_counters();
     logger << log4cpp::Priority::INFO << "We finished zerofication";
 
+    logger << log4cpp::Priority::INFO << "Counters use " << counters_memory.huge_pages_bytes / 1024 / 1024
+           << " MB on huge pages, " << counters_memory.transparent_huge_pages_bytes / 1024 / 1024
+           << " MB on transparent huge pages and " << counters_memory.regular_bytes / 1024 / 1024 << " MB on regular pages";
+
+    if (counters_memory.huge_pages_allocation_failures > 0) {
+        logger << log4cpp::Priority::WARN << "We could not get huge pages " << counters_memory.huge_pages_allocation_failures
+               << " times, please increase vm.nr_hugepages";
+    }
+
+    if (counters_memory.numa_bind_failures > 0) {
+        logger << log4cpp::Priority::WARN << "We could not bind counters to NUMA node " << counters_memory.numa_bind_failures << " times";
+    }
+
+    link_networks_lookup_with_counters(*new_networks_lookup, ipv4_subnets);
+    our_networks_lookup.publish(new_networks_lookup.release());
+
     logger << log4cpp::Priority::INFO << "We loaded " << networks_list_ipv4_as_string.size()
            << " IPv4 subnets to our in-memory list of networks";
 
     return true;
 }
 
+// Reloads networks list and host groups without touching counters for networks we already monitor
+// Only networks_reload_thread calls it
+bool reload_networks_and_host_groups() {
+    logger << log4cpp::Priority::INFO << "We start reload of networks list and host groups";
+
+    std::vector<std::string> networks_list_ipv4_as_string;
+    std::vector<std::string> networks_list_ipv6_as_string;
+
+    read_our_networks_list(networks_list_ipv4_as_string, networks_list_ipv6_as_string);
+
+    std::set<subnet_cidr_mask_t> ipv4_subnets;
+    uint64_t number_of_hosts = 0;
+
+    std::unique_ptr<networks_lookup_t> new_networks_lookup(
+        build_networks_lookup(networks_list_ipv4_as_string, networks_list_ipv6_as_string, ipv4_subnets, number_of_hosts));
+
+    // We read host groups before we change anything to keep networks and host groups consistent on errors
+    std::unique_ptr<host_groups_configuration_t> new_host_groups_configuration(new host_groups_configuration_t);
+    configuration_map_t new_configuration_map;
+
+    if (!read_configuration_file(fastnetmon_platform_configuration.global_config_path, new_configuration_map,
+                                 *new_host_groups_configuration)) {
+        logger << log4cpp::Priority::ERROR << "Can't reload host groups, we keep previous networks list and host groups";
+
+        networks_reload_errors++;
+        return false;
+    }
+
+    read_host_groups_ban_settings(new_configuration_map, *new_host_groups_configuration);
+
+    // Nobody else publishes lookups and this copy stays alive for grace period after we publish new one
+    const networks_lookup_t* current_networks_lookup = our_networks_lookup.get();
+
+    time_t current_time = time(NULL);
+
+    // Readers may use previous copy of lookup for few seconds and we must keep counters for them
+    time_t free_time_for_removed_networks = current_time + std::max(removed_networks_grace_period, 10u);
+
+    std::vector<subnet_cidr_mask_t> allocated_subnets;
+    unsigned int added_networks = 0;
+
+    for (const auto& subnet : ipv4_subnets) {
+        if (current_networks_lookup->counters[0].count(subnet) == 0) {
+            added_networks++;
+        }
+
+        bool counters_allocated = false;
+
+        {
+            std::shared_lock<std::shared_mutex> lock(subnet_vector_maps_mutex);
+            counters_allocated = SubnetVectorMap[0].count(subnet) > 0;
+        }
+
+        if (counters_allocated) {
+            continue;
+        }
+
+        if (!allocate_counters_for_subnet(subnet)) {
+            logger << log4cpp::Priority::ERROR << "Can't allocate counters for " << convert_subnet_to_string(subnet)
+                   << ", we keep previous networks list";
+
+            // Nobody uses counters allocated on this attempt
+            for (const auto& allocated_subnet : allocated_subnets) {
+                retired_networks[allocated_subnet] = current_time;
+            }
+
+            networks_reload_errors++;
+            return false;
+        }
+
+        allocated_subnets.push_back(subnet);
+    }
+
+    link_networks_lookup_with_counters(*new_networks_lookup, ipv4_subnets);
+    our_networks_lookup.publish(new_networks_lookup.release());
+
+    // Networks came back before we freed their counters and new lookup uses them now
+    for (const auto& subnet : ipv4_subnets) {
+        retired_networks.erase(subnet);
+    }
+
+    unsigned int removed_networks = 0;
+
+    for (const auto& counters : current_networks_lookup->counters[0]) {
+        if (ipv4_subnets.count(counters.first) == 0) {
+            retired_networks[counters.first] = free_time_for_removed_networks;
+            removed_networks++;
+        }
+    }
+
+    total_number_of_hosts_in_our_networks = number_of_hosts;
+
+    networks_added_on_reload += added_networks;
+    networks_removed_on_reload += removed_networks;
+
+    logger << log4cpp::Priority::INFO << "We reloaded networks list, added " << added_networks << " and removed "
+           << removed_networks << " IPv4 networks";
+
+    logger << log4cpp::Priority::INFO << "We reloaded " << new_host_groups_configuration->host_groups.size() << " host groups";
+
+    host_groups_configuration.publish(new_host_groups_configuration.release());
+
+    networks_reloads++;
+    return true;
+}
+
+// Frees counters for removed networks when their grace period is over
+void free_retired_networks_counters() {
+    time_t current_time = time(NULL);
+
+    for (auto itr = retired_networks.begin(); itr != retired_networks.end();) {
+        if (itr->second > current_time) {
+            ++itr;
+            continue;
+        }
+
+        // We release memory after lock
+        map_of_vector_counters_t::node_type counters[2];
+        map_of_vector_counters_t::node_type speed_counters;
+        map_of_vector_counters_t::node_type average_speed_counters;
+        map_of_vector_counters_for_flow_t::node_type flow_counters;
+
+        {
+            std::unique_lock<std::shared_mutex> lock(subnet_vector_maps_mutex);
+
+            counters[0]            = SubnetVectorMap[0].extract(itr->first);
+            counters[1]            = SubnetVectorMap[1].extract(itr->first);
+            speed_counters         = SubnetVectorMapSpeed.extract(itr->first);
+            average_speed_counters = SubnetVectorMapSpeedAverage.extract(itr->first);
+            flow_counters          = SubnetVectorMapFlow.extract(itr->first);
+        }
+
+        ipv4_network_counters.remove_key(itr->first);
+
+        logger << log4cpp::Priority::INFO << "We freed counters for removed network " << convert_subnet_to_string(itr->first);
+
+        itr = retired_networks.erase(itr);
+    }
+}
+
+// Applies reload requests from SIGHUP and API and frees counters for removed networks
+void networks_reload_thread() {
+    while (true) {
+        boost::this_thread::sleep(boost::posix_time::seconds(1));
+
+        stage_latency_scope_t stage_latency_scope(latency_stage_t::networks_reload);
+
+        if (networks_reload_requested.exchange(false)) {
+            reload_networks_and_host_groups();
+        }
+
+        free_retired_networks_counters();
+    }
+}
+
+void networks_reload_signal_handler(int signal_number) {
+    // We could do only async signal safe things here
+    networks_reload_requested = true;
+}
+
 #ifdef GEOIP
 unsigned int get_asn_for_ip(uint32_t ip) {
     char* asn_raw       = GeoIP_org_by_name(geo_ip, convert_ip_as_uint_to_string(remote_ip).c_str());
@@ -1331,6 +2034,8 @@ void screen_draw_ipv4_thread() {
         // Available only from boost 1.54: boost::this_thread::sleep_for(
         // boost::chrono::seconds(check_period) );
         boost::this_thread::sleep(boost::posix_time::seconds(check_period));
+
+        stage_latency_scope_t stage_latency_scope(latency_stage_t::screen_drawing_ipv4);
         traffic_draw_ipv4_program();
     }
 }
@@ -1349,17 +2054,33 @@ void screen_draw_ipv6_thread() {
         // Available only from boost 1.54: boost::this_thread::sleep_for(
         // boost::chrono::seconds(check_period) );
         boost::this_thread::sleep(boost::posix_time::seconds(check_period));
+
+        stage_latency_scope_t stage_latency_scope(latency_stage_t::screen_drawing_ipv6);
         traffic_draw_ipv6_program();
     }
 }
 
 
 void recalculate_speed_thread_handler() {
+    // We schedule runs from fixed points of time and time spent on recalculation does not shift next runs
+    std::chrono::steady_clock::time_point next_run = std::chrono::steady_clock::now();
+
+    std::chrono::microseconds delay(int64_t(recalculate_speed_timeout * 1000000));
+
     while (true) {
-        // recalculate data every one second
-        // Available only from boost 1.54: boost::this_thread::sleep_for( boost::chrono::seconds(1)
-        // );
-        boost::this_thread::sleep(boost::posix_time::seconds(recalculate_speed_timeout));
+        next_run += delay;
+
+        std::chrono::steady_clock::time_point current_time = std::chrono::steady_clock::now();
+
+        if (next_run > current_time) {
+            boost::this_thread::sleep(boost::posix_time::microseconds(
+                std::chrono::duration_cast<std::chrono::microseconds>(next_run - current_time).count()));
+        } else {
+            // We are late and we do not run missed iterations one by one
+            next_run = current_time;
+            boost::this_thread::interruption_point();
+        }
+
         recalculate_speed();
     }
 }
@@ -1519,6 +2240,10 @@ int main(int argc, char** argv) {
     // By default we do PID checks
     bool do_pid_checks = true;
 
+#ifdef FASTNETMON_REPLAY_BENCH
+    replay_bench_options_t replay_bench_options;
+#endif
+
     try {
         // clang-format off
         po::options_description desc("Allowed options");
@@ -1531,6 +2256,14 @@ int main(int argc, char** argv) {
 		("log_file", po::value<std::string>(), "set path to custom log file")
         ("log_to_console", "switches all logging to console")
         ("disable_pid_logic", "Disables logic which stores PID to file and uses it for duplicate instance checks");
+
+#ifdef FASTNETMON_REPLAY_BENCH
+        desc.add_options()
+        ("pcap_file", po::value<std::string>(), "pcap dump which we replay through parsers and process_packet")
+        ("format", po::value<std::string>(), "format of dump: raw, sflow or netflow")
+        ("threads", po::value<unsigned int>(), "number of threads which process packets")
+        ("loops", po::value<unsigned int>(), "number of times we process all packets from dump");
+#endif
         // clang-format on
 
         po::variables_map vm;
@@ -1574,6 +2307,30 @@ int main(int argc, char** argv) {
         if (vm.count("disable_pid_logic")) {
             do_pid_checks = false;
         }
+
+#ifdef FASTNETMON_REPLAY_BENCH
+        if (vm.count("pcap_file") == 0) {
+            std::cerr << "Please specify dump with --pcap_file" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        replay_bench_options.pcap_file_path = vm["pcap_file"].as<std::string>();
+
+        if (vm.count("format")) {
+            replay_bench_options.format = vm["format"].as<std::string>();
+        }
+
+        if (vm.count("threads")) {
+            replay_bench_options.threads = vm["threads"].as<unsigned int>();
+        }
+
+        if (vm.count("loops")) {
+            replay_bench_options.loops = vm["loops"].as<unsigned int>();
+        }
+
+        // Benchmark could run in parallel with daemon
+        do_pid_checks = false;
+#endif
     } catch (po::error& e) {
         std::cerr << "ERROR: " << e.what() << std::endl << std::endl;
         exit(EXIT_FAILURE);
@@ -1690,10 +2447,7 @@ int main(int argc, char** argv) {
         }
     }
 
-    lookup_tree_ipv4    = New_Patricia(32);
     whitelist_tree_ipv4 = New_Patricia(32);
-
-    lookup_tree_ipv6    = New_Patricia(128);
     whitelist_tree_ipv6 = New_Patricia(128);
 
     /* Create folder for attack details */
@@ -1723,15 +2477,43 @@ int main(int argc, char** argv) {
 
     load_our_networks_list();
 
+    // We restore state when all counters are allocated and before we start traffic processing
+    if (state_checkpoint) {
+        load_state_checkpoint(state_checkpoint_path);
+    }
+
     // Set capacity for nested buffers
     packet_buckets_ipv6_storage.set_buffers_capacity(ban_details_records_count);
 
+    if (packet_capture_memory_budget > 0 && ban_details_records_count > 0) {
+        if (packet_capture_slab.allocate(uint64_t(packet_capture_memory_budget) * 1024 * 1024, packet_capture_snaplen)) {
+            logger << log4cpp::Priority::INFO << "We allocated " << packet_capture_memory_budget
+                   << " megabytes for " << packet_capture_slab.get_number_of_chunks() << " chunks of captured packets";
+
+            packet_buckets_ipv6_storage.set_packet_capture_slab(&packet_capture_slab);
+        } else {
+            logger << log4cpp::Priority::ERROR << "Could not allocate " << packet_capture_memory_budget
+                   << " megabytes for captured packets, we will keep only parsed packets";
+        }
+    }
+
+#ifdef FASTNETMON_REPLAY_BENCH
+    // We use configuration and networks from configuration file but do not start any threads of daemon
+    return run_replay_bench(replay_bench_options);
+#endif
+
     // Setup CTRL+C handler
     if (signal(SIGINT, interruption_signal_handler) == SIG_ERR) {
         logger << log4cpp::Priority::ERROR << "Can't setup SIGINT handler";
         exit(1);
     }
 
+    // Reload networks list and host groups on SIGHUP
+    if (signal(SIGHUP, networks_reload_signal_handler) == SIG_ERR) {
+        logger << log4cpp::Priority::ERROR << "Can't setup SIGHUP handler";
+        exit(1);
+    }
+
     /* Without this SIGPIPE error could shutdown toolkit on call of exec_with_stdin_params */
     if (signal(SIGPIPE, sigpipe_handler_for_popen) == SIG_ERR) {
         logger << log4cpp::Priority::ERROR << "Can't setup SIGPIPE handler";
@@ -1752,11 +2534,70 @@ int main(int argc, char** argv) {
 #ifdef ENABLE_GOBGP
     if (gobgp_enabled) {
         gobgp_action_init();
+        gobgp_start_announce_thread();
     }
 #endif
 
+    // Batch handlers merge actions for same backend into single request
+    action_dispatcher.register_batch_handler(action_backend_t::ExaBGP, [](const std::vector<action_batch_element_t>& batch_elements) {
+        std::vector<std::string> exabgp_messages;
+
+        for (const auto& batch_element : batch_elements) {
+            exabgp_messages.push_back(batch_element.value);
+        }
+
+        exabgp_write_messages(exabgp_messages);
+    });
+
+#ifdef REDIS
+    action_dispatcher.register_batch_handler(action_backend_t::Redis, store_data_in_redis_batch);
+#endif
+
+    action_dispatcher.set_queue_capacity(action_queue_capacity);
+
+    if (action_maximum_batch_size == 0) {
+        logger << log4cpp::Priority::ERROR << "action_maximum_batch_size should be positive, we will use batches with single element";
+        action_maximum_batch_size = 1;
+    }
+
+    action_dispatcher.set_maximum_batch_size(action_maximum_batch_size);
+
+    if (action_worker_threads == 0) {
+        logger << log4cpp::Priority::ERROR << "action_worker_threads should be positive, we will use single thread";
+        action_worker_threads = 1;
+    }
+
+    // Only notify scripts could run in parallel, BGP backends need strict order and Redis and MongoDB use single connection
+    action_dispatcher.set_number_of_workers(action_backend_t::Script, action_worker_threads);
+
+    for (unsigned int backend_index = 0; backend_index < number_of_action_backends; backend_index++) {
+        action_backend_t backend = action_backend_t(backend_index);
+
+        for (unsigned int i = 0; i < action_dispatcher.get_number_of_workers(backend); i++) {
+            auto action_worker_thread = new boost::thread([backend]() { action_dispatcher.run_worker(backend); });
+            set_boost_process_name(action_worker_thread, "act_" + get_action_backend_name(backend));
+            service_thread_group.add_thread(action_worker_thread);
+        }
+    }
+
 #ifdef KAFKA
     if (kafka_traffic_export) {
+        // With zero records per message export thread will never take records from rings
+        if (kafka_traffic_export_records_per_message == 0) {
+            logger << log4cpp::Priority::ERROR << "kafka_traffic_export_records_per_message must be at least 1, we will use 1";
+            kafka_traffic_export_records_per_message = 1;
+        }
+
+        if (kafka_traffic_export_ring_size == 0) {
+            logger << log4cpp::Priority::ERROR << "kafka_traffic_export_ring_size must be at least 1, we will use 1";
+            kafka_traffic_export_ring_size = 1;
+        }
+
+        if (kafka_traffic_export_batch_num_messages == 0) {
+            logger << log4cpp::Priority::ERROR << "kafka_traffic_export_batch_num_messages must be at least 1, we will use 1";
+            kafka_traffic_export_batch_num_messages = 1;
+        }
+
         if (kafka_traffic_export_brokers.size() == 0) {
             logger << log4cpp::Priority::ERROR << "Kafka traffic export requires at least single broker, please configure kafka_traffic_export_brokers";
         } else {
@@ -1769,6 +2610,10 @@ int main(int argc, char** argv) {
                 { "metadata.broker.list", all_brokers },
                 { "request.required.acks", "0" }, // Disable ACKs
                 { "partitioner", partitioner },
+                // Our messages are already batched and librdkafka adds its own batching on top
+                { "linger.ms", std::to_string(kafka_traffic_export_linger_milliseconds) },
+                { "batch.num.messages", std::to_string(kafka_traffic_export_batch_num_messages) },
+                { "compression.codec", "lz4" },
             };
 
             logger << log4cpp::Priority::INFO << "Initialise Kafka producer for traffic export";
@@ -1781,7 +2626,13 @@ int main(int argc, char** argv) {
                 kafka_traffic_export = false;
             }
 
-            logger << log4cpp::Priority::INFO << "Kafka traffic producer is ready";
+            if (kafka_traffic_export) {
+                logger << log4cpp::Priority::INFO << "Kafka traffic producer is ready";
+
+                auto kafka_traffic_export_thread_handle = new boost::thread(kafka_traffic_export_thread);
+                set_boost_process_name(kafka_traffic_export_thread_handle, "kafka_export");
+                service_thread_group.add_thread(kafka_traffic_export_thread_handle);
+            }
         }
     }
 #endif
@@ -1798,8 +2649,8 @@ int main(int argc, char** argv) {
         service_thread_group.add_thread(prometheus_thread);
     }
 
-    // Set inaccurate time value which will be used in process_packet() from capture backends
-    time(&current_inaccurate_time);
+    logger << log4cpp::Priority::INFO << "We use clock with resolution " << get_fast_time_resolution()
+           << " nanoseconds for timestamps of packets";
 
     // start thread which pre-calculates speed for system counters
     auto system_counters_speed_thread = new boost::thread(system_counters_speed_thread_handler);
@@ -1807,10 +2658,6 @@ int main(int argc, char** argv) {
     service_thread_group.add_thread(system_counters_speed_thread);
 
 
-    auto inaccurate_time_generator_thread = new boost::thread(inaccurate_time_generator);
-    set_boost_process_name(inaccurate_time_generator_thread, "fast_time");
-    service_thread_group.add_thread(inaccurate_time_generator_thread);
-
     // Run stats thread
     bool usage_stats = true;
 
@@ -1840,50 +2687,122 @@ int main(int argc, char** argv) {
         service_thread_group.add_thread(new boost::thread(influxdb_push_thread));
     }
 
+    if (speed_calculation_threads == 0) {
+        logger << log4cpp::Priority::ERROR << "speed_calculation_threads should be positive, we will use single thread";
+        speed_calculation_threads = 1;
+    }
+
+    speed_calculation_executor.set_number_of_workers(speed_calculation_threads);
+
+    // Recalculation thread is first worker and we start threads only for other workers
+    for (unsigned int worker_index = 1; worker_index < speed_calculation_threads; worker_index++) {
+        auto speed_calculation_worker_thread =
+            new boost::thread([worker_index]() { speed_calculation_executor.run_worker(worker_index); });
+        set_boost_process_name(speed_calculation_worker_thread, "speed_calc");
+        service_thread_group.add_thread(speed_calculation_worker_thread);
+    }
+
     // start thread for recalculating speed in realtime
-    service_thread_group.add_thread(new boost::thread(recalculate_speed_thread_handler));
+    // In offline mode we recalculate speed using time from packets
+    if (!pcap_offline) {
+        service_thread_group.add_thread(new boost::thread(recalculate_speed_thread_handler));
+    }
 
     // Run banlist cleaner thread
     if (unban_enabled) {
         service_thread_group.add_thread(new boost::thread(cleanup_ban_list));
     }
 
+    if (state_checkpoint) {
+        auto state_checkpoint_thread_handle = new boost::thread(state_checkpoint_thread);
+        set_boost_process_name(state_checkpoint_thread_handle, "checkpoint");
+        service_thread_group.add_thread(state_checkpoint_thread_handle);
+    }
+
+    // Applies reload requests for networks list and host groups
+    auto networks_reload_thread_handle = new boost::thread(networks_reload_thread);
+    set_boost_process_name(networks_reload_thread_handle, "networks_reload");
+    service_thread_group.add_thread(networks_reload_thread_handle);
+
     // This thread will check about filled buckets with packets and process they
     auto check_traffic_buckets_thread = new boost::thread(check_traffic_buckets);
     set_boost_process_name(check_traffic_buckets_thread, "check_buckets");
     service_thread_group.add_thread(check_traffic_buckets_thread);
 
+    // Capture plugins call this function for each parsed packet
+    process_packet_pointer packet_handler = process_packet;
+
+    if (packet_pipeline_enabled && pcap_offline) {
+        // Speed recalculation should see all packets of time slice and we could not leave them in rings
+        logger << log4cpp::Priority::WARN << "We do not use pipeline mode for offline processing of dumps";
+        packet_pipeline_enabled = false;
+    }
+
+    if (packet_pipeline_enabled) {
+        if (packet_pipeline_threads == 0 || packet_pipeline_ring_size == 0) {
+            logger << log4cpp::Priority::ERROR << "packet_pipeline_threads and packet_pipeline_ring_size should be positive, we will use defaults";
+            packet_pipeline_threads   = 2;
+            packet_pipeline_ring_size = 16384;
+        }
+
+        packet_pipeline.set_configuration(packet_pipeline_threads, packet_pipeline_ring_size);
+
+        logger << log4cpp::Priority::INFO << "We will process traffic in " << packet_pipeline_threads
+               << " pipeline threads with rings for " << packet_pipeline_ring_size << " packets";
+
+        for (unsigned int processing_thread_index = 0; processing_thread_index < packet_pipeline_threads; processing_thread_index++) {
+            auto packet_pipeline_thread = new boost::thread(
+                [processing_thread_index]() { packet_pipeline.run_processing_thread(processing_thread_index, process_packet); });
+            set_boost_process_name(packet_pipeline_thread, "pipeline");
+            service_thread_group.add_thread(packet_pipeline_thread);
+        }
+
+        packet_handler = push_packet_to_pipeline;
+    }
+
 #ifdef NETMAP_PLUGIN
     // netmap processing
     if (enable_netmap_collection) {
-        packet_capture_plugin_thread_group.add_thread(new boost::thread(start_netmap_collection, process_packet));
+        packet_capture_plugin_thread_group.add_thread(new boost::thread(start_netmap_collection, packet_handler));
     }
 #endif
 
 #ifdef FASTNETMON_ENABLE_AFPACKET
     if (enable_afpacket_collection) {
-        packet_capture_plugin_thread_group.add_thread(new boost::thread(start_afpacket_collection, process_packet));
+        packet_capture_plugin_thread_group.add_thread(new boost::thread(start_afpacket_collection, packet_handler));
     }
 #endif
 
 #ifdef FASTNETMON_ENABLE_AF_XDP
     if (enable_af_xdp_collection) {
-        auto xdp_thread = new boost::thread(start_xdp_collection, process_packet);
+        auto xdp_thread = new boost::thread(start_xdp_collection, packet_handler);
         set_boost_process_name(xdp_thread, "xdp");
         packet_capture_plugin_thread_group.add_thread(xdp_thread);
     }
 #endif
 
     if (enable_sflow_collection) {
-        packet_capture_plugin_thread_group.add_thread(new boost::thread(start_sflow_collection, process_packet));
+        packet_capture_plugin_thread_group.add_thread(new boost::thread(start_sflow_collection, packet_handler));
     }
 
     if (enable_netflow_collection) {
-        packet_capture_plugin_thread_group.add_thread(new boost::thread(start_netflow_collection, process_packet));
+        packet_capture_plugin_thread_group.add_thread(new boost::thread(start_netflow_collection, packet_handler));
     }
 
     if (enable_pcap_collection) {
-        packet_capture_plugin_thread_group.add_thread(new boost::thread(start_pcap_collection, process_packet));
+        packet_capture_plugin_thread_group.add_thread(new boost::thread(start_pcap_collection, packet_handler));
+    }
+
+    if (enable_traffic_generator_collection) {
+        auto traffic_generator_thread = new boost::thread(start_traffic_generator_collection, packet_handler);
+        set_boost_process_name(traffic_generator_thread, "traffic_gen");
+        packet_capture_plugin_thread_group.add_thread(traffic_generator_thread);
+    }
+
+    if (pcap_offline) {
+        auto offline_pcap_ingestion_thread = new boost::thread(run_offline_pcap_ingestion);
+        set_boost_process_name(offline_pcap_ingestion_thread, "pcap_offline");
+        packet_capture_plugin_thread_group.add_thread(offline_pcap_ingestion_thread);
     }
 
     // Wait for all threads in capture thread group
@@ -1903,10 +2822,7 @@ void free_up_all_resources() {
     GeoIP_delete(geo_ip);
 #endif
 
-    Destroy_Patricia(lookup_tree_ipv4);
     Destroy_Patricia(whitelist_tree_ipv4);
-
-    Destroy_Patricia(lookup_tree_ipv6);
     Destroy_Patricia(whitelist_tree_ipv6);
 }
 
@@ -1926,6 +2842,13 @@ void interruption_signal_handler(int signal_number) {
     logger << log4cpp::Priority::INFO << "Wait while they finished";
     service_thread_group.join_all();
 
+#ifdef ENABLE_GOBGP
+    if (gobgp_enabled) {
+        logger << log4cpp::Priority::INFO << "Stop GoBGP announce thread";
+        gobgp_action_shutdown();
+    }
+#endif
+
     logger << log4cpp::Priority::INFO << "Interrupt packet capture treads";
     packet_capture_plugin_thread_group.interrupt_all();
 
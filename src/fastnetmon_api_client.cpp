@@ -1,3 +1,4 @@
+#include <iomanip>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -48,6 +49,66 @@ class FastnetmonClient {
         }
     }
 
+    void ReloadNetworks() {
+        ClientContext context;
+        fastmitigation::ReloadNetworksRequest request;
+        fastmitigation::ReloadNetworksReply reply;
+
+        std::chrono::system_clock::time_point deadline =
+            std::chrono::system_clock::now() + std::chrono::seconds(client_connection_timeout);
+
+        context.set_deadline(deadline);
+
+        Status status = stub_->ReloadNetworks(&context, request, &reply);
+
+        if (!status.ok()) {
+            if (status.error_code() == grpc::DEADLINE_EXCEEDED) {
+                std::cerr << "Could not connect to API server. Timeout exceed" << std::endl;
+                return;
+            } else {
+                std::cerr << "Query failed " + status.error_message() << std::endl;
+                return;
+            }
+        }
+    }
+
+    void GetStageLatency() {
+        fastmitigation::StageLatencyRequest request;
+        fastmitigation::StageLatencyReply reply;
+
+        ClientContext context;
+
+        std::chrono::system_clock::time_point deadline =
+            std::chrono::system_clock::now() + std::chrono::seconds(client_connection_timeout);
+
+        context.set_deadline(deadline);
+
+        auto stages = stub_->GetStageLatency(&context, request);
+
+        std::cout << std::left << std::setw(24) << "stage" << std::right << std::setw(14) << "samples" << std::setw(14)
+                  << "avg ns" << std::setw(14) << "p50 ns" << std::setw(14) << "p90 ns" << std::setw(14) << "p99 ns" << std::endl;
+
+        while (stages->Read(&reply)) {
+            uint64_t average = reply.samples() == 0 ? 0 : reply.total_nanoseconds() / reply.samples();
+
+            std::cout << std::left << std::setw(24) << reply.stage() << std::right << std::setw(14) << reply.samples()
+                      << std::setw(14) << average << std::setw(14) << reply.p50_nanoseconds() << std::setw(14)
+                      << reply.p90_nanoseconds() << std::setw(14) << reply.p99_nanoseconds() << std::endl;
+        }
+
+        auto status = stages->Finish();
+
+        if (!status.ok()) {
+            if (status.error_code() == grpc::DEADLINE_EXCEEDED) {
+                std::cerr << "Could not connect to API server. Timeout exceed" << std::endl;
+                return;
+            } else {
+                std::cerr << "Query failed " + status.error_message() << std::endl;
+                return;
+            }
+        }
+    }
+
     void GetBanList() {
         // This request haven't any useful data
         BanListRequest request;
@@ -95,7 +156,7 @@ void silent_logging_function(gpr_log_func_args* args) {
 }
 
 int main(int argc, char** argv) {
-    std::string supported_commands_list = "ban, unban, get_banlist";
+    std::string supported_commands_list = "ban, unban, get_banlist, reload_networks, get_stage_latency";
 
     if (argc <= 1) {
         std::cerr << "Please provide command as argument, supported commands: " << supported_commands_list << std::endl;
@@ -114,6 +175,10 @@ int main(int argc, char** argv) {
 
     if (request_command == "get_banlist") {
         fastnetmon.GetBanList();
+    } else if (request_command == "reload_networks") {
+        fastnetmon.ReloadNetworks();
+    } else if (request_command == "get_stage_latency") {
+        fastnetmon.GetStageLatency();
     } else if (request_command == "ban" or request_command == "unban") {
         if (argc < 3) {
             std::cerr << "Please provide IP for action" << std::endl;
@@ -3,10 +3,12 @@
 #include <chrono>
 #include <fstream>
 #include <iomanip>
+#include <shared_mutex>
 #include <sstream>
 #include <thread>
 #include <vector>
 
+#include <boost/algorithm/string.hpp>
 #include <boost/asio/ip/tcp.hpp>
 
 #include <boost/beast/core.hpp>
@@ -17,6 +19,7 @@
 #include "bgp_protocol.hpp"
 #include "fast_library.hpp"
 #include "fast_platform.hpp"
+#include "fast_time.hpp"
 
 // Plugins
 #include "netflow_plugin/netflow_collector.hpp"
@@ -45,6 +48,8 @@
 // Yes, maybe it's not an good idea but with this we can guarantee working code in example plugin
 #include "example_plugin/example_collector.hpp"
 
+#include "traffic_generator_plugin/traffic_generator_collector.hpp"
+
 #ifdef MONGO
 #include <bson.h>
 #include <mongoc.h>
@@ -58,8 +63,30 @@
 
 #include "ban_list.hpp"
 
+#include "attack_fingerprint.hpp"
+#include "flow_spec_generator.hpp"
+#include "flow_tracking.hpp"
+
+#include "ipv4_host_set.hpp"
+
+#include "action_dispatcher.hpp"
+
+#include "state_checkpoint.hpp"
+
+#include "networks_lookup.hpp"
+#include "counters_epoch.hpp"
+#include "offline_pcap_ingestion.hpp"
+#include "packet_pipeline.hpp"
+#include "parallel_executor.hpp"
+#include "rcu_pointer.hpp"
+#include "stage_latency.hpp"
+
 #ifdef KAFKA
 #include <cppkafka/cppkafka.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
+
+#include "compact_packet_record.hpp"
 #endif
 
 extern uint64_t influxdb_writes_total;
@@ -68,23 +95,30 @@ extern packet_buckets_storage_t<subnet_ipv6_cidr_mask_t> packet_buckets_ipv6_sto
 extern std::string cli_stats_file_path;
 extern unsigned int total_number_of_hosts_in_our_networks;
 extern abstract_subnet_counters_t<subnet_cidr_mask_t> ipv4_network_counters;
-extern unsigned int recalculate_speed_timeout;
+extern double recalculate_speed_timeout;
+extern double speed_calculation_window;
 extern map_of_vector_counters_for_flow_t SubnetVectorMapFlow;
 extern bool DEBUG_DUMP_ALL_PACKETS;
 extern bool DEBUG_DUMP_OTHER_PACKETS;
-extern uint64_t total_ipv4_packets;
+extern per_thread_counter_t total_ipv4_packets;
 extern blackhole_ban_list_t<subnet_ipv6_cidr_mask_t> ban_list_ipv6_ng;
-extern uint64_t total_ipv6_packets;
+extern per_thread_counter_t total_ipv6_packets;
 extern map_of_vector_counters_t SubnetVectorMapSpeed;
 extern double average_calculation_amount;
 extern bool print_configuration_params_on_the_screen;
 extern uint64_t our_ipv6_packets;
-extern map_of_vector_counters_t SubnetVectorMap;
-extern uint64_t unknown_ip_version_packets;
-extern uint64_t total_simple_packets_processed;
+extern map_of_vector_counters_t SubnetVectorMap[2];
+extern counters_epoch_t ipv4_host_counters_epoch;
+extern per_thread_counter_t unknown_ip_version_packets;
+extern per_thread_counter_t total_simple_packets_processed;
 extern unsigned int maximum_time_since_bucket_start_to_remove;
 extern unsigned int max_ips_in_list;
 extern struct timeval speed_calculation_time;
+extern uint64_t recalculated_hosts;
+extern parallel_executor_t speed_calculation_executor;
+extern unsigned int average_speed_floor_pps;
+extern bool sparse_counters;
+extern unsigned int sparse_counters_idle_periods;
 extern double drawing_thread_execution_time;
 extern std::chrono::steady_clock::time_point last_call_of_traffic_recalculation;
 extern std::string cli_stats_ipv6_file_path;
@@ -93,8 +127,7 @@ extern abstract_subnet_counters_t<subnet_ipv6_cidr_mask_t> ipv6_host_counters;
 extern abstract_subnet_counters_t<subnet_ipv6_cidr_mask_t> ipv6_subnet_counters;
 extern bool process_incoming_traffic;
 extern bool process_outgoing_traffic;
-extern uint64_t total_unparsed_packets;
-extern time_t current_inaccurate_time;
+extern per_thread_counter_t total_unparsed_packets;
 extern uint64_t total_unparsed_packets_speed;
 extern bool enable_connection_tracking;
 extern bool enable_afpacket_collection;
@@ -103,17 +136,18 @@ extern bool enable_netmap_collection;
 extern bool enable_sflow_collection;
 extern bool enable_netflow_collection;
 extern bool enable_pcap_collection;
+extern bool enable_traffic_generator_collection;
 extern uint64_t incoming_total_flows_speed;
 extern uint64_t outgoing_total_flows_speed;
 extern total_speed_counters_t total_counters_ipv4;
 extern total_speed_counters_t total_counters_ipv6;
-extern host_group_ban_settings_map_t host_group_ban_settings_map;
+extern total_traffic_counters_t total_traffic_counters_ipv4;
+extern total_traffic_counters_t total_traffic_counters_ipv6;
+extern rcu_pointer_t<host_groups_configuration_t> host_groups_configuration;
 extern bool exabgp_announce_whole_subnet;
-extern subnet_to_host_group_map_t subnet_to_host_groups;
 extern bool collect_attack_pcap_dumps;
 
 extern std::mutex ban_list_details_mutex;
-extern std::mutex ban_list_mutex;
 extern std::mutex flow_counter;
 
 #ifdef REDIS
@@ -137,17 +171,37 @@ extern std::string mongodb_database_name;
 #endif
 
 extern unsigned int number_of_packets_for_pcap_attack_dump;
-extern patricia_tree_t *lookup_tree_ipv4, *whitelist_tree_ipv4;
-extern patricia_tree_t *lookup_tree_ipv6, *whitelist_tree_ipv6;
+extern patricia_tree_t* whitelist_tree_ipv4;
+extern patricia_tree_t* whitelist_tree_ipv6;
+extern rcu_pointer_t<networks_lookup_t> our_networks_lookup;
+extern std::shared_mutex subnet_vector_maps_mutex;
+extern std::atomic<bool> networks_reload_requested;
 extern std::map<uint32_t, std::vector<simple_packet_t>> ban_list_details;
+extern std::map<uint32_t, std::shared_ptr<attack_fingerprint_t>> attack_fingerprints;
+extern std::mutex attack_fingerprints_mutex;
+extern rcu_ipv4_host_set_t hosts_under_collection;
+extern rcu_ipv4_host_set_t hosts_under_fingerprinting;
+extern rcu_pointer_t<attack_fingerprints_index_t> attack_fingerprints_index;
+extern action_dispatcher_t action_dispatcher;
+extern bool collect_attack_fingerprints;
+extern unsigned int attack_fingerprint_sketch_size;
+extern unsigned int attack_fingerprint_top_elements;
 extern ban_settings_t global_ban_settings;
 extern bool exabgp_enabled;
 extern bool gobgp_enabled;
+extern bool flow_spec_announces;
+extern flow_spec_generator_configuration_t flow_spec_generator_configuration;
+extern bgp_flow_spec_action_t flow_spec_action;
+extern std::map<uint32_t, std::vector<flow_spec_rule_t>> flow_spec_announced_rules;
+extern std::mutex flow_spec_announced_rules_mutex;
 extern map_of_vector_counters_t SubnetVectorMapSpeedAverage;
 extern int global_ban_time;
 extern bool notify_script_enabled;
-extern std::map<uint32_t, banlist_item_t> ban_list;
+extern blackhole_ban_list_t<uint32_t> ban_list;
 extern int unban_iteration_sleep_time;
+extern std::string state_checkpoint_path;
+extern unsigned int state_checkpoint_interval;
+extern unsigned int state_checkpoint_max_age;
 extern bool unban_enabled;
 extern bool unban_only_if_attack_finished;
 
@@ -343,6 +397,37 @@ void build_average_speed_counters_from_speed_counters(subnet_counter_t* current_
 }
 
 
+// Returns weight of previous speed value, speed for periods shorter than speed_calculation_window is smoothed over this window
+double get_speed_window_exp_value(double speed_calc_period) {
+    if (speed_calc_period >= speed_calculation_window) {
+        return 0;
+    }
+
+    return exp(-speed_calc_period / speed_calculation_window);
+}
+
+// Returns speed smoothed over speed_calculation_window
+uint64_t get_windowed_speed(uint64_t current_speed, double new_speed, double window_exp_value) {
+    return uint64_t(new_speed + window_exp_value * ((double)current_speed - new_speed));
+}
+
+// Updates speed element from speed for last period
+void build_windowed_speed_counters(subnet_counter_t* current_speed_element, subnet_counter_t& new_speed_element, double speed_calc_period) {
+    double window_exp_value = get_speed_window_exp_value(speed_calc_period);
+
+    if (window_exp_value == 0) {
+        *current_speed_element = new_speed_element;
+        return;
+    }
+
+    build_average_speed_counters_from_speed_counters(current_speed_element, new_speed_element, window_exp_value,
+                                                     -speed_calc_period / speed_calculation_window);
+
+    // We count flows from flow tables and they are not noisy
+    current_speed_element->in_flows  = new_speed_element.in_flows;
+    current_speed_element->out_flows = new_speed_element.out_flows;
+}
+
 std::string print_flow_tracking_for_ip(conntrack_main_struct_t& conntrack_element, std::string client_ip) {
     std::stringstream buffer;
 
@@ -659,7 +744,7 @@ bool exceed_mbps_speed(uint64_t in_counter, uint64_t out_counter, unsigned int t
 
 // Return true when we should ban this entity
 bool we_should_ban_this_entity(subnet_counter_t* average_speed_element,
-                               ban_settings_t& current_ban_settings,
+                               const ban_settings_t& current_ban_settings,
                                attack_detection_threshold_type_t& attack_detection_source,
                                attack_detection_direction_type_t& attack_detection_direction) {
 
@@ -802,38 +887,22 @@ void convert_integer_to_conntrack_hash_struct(packed_session* packed_connection_
 
 // Unbans host which are ready to it
 void execute_unban_operation_ipv6() {
-    time_t current_time;
-    time(&current_time);
+    // We use same clock as for ban time and in offline mode it's time from packets
+    time_t current_time = get_fast_time_seconds();
 
     std::vector<subnet_ipv6_cidr_mask_t> ban_list_items_for_erase;
 
-    std::map<subnet_ipv6_cidr_mask_t, banlist_item_t> ban_list_copy;
-
-    // Get whole ban list content atomically
-    ban_list_ipv6_ng.get_whole_banlist(ban_list_copy);
+    std::vector<std::pair<subnet_ipv6_cidr_mask_t, banlist_item_t>> expired_bans;
 
-    for (auto itr : ban_list_copy) {
-        // This IP should be banned permanentely and we skip any processing
-        if (!itr.second.unban_enabled) {
-            continue;
-        }
+    // Get only bans with ended ban time
+    ban_list_ipv6_ng.get_expired_blackholes(current_time, expired_bans);
 
+    for (auto itr : expired_bans) {
         // This IP banned manually and we should not unban it automatically
         if (itr.second.attack_detection_source == attack_detection_source_t::Manual) {
             continue;
         }
 
-        double time_difference = difftime(current_time, itr.second.ban_timestamp);
-        int current_ban_time   = itr.second.ban_time;
-
-        // Yes, we reached end of ban time for this customer
-        bool we_could_unban_this_ip = time_difference > current_ban_time;
-
-        // We haven't reached time for unban yet
-        if (!we_could_unban_this_ip) {
-            continue;
-        }
-
         if (unban_only_if_attack_finished) {
             logger << log4cpp::Priority::WARN << "Sorry, we do not support unban_only_if_attack_finished for IPv6";
         }
@@ -853,105 +922,429 @@ void execute_unban_operation_ipv6() {
     }
 }
 
-/* Thread for cleaning up ban list */
-void cleanup_ban_list() {
-    // If we use very small ban time we should call ban_cleanup thread more often
-    if (unban_iteration_sleep_time > global_ban_time) {
-        unban_iteration_sleep_time = int(global_ban_time / 2);
+std::string state_checkpoint_writes_desc = "Number of state checkpoints written to disk";
+uint64_t state_checkpoint_writes         = 0;
+
+std::string state_checkpoint_write_errors_desc = "Number of failed state checkpoint writes";
+uint64_t state_checkpoint_write_errors         = 0;
+
+std::string state_checkpoint_last_duration_microseconds_desc = "Time spent on last state checkpoint";
+uint64_t state_checkpoint_last_duration_microseconds         = 0;
+
+// Checkpoint file starts from this magic and version
+const uint32_t state_checkpoint_magic   = 0x464e5331; // FNS1
+const uint32_t state_checkpoint_version = 3;
+
+// Types which we copy to checkpoint as raw memory
+typedef checkpoint_layout_t<subnet_counter_t, subnet_cidr_mask_t, subnet_ipv6_cidr_mask_t, time_t, direction_t, attack_detection_source_t>
+    state_checkpoint_layout_t;
+
+// Size check could not catch reordered fields of same size
+static_assert(sizeof(subnet_counter_t) == 248,
+              "Please increase state_checkpoint_version after changes in subnet_counter_t and update this size");
+
+// We do not save pcap dump for attack because we do not need it after restart
+void write_attack_details_to_checkpoint(checkpoint_writer_t& writer, const attack_details_t& current_attack) {
+    writer.write((const subnet_counter_t&)current_attack);
+
+    writer.write_string(current_attack.host_group);
+    writer.write_string(current_attack.parent_host_group);
+
+    writer.write(current_attack.attack_direction);
+    writer.write(current_attack.attack_power);
+    writer.write(current_attack.max_attack_power);
+    writer.write(current_attack.attack_protocol);
+
+    writer.write(current_attack.average_in_bytes);
+    writer.write(current_attack.average_out_bytes);
+    writer.write(current_attack.average_in_packets);
+    writer.write(current_attack.average_out_packets);
+    writer.write(current_attack.average_in_flows);
+    writer.write(current_attack.average_out_flows);
+
+    writer.write(current_attack.ban_timestamp);
+    writer.write(current_attack.unban_enabled);
+    writer.write(current_attack.ban_time);
+    writer.write(current_attack.ipv6);
+    writer.write(current_attack.customer_network);
+    writer.write(current_attack.attack_detection_source);
+    writer.write(current_attack.attack_uuid);
+    writer.write(current_attack.attack_severity);
+    writer.write(current_attack.attack_detection_threshold);
+    writer.write(current_attack.attack_detection_direction);
+}
 
-        logger << log4cpp::Priority::INFO << "You are using enough small ban time " << global_ban_time
-               << " we need reduce unban_iteration_sleep_time twices to " << unban_iteration_sleep_time << " seconds";
+bool read_attack_details_from_checkpoint(checkpoint_reader_t& reader, attack_details_t& current_attack) {
+    return reader.read((subnet_counter_t&)current_attack) && reader.read_string(current_attack.host_group) &&
+           reader.read_string(current_attack.parent_host_group) && reader.read(current_attack.attack_direction) &&
+           reader.read(current_attack.attack_power) && reader.read(current_attack.max_attack_power) &&
+           reader.read(current_attack.attack_protocol) && reader.read(current_attack.average_in_bytes) &&
+           reader.read(current_attack.average_out_bytes) && reader.read(current_attack.average_in_packets) &&
+           reader.read(current_attack.average_out_packets) && reader.read(current_attack.average_in_flows) &&
+           reader.read(current_attack.average_out_flows) && reader.read(current_attack.ban_timestamp) &&
+           reader.read(current_attack.unban_enabled) && reader.read(current_attack.ban_time) &&
+           reader.read(current_attack.ipv6) && reader.read(current_attack.customer_network) &&
+           reader.read(current_attack.attack_detection_source) && reader.read(current_attack.attack_uuid) &&
+           reader.read(current_attack.attack_severity) && reader.read(current_attack.attack_detection_threshold) &&
+           reader.read(current_attack.attack_detection_direction);
+}
+
+// Saves moving averages and bans to disk
+bool write_state_checkpoint(const std::string& file_path) {
+    // We copy structures which could change size during checkpoint
+    // IPv4 average vectors are allocated on start and we read them directly
+    std::vector<std::pair<subnet_ipv6_cidr_mask_t, subnet_counter_t>> ipv6_host_averages;
+    ipv6_host_counters.get_all_non_zero_average_speed_elements_as_pairs(ipv6_host_averages);
+
+    std::map<uint32_t, banlist_item_t> ban_list_copy;
+    ban_list.get_whole_banlist(ban_list_copy);
+
+    std::map<subnet_ipv6_cidr_mask_t, banlist_item_t> ban_list_ipv6_copy;
+    ban_list_ipv6_ng.get_whole_banlist(ban_list_ipv6_copy);
+
+    time_t checkpoint_time = 0;
+    time(&checkpoint_time);
+
+    // Set of networks must not change between size calculation and write
+    std::shared_lock<std::shared_mutex> lock(subnet_vector_maps_mutex);
+
+    // Sparse blocks could be allocated or retired between passes of serialiser and we write same blocks in both
+    std::vector<std::vector<uint64_t>> subnet_averages_blocks;
+    subnet_averages_blocks.reserve(SubnetVectorMapSpeedAverage.size());
+
+    for (const auto& subnet_averages : SubnetVectorMapSpeedAverage) {
+        subnet_averages_blocks.push_back(get_counters_storage_blocks_for_checkpoint(subnet_averages.second));
     }
 
-    logger << log4cpp::Priority::INFO << "Run banlist cleanup thread, we will awake every " << unban_iteration_sleep_time << " seconds";
+    auto serialiser = [&](checkpoint_writer_t& writer) {
+        writer.write(state_checkpoint_magic);
+        writer.write(state_checkpoint_version);
+        writer.write(checkpoint_time);
 
-    while (true) {
-        boost::this_thread::sleep(boost::posix_time::seconds(unban_iteration_sleep_time));
+        state_checkpoint_layout_t::write(writer);
 
-        time_t current_time;
-        time(&current_time);
+        writer.write<uint64_t>(SubnetVectorMapSpeedAverage.size());
 
-        std::vector<uint32_t> ban_list_items_for_erase;
+        size_t subnet_index = 0;
 
-        for (std::map<uint32_t, banlist_item_t>::iterator itr = ban_list.begin(); itr != ban_list.end(); ++itr) {
-            uint32_t client_ip = itr->first;
+        for (const auto& subnet_averages : SubnetVectorMapSpeedAverage) {
+            writer.write(subnet_averages.first);
+            write_counters_storage_to_checkpoint(writer, subnet_averages.second, subnet_averages_blocks[subnet_index]);
 
-            // This IP should be banned permanentely and we skip any processing
-            if (!itr->second.unban_enabled) {
-                continue;
+            subnet_index++;
+        }
+
+        writer.write<uint64_t>(ipv6_host_averages.size());
+
+        for (const auto& host_average : ipv6_host_averages) {
+            writer.write(host_average.first);
+            writer.write(host_average.second);
+        }
+
+        writer.write<uint64_t>(ban_list_copy.size());
+
+        for (const auto& ban : ban_list_copy) {
+            writer.write(ban.first);
+            write_attack_details_to_checkpoint(writer, ban.second);
+        }
+
+        writer.write<uint64_t>(ban_list_ipv6_copy.size());
+
+        for (const auto& ban : ban_list_ipv6_copy) {
+            writer.write(ban.first);
+            write_attack_details_to_checkpoint(writer, ban.second);
+        }
+    };
+
+    std::string error_text;
+
+    if (!write_checkpoint_file(file_path, serialiser, error_text)) {
+        logger << log4cpp::Priority::ERROR << "Cannot write state checkpoint: " << error_text;
+        return false;
+    }
+
+    return true;
+}
+
+// Restores moving averages and bans from checkpoint, should be called before we start traffic processing
+bool load_state_checkpoint(const std::string& file_path) {
+    time_t current_time = 0;
+    time(&current_time);
+
+    uint64_t restored_subnets    = 0;
+    uint64_t restored_ipv6_hosts = 0;
+    bool restore_averages        = true;
+
+    std::map<uint32_t, banlist_item_t> restored_ban_list;
+    std::map<subnet_ipv6_cidr_mask_t, banlist_item_t> restored_ban_list_ipv6;
+
+    auto deserialiser = [&](checkpoint_reader_t& reader) -> bool {
+        uint32_t magic         = 0;
+        uint32_t version       = 0;
+        time_t checkpoint_time = 0;
+
+        if (!reader.read(magic) || !reader.read(version) || !reader.read(checkpoint_time)) {
+            return false;
+        }
+
+        if (magic != state_checkpoint_magic || version != state_checkpoint_version) {
+            return false;
+        }
+
+        if (!state_checkpoint_layout_t::read_and_compare(reader)) {
+            logger << log4cpp::Priority::ERROR << "State checkpoint was written by build with different layout of counters";
+            return false;
+        }
+
+        // Averages from old checkpoint will only mislead us
+        if (current_time - checkpoint_time > state_checkpoint_max_age) {
+            logger << log4cpp::Priority::INFO << "State checkpoint is " << current_time - checkpoint_time
+                   << " seconds old and we will restore only bans from it";
+            restore_averages = false;
+        }
+
+        uint64_t number_of_subnets = 0;
+
+        if (!reader.read(number_of_subnets)) {
+            return false;
+        }
+
+        for (uint64_t i = 0; i < number_of_subnets; i++) {
+            subnet_cidr_mask_t subnet;
+
+            if (!reader.read(subnet)) {
+                return false;
+            }
+
+            auto itr = SubnetVectorMapSpeedAverage.find(subnet);
+
+            // Networks list may be changed since checkpoint and we skip averages for removed or resized networks
+            vector_of_counters* subnet_averages =
+                restore_averages && itr != SubnetVectorMapSpeedAverage.end() ? &itr->second : nullptr;
+
+            bool restored = false;
+
+            if (!read_counters_storage_from_checkpoint(reader, subnet_averages, restored)) {
+                return false;
             }
 
-            double time_difference = difftime(current_time, itr->second.ban_timestamp);
-            int ban_time           = itr->second.ban_time;
+            if (restored) {
+                restored_subnets++;
+            }
+        }
+
+        uint64_t number_of_ipv6_hosts = 0;
+
+        if (!reader.read(number_of_ipv6_hosts)) {
+            return false;
+        }
+
+        for (uint64_t i = 0; i < number_of_ipv6_hosts; i++) {
+            subnet_ipv6_cidr_mask_t ipv6_host;
+            subnet_counter_t average_speed_element;
 
-            // Yes, we reached end of ban time for this customer
-            bool we_could_unban_this_ip = time_difference > ban_time;
+            if (!reader.read(ipv6_host) || !reader.read(average_speed_element)) {
+                return false;
+            }
 
-            // We haven't reached time for unban yet
-            if (!we_could_unban_this_ip) {
+            if (!restore_averages) {
                 continue;
             }
 
-            // Check about ongoing attack
-            if (unban_only_if_attack_finished) {
-                std::string client_ip_as_string = convert_ip_as_uint_to_string(client_ip);
+            std::lock_guard<std::mutex> speed_maps_lock_guard(ipv6_host_counters.speed_maps_mutex);
+            std::lock_guard<std::mutex> lock_guard(ipv6_host_counters.counter_map_mutex);
 
-                uint32_t subnet_in_host_byte_order = ntohl(itr->second.customer_network.subnet_address);
-                int64_t shift_in_vector            = (int64_t)ntohl(client_ip) - (int64_t)subnet_in_host_byte_order;
+            ipv6_host_counters.average_speed_map[ipv6_host] = average_speed_element;
 
-                // Try to find average speed element
-                map_of_vector_counters_t::iterator itr_average_speed =
-                    SubnetVectorMapSpeedAverage.find(itr->second.customer_network);
+            // We need element in counter map to recalculate average and remove it when host becomes idle
+            ipv6_host_counters.counter_map[ipv6_host].last_update_time = current_time;
 
-                if (itr_average_speed == SubnetVectorMapSpeedAverage.end()) {
-                    logger << log4cpp::Priority::ERROR << "Can't find vector address in subnet map for unban function";
-                    continue;
-                }
+            restored_ipv6_hosts++;
+        }
 
-                if (shift_in_vector < 0 or shift_in_vector >= itr_average_speed->second.size()) {
-                    logger << log4cpp::Priority::ERROR << "We tried to access to element with index " << shift_in_vector
-                           << " which located outside allocated vector with size " << itr_average_speed->second.size();
+        uint64_t number_of_bans = 0;
 
-                    continue;
-                }
+        if (!reader.read(number_of_bans)) {
+            return false;
+        }
 
-                subnet_counter_t* average_speed_element = &itr_average_speed->second[shift_in_vector];
+        for (uint64_t i = 0; i < number_of_bans; i++) {
+            uint32_t client_ip = 0;
+            attack_details_t current_attack;
+
+            if (!reader.read(client_ip) || !read_attack_details_from_checkpoint(reader, current_attack)) {
+                return false;
+            }
 
-                // We get ban settings from host subnet
-                std::string host_group_name;
-                ban_settings_t current_ban_settings =
-                    get_ban_settings_for_this_subnet(itr->second.customer_network, host_group_name);
+            restored_ban_list[client_ip] = current_attack;
+        }
 
-                attack_detection_threshold_type_t attack_detection_source;
-                attack_detection_direction_type_t attack_detection_direction;
+        if (!reader.read(number_of_bans)) {
+            return false;
+        }
 
-                if (we_should_ban_this_entity(average_speed_element, current_ban_settings, attack_detection_source,
-                                              attack_detection_direction)) {
-                    logger << log4cpp::Priority::ERROR << "Attack to IP " << client_ip_as_string
-                           << " still going! We should not unblock this host";
+        for (uint64_t i = 0; i < number_of_bans; i++) {
+            subnet_ipv6_cidr_mask_t ipv6_client;
+            attack_details_t current_attack;
 
-                    // Well, we still saw attack, skip to next iteration
-                    continue;
-                }
+            if (!reader.read(ipv6_client) || !read_attack_details_from_checkpoint(reader, current_attack)) {
+                return false;
             }
 
-            // Add this IP to remove list
-            // We will remove keyas really after this loop
-            ban_list_items_for_erase.push_back(itr->first);
+            restored_ban_list_ipv6[ipv6_client] = current_attack;
+        }
+
+        return true;
+    };
+
+    std::string error_text;
+
+    if (!read_checkpoint_file(file_path, deserialiser, error_text)) {
+        logger << log4cpp::Priority::ERROR << "Cannot load state checkpoint: " << error_text;
+        return false;
+    }
+
+    // Bans expired during downtime will be removed by cleanup thread with call of unban actions
+    ban_list.set_whole_banlist(restored_ban_list);
+    ban_list_ipv6_ng.set_whole_banlist(restored_ban_list_ipv6);
+
+    logger << log4cpp::Priority::INFO << "Restored averages for " << restored_subnets << " IPv4 networks and "
+           << restored_ipv6_hosts << " IPv6 hosts, " << restored_ban_list.size() << " IPv4 and "
+           << restored_ban_list_ipv6.size() << " IPv6 bans from state checkpoint";
+
+    return true;
+}
+
+// Thread for periodic state checkpoints
+void state_checkpoint_thread() {
+    logger << log4cpp::Priority::INFO << "We will save state checkpoint every " << state_checkpoint_interval << " seconds";
+
+    while (true) {
+        boost::this_thread::sleep(boost::posix_time::seconds(state_checkpoint_interval));
+
+        stage_latency_scope_t stage_latency_scope(latency_stage_t::state_checkpoint);
 
-            // Call all hooks for unban
-            subnet_ipv6_cidr_mask_t zero_ipv6_address;
-            call_unban_handlers(itr->first, zero_ipv6_address, false, itr->second, attack_detection_source_t::Automatic);
+        auto start_time = std::chrono::steady_clock::now();
+
+        if (write_state_checkpoint(state_checkpoint_path)) {
+            state_checkpoint_writes++;
+        } else {
+            state_checkpoint_write_errors++;
         }
 
-        // Remove all unbanned hosts from the ban list
-        for (std::vector<uint32_t>::iterator itr = ban_list_items_for_erase.begin(); itr != ban_list_items_for_erase.end(); ++itr) {
-            std::lock_guard<std::mutex> lock_guard(ban_list_mutex);
-            ban_list.erase(*itr);
+        state_checkpoint_last_duration_microseconds =
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count();
+    }
+}
+
+// Unbans IPv4 and IPv6 hosts with ended ban time
+void execute_unban_operation() {
+    stage_latency_scope_t stage_latency_scope(latency_stage_t::ban_list_cleanup);
+
+    // We use same clock as for ban time and in offline mode it's time from packets
+    time_t current_time = get_fast_time_seconds();
+
+    std::vector<uint32_t> ban_list_items_for_erase;
+
+    // We get only hosts with ended ban time from timer wheel and do not scan whole ban list
+    std::vector<std::pair<uint32_t, banlist_item_t>> expired_bans;
+    ban_list.get_expired_blackholes(current_time, expired_bans);
+
+    for (auto itr = expired_bans.begin(); itr != expired_bans.end(); ++itr) {
+        uint32_t client_ip = itr->first;
+
+        // Check about ongoing attack
+        if (unban_only_if_attack_finished) {
+            std::string client_ip_as_string = convert_ip_as_uint_to_string(client_ip);
+
+            uint32_t subnet_in_host_byte_order = ntohl(itr->second.customer_network.subnet_address);
+            int64_t shift_in_vector            = (int64_t)ntohl(client_ip) - (int64_t)subnet_in_host_byte_order;
+
+            // Network could be removed by reload in same time
+            std::shared_lock<std::shared_mutex> lock(subnet_vector_maps_mutex);
+
+            // Try to find average speed element
+            map_of_vector_counters_t::iterator itr_average_speed =
+                SubnetVectorMapSpeedAverage.find(itr->second.customer_network);
+
+            if (itr_average_speed == SubnetVectorMapSpeedAverage.end()) {
+                logger << log4cpp::Priority::ERROR << "Can't find vector address in subnet map for unban function";
+                ban_list.reschedule_unban(client_ip, current_time + unban_iteration_sleep_time);
+                continue;
+            }
+
+            if (shift_in_vector < 0 or shift_in_vector >= itr_average_speed->second.size()) {
+                logger << log4cpp::Priority::ERROR << "We tried to access to element with index " << shift_in_vector
+                       << " which located outside allocated vector with size " << itr_average_speed->second.size();
+
+                ban_list.reschedule_unban(client_ip, current_time + unban_iteration_sleep_time);
+                continue;
+            }
+
+            subnet_counter_t* average_speed_element = itr_average_speed->second.get(shift_in_vector);
+
+            // In sparse mode we have no averages for blocks without traffic
+            subnet_counter_t zero_average_speed_element{};
+
+            if (average_speed_element == nullptr) {
+                average_speed_element = &zero_average_speed_element;
+            }
+
+            // We get ban settings from host subnet
+            std::string host_group_name;
+            ban_settings_t current_ban_settings =
+                get_ban_settings_for_this_subnet(itr->second.customer_network, host_group_name);
+
+            attack_detection_threshold_type_t attack_detection_source;
+            attack_detection_direction_type_t attack_detection_direction;
+
+            if (we_should_ban_this_entity(average_speed_element, current_ban_settings, attack_detection_source,
+                                          attack_detection_direction)) {
+                logger << log4cpp::Priority::ERROR << "Attack to IP " << client_ip_as_string
+                       << " still going! We should not unblock this host";
+
+                // Well, we still saw attack, check it again on next iteration
+                ban_list.reschedule_unban(client_ip, current_time + unban_iteration_sleep_time);
+                continue;
+            }
         }
 
-        // Unban IPv6 bans
-        execute_unban_operation_ipv6();
+        // Add this IP to remove list
+        // We will remove keyas really after this loop
+        ban_list_items_for_erase.push_back(itr->first);
+
+        // Call all hooks for unban
+        subnet_ipv6_cidr_mask_t zero_ipv6_address;
+        call_unban_handlers(itr->first, zero_ipv6_address, false, itr->second, attack_detection_source_t::Automatic);
+    }
+
+    // Remove all unbanned hosts from the ban list
+    for (std::vector<uint32_t>::iterator itr = ban_list_items_for_erase.begin(); itr != ban_list_items_for_erase.end(); ++itr) {
+        ban_list.remove_from_blackhole(*itr);
+
+        stop_attack_fingerprint_collection(*itr);
+    }
+
+    // Unban IPv6 bans
+    execute_unban_operation_ipv6();
+}
+
+/* Thread for cleaning up ban list */
+void cleanup_ban_list() {
+    // If we use very small ban time we should call ban_cleanup thread more often
+    if (unban_iteration_sleep_time > global_ban_time) {
+        unban_iteration_sleep_time = int(global_ban_time / 2);
+
+        logger << log4cpp::Priority::INFO << "You are using enough small ban time " << global_ban_time
+               << " we need reduce unban_iteration_sleep_time twices to " << unban_iteration_sleep_time << " seconds";
+    }
+
+    logger << log4cpp::Priority::INFO << "Run banlist cleanup thread, we will awake every " << unban_iteration_sleep_time << " seconds";
+
+    while (true) {
+        boost::this_thread::sleep(boost::posix_time::seconds(unban_iteration_sleep_time));
+
+        execute_unban_operation();
     }
 }
 
@@ -980,41 +1373,80 @@ void call_unban_handlers(uint32_t client_ip,
         std::string script_call_params = fastnetmon_platform_configuration.notify_script_path + " " + client_ip_as_string +
                                          " " + data_direction_as_string + " " + pps_as_string + " unban";
 
-        logger << log4cpp::Priority::INFO << "Call script for unban client: " << client_ip_as_string;
+        logger << log4cpp::Priority::INFO << "Queue script call for unban client: " << client_ip_as_string;
 
-        // We should execute external script in separate thread because any lag in this
-        // code will be very distructive
-        boost::thread exec_thread(exec_no_error_check, script_call_params);
-        exec_thread.detach();
+        // Any lag in this code will be very destructive and we execute script from action workers
+        action_dispatcher.enqueue(action_backend_t::Script, [script_call_params]() { exec_no_error_check(script_call_params); });
+    }
 
-        logger << log4cpp::Priority::INFO << "Script for unban client is finished: " << client_ip_as_string;
+    if (ipv4) {
+        withdraw_flow_spec_rules(client_ip);
     }
 
     if (exabgp_enabled && ipv4) {
-        logger << log4cpp::Priority::INFO << "Call ExaBGP for unban client started: " << client_ip_as_string;
+        logger << log4cpp::Priority::INFO << "Queue ExaBGP withdrawal for unban client: " << client_ip_as_string;
 
-        boost::thread exabgp_thread(exabgp_ban_manage, "unban", client_ip_as_string, current_attack);
-        exabgp_thread.detach();
-
-        logger << log4cpp::Priority::INFO << "Call to ExaBGP for unban client is finished: " << client_ip_as_string;
+        // Announces from multiple hosts will be written to ExaBGP pipe in single batch
+        for (const auto& exabgp_message : exabgp_ban_messages("unban", client_ip_as_string, current_attack)) {
+            action_dispatcher.enqueue_batched(action_backend_t::ExaBGP, action_batch_element_t("", exabgp_message));
+        }
     }
 
 #ifdef ENABLE_GOBGP
     if (gobgp_enabled) {
-        logger << log4cpp::Priority::INFO << "Call GoBGP for unban client started: " << client_ip_as_string;
+        logger << log4cpp::Priority::INFO << "Queue GoBGP withdrawal for unban client: " << client_ip_as_string;
 
-        boost::thread gobgp_thread(gobgp_ban_manage, "unban", ipv6, client_ip_as_string, client_ipv6, current_attack);
-        gobgp_thread.detach();
-
-        logger << log4cpp::Priority::INFO << "Call to GoBGP for unban client is finished: " << client_ip_as_string;
+        // It only queues paths for GoBGP announce thread which sends them in batches
+        gobgp_ban_manage("unban", ipv6, client_ip_as_string, client_ipv6, current_attack);
     }
 #endif
+
+    // Fingerprint has traffic for whole duration of attack only now and we store it in same way as ban information
+    // Caller stops fingerprint collection after this function
+    if (ipv4 && collect_attack_fingerprints) {
+        std::string unban_information_in_json =
+            get_attack_description_in_json_for_web_hooks(client_ip, client_ipv6, ipv6, "unban", current_attack);
+
+#ifdef REDIS
+        if (redis_enabled) {
+            std::string redis_key_name = client_ip_as_string + "_attack_fingerprint";
+
+            if (!redis_prefix.empty()) {
+                redis_key_name = redis_prefix + "_" + client_ip_as_string + "_attack_fingerprint";
+            }
+
+            logger << log4cpp::Priority::INFO << "Queue data save in Redis in key: " << redis_key_name;
+            action_dispatcher.enqueue_batched(action_backend_t::Redis,
+                                              action_batch_element_t(redis_key_name, unban_information_in_json));
+        }
+#endif
+
+#ifdef MONGO
+        if (mongodb_enabled) {
+            std::string mongo_key_name =
+                client_ip_as_string + "_attack_fingerprint_" + print_time_t_in_fastnetmon_format(current_attack.ban_timestamp);
+
+            // We could not use dot in key names: http://docs.mongodb.org/manual/core/document/#dot-notation
+            std::replace(mongo_key_name.begin(), mongo_key_name.end(), '.', '_');
+
+            logger << log4cpp::Priority::INFO << "Queue data save in Mongo in key: " << mongo_key_name;
+            action_dispatcher.enqueue(action_backend_t::MongoDB, [mongo_key_name, unban_information_in_json]() {
+                store_data_in_mongo(mongo_key_name, unban_information_in_json);
+            });
+        }
+#endif
+    }
 }
 
 std::string print_ddos_attack_details() {
     std::stringstream output_buffer;
 
-    for (std::map<uint32_t, banlist_item_t>::iterator ii = ban_list.begin(); ii != ban_list.end(); ++ii) {
+    std::map<uint32_t, banlist_item_t> ban_list_copy;
+
+    // Get whole ban list content atomically
+    ban_list.get_whole_banlist(ban_list_copy);
+
+    for (std::map<uint32_t, banlist_item_t>::iterator ii = ban_list_copy.begin(); ii != ban_list_copy.end(); ++ii) {
         uint32_t client_ip = (*ii).first;
 
         std::string client_ip_as_string = convert_ip_as_uint_to_string(client_ip);
@@ -1139,6 +1571,61 @@ bool serialize_attack_description_to_json(const attack_details_t& current_attack
     return true;
 }
 
+// Serialises top elements from heavy hitters sketches to JSON
+template <typename TemplateKeyType>
+nlohmann::json serialize_heavy_hitters_to_json(const std::vector<heavy_hitter_element_t<TemplateKeyType>>& top_elements,
+                                               const std::string& key_name,
+                                               std::function<nlohmann::json(const TemplateKeyType&)> key_serializer) {
+    nlohmann::json top_elements_json = nlohmann::json::array();
+
+    for (const auto& element : top_elements) {
+        nlohmann::json json_element;
+
+        json_element[key_name]  = key_serializer(element.key);
+        json_element["packets"] = element.count;
+        json_element["error"]   = element.error;
+
+        top_elements_json.push_back(json_element);
+    }
+
+    return top_elements_json;
+}
+
+bool serialize_attack_fingerprint_to_json(const attack_fingerprint_t& attack_fingerprint, nlohmann::json& json_details) {
+    attack_fingerprint_summary_t summary = attack_fingerprint.get_summary(attack_fingerprint_top_elements);
+
+    try {
+        json_details["total_packets"] = summary.total_packets;
+
+        json_details["top_peer_ips"] =
+            serialize_heavy_hitters_to_json<uint32_t>(summary.top_peer_ips, "ip", [](const uint32_t& ip) {
+                return nlohmann::json(convert_ip_as_uint_to_string(ip));
+            });
+
+        json_details["top_peer_asns"] =
+            serialize_heavy_hitters_to_json<uint32_t>(summary.top_peer_asns, "asn",
+                                                      [](const uint32_t& asn) { return nlohmann::json(asn); });
+
+        json_details["top_source_ports"] =
+            serialize_heavy_hitters_to_json<uint16_t>(summary.top_source_ports, "port",
+                                                      [](const uint16_t& port) { return nlohmann::json(port); });
+
+        json_details["top_destination_ports"] =
+            serialize_heavy_hitters_to_json<uint16_t>(summary.top_destination_ports, "port",
+                                                      [](const uint16_t& port) { return nlohmann::json(port); });
+
+        json_details["top_protocols"] =
+            serialize_heavy_hitters_to_json<uint32_t>(summary.top_protocols, "protocol", [](const uint32_t& protocol) {
+                return nlohmann::json(get_printable_protocol_name(protocol));
+            });
+    } catch (...) {
+        logger << log4cpp::Priority::ERROR << "Exception was triggered in attack fingerprint JSON encoder";
+        return false;
+    }
+
+    return true;
+}
+
 std::string get_attack_description_in_json_for_web_hooks(uint32_t client_ip,
                                                          const subnet_ipv6_cidr_mask_t& client_ipv6,
                                                          bool ipv6,
@@ -1166,6 +1653,21 @@ std::string get_attack_description_in_json_for_web_hooks(uint32_t client_ip,
         logger << log4cpp::Priority::ERROR << "Cannot generate attack details for get_attack_description_in_json_for_web_hooks";
     }
 
+    // We start fingerprint collection on ban and it has no traffic for ban notification
+    // We add it for callbacks which we call later, for example on unban
+    if (!ipv6) {
+        std::shared_ptr<attack_fingerprint_t> attack_fingerprint = get_attack_fingerprint(client_ip);
+
+        if (attack_fingerprint) {
+            nlohmann::json attack_fingerprint_json;
+
+            if (!serialize_attack_fingerprint_to_json(*attack_fingerprint, attack_fingerprint_json)) {
+                logger << log4cpp::Priority::ERROR << "Cannot generate attack fingerprint for get_attack_description_in_json_for_web_hooks";
+            } else if (attack_fingerprint_json["total_packets"].get<uint64_t>() > 0) {
+                callback_info["attack_fingerprint"] = attack_fingerprint_json;
+            }
+        }
+    }
 
     std::string json_as_text = callback_info.dump();
 
@@ -1202,25 +1704,114 @@ void send_attack_details(uint32_t client_ip, attack_details_t current_attack_det
         attack_details << get_attack_description(client_ip, current_attack_details) << "\n\n";
         attack_details << generate_simple_packets_dump(ban_list_details[client_ip]);
 
+        std::shared_ptr<attack_fingerprint_t> attack_fingerprint = get_attack_fingerprint(client_ip);
+
+        if (attack_fingerprint) {
+            nlohmann::json attack_fingerprint_json;
+
+            if (serialize_attack_fingerprint_to_json(*attack_fingerprint, attack_fingerprint_json)) {
+                attack_details << "\nAttack fingerprint:\n" << attack_fingerprint_json.dump(4) << "\n";
+            }
+        }
+
         logger << log4cpp::Priority::INFO << "Attack with direction: " << attack_direction
                << " IP: " << client_ip_as_string << " Power: " << pps_as_string << " traffic samples collected";
 
         call_attack_details_handlers(client_ip, current_attack_details, attack_details.str());
 
+        announce_flow_spec_rules(client_ip, ban_list_details[client_ip]);
+
         // TODO: here we have definitely RACE CONDITION!!! FIX IT
 
         // Remove key and prevent collection new data about this attack
         std::lock_guard<std::mutex> lock_guard(ban_list_details_mutex);
         ban_list_details.erase(client_ip);
+        publish_hosts_under_collection();
     }
 }
 
-void call_attack_details_handlers(uint32_t client_ip, attack_details_t& current_attack, std::string attack_fingerprint) {
+// Builds flow spec rules from traffic samples of host and announces them with BGP
+void announce_flow_spec_rules(uint32_t client_ip, const std::vector<simple_packet_t>& simple_packets) {
+    if (!flow_spec_announces or !(exabgp_enabled or gobgp_enabled)) {
+        return;
+    }
+
     std::string client_ip_as_string = convert_ip_as_uint_to_string(client_ip);
-    std::string attack_direction    = get_direction_name(current_attack.attack_direction);
-    std::string pps_as_string       = convert_int_to_string(current_attack.attack_power);
 
-    std::string ban_timestamp_as_string = print_time_t_in_fastnetmon_format(current_attack.ban_timestamp);
+    flow_spec_generator_t flow_spec_generator(flow_spec_generator_configuration);
+
+    std::vector<flow_spec_signature_t> signatures = flow_spec_generator.get_signatures(simple_packets);
+    std::vector<flow_spec_rule_t> flow_spec_rules =
+        flow_spec_generator.get_rules(signatures, subnet_cidr_mask_t(client_ip, 32), flow_spec_action);
+
+    if (flow_spec_rules.empty()) {
+        logger << log4cpp::Priority::WARN << "We could not build flow spec rules for " << client_ip_as_string;
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock_guard(flow_spec_announced_rules_mutex);
+
+        // Host could be banned again before unban of previous attack and we keep rules from previous announce
+        std::vector<flow_spec_rule_t>& announced_rules = flow_spec_announced_rules[client_ip];
+        announced_rules.insert(announced_rules.end(), flow_spec_rules.begin(), flow_spec_rules.end());
+    }
+
+    logger << log4cpp::Priority::INFO << "Queue announce of " << flow_spec_rules.size() << " flow spec rules for "
+           << client_ip_as_string;
+
+    if (exabgp_enabled) {
+        for (const auto& exabgp_message : exabgp_flow_spec_messages("ban", flow_spec_rules)) {
+            action_dispatcher.enqueue_batched(action_backend_t::ExaBGP, action_batch_element_t("", exabgp_message));
+        }
+    }
+
+#ifdef ENABLE_GOBGP
+    if (gobgp_enabled) {
+        gobgp_flow_spec_manage("ban", flow_spec_rules);
+    }
+#endif
+}
+
+// Withdraws all flow spec rules which we announced for host
+void withdraw_flow_spec_rules(uint32_t client_ip) {
+    std::vector<flow_spec_rule_t> flow_spec_rules;
+
+    {
+        std::lock_guard<std::mutex> lock_guard(flow_spec_announced_rules_mutex);
+
+        auto itr = flow_spec_announced_rules.find(client_ip);
+
+        if (itr == flow_spec_announced_rules.end()) {
+            return;
+        }
+
+        flow_spec_rules = itr->second;
+        flow_spec_announced_rules.erase(itr);
+    }
+
+    logger << log4cpp::Priority::INFO << "Queue withdrawal of " << flow_spec_rules.size() << " flow spec rules for "
+           << convert_ip_as_uint_to_string(client_ip);
+
+    if (exabgp_enabled) {
+        for (const auto& exabgp_message : exabgp_flow_spec_messages("unban", flow_spec_rules)) {
+            action_dispatcher.enqueue_batched(action_backend_t::ExaBGP, action_batch_element_t("", exabgp_message));
+        }
+    }
+
+#ifdef ENABLE_GOBGP
+    if (gobgp_enabled) {
+        gobgp_flow_spec_manage("unban", flow_spec_rules);
+    }
+#endif
+}
+
+void call_attack_details_handlers(uint32_t client_ip, attack_details_t& current_attack, std::string attack_fingerprint) {
+    std::string client_ip_as_string = convert_ip_as_uint_to_string(client_ip);
+    std::string attack_direction    = get_direction_name(current_attack.attack_direction);
+    std::string pps_as_string       = convert_int_to_string(current_attack.attack_power);
+
+    std::string ban_timestamp_as_string = print_time_t_in_fastnetmon_format(current_attack.ban_timestamp);
     std::string attack_pcap_dump_path   = fastnetmon_platform_configuration.attack_details_folder + "/" +
                                         client_ip_as_string + "_" + ban_timestamp_as_string + ".pcap";
 
@@ -1252,12 +1843,10 @@ void call_attack_details_handlers(uint32_t client_ip, attack_details_t& current_
         std::string script_params = fastnetmon_platform_configuration.notify_script_path + " " + client_ip_as_string +
                                     " " + attack_direction + " " + pps_as_string + " attack_details";
 
-        // We should execute external script in separate thread because any lag in this code
-        // will be very destructive
-        boost::thread exec_with_params_thread(exec_with_stdin_params, script_params, attack_fingerprint);
-        exec_with_params_thread.detach();
-
-        logger << log4cpp::Priority::INFO << "Script for notify about attack details is finished: " << client_ip_as_string;
+        // Any lag in this code will be very destructive and we execute script from action workers
+        action_dispatcher.enqueue(action_backend_t::Script, [script_params, attack_fingerprint]() {
+            exec_with_stdin_params(script_params, attack_fingerprint);
+        });
     }
 
 #ifdef REDIS
@@ -1268,10 +1857,8 @@ void call_attack_details_handlers(uint32_t client_ip, attack_details_t& current_
             redis_key_name = redis_prefix + "_" + client_ip_as_string + "_packets_dump";
         }
 
-        logger << log4cpp::Priority::INFO << "Start data save in redis for key: " << redis_key_name;
-        boost::thread redis_store_thread(store_data_in_redis, redis_key_name, attack_fingerprint);
-        redis_store_thread.detach();
-        logger << log4cpp::Priority::INFO << "Finish data save in redis for key: " << redis_key_name;
+        logger << log4cpp::Priority::INFO << "Queue data save in redis for key: " << redis_key_name;
+        action_dispatcher.enqueue_batched(action_backend_t::Redis, action_batch_element_t(redis_key_name, attack_fingerprint));
     }
 #endif
 }
@@ -1348,10 +1935,13 @@ bool exec_with_stdin_params(std::string cmd, std::string params) {
 
 // Get ban settings for this subnet or return global ban settings
 ban_settings_t get_ban_settings_for_this_subnet(subnet_cidr_mask_t subnet, std::string& host_group_name) {
+    // It could be replaced on reload but we use copy which we got here
+    const host_groups_configuration_t* current_host_groups_configuration = host_groups_configuration.get();
+
     // Try to find host group for this subnet
-    subnet_to_host_group_map_t::iterator host_group_itr = subnet_to_host_groups.find(subnet);
+    auto host_group_itr = current_host_groups_configuration->subnet_to_host_groups.find(subnet);
 
-    if (host_group_itr == subnet_to_host_groups.end()) {
+    if (host_group_itr == current_host_groups_configuration->subnet_to_host_groups.end()) {
         // We haven't host groups for all subnets, it's OK
         // logger << log4cpp::Priority::INFO << "We haven't custom host groups for this network. We will use global ban settings";
         host_group_name = "global";
@@ -1361,9 +1951,9 @@ ban_settings_t get_ban_settings_for_this_subnet(subnet_cidr_mask_t subnet, std::
     host_group_name = host_group_itr->second;
 
     // We found host group for this subnet
-    host_group_ban_settings_map_t::iterator hostgroup_settings_itr = host_group_ban_settings_map.find(host_group_itr->second);
+    auto hostgroup_settings_itr = current_host_groups_configuration->host_group_ban_settings_map.find(host_group_itr->second);
 
-    if (hostgroup_settings_itr == host_group_ban_settings_map.end()) {
+    if (hostgroup_settings_itr == current_host_groups_configuration->host_group_ban_settings_map.end()) {
         logger << log4cpp::Priority::ERROR << "We can't find ban settings for host group " << host_group_itr->second;
         return global_ban_settings;
     }
@@ -1401,6 +1991,34 @@ void store_data_in_redis(std::string key_name, std::string attack_details) {
     redisFree(redis_context);
 }
 
+// Stores all keys using single connection and pipelined SET commands
+void store_data_in_redis_batch(const std::vector<action_batch_element_t>& batch_elements) {
+    redisContext* redis_context = redis_init_connection();
+
+    if (!redis_context) {
+        logger << log4cpp::Priority::ERROR << "Could not initiate connection to Redis";
+        return;
+    }
+
+    for (const auto& batch_element : batch_elements) {
+        redisAppendCommand(redis_context, "SET %s %s", batch_element.key.c_str(), batch_element.value.c_str());
+    }
+
+    for (size_t i = 0; i < batch_elements.size(); i++) {
+        redisReply* reply = NULL;
+
+        if (redisGetReply(redis_context, (void**)&reply) != REDIS_OK) {
+            logger << log4cpp::Priority::ERROR << "Can't store data in redis error_code: " << redis_context->err
+                   << " error_string: " << redis_context->errstr;
+            break;
+        }
+
+        freeReplyObject(reply);
+    }
+
+    redisFree(redis_context);
+}
+
 redisContext* redis_init_connection() {
     struct timeval timeout      = { 1, 500000 }; // 1.5 seconds
     redisContext* redis_context = redisConnectWithTimeout(redis_host.c_str(), redis_port, timeout);
@@ -1423,6 +2041,67 @@ redisContext* redis_init_connection() {
 #endif
 
 
+// Publishes hosts from ban_list_details which still need packet samples for lock free lookups from process_packet
+// ban_list_details_mutex must be locked by caller
+void publish_hosts_under_collection() {
+    std::vector<uint32_t> hosts;
+    hosts.reserve(ban_list_details.size());
+
+    for (const auto& ban_list_details_element : ban_list_details) {
+        if (ban_list_details_element.second.size() < ban_details_records_count) {
+            hosts.push_back(ban_list_details_element.first);
+        }
+    }
+
+    hosts_under_collection.publish(hosts);
+}
+
+// attack_fingerprints_mutex must be locked by caller
+void publish_hosts_under_fingerprinting() {
+    std::vector<uint32_t> hosts;
+    hosts.reserve(attack_fingerprints.size());
+
+    for (const auto& attack_fingerprint_element : attack_fingerprints) {
+        hosts.push_back(attack_fingerprint_element.first);
+    }
+
+    hosts_under_fingerprinting.publish(hosts);
+    attack_fingerprints_index.publish(new attack_fingerprints_index_t(attack_fingerprints.begin(), attack_fingerprints.end()));
+}
+
+// Starts collection of heavy hitters for host under attack
+void start_attack_fingerprint_collection(uint32_t client_ip) {
+    if (!collect_attack_fingerprints) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock_guard(attack_fingerprints_mutex);
+    attack_fingerprints[client_ip] = std::make_shared<attack_fingerprint_t>(attack_fingerprint_sketch_size);
+    publish_hosts_under_fingerprinting();
+}
+
+void stop_attack_fingerprint_collection(uint32_t client_ip) {
+    std::lock_guard<std::mutex> lock_guard(attack_fingerprints_mutex);
+
+    if (attack_fingerprints.erase(client_ip) > 0) {
+        publish_hosts_under_fingerprinting();
+    }
+}
+
+// Returns empty pointer when we do not collect fingerprint for this host
+// It's not intended for process_packet, we use attack_fingerprints_index there
+std::shared_ptr<attack_fingerprint_t> get_attack_fingerprint(uint32_t client_ip) {
+    std::lock_guard<std::mutex> lock_guard(attack_fingerprints_mutex);
+
+    auto itr = attack_fingerprints.find(client_ip);
+
+    if (itr == attack_fingerprints.end()) {
+        return std::shared_ptr<attack_fingerprint_t>();
+    }
+
+    return itr->second;
+}
+
 void execute_ip_ban(uint32_t client_ip, subnet_counter_t average_speed_element, std::string flow_attack_details, subnet_cidr_mask_t customer_subnet) {
     attack_details_t current_attack;
     uint64_t pps = 0;
@@ -1465,17 +2144,24 @@ void execute_ip_ban(uint32_t client_ip, subnet_counter_t average_speed_element,
 
     current_attack.attack_protocol = detect_attack_protocol(average_speed_element, data_direction);
 
-    if (ban_list.count(client_ip) > 0) {
-        if (ban_list[client_ip].attack_direction != data_direction) {
-            logger << log4cpp::Priority::INFO << "We expected very strange situation: attack direction for "
-                   << convert_ip_as_uint_to_string(client_ip) << " was changed";
+    bool attack_direction_changed = false;
 
+    bool already_banned = ban_list.modify_blackhole_details(client_ip, [&](banlist_item_t& banlist_item) {
+        if (banlist_item.attack_direction != data_direction) {
+            attack_direction_changed = true;
             return;
         }
 
         // update attack power
-        if (pps > ban_list[client_ip].max_attack_power) {
-            ban_list[client_ip].max_attack_power = pps;
+        if (pps > banlist_item.max_attack_power) {
+            banlist_item.max_attack_power = pps;
+        }
+    });
+
+    if (already_banned) {
+        if (attack_direction_changed) {
+            logger << log4cpp::Priority::INFO << "We expected very strange situation: attack direction for "
+                   << convert_ip_as_uint_to_string(client_ip) << " was changed";
         }
 
         return;
@@ -1504,8 +2190,8 @@ void execute_ip_ban(uint32_t client_ip, subnet_counter_t average_speed_element,
     // Store information about subnet
     current_attack.customer_network = customer_subnet;
 
-    // Store ban time
-    time(&current_attack.ban_timestamp);
+    // Store ban time, in offline mode we use time from packets
+    current_attack.ban_timestamp = get_fast_time_seconds();
     // set ban time in seconds
     current_attack.ban_time      = global_ban_time;
     current_attack.unban_enabled = unban_enabled;
@@ -1566,16 +2252,16 @@ void execute_ip_ban(uint32_t client_ip, subnet_counter_t average_speed_element,
         }
     }
 
-    {
-        std::lock_guard<std::mutex> lock_guard(ban_list_mutex);
-        ban_list[client_ip] = current_attack;
-    }
+    ban_list.add_to_blackhole(client_ip, current_attack);
 
     {
         std::lock_guard<std::mutex> lock_guard(ban_list_details_mutex);
         ban_list_details[client_ip] = std::vector<simple_packet_t>();
+        publish_hosts_under_collection();
     }
 
+    start_attack_fingerprint_collection(client_ip);
+
     logger << log4cpp::Priority::INFO << "Attack with direction: " << data_direction_as_string
            << " IP: " << client_ip_as_string << " Power: " << pps_as_string;
 
@@ -1583,7 +2269,7 @@ void execute_ip_ban(uint32_t client_ip, subnet_counter_t average_speed_element,
 
     boost::circular_buffer<simple_packet_t> empty_simple_packets_buffer;
 
-    call_ban_handlers(client_ip, zero_ipv6_address, false, ban_list[client_ip], flow_attack_details,
+    call_ban_handlers(client_ip, zero_ipv6_address, false, current_attack, flow_attack_details,
                       attack_detection_source_t::Automatic, "", empty_simple_packets_buffer);
 }
 
@@ -1627,33 +2313,28 @@ void call_ban_handlers(uint32_t client_ip,
                                          " " + data_direction_as_string + " " + pps_as_string + " " + "ban";
         logger << log4cpp::Priority::INFO << "Call script for ban client: " << client_ip_as_string;
 
-        // We should execute external script in separate thread because any lag in this code will be
-        // very destructive
-
+        // Any lag in this code will be very destructive and we execute script from action workers
         // We will pass attack details over stdin
-        boost::thread exec_thread(exec_with_stdin_params, script_call_params, full_attack_description);
-        exec_thread.detach();
-
-        logger << log4cpp::Priority::INFO << "Script for ban client is finished: " << client_ip_as_string;
+        action_dispatcher.enqueue(action_backend_t::Script, [script_call_params, full_attack_description]() {
+            exec_with_stdin_params(script_call_params, full_attack_description);
+        });
     }
 
     if (exabgp_enabled && ipv4) {
-        logger << log4cpp::Priority::INFO << "Call ExaBGP for ban client started: " << client_ip_as_string;
+        logger << log4cpp::Priority::INFO << "Queue ExaBGP announce for ban client: " << client_ip_as_string;
 
-        boost::thread exabgp_thread(exabgp_ban_manage, "ban", client_ip_as_string, current_attack);
-        exabgp_thread.detach();
-
-        logger << log4cpp::Priority::INFO << "Call to ExaBGP for ban client is finished: " << client_ip_as_string;
+        // Announces from multiple hosts will be written to ExaBGP pipe in single batch
+        for (const auto& exabgp_message : exabgp_ban_messages("ban", client_ip_as_string, current_attack)) {
+            action_dispatcher.enqueue_batched(action_backend_t::ExaBGP, action_batch_element_t("", exabgp_message));
+        }
     }
 
 #ifdef ENABLE_GOBGP
     if (gobgp_enabled) {
-        logger << log4cpp::Priority::INFO << "Call GoBGP for ban client started: " << client_ip_as_string;
-
-        boost::thread gobgp_thread(gobgp_ban_manage, "ban", ipv6, client_ip_as_string, client_ipv6, current_attack);
-        gobgp_thread.detach();
+        logger << log4cpp::Priority::INFO << "Queue GoBGP announce for ban client: " << client_ip_as_string;
 
-        logger << log4cpp::Priority::INFO << "Call to GoBGP for ban client is finished: " << client_ip_as_string;
+        // It only queues paths for GoBGP announce thread which sends them in batches
+        gobgp_ban_manage("ban", ipv6, client_ip_as_string, client_ipv6, current_attack);
     }
 #endif
 
@@ -1665,10 +2346,9 @@ void call_ban_handlers(uint32_t client_ip,
             redis_key_name = redis_prefix + "_" + client_ip_as_string + "_information";
         }
 
-        logger << log4cpp::Priority::INFO << "Start data save in Redis in key: " << redis_key_name;
-        boost::thread redis_store_thread(store_data_in_redis, redis_key_name, basic_attack_information_in_json);
-        redis_store_thread.detach();
-        logger << log4cpp::Priority::INFO << "Finish data save in Redis in key: " << redis_key_name;
+        logger << log4cpp::Priority::INFO << "Queue data save in Redis in key: " << redis_key_name;
+        action_dispatcher.enqueue_batched(action_backend_t::Redis,
+                                          action_batch_element_t(redis_key_name, basic_attack_information_in_json));
 
         // If we have flow dump put in redis too
         if (!flow_attack_details.empty()) {
@@ -1678,10 +2358,8 @@ void call_ban_handlers(uint32_t client_ip,
                 redis_key_name = redis_prefix + "_" + client_ip_as_string + "_flow_dump";
             }
 
-            logger << log4cpp::Priority::INFO << "Start data save in redis in key: " << redis_key_name;
-            boost::thread redis_store_thread(store_data_in_redis, redis_key_name, flow_attack_details);
-            redis_store_thread.detach();
-            logger << log4cpp::Priority::INFO << "Finish data save in redis in key: " << redis_key_name;
+            logger << log4cpp::Priority::INFO << "Queue data save in redis in key: " << redis_key_name;
+            action_dispatcher.enqueue_batched(action_backend_t::Redis, action_batch_element_t(redis_key_name, flow_attack_details));
         }
     }
 #endif
@@ -1694,10 +2372,10 @@ void call_ban_handlers(uint32_t client_ip,
         // We could not use dot in key names: http://docs.mongodb.org/manual/core/document/#dot-notation
         std::replace(mongo_key_name.begin(), mongo_key_name.end(), '.', '_');
 
-        logger << log4cpp::Priority::INFO << "Start data save in Mongo in key: " << mongo_key_name;
-        boost::thread mongo_store_thread(store_data_in_mongo, mongo_key_name, basic_attack_information_in_json);
-        mongo_store_thread.detach();
-        logger << log4cpp::Priority::INFO << "Finish data save in Mongo in key: " << mongo_key_name;
+        logger << log4cpp::Priority::INFO << "Queue data save in Mongo in key: " << mongo_key_name;
+        action_dispatcher.enqueue(action_backend_t::MongoDB, [mongo_key_name, basic_attack_information_in_json]() {
+            store_data_in_mongo(mongo_key_name, basic_attack_information_in_json);
+        });
     }
 #endif
 }
@@ -1928,7 +2606,7 @@ void traffic_draw_ipv4_program() {
         output_buffer << get_pcap_stats() << "\n";
     }
 
-    if (!ban_list.empty()) {
+    if (ban_list.size() > 0) {
         output_buffer << std::endl << "Ban list:" << std::endl;
         output_buffer << print_ddos_attack_details();
     }
@@ -2026,8 +2704,8 @@ bool fill_attack_information(subnet_counter_t average_speed_element,
            << " out: " << out_pps << " pps " << convert_speed_to_mbps(out_bps) << " mbps"
            << " and we decided it's " << data_direction_as_string << " attack";
 
-    // Store ban time
-    time(&current_attack.ban_timestamp);
+    // Store ban time, in offline mode we use time from packets
+    current_attack.ban_timestamp = get_fast_time_seconds();
     // set ban time in seconds
     current_attack.ban_time      = ban_time;
     current_attack.unban_enabled = unban_enabled;
@@ -2156,79 +2834,129 @@ void speed_callback_subnet_ipv6(subnet_ipv6_cidr_mask_t* subnet, subnet_counter_
 }
 
 
-/* Calculate speed for all connnections */
-void recalculate_speed() {
-    // logger<< log4cpp::Priority::INFO<<"We run recalculate_speed";
-    double speed_calc_period = recalculate_speed_timeout;
+// Part of IPv4 network which single worker recalculates
+class ipv4_recalculation_task_t {
+    public:
+    subnet_cidr_mask_t subnet;
 
-    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    vector_of_counters* counters               = nullptr;
+    vector_of_counters* speed_counters         = nullptr;
+    vector_of_counters* average_speed_counters = nullptr;
+    vector_of_flow_counters_t* flow_counters   = nullptr;
 
-    // Calculate duration of our sleep duration as it may be altered by OS behaviour (i.e. process scheduler)
-    // And if it differs from reference value then we need to adjust it and use new value
-    std::chrono::duration<double> diff = start_time - last_call_of_traffic_recalculation;
+    ban_settings_t ban_settings;
+    std::string host_group_name;
 
-    double time_difference = diff.count();
+    size_t first_block = 0;
+    size_t last_block  = 0;
+};
 
-    // Handle case of time moving backwards
-    if (time_difference < 0) {
-        // It must not happen as our time source is explicitly monotonic: https://en.cppreference.com/w/cpp/chrono/steady_clock
-        logger << log4cpp::Priority::ERROR << "Negative delay for traffic calculation " << time_difference;
-        logger << log4cpp::Priority::ERROR << "This must not happen, please report this issue to maintainers. Skipped iteration";
+// Host which exceeded thresholds, we ban it from recalculation thread after all workers finished
+class ipv4_ban_candidate_t {
+    public:
+    uint32_t client_ip = 0;
+    subnet_counter_t average_speed_element;
+    std::string flow_attack_details;
+    subnet_cidr_mask_t customer_network;
+};
 
-        return;
-    }
+// Block of sparse counters without traffic for sparse_counters_idle_periods, we free it from recalculation thread
+class ipv4_idle_block_t {
+    public:
+    subnet_cidr_mask_t subnet;
+    size_t block_index = 0;
+};
 
-    // logger << log4cpp::Priority::INFO << "Delay in seconds " << time_difference;
+// Results of single worker, we align them to avoid false sharing between workers
+class alignas(64) ipv4_recalculation_results_t {
+    public:
+    uint64_t incoming_total_flows = 0;
+    uint64_t outgoing_total_flows = 0;
+    uint64_t recalculated_hosts   = 0;
 
-    // Zero or positive delay
-    if (time_difference < recalculate_speed_timeout) {
-        // It could occur on toolkit start or in some weird cases of Linux scheduler
-        // I really saw cases when sleep executed in zero seconds:
-        // [WARN] Sleep time expected: 1. Sleep time experienced: 0
-        // But we have handlers for such case and should not bother client about with it
-        // And we are using DEBUG level here
-        logger << log4cpp::Priority::DEBUG
-               << "We skip one iteration of speed_calc because it runs so early! That's "
-                  "really impossible! Please ask support.";
-        logger << log4cpp::Priority::DEBUG << "Sleep time expected: " << recalculate_speed_timeout
-               << ". Sleep time experienced: " << time_difference;
-        return;
-    } else if (int(time_difference) == int(speed_calc_period)) {
-        // All fine, we run on time
-    } else {
-        // logger << log4cpp::Priority::INFO << "Time from last run of speed_recalc is soooo big, we got ugly lags: " <<
-        // time_difference << " seconds";
-        speed_calc_period = time_difference;
-    }
+    std::vector<ipv4_ban_candidate_t> ban_candidates;
+    std::vector<ipv4_idle_block_t> idle_blocks;
+};
+
+// Number of /24 blocks in single task of IPv4 recalculation
+const size_t ipv4_recalculation_blocks_per_task = 64;
 
+// Recalculates speed and averages for blocks of IPv4 network, it could run in parallel for different tasks
+void recalculate_speed_for_ipv4_task(const ipv4_recalculation_task_t& task,
+                                     double speed_calc_period,
+                                     ipv4_recalculation_results_t& results) {
     subnet_counter_t zero_map_element{};
 
-    uint64_t incoming_total_flows = 0;
-    uint64_t outgoing_total_flows = 0;
+    vector_of_counters& counters               = *task.counters;
+    vector_of_counters& speed_counters         = *task.speed_counters;
+    vector_of_counters& average_speed_counters = *task.average_speed_counters;
+    vector_of_flow_counters_t& flow_counters   = *task.flow_counters;
 
-    ipv4_network_counters.recalculate_speed(speed_calc_period, (double)average_calculation_amount, nullptr);
+    // convert to host order for math operations
+    uint32_t subnet_ip = ntohl(task.subnet.subnet_address);
 
+    for (size_t block_index = task.first_block; block_index < task.last_block; block_index++) {
+        bool block_has_traffic = counters.clear_block_activity(block_index);
+
+        // We skip blocks without traffic and with zero averages
+        if (!block_has_traffic && !average_speed_counters.is_block_active(block_index)) {
+            // Sparse blocks stay allocated after end of traffic and we free them after long idle time
+            if (average_speed_counters.is_sparse() && sparse_counters_idle_periods > 0 &&
+                average_speed_counters.get_block(block_index) != nullptr &&
+                average_speed_counters.increment_idle_periods(block_index) >= sparse_counters_idle_periods) {
+                results.idle_blocks.push_back({ task.subnet, block_index });
+            }
+
+            continue;
+        }
+
+        if (average_speed_counters.is_sparse()) {
+            average_speed_counters.reset_idle_periods(block_index);
+        }
+
+        // Averages restored from checkpoint may have no traffic counters yet
+        subnet_counter_t* counters_block      = counters.get_or_allocate_block(block_index);
+        subnet_counter_t* speed_block         = speed_counters.get_or_allocate_block(block_index);
+        subnet_counter_t* average_speed_block = average_speed_counters.get_or_allocate_block(block_index);
+
+        if (counters_block == nullptr || speed_block == nullptr || average_speed_block == nullptr) {
+            logger << log4cpp::Priority::ERROR << "Can't allocate memory for counters";
+            continue;
+        }
 
-    for (map_of_vector_counters_t::iterator itr = SubnetVectorMap.begin(); itr != SubnetVectorMap.end(); ++itr) {
-        for (vector_of_counters::iterator vector_itr = itr->second.begin(); vector_itr != itr->second.end(); ++vector_itr) {
-            int current_index = vector_itr - itr->second.begin();
+        // We have no flow counters for hosts without traffic in sparse mode
+        conntrack_main_struct_t* flow_counters_block = flow_counters.get_block(block_index);
+
+        bool block_has_non_zero_averages = false;
+
+        for (size_t index_in_block = 0; index_in_block < counters.get_block_length(block_index); index_in_block++) {
+            subnet_counter_t* current_average_speed_element = &average_speed_block[index_in_block];
+
+            // Idle host in active block has nothing to recalculate
+            if (counters_block[index_in_block].is_zero() && current_average_speed_element->is_zero() &&
+                speed_block[index_in_block].is_zero()) {
+                continue;
+            }
+
+            results.recalculated_hosts++;
+
+            size_t current_index = block_index * vector_of_counters::block_size + index_in_block;
 
             // New element
             subnet_counter_t new_speed_element;
 
-            // convert to host order for math operations
-            uint32_t subnet_ip                     = ntohl(itr->first.subnet_address);
             uint32_t client_ip_in_host_bytes_order = subnet_ip + current_index;
 
             // covnert to our standard network byte order
             uint32_t client_ip = htonl(client_ip_in_host_bytes_order);
 
             // Calculate speed for IP or whole subnet
-            build_speed_counters_from_packet_counters(new_speed_element, &*vector_itr, speed_calc_period);
+            build_speed_counters_from_packet_counters(new_speed_element, &counters_block[index_in_block], speed_calc_period);
 
-            conntrack_main_struct_t* flow_counter_ptr = &SubnetVectorMapFlow[itr->first][current_index];
+            conntrack_main_struct_t* flow_counter_ptr =
+                flow_counters_block != nullptr ? &flow_counters_block[index_in_block] : nullptr;
 
-            if (enable_connection_tracking) {
+            if (enable_connection_tracking && flow_counter_ptr != nullptr) {
                 // todo: optimize this operations!
                 // it's really bad and SLOW CODE
                 uint64_t total_out_flows =
@@ -2243,8 +2971,8 @@ void recalculate_speed() {
                 new_speed_element.in_flows  = uint64_t((double)total_in_flows / speed_calc_period);
 
                 // Increment global counter
-                outgoing_total_flows += new_speed_element.out_flows;
-                incoming_total_flows += new_speed_element.in_flows;
+                results.outgoing_total_flows += new_speed_element.out_flows;
+                results.incoming_total_flows += new_speed_element.in_flows;
             } else {
                 new_speed_element.out_flows = 0;
                 new_speed_element.in_flows  = 0;
@@ -2256,54 +2984,257 @@ void recalculate_speed() {
             double exp_power = -speed_calc_period / average_calculation_amount;
             double exp_value = exp(exp_power);
 
-            subnet_counter_t* current_average_speed_element = &SubnetVectorMapSpeedAverage[itr->first][current_index];
-
             // Calculate average speed from per-second speed
-            build_average_speed_counters_from_speed_counters(current_average_speed_element, new_speed_element, exp_value, exp_power);
+            build_average_speed_counters_from_speed_counters(current_average_speed_element, new_speed_element,
+                                                             exp_value, exp_power);
 
             if (enable_connection_tracking) {
-                current_average_speed_element->out_flows =
-                    uint64_t(new_speed_element.out_flows + exp_value * ((double)current_average_speed_element->out_flows -
-                                                                        (double)new_speed_element.out_flows));
+                current_average_speed_element->out_flows = uint64_t(
+                    new_speed_element.out_flows +
+                    exp_value * ((double)current_average_speed_element->out_flows - (double)new_speed_element.out_flows));
 
-                current_average_speed_element->in_flows =
-                    uint64_t(new_speed_element.in_flows + exp_value * ((double)current_average_speed_element->in_flows -
-                                                                       (double)new_speed_element.in_flows));
+                current_average_speed_element->in_flows = uint64_t(
+                    new_speed_element.in_flows +
+                    exp_value * ((double)current_average_speed_element->in_flows - (double)new_speed_element.in_flows));
             }
 
-            /* Moving average recalculation end */
-            std::string host_group_name;
-            ban_settings_t current_ban_settings = get_ban_settings_for_this_subnet(itr->first, host_group_name);
+            // Without this averages of idle hosts decay to zero in hundreds of periods and keep their blocks active
+            if (new_speed_element.is_zero() && current_average_speed_element->total.in_packets < average_speed_floor_pps &&
+                current_average_speed_element->total.out_packets < average_speed_floor_pps) {
+                current_average_speed_element->zeroify();
+            }
 
+            /* Moving average recalculation end */
             attack_detection_threshold_type_t attack_detection_source;
             attack_detection_direction_type_t attack_detection_direction;
 
 
-            if (we_should_ban_this_entity(current_average_speed_element, current_ban_settings, attack_detection_source,
-                                          attack_detection_direction)) {
-                logger << log4cpp::Priority::DEBUG << "We have found host group for this host as: " << host_group_name;
+            if (we_should_ban_this_entity(current_average_speed_element, task.ban_settings,
+                                          attack_detection_source, attack_detection_direction)) {
+                logger << log4cpp::Priority::DEBUG << "We have found host group for this host as: " << task.host_group_name;
 
-                std::string flow_attack_details = "";
+                ipv4_ban_candidate_t ban_candidate;
+                ban_candidate.client_ip             = client_ip;
+                ban_candidate.average_speed_element = *current_average_speed_element;
+                ban_candidate.customer_network      = task.subnet;
 
-                if (enable_connection_tracking) {
-                    flow_attack_details = print_flow_tracking_for_ip(*flow_counter_ptr, convert_ip_as_uint_to_string(client_ip));
+                if (enable_connection_tracking && flow_counter_ptr != nullptr) {
+                    ban_candidate.flow_attack_details =
+                        print_flow_tracking_for_ip(*flow_counter_ptr, convert_ip_as_uint_to_string(client_ip));
                 }
 
-                // TODO: we should pass type of ddos ban source (pps, flowd, bandwidth)!
-                execute_ip_ban(client_ip, *current_average_speed_element, flow_attack_details, itr->first);
+                results.ban_candidates.push_back(ban_candidate);
+            }
+
+            build_windowed_speed_counters(&speed_block[index_in_block], new_speed_element, speed_calc_period);
+
+            // Windowed speed decays to zero in same way as averages
+            if (!current_average_speed_element->is_zero() || !speed_block[index_in_block].is_zero()) {
+                block_has_non_zero_averages = true;
             }
 
-            SubnetVectorMapSpeed[itr->first][current_index] = new_speed_element;
+            // Nobody increments this generation until next flip and we prepare it for reuse
+            counters_block[index_in_block] = zero_map_element;
+        }
+
+        // We will recalculate this block until averages decay to zero
+        average_speed_counters.set_block_activity(block_index, block_has_non_zero_averages);
+    }
+}
+
+// Detaches idle sparse blocks from all counters of network and frees blocks retired earlier
+// We call it with shared lock for networks maps after all recalculation workers finished
+void retire_idle_ipv4_blocks(const std::vector<ipv4_recalculation_results_t>& ipv4_recalculation_results,
+                             unsigned int inactive_generation) {
+    for (const auto& results : ipv4_recalculation_results) {
+        for (const auto& idle_block : results.idle_blocks) {
+            auto active_counters_itr = SubnetVectorMap[inactive_generation ^ 1].find(idle_block.subnet);
+
+            // Traffic came to block of active generation after we checked it
+            if (active_counters_itr == SubnetVectorMap[inactive_generation ^ 1].end() ||
+                active_counters_itr->second.is_block_active(idle_block.block_index)) {
+                continue;
+            }
+
+            // Packet processing threads do not use inactive generation and we could lose only packets which
+            // hit block of active generation in same time, it's fine for block idle for so long time
+            active_counters_itr->second.retire_block(idle_block.block_index);
+
+            // We use find() because we hold only shared lock and must not insert elements
+            auto retire_block_in_map = [&](auto& counters_map) {
+                auto itr = counters_map.find(idle_block.subnet);
 
-            *vector_itr = zero_map_element;
+                if (itr != counters_map.end()) {
+                    itr->second.retire_block(idle_block.block_index);
+                }
+            };
+
+            retire_block_in_map(SubnetVectorMap[inactive_generation]);
+            retire_block_in_map(SubnetVectorMapSpeed);
+            retire_block_in_map(SubnetVectorMapSpeedAverage);
+            retire_block_in_map(SubnetVectorMapFlow);
         }
     }
 
+    if (!sparse_counters) {
+        return;
+    }
+
+    auto now = std::chrono::steady_clock::now();
+
+    for (auto& counters : SubnetVectorMap[0]) {
+        counters.second.free_retired_blocks(now);
+    }
+
+    for (auto& counters : SubnetVectorMap[1]) {
+        counters.second.free_retired_blocks(now);
+    }
+
+    for (auto& counters : SubnetVectorMapSpeed) {
+        counters.second.free_retired_blocks(now);
+    }
+
+    for (auto& counters : SubnetVectorMapSpeedAverage) {
+        counters.second.free_retired_blocks(now);
+    }
+
+    for (auto& counters : SubnetVectorMapFlow) {
+        counters.second.free_retired_blocks(now);
+    }
+}
+
+/* Calculate speed for all connnections */
+void recalculate_speed() {
+    // logger<< log4cpp::Priority::INFO<<"We run recalculate_speed";
+    double speed_calc_period = recalculate_speed_timeout;
+
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+    // Calculate duration of our sleep duration as it may be altered by OS behaviour (i.e. process scheduler)
+    // And if it differs from reference value then we need to adjust it and use new value
+    std::chrono::duration<double> diff = start_time - last_call_of_traffic_recalculation;
+
+    double time_difference = diff.count();
+
+    // Handle case of time moving backwards
+    if (time_difference < 0) {
+        // It must not happen as our time source is explicitly monotonic: https://en.cppreference.com/w/cpp/chrono/steady_clock
+        logger << log4cpp::Priority::ERROR << "Negative delay for traffic calculation " << time_difference;
+        logger << log4cpp::Priority::ERROR << "This must not happen, please report this issue to maintainers. Skipped iteration";
+
+        return;
+    }
+
+    // logger << log4cpp::Priority::INFO << "Delay in seconds " << time_difference;
+
+    // Zero or positive delay
+    // Scheduler may wake us bit earlier than expected and we skip only runs which are much earlier
+    if (time_difference < recalculate_speed_timeout / 2) {
+        // It could occur on toolkit start or in some weird cases of Linux scheduler
+        // I really saw cases when sleep executed in zero seconds:
+        // [WARN] Sleep time expected: 1. Sleep time experienced: 0
+        // But we have handlers for such case and should not bother client about with it
+        // And we are using DEBUG level here
+        logger << log4cpp::Priority::DEBUG
+               << "We skip one iteration of speed_calc because it runs so early! That's "
+                  "really impossible! Please ask support.";
+        logger << log4cpp::Priority::DEBUG << "Sleep time expected: " << recalculate_speed_timeout
+               << ". Sleep time experienced: " << time_difference;
+        return;
+    }
+
+    // Counters were collected from previous run and we use real time between runs because for short
+    // periods even small lag changes speed a lot
+    speed_calc_period = time_difference;
+
+    recalculate_speed_for_period(speed_calc_period);
+
+    // Set time of previous startup, counters for next run are collected from this time
+    last_call_of_traffic_recalculation = start_time;
+}
+
+// Calculates speed from counters collected during speed_calc_period seconds
+void recalculate_speed_for_period(double speed_calc_period) {
+    stage_latency_scope_t stage_latency_scope(latency_stage_t::speed_recalculation);
+
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+    uint64_t incoming_total_flows = 0;
+    uint64_t outgoing_total_flows = 0;
+
+    ipv4_network_counters.recalculate_speed(speed_calc_period, (double)average_calculation_amount, nullptr);
+
+    // Reload could not add or remove networks while we iterate over them
+    std::shared_lock<std::shared_mutex> subnet_vector_maps_lock(subnet_vector_maps_mutex);
+
+    // Packet processing threads switch to another generation and we read this one without races
+    unsigned int inactive_generation = ipv4_host_counters_epoch.flip();
+
+    std::vector<ipv4_recalculation_task_t> ipv4_recalculation_tasks;
+
+    for (map_of_vector_counters_t::iterator itr = SubnetVectorMap[inactive_generation].begin();
+         itr != SubnetVectorMap[inactive_generation].end(); ++itr) {
+        auto speed_itr         = SubnetVectorMapSpeed.find(itr->first);
+        auto average_speed_itr = SubnetVectorMapSpeedAverage.find(itr->first);
+        auto flow_itr          = SubnetVectorMapFlow.find(itr->first);
+
+        if (speed_itr == SubnetVectorMapSpeed.end() || average_speed_itr == SubnetVectorMapSpeedAverage.end() ||
+            flow_itr == SubnetVectorMapFlow.end()) {
+            logger << log4cpp::Priority::ERROR << "We have no all counters for subnet " << convert_subnet_to_string(itr->first);
+            continue;
+        }
+
+        ipv4_recalculation_task_t task;
+        task.subnet                 = itr->first;
+        task.counters               = &itr->second;
+        task.speed_counters         = &speed_itr->second;
+        task.average_speed_counters = &average_speed_itr->second;
+        task.flow_counters          = &flow_itr->second;
+        task.ban_settings           = get_ban_settings_for_this_subnet(itr->first, task.host_group_name);
+
+        for (size_t first_block = 0; first_block < itr->second.get_number_of_blocks();
+             first_block += ipv4_recalculation_blocks_per_task) {
+            task.first_block = first_block;
+            task.last_block  = std::min(first_block + ipv4_recalculation_blocks_per_task, itr->second.get_number_of_blocks());
+
+            ipv4_recalculation_tasks.push_back(task);
+        }
+    }
+
+    std::vector<ipv4_recalculation_results_t> ipv4_recalculation_results(speed_calculation_executor.get_number_of_workers());
+
+    speed_calculation_executor.run(ipv4_recalculation_tasks.size(), [&](size_t task_index, size_t worker_index) {
+        recalculate_speed_for_ipv4_task(ipv4_recalculation_tasks[task_index], speed_calc_period,
+                                        ipv4_recalculation_results[worker_index]);
+    });
+
+    // We ban hosts from single thread
+    uint64_t recalculated_hosts_in_this_run = 0;
+
+    for (const auto& results : ipv4_recalculation_results) {
+        incoming_total_flows += results.incoming_total_flows;
+        outgoing_total_flows += results.outgoing_total_flows;
+        recalculated_hosts_in_this_run += results.recalculated_hosts;
+
+        for (const auto& ban_candidate : results.ban_candidates) {
+            // TODO: we should pass type of ddos ban source (pps, flowd, bandwidth)!
+            execute_ip_ban(ban_candidate.client_ip, ban_candidate.average_speed_element,
+                           ban_candidate.flow_attack_details, ban_candidate.customer_network);
+        }
+    }
+
+    retire_idle_ipv4_blocks(ipv4_recalculation_results, inactive_generation);
+
+    subnet_vector_maps_lock.unlock();
+
+    recalculated_hosts = recalculated_hosts_in_this_run;
+
     // Calculate IPv6 per network traffic
     ipv6_subnet_counters.recalculate_speed(speed_calc_period, (double)average_calculation_amount, speed_callback_subnet_ipv6);
 
     // Recalculate traffic for hosts
-    ipv6_host_counters.recalculate_speed(speed_calc_period, (double)average_calculation_amount, speed_callback_ipv6);
+    ipv6_host_counters.recalculate_speed_parallel(speed_calculation_executor, speed_calc_period,
+                                                  (double)average_calculation_amount, speed_callback_ipv6);
 
 
     // Calculate global flow speed
@@ -2312,20 +3243,35 @@ void recalculate_speed() {
 
     if (enable_connection_tracking) {
         // Clean Flow Counter
+        std::shared_lock<std::shared_mutex> subnet_vector_maps_lock(subnet_vector_maps_mutex);
         std::lock_guard<std::mutex> lock_guard(flow_counter);
         zeroify_all_flow_counters();
     }
 
-    total_unparsed_packets_speed = uint64_t((double)total_unparsed_packets / (double)speed_calc_period);
-    total_unparsed_packets       = 0;
+    double speed_window_exp_value = get_speed_window_exp_value(speed_calc_period);
+
+    // Unparsed packets since previous recalculation
+    static uint64_t previous_total_unparsed_packets = 0;
+
+    uint64_t current_total_unparsed_packets = total_unparsed_packets.get();
+
+    total_unparsed_packets_speed =
+        uint64_t((double)(current_total_unparsed_packets - previous_total_unparsed_packets) / (double)speed_calc_period);
+    previous_total_unparsed_packets = current_total_unparsed_packets;
+
+    // Sum traffic from all capture threads
+    total_traffic_counters_ipv4.get_increments(total_counters_ipv4.total_counters);
+    total_traffic_counters_ipv6.get_increments(total_counters_ipv6.total_counters);
 
     // Calculate IPv4 total traffic speed
     for (unsigned int index = 0; index < 4; index++) {
         total_counters_ipv4.total_speed_counters[index].bytes =
-            uint64_t((double)total_counters_ipv4.total_counters[index].bytes / (double)speed_calc_period);
+            get_windowed_speed(total_counters_ipv4.total_speed_counters[index].bytes,
+                               (double)total_counters_ipv4.total_counters[index].bytes / (double)speed_calc_period, speed_window_exp_value);
 
         total_counters_ipv4.total_speed_counters[index].packets =
-            uint64_t((double)total_counters_ipv4.total_counters[index].packets / (double)speed_calc_period);
+            get_windowed_speed(total_counters_ipv4.total_speed_counters[index].packets,
+                               (double)total_counters_ipv4.total_counters[index].packets / (double)speed_calc_period, speed_window_exp_value);
 
         double exp_power = -speed_calc_period / average_calculation_amount;
         double exp_value = exp(exp_power);
@@ -2339,18 +3285,16 @@ void recalculate_speed() {
             uint64_t(total_counters_ipv4.total_speed_counters[index].packets +
                      exp_value * ((double)total_counters_ipv4.total_speed_average_counters[index].packets -
                                   (double)total_counters_ipv4.total_speed_counters[index].packets));
-
-        // nullify data counters after speed calculation
-        total_counters_ipv4.total_counters[index].bytes   = 0;
-        total_counters_ipv4.total_counters[index].packets = 0;
     }
 
     // Do same for IPv6
     for (unsigned int index = 0; index < 4; index++) {
         total_counters_ipv6.total_speed_counters[index].bytes =
-            uint64_t((double)total_counters_ipv6.total_counters[index].bytes / (double)speed_calc_period);
+            get_windowed_speed(total_counters_ipv6.total_speed_counters[index].bytes,
+                               (double)total_counters_ipv6.total_counters[index].bytes / (double)speed_calc_period, speed_window_exp_value);
         total_counters_ipv6.total_speed_counters[index].packets =
-            uint64_t((double)total_counters_ipv6.total_counters[index].packets / (double)speed_calc_period);
+            get_windowed_speed(total_counters_ipv6.total_speed_counters[index].packets,
+                               (double)total_counters_ipv6.total_counters[index].packets / (double)speed_calc_period, speed_window_exp_value);
 
         double exp_power = -speed_calc_period / average_calculation_amount;
         double exp_value = exp(exp_power);
@@ -2364,14 +3308,8 @@ void recalculate_speed() {
             uint64_t(total_counters_ipv6.total_speed_counters[index].packets +
                      exp_value * ((double)total_counters_ipv6.total_speed_average_counters[index].packets -
                                   (double)total_counters_ipv6.total_speed_counters[index].packets));
-
-        // nullify data counters after speed calculation
-        total_counters_ipv6.total_counters[index].zeroify();
     }
 
-    // Set time of previous startup
-    last_call_of_traffic_recalculation = std::chrono::steady_clock::now();
-
     // Calculate time we spent to calculate speed in this function
     std::chrono::duration<double> speed_calculation_diff = std::chrono::steady_clock::now() - start_time;
 
@@ -2385,12 +3323,13 @@ void recalculate_speed() {
     speed_calculation_time.tv_usec = suseconds_t(fractional * 1000000);
 
     // Report cases when we calculate speed too slow
-    if (speed_calculation_time.tv_sec > 0) {
-        logger << log4cpp::Priority::ERROR << "ALERT. Toolkit working incorrectly. We should calculate speed counters in <1 second";
+    if (speed_calculation_diff.count() > recalculate_speed_timeout) {
+        logger << log4cpp::Priority::ERROR << "ALERT. Toolkit working incorrectly. We should calculate speed counters in less than "
+               << recalculate_speed_timeout << " seconds";
         logger << log4cpp::Priority::ERROR << "Traffic was calculated in: " << speed_calculation_time.tv_sec << " sec "
                << speed_calculation_time.tv_usec << " microseconds";
 
-        logger << log4cpp::Priority::ERROR << "Please use CPU with higher frequency and better single core performance or reduce number of monitored hosts";
+        logger << log4cpp::Priority::ERROR << "Please increase speed_calculation_threads, use CPU with higher frequency or reduce number of monitored hosts";
     }
 }
 
@@ -2401,7 +3340,7 @@ std::string draw_table_ipv6(direction_t sort_direction, bool do_redis_update, so
 
     // TODO: implement method for such tasks
     {
-        std::lock_guard<std::mutex> lock_guard(ipv6_host_counters.counter_map_mutex);
+        std::lock_guard<std::mutex> lock_guard(ipv6_host_counters.speed_maps_mutex);
         size_of_ipv6_counters_map = ipv6_host_counters.average_speed_map.size();
     }
 
@@ -2501,27 +3440,31 @@ std::string draw_table_ipv4(direction_t data_direction, bool do_redis_update, so
 
     subnet_counter_t zero_map_element{};
 
+    // We could not iterate over networks when reload adds or removes them
+    std::shared_lock<std::shared_mutex> subnet_vector_maps_lock(subnet_vector_maps_mutex);
+
     unsigned int count_of_zero_speed_packets = 0;
     for (map_of_vector_counters_t::iterator itr = current_speed_map->begin(); itr != current_speed_map->end(); ++itr) {
-        for (vector_of_counters::iterator vector_itr = itr->second.begin(); vector_itr != itr->second.end(); ++vector_itr) {
-            int current_index = vector_itr - itr->second.begin();
+        // convert to host order for math operations
+        uint32_t subnet_ip = ntohl(itr->first.subnet_address);
 
-            // convert to host order for math operations
-            uint32_t subnet_ip                     = ntohl(itr->first.subnet_address);
+        itr->second.for_each_allocated_element([&](size_t current_index, subnet_counter_t& current_element) {
             uint32_t client_ip_in_host_bytes_order = subnet_ip + current_index;
 
             // covnert to our standard network byte order
             uint32_t client_ip = htonl(client_ip_in_host_bytes_order);
 
             // Do not add zero speed packets to sort list
-            if (memcmp((void*)&zero_map_element, &*vector_itr, sizeof(subnet_counter_t)) != 0) {
-                vector_for_sort.push_back(std::make_pair(client_ip, *vector_itr));
+            if (memcmp((void*)&zero_map_element, &current_element, sizeof(subnet_counter_t)) != 0) {
+                vector_for_sort.push_back(std::make_pair(client_ip, current_element));
             } else {
                 count_of_zero_speed_packets++;
             }
-        }
+        });
     }
 
+    subnet_vector_maps_lock.unlock();
+
     // Sort only first X elements in this vector
     unsigned int shift_for_sort = max_ips_in_list;
 
@@ -2570,120 +3513,429 @@ std::string draw_table_ipv4(direction_t data_direction, bool do_redis_update, so
             flows = current_speed_element->out_flows;
         }
 
-        uint64_t mbps = convert_speed_to_mbps(bps);
+        uint64_t mbps = convert_speed_to_mbps(bps);
+
+        std::string is_banned = ban_list.is_blackholed(client_ip) ? " *banned* " : "";
+
+        // We use setw for alignment
+        output_buffer << client_ip_as_string << "\t\t";
+
+        output_buffer << std::setw(6) << pps << " pps ";
+        output_buffer << std::setw(6) << mbps << " mbps ";
+        output_buffer << std::setw(6) << flows << " flows ";
+
+        output_buffer << is_banned << std::endl;
+
+        element_number++;
+    }
+
+    return output_buffer.str();
+}
+
+void print_screen_contents_into_file(std::string screen_data_stats_param, std::string file_path) {
+    std::ofstream screen_data_file;
+    screen_data_file.open(file_path.c_str(), std::ios::trunc);
+
+    if (screen_data_file.is_open()) {
+        // Set 660 permissions to file for security reasons
+        chmod(cli_stats_file_path.c_str(), S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH);
+
+        screen_data_file << screen_data_stats_param;
+        screen_data_file.close();
+    } else {
+        logger << log4cpp::Priority::ERROR << "Can't print program screen into file: " << file_path;
+    }
+}
+
+void zeroify_all_flow_counters() {
+    // On creating it initilizes by zeros
+    conntrack_main_struct_t zero_conntrack_main_struct;
+
+    // Freeing of maps takes lots of time and we split it between workers by blocks
+    std::vector<std::pair<vector_of_flow_counters_t*, size_t>> flow_counters_blocks;
+
+    for (map_of_vector_counters_for_flow_t::iterator itr = SubnetVectorMapFlow.begin(); itr != SubnetVectorMapFlow.end(); ++itr) {
+        for (size_t block_index = 0; block_index < itr->second.get_number_of_blocks(); block_index++) {
+            if (itr->second.get_block(block_index) != nullptr) {
+                flow_counters_blocks.push_back(std::make_pair(&itr->second, block_index));
+            }
+        }
+    }
+
+    speed_calculation_executor.run(flow_counters_blocks.size(), [&](size_t task_index, size_t) {
+        vector_of_flow_counters_t* flow_counters = flow_counters_blocks[task_index].first;
+        size_t block_index                       = flow_counters_blocks[task_index].second;
+
+        conntrack_main_struct_t* block = flow_counters->get_block(block_index);
+
+        for (size_t index_in_block = 0; index_in_block < flow_counters->get_block_length(block_index); index_in_block++) {
+            // TODO: rewrite this monkey code
+            block[index_in_block].in_tcp.clear();
+            block[index_in_block].in_udp.clear();
+            block[index_in_block].in_icmp.clear();
+            block[index_in_block].in_other.clear();
+
+            block[index_in_block].out_tcp.clear();
+            block[index_in_block].out_udp.clear();
+            block[index_in_block].out_icmp.clear();
+            block[index_in_block].out_other.clear();
+        }
+    });
+}
+
+#ifdef KAFKA
+extern unsigned int kafka_traffic_export_ring_size;
+extern unsigned int kafka_traffic_export_records_per_message;
+extern unsigned int kafka_traffic_export_linger_milliseconds;
+
+class kafka_traffic_export_ring_t {
+    public:
+    explicit kafka_traffic_export_ring_t(size_t capacity) : records(capacity) {
+    }
+
+    compact_packet_record_queue_t records;
+
+    // Set when capture thread exits, we remove ring after we drained it
+    std::atomic<bool> producer_finished{ false };
+};
+
+// Marks ring of capture thread as finished when thread exits
+class kafka_traffic_export_ring_owner_t {
+    public:
+    ~kafka_traffic_export_ring_owner_t() {
+        if (ring) {
+            ring->producer_finished.store(true, std::memory_order_release);
+        }
+    }
+
+    std::shared_ptr<kafka_traffic_export_ring_t> ring;
+};
+
+// Each capture thread has own ring and Kafka producer thread drains all of them
+std::mutex kafka_traffic_export_rings_mutex;
+std::vector<std::shared_ptr<kafka_traffic_export_ring_t>> kafka_traffic_export_rings;
+
+std::string kafka_traffic_export_records_desc = "Number of traffic records exported to Kafka";
+std::atomic<uint64_t> kafka_traffic_export_records{ 0 };
+
+std::string kafka_traffic_export_messages_desc = "Number of Kafka messages with traffic records";
+std::atomic<uint64_t> kafka_traffic_export_messages{ 0 };
+
+std::string kafka_traffic_export_dropped_desc = "Number of traffic records dropped because export ring was full";
+std::atomic<uint64_t> kafka_traffic_export_dropped{ 0 };
+
+std::string kafka_traffic_export_errors_desc = "Number of Kafka messages we failed to produce";
+std::atomic<uint64_t> kafka_traffic_export_errors{ 0 };
+
+// Returns ring for current thread, we create it on first call
+kafka_traffic_export_ring_t* get_kafka_traffic_export_ring() {
+    thread_local kafka_traffic_export_ring_owner_t kafka_traffic_export_ring_owner;
+
+    if (!kafka_traffic_export_ring_owner.ring) {
+        auto new_ring = std::make_shared<kafka_traffic_export_ring_t>(kafka_traffic_export_ring_size);
+
+        std::lock_guard<std::mutex> lock_guard(kafka_traffic_export_rings_mutex);
+        kafka_traffic_export_rings.push_back(new_ring);
+
+        kafka_traffic_export_ring_owner.ring = new_ring;
+    }
+
+    return kafka_traffic_export_ring_owner.ring.get();
+}
+
+// Queues packet for Kafka export, it never blocks capture threads
+void export_to_kafka(const simple_packet_t& current_packet) {
+    compact_packet_record_t record;
+    convert_simple_packet_to_compact_record(current_packet, record);
+
+    if (!get_kafka_traffic_export_ring()->records.push(record)) {
+        kafka_traffic_export_dropped++;
+    }
+}
+
+// Adds packet to batch in configured format
+bool add_packet_to_kafka_batch(const simple_packet_t& current_packet, std::string& batch) {
+    extern kafka_traffic_export_format_t kafka_traffic_export_format;
+
+    if (kafka_traffic_export_format == kafka_traffic_export_format_t::JSON) {
+        nlohmann::json json_packet;
+
+        if (!serialize_simple_packet_to_json(current_packet, json_packet)) {
+            return false;
+        }
+
+        // We use one JSON document per line
+        batch += json_packet.dump();
+        batch += "\n";
+    } else if (kafka_traffic_export_format == kafka_traffic_export_format_t::Protobuf) {
+        TrafficData traffic_data;
+
+        // Encode Packet in protobuf
+        write_simple_packet_to_protobuf(current_packet, traffic_data);
+
+        // Each record is prefixed by varint length
+        google::protobuf::io::StringOutputStream string_output_stream(&batch);
+        google::protobuf::io::CodedOutputStream coded_output_stream(&string_output_stream);
+
+        coded_output_stream.WriteVarint32(traffic_data.ByteSizeLong());
+
+        if (!traffic_data.SerializeToCodedStream(&coded_output_stream)) {
+            // Encoding error happened
+            return false;
+        }
+    } else {
+        // Unknown format
+        return false;
+    }
+
+    return true;
+}
+
+// Sends batch as single Kafka message
+void produce_kafka_batch(std::string& batch, unsigned int& records_in_batch) {
+    extern std::string kafka_traffic_export_topic;
+    extern cppkafka::Producer* kafka_traffic_export_producer;
+
+    if (records_in_batch == 0) {
+        return;
+    }
+
+    try {
+        kafka_traffic_export_producer->produce(
+            cppkafka::MessageBuilder(kafka_traffic_export_topic).partition(RD_KAFKA_PARTITION_UA).payload(batch));
+
+        kafka_traffic_export_messages++;
+        kafka_traffic_export_records += records_in_batch;
+    } catch (...) {
+        // We do not log it as it will flood log files
+        kafka_traffic_export_errors++;
+    }
+
+    batch.clear();
+    records_in_batch = 0;
+}
+
+// Drains export rings and sends records to Kafka in batches
+void kafka_traffic_export_thread() {
+    extern cppkafka::Producer* kafka_traffic_export_producer;
+
+    std::string batch;
+    unsigned int records_in_batch = 0;
+
+    auto batch_start_time = std::chrono::steady_clock::now();
+
+    std::vector<std::shared_ptr<kafka_traffic_export_ring_t>> rings;
+    std::vector<std::shared_ptr<kafka_traffic_export_ring_t>> finished_rings;
+
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock_guard(kafka_traffic_export_rings_mutex);
+            rings = kafka_traffic_export_rings;
+        }
+
+        bool got_records = false;
+        compact_packet_record_t current_record;
+        simple_packet_t current_packet;
+
+        for (auto& ring : rings) {
+            // We check it before draining as all records were pushed before thread set this flag
+            bool producer_finished = ring->producer_finished.load(std::memory_order_acquire);
+
+            // We limit number of records from single ring to keep other threads served
+            for (unsigned int i = 0; i < kafka_traffic_export_records_per_message && ring->records.pop(current_record); i++) {
+                got_records = true;
+
+                if (records_in_batch == 0) {
+                    batch_start_time = std::chrono::steady_clock::now();
+                }
+
+                convert_compact_record_to_simple_packet(current_record, current_packet);
+
+                if (add_packet_to_kafka_batch(current_packet, batch)) {
+                    records_in_batch++;
+                }
+
+                if (records_in_batch >= kafka_traffic_export_records_per_message) {
+                    produce_kafka_batch(batch, records_in_batch);
+                }
+            }
+
+            if (producer_finished && ring->records.read_available() == 0) {
+                finished_rings.push_back(ring);
+            }
+        }
+
+        // Release rings of exited capture threads
+        if (!finished_rings.empty()) {
+            std::lock_guard<std::mutex> lock_guard(kafka_traffic_export_rings_mutex);
 
-        std::string is_banned = ban_list.count(client_ip) > 0 ? " *banned* " : "";
+            for (auto& finished_ring : finished_rings) {
+                kafka_traffic_export_rings.erase(std::remove(kafka_traffic_export_rings.begin(),
+                                                             kafka_traffic_export_rings.end(), finished_ring),
+                                                 kafka_traffic_export_rings.end());
+            }
 
-        // We use setw for alignment
-        output_buffer << client_ip_as_string << "\t\t";
+            finished_rings.clear();
+        }
 
-        output_buffer << std::setw(6) << pps << " pps ";
-        output_buffer << std::setw(6) << mbps << " mbps ";
-        output_buffer << std::setw(6) << flows << " flows ";
+        if (records_in_batch > 0 && std::chrono::steady_clock::now() - batch_start_time >=
+                                        std::chrono::milliseconds(kafka_traffic_export_linger_milliseconds)) {
+            produce_kafka_batch(batch, records_in_batch);
+        }
 
-        output_buffer << is_banned << std::endl;
+        try {
+            // Serve delivery reports without blocking
+            kafka_traffic_export_producer->poll(std::chrono::milliseconds(0));
+        } catch (...) {
+        }
 
-        element_number++;
+        if (!got_records) {
+            // It's interruption point for boost threads
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        }
     }
+}
 
-    return output_buffer.str();
+std::vector<system_counter_t> get_kafka_traffic_export_stats() {
+    std::vector<system_counter_t> system_counter;
+
+    system_counter.push_back(system_counter_t("kafka_traffic_export_records", kafka_traffic_export_records.load(),
+                                              metric_type_t::counter, kafka_traffic_export_records_desc));
+    system_counter.push_back(system_counter_t("kafka_traffic_export_messages", kafka_traffic_export_messages.load(),
+                                              metric_type_t::counter, kafka_traffic_export_messages_desc));
+    system_counter.push_back(system_counter_t("kafka_traffic_export_dropped", kafka_traffic_export_dropped.load(),
+                                              metric_type_t::counter, kafka_traffic_export_dropped_desc));
+    system_counter.push_back(system_counter_t("kafka_traffic_export_errors", kafka_traffic_export_errors.load(),
+                                              metric_type_t::counter, kafka_traffic_export_errors_desc));
+
+    return system_counter;
 }
+#endif
 
-void print_screen_contents_into_file(std::string screen_data_stats_param, std::string file_path) {
-    std::ofstream screen_data_file;
-    screen_data_file.open(file_path.c_str(), std::ios::trunc);
+// Sets time of packet when capture plugin could not do it, we keep time from Netflow and IPFIX devices in ts
+void set_packet_arrival_time(simple_packet_t& current_packet) {
+    if (current_packet.arrival_time != 0) {
+        return;
+    }
 
-    if (screen_data_file.is_open()) {
-        // Set 660 permissions to file for security reasons
-        chmod(cli_stats_file_path.c_str(), S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH);
+    struct timeval current_time;
+    get_fast_time(current_time);
 
-        screen_data_file << screen_data_stats_param;
-        screen_data_file.close();
-    } else {
-        logger << log4cpp::Priority::ERROR << "Can't print program screen into file: " << file_path;
+    current_packet.arrival_time = current_time.tv_sec;
+
+    if (current_packet.ts.tv_sec == 0) {
+        current_packet.ts = current_time;
     }
 }
 
-void zeroify_all_flow_counters() {
-    // On creating it initilizes by zeros
-    conntrack_main_struct_t zero_conntrack_main_struct;
+// Capture plugins call it instead of process_packet in pipeline mode
+void push_packet_to_pipeline(simple_packet_t& current_packet) {
+    extern packet_pipeline_t packet_pipeline;
 
-    // Iterate over map
-    for (map_of_vector_counters_for_flow_t::iterator itr = SubnetVectorMapFlow.begin(); itr != SubnetVectorMapFlow.end(); ++itr) {
-        // Iterate over vector
-        for (vector_of_flow_counters_t::iterator vector_iterator = itr->second.begin();
-             vector_iterator != itr->second.end(); ++vector_iterator) {
-            // TODO: rewrite this monkey code
-            vector_iterator->in_tcp.clear();
-            vector_iterator->in_udp.clear();
-            vector_iterator->in_icmp.clear();
-            vector_iterator->in_other.clear();
+    // Packet may wait in ring for some time and we use time when we received it
+    set_packet_arrival_time(current_packet);
 
-            vector_iterator->out_tcp.clear();
-            vector_iterator->out_udp.clear();
-            vector_iterator->out_icmp.clear();
-            vector_iterator->out_other.clear();
-        }
+    // Pipeline selects processing thread by our host and needs direction for it
+    const networks_lookup_t* networks_lookup = our_networks_lookup.get();
+
+    if (current_packet.ip_protocol_version == 4) {
+        subnet_cidr_mask_t current_subnet;
+
+        current_packet.packet_direction =
+            get_packet_direction(networks_lookup->lookup_tree_ipv4, current_packet.src_ip, current_packet.dst_ip, current_subnet);
+    } else if (current_packet.ip_protocol_version == 6) {
+        subnet_ipv6_cidr_mask_t current_subnet;
+
+        current_packet.packet_direction = get_packet_direction_ipv6(networks_lookup->lookup_tree_ipv6, current_packet.src_ipv6,
+                                                                    current_packet.dst_ipv6, current_subnet);
     }
+
+    packet_pipeline.push(current_packet);
 }
 
-#ifdef KAFKA
-// Exports traffic to Kafka
-void export_to_kafka(const simple_packet_t& current_packet) {
-    extern std::string kafka_traffic_export_topic;
-    extern cppkafka::Producer* kafka_traffic_export_producer;
-    extern kafka_traffic_export_format_t kafka_traffic_export_format;
+std::vector<system_counter_t> get_packet_pipeline_stats() {
+    extern packet_pipeline_t packet_pipeline;
 
-    if (kafka_traffic_export_format == kafka_traffic_export_format_t::JSON) {
+    std::vector<system_counter_t> system_counter;
 
-        nlohmann::json json_packet;
+    uint64_t queued_packets            = 0;
+    uint64_t maximum_occupancy_percent = 0;
 
-        if (!serialize_simple_packet_to_json(current_packet, json_packet)) {
-            return;
-        }
+    packet_pipeline.get_rings_occupancy(queued_packets, maximum_occupancy_percent);
 
-        std::string simple_packet_as_json_string = json_packet.dump();
+    system_counter.push_back(system_counter_t("packet_pipeline_pushed", packet_pipeline.get_pushed_packets(),
+                                              metric_type_t::counter, "Number of packets passed from capture threads to pipeline rings"));
+    system_counter.push_back(system_counter_t("packet_pipeline_processed", packet_pipeline.get_processed_packets(),
+                                              metric_type_t::counter, "Number of packets processed by pipeline threads"));
+    system_counter.push_back(system_counter_t("packet_pipeline_dropped", packet_pipeline.get_dropped_packets(),
+                                              metric_type_t::counter, "Number of packets dropped because pipeline ring was full"));
+    system_counter.push_back(system_counter_t("packet_pipeline_queued", queued_packets, metric_type_t::gauge,
+                                              "Number of packets waiting in pipeline rings"));
+    system_counter.push_back(system_counter_t("packet_pipeline_max_ring_occupancy", maximum_occupancy_percent,
+                                              metric_type_t::gauge, "Occupancy of most loaded pipeline ring in percents"));
 
-        try {
-            kafka_traffic_export_producer->produce(
-                cppkafka::MessageBuilder(kafka_traffic_export_topic).partition(RD_KAFKA_PARTITION_UA).payload(simple_packet_as_json_string));
-        } catch (...) {
-            // We do not log it as it will flood log files
-            // logger << log4cpp::Priority::ERROR << "Kafka write failed";
-        }
-    } else if (kafka_traffic_export_format == kafka_traffic_export_format_t::Protobuf) {
-        TrafficData traffic_data;
+    return system_counter;
+}
 
-        // Encode Packet in protobuf
-        write_simple_packet_to_protobuf(current_packet, traffic_data);
+// Thread body for offline mode
+void run_offline_pcap_ingestion() {
+    extern std::string pcap_offline_files;
+    extern unsigned int pcap_offline_threads;
+    extern offline_pcap_ingestion_t offline_pcap_ingestion;
 
-        std::string output_data;
+    std::vector<std::string> pcap_file_paths;
+    boost::split(pcap_file_paths, pcap_offline_files, boost::is_any_of(","), boost::token_compress_on);
 
-        if (!traffic_data.SerializeToString(&output_data)) {
-            // Encoding error happened
-            return;
-        }
+    offline_pcap_ingestion.set_configuration(pcap_offline_threads, recalculate_speed_timeout);
 
-        try {
-            kafka_traffic_export_producer->produce(
-                cppkafka::MessageBuilder(kafka_traffic_export_topic).partition(RD_KAFKA_PARTITION_UA).payload(output_data));
-        } catch (...) {
-            // We do not log it as it will flood log files
-            // logger << log4cpp::Priority::ERROR << "Kafka write failed";
+    logger << log4cpp::Priority::INFO << "We will process " << pcap_file_paths.size() << " dumps in offline mode using "
+           << pcap_offline_threads << " threads";
+
+    time_t last_unban_time = get_fast_time_seconds();
+
+    // Ban list cleanup thread sleeps using wall clock and we run unban when same period passed in time from packets
+    auto recalculation_callback = [&last_unban_time](double speed_calc_period) {
+        recalculate_speed_for_period(speed_calc_period);
+
+        time_t current_time = get_fast_time_seconds();
+
+        if (current_time - last_unban_time >= unban_iteration_sleep_time) {
+            execute_unban_operation();
+            last_unban_time = current_time;
         }
-    } else {
-        // Unknown format
-        return;
-    }
+    };
 
-    try {
-        kafka_traffic_export_producer->flush();
-    } catch (...) {
-        // We do not log it as it will flood log files
-        // logger << log4cpp::Priority::ERROR << "Kafka flush failed";
+    bool all_dumps_processed = offline_pcap_ingestion.run(pcap_file_paths, process_packet, recalculation_callback);
+
+    logger << log4cpp::Priority::INFO << "Offline processing finished, we parsed " << offline_pcap_ingestion.get_parsed_packets()
+           << " packets from " << offline_pcap_ingestion.get_frames() << " frames in "
+           << offline_pcap_ingestion.get_slices() << " time slices";
+
+    if (!all_dumps_processed) {
+        logger << log4cpp::Priority::ERROR << "Some dumps were not processed completely, please check log";
     }
 }
-#endif
+
+std::vector<system_counter_t> get_offline_pcap_ingestion_stats() {
+    extern offline_pcap_ingestion_t offline_pcap_ingestion;
+
+    std::vector<system_counter_t> system_counter;
+
+    system_counter.push_back(system_counter_t("pcap_offline_frames", offline_pcap_ingestion.get_frames(),
+                                              metric_type_t::counter, "Number of frames read from dumps in offline mode"));
+    system_counter.push_back(system_counter_t("pcap_offline_parsed_packets", offline_pcap_ingestion.get_parsed_packets(),
+                                              metric_type_t::counter, "Number of packets from dumps passed to processing"));
+    system_counter.push_back(system_counter_t("pcap_offline_unparsed_packets", offline_pcap_ingestion.get_unparsed_packets(),
+                                              metric_type_t::counter, "Number of packets from dumps which we could not parse"));
+    system_counter.push_back(system_counter_t("pcap_offline_time_slices", offline_pcap_ingestion.get_slices(),
+                                              metric_type_t::counter, "Number of speed recalculations driven by time from packets"));
+    system_counter.push_back(system_counter_t("pcap_offline_packet_time", offline_pcap_ingestion.get_packet_time(),
+                                              metric_type_t::gauge, "Time of last processed packet from dumps"));
+    system_counter.push_back(system_counter_t("pcap_offline_finished", offline_pcap_ingestion.is_finished() ? 1 : 0,
+                                              metric_type_t::gauge, "Processing of all dumps finished"));
+
+    return system_counter;
+}
 
 // Process IPv6 traffic
 void process_ipv6_packet(simple_packet_t& current_packet) {
@@ -2694,28 +3946,22 @@ void process_ipv6_packet(simple_packet_t& current_packet) {
 
     subnet_ipv6_cidr_mask_t ipv6_cidr_subnet;
 
-    current_packet.packet_direction =
-        get_packet_direction_ipv6(lookup_tree_ipv6, current_packet.src_ipv6, current_packet.dst_ipv6, ipv6_cidr_subnet);
+    packet_latency_trace_t latency_trace;
+
+    current_packet.packet_direction = get_packet_direction_ipv6(our_networks_lookup.get()->lookup_tree_ipv6, current_packet.src_ipv6,
+                                                                current_packet.dst_ipv6, ipv6_cidr_subnet);
+
+    latency_trace.checkpoint(latency_stage_t::direction_lookup);
 
 #ifdef KAFKA
     if (kafka_traffic_export) {
         export_to_kafka(current_packet);
+
+        latency_trace.checkpoint(latency_stage_t::traffic_export);
     }
 #endif
 
-#ifdef USE_NEW_ATOMIC_BUILTINS
-    __atomic_add_fetch(&total_counters_ipv6.total_counters[current_packet.packet_direction].packets,
-                       sampled_number_of_packets, __ATOMIC_RELAXED);
-    __atomic_add_fetch(&total_counters_ipv6.total_counters[current_packet.packet_direction].bytes,
-                       sampled_number_of_bytes, __ATOMIC_RELAXED);
-
-    __atomic_add_fetch(&total_ipv6_packets, 1, __ATOMIC_RELAXED);
-#else
-    __sync_fetch_and_add(&total_counters_ipv6.total_counters[current_packet.packet_direction].packets, sampled_number_of_packets);
-    __sync_fetch_and_add(&total_counters_ipv6.total_counters[current_packet.packet_direction].bytes, sampled_number_of_bytes);
-
-    __sync_fetch_and_add(&total_ipv6_packets, 1);
-#endif
+    total_traffic_counters_ipv6.increment(current_packet.packet_direction, sampled_number_of_packets, sampled_number_of_bytes);
 
     {
         std::lock_guard<std::mutex> lock_guard(ipv6_subnet_counters.counter_map_mutex);
@@ -2760,9 +4006,40 @@ void process_ipv6_packet(simple_packet_t& current_packet) {
         }
     }
 
+    latency_trace.checkpoint(latency_stage_t::counter_update);
+
     return;
 }
 
+// Stores packet sample for host under collection
+void collect_ban_details_for_host(uint32_t client_ip, simple_packet_t& current_packet) {
+    std::lock_guard<std::mutex> lock_guard(ban_list_details_mutex);
+
+    auto ban_list_details_itr = ban_list_details.find(client_ip);
+
+    // Collection may be finished after our lock free check
+    if (ban_list_details_itr == ban_list_details.end() or ban_list_details_itr->second.size() >= ban_details_records_count) {
+        return;
+    }
+
+    if (collect_attack_pcap_dumps) {
+        if (current_packet.packet_payload_length > 0 && current_packet.packet_payload_pointer != NULL) {
+            ban_list.modify_blackhole_details(client_ip, [&current_packet](banlist_item_t& banlist_item) {
+                banlist_item.pcap_attack_dump.write_packet(current_packet.packet_payload_pointer,
+                                                           current_packet.packet_payload_length,
+                                                           current_packet.packet_payload_length, current_packet.ts);
+            });
+        }
+    }
+
+    ban_list_details_itr->second.push_back(current_packet);
+
+    // We've collected enough samples and stop lookups for this host
+    if (ban_list_details_itr->second.size() >= ban_details_records_count) {
+        publish_hosts_under_collection();
+    }
+}
+
 // Process simple unified packet
 void process_packet(simple_packet_t& current_packet) {
     extern bool kafka_traffic_export;
@@ -2773,31 +4050,20 @@ void process_packet(simple_packet_t& current_packet) {
     }
 
     // Increment counter about total number of packets processes here
-#ifdef USE_NEW_ATOMIC_BUILTINS
-    __atomic_add_fetch(&total_simple_packets_processed, 1, __ATOMIC_RELAXED);
+    // Each thread has own copy of these counters and we do not need atomic operations
+    total_simple_packets_processed.increment();
 
-    if (current_packet.ip_protocol_version == 4) {
-        __atomic_add_fetch(&total_ipv4_packets, 1, __ATOMIC_RELAXED);
-    } else if (current_packet.ip_protocol_version == 6) {
-        __atomic_add_fetch(&total_ipv6_packets, 1, __ATOMIC_RELAXED);
-    } else {
-        // Non IPv4 and non IPv6 packets
-        __atomic_add_fetch(&unknown_ip_version_packets, 1, __ATOMIC_RELAXED);
-        return;
-    }
-#else
-    __sync_fetch_and_add(&total_simple_packets_processed, 1);
+    set_packet_arrival_time(current_packet);
 
     if (current_packet.ip_protocol_version == 4) {
-        __sync_fetch_and_add(&total_ipv4_packets, 1);
+        total_ipv4_packets.increment();
     } else if (current_packet.ip_protocol_version == 6) {
-        __sync_fetch_and_add(&total_ipv6_packets, 1);
+        total_ipv6_packets.increment();
     } else {
         // Non IPv4 and non IPv6 packets
-        __atomic_add_fetch(&unknown_ip_version_packets, 1, __ATOMIC_RELAXED);
+        unknown_ip_version_packets.increment();
         return;
     }
-#endif
 
     // Process IPv6 traffic in differnt function
     if (current_packet.ip_protocol_version == 6) {
@@ -2811,15 +4077,25 @@ void process_packet(simple_packet_t& current_packet) {
         return;
     }
 
+    // Time of each stage for sampled packets
+    packet_latency_trace_t latency_trace;
+
+    // Lookup could be replaced on reload but we keep using this copy until end of function
+    const networks_lookup_t* networks_lookup = our_networks_lookup.get();
+
     // Subnet for found IPs
     subnet_cidr_mask_t current_subnet;
 
     current_packet.packet_direction =
-        get_packet_direction(lookup_tree_ipv4, current_packet.src_ip, current_packet.dst_ip, current_subnet);
+        get_packet_direction(networks_lookup->lookup_tree_ipv4, current_packet.src_ip, current_packet.dst_ip, current_subnet);
+
+    latency_trace.checkpoint(latency_stage_t::direction_lookup);
 
 #ifdef KAFKA
     if (kafka_traffic_export) {
         export_to_kafka(current_packet);
+
+        latency_trace.checkpoint(latency_stage_t::traffic_export);
     }
 #endif
 
@@ -2853,16 +4129,18 @@ void process_packet(simple_packet_t& current_packet) {
         }
     }
 
-    map_of_vector_counters_for_flow_t::iterator itr_flow;
+    vector_of_flow_counters_t* flow_counters = nullptr;
 
     if (enable_connection_tracking) {
         if (current_packet.packet_direction == OUTGOING or current_packet.packet_direction == INCOMING) {
-            itr_flow = SubnetVectorMapFlow.find(current_subnet);
+            auto itr_flow = networks_lookup->flow_counters.find(current_subnet);
 
-            if (itr_flow == SubnetVectorMapFlow.end()) {
+            if (itr_flow == networks_lookup->flow_counters.end()) {
                 logger << log4cpp::Priority::ERROR << "Can't find vector address in subnet flow map";
                 return;
             }
+
+            flow_counters = itr_flow->second;
         }
     }
 
@@ -2873,27 +4151,24 @@ void process_packet(simple_packet_t& current_packet) {
         - Another combinations of this three options
     */
 
-#ifdef USE_NEW_ATOMIC_BUILTINS
-    __atomic_add_fetch(&total_counters_ipv4.total_counters[current_packet.packet_direction].packets,
-                       sampled_number_of_packets, __ATOMIC_RELAXED);
-    __atomic_add_fetch(&total_counters_ipv4.total_counters[current_packet.packet_direction].bytes,
-                       sampled_number_of_bytes, __ATOMIC_RELAXED);
-#else
-    __sync_fetch_and_add(&total_counters_ipv4.total_counters[current_packet.packet_direction].packets, sampled_number_of_packets);
-    __sync_fetch_and_add(&total_counters_ipv4.total_counters[current_packet.packet_direction].bytes, sampled_number_of_bytes);
-#endif
+    total_traffic_counters_ipv4.increment(current_packet.packet_direction, sampled_number_of_packets, sampled_number_of_bytes);
+
+    // Counters for this subnet
+    vector_of_counters* counters = nullptr;
 
-    // Try to find map key for this subnet
-    map_of_vector_counters_t::iterator itr;
+    // Recalculation thread reads another generation of counters in same time
+    counters_epoch_guard_t counters_epoch_guard(ipv4_host_counters_epoch);
 
     if (current_packet.packet_direction == OUTGOING or current_packet.packet_direction == INCOMING) {
         // Find element in map of vectors
-        itr = SubnetVectorMap.find(current_subnet);
+        auto itr = networks_lookup->counters[counters_epoch_guard.get_generation()].find(current_subnet);
 
-        if (itr == SubnetVectorMap.end()) {
+        if (itr == networks_lookup->counters[counters_epoch_guard.get_generation()].end()) {
             logger << log4cpp::Priority::ERROR << "Can't find vector address in subnet map";
             return;
         }
+
+        counters = itr->second;
     }
 
 
@@ -2901,9 +4176,9 @@ void process_packet(simple_packet_t& current_packet) {
     if (current_packet.packet_direction == OUTGOING) {
         int64_t shift_in_vector = (int64_t)ntohl(current_packet.src_ip) - (int64_t)subnet_in_host_byte_order;
 
-        if (shift_in_vector < 0 or shift_in_vector >= itr->second.size()) {
+        if (shift_in_vector < 0 or shift_in_vector >= counters->size()) {
             logger << log4cpp::Priority::ERROR << "We tried to access to element with index " << shift_in_vector
-                   << " which located outside allocated vector with size " << itr->second.size();
+                   << " which located outside allocated vector with size " << counters->size();
 
             logger << log4cpp::Priority::ERROR
                    << "We expect issues with this packet in OUTGOING direction: " << print_simple_packet(current_packet);
@@ -2911,20 +4186,30 @@ void process_packet(simple_packet_t& current_packet) {
             return;
         }
 
-        subnet_counter_t* current_element = &itr->second[shift_in_vector];
+        // In sparse mode we allocate block for this host here
+        subnet_counter_t* current_element = counters->get_or_allocate(shift_in_vector);
+
+        if (current_element == nullptr) {
+            logger << log4cpp::Priority::ERROR << "Can't allocate memory for counters";
+            return;
+        }
 
         increment_outgoing_counters(current_element, current_packet, sampled_number_of_packets, sampled_number_of_bytes);
 
+        latency_trace.checkpoint(latency_stage_t::counter_update);
+
         if (enable_connection_tracking) {
-            increment_outgoing_flow_counters(SubnetVectorMapFlow, shift_in_vector, current_packet,
-                                             sampled_number_of_packets, sampled_number_of_bytes, current_subnet);
+            increment_outgoing_flow_counters(*flow_counters, shift_in_vector, current_packet, sampled_number_of_packets,
+                                             sampled_number_of_bytes);
+
+            latency_trace.checkpoint(latency_stage_t::flow_tracking);
         }
     } else if (current_packet.packet_direction == INCOMING) {
         int64_t shift_in_vector = (int64_t)ntohl(current_packet.dst_ip) - (int64_t)subnet_in_host_byte_order;
 
-        if (shift_in_vector < 0 or shift_in_vector >= itr->second.size()) {
+        if (shift_in_vector < 0 or shift_in_vector >= counters->size()) {
             logger << log4cpp::Priority::ERROR << "We tried to access to element with index " << shift_in_vector
-                   << " which located outside allocated vector with size " << itr->second.size();
+                   << " which located outside allocated vector with size " << counters->size();
 
             logger << log4cpp::Priority::ERROR
                    << "We expect issues with this packet in INCOMING direction: " << print_simple_packet(current_packet);
@@ -2932,58 +4217,64 @@ void process_packet(simple_packet_t& current_packet) {
             return;
         }
 
-        subnet_counter_t* current_element = &itr->second[shift_in_vector];
+        // In sparse mode we allocate block for this host here
+        subnet_counter_t* current_element = counters->get_or_allocate(shift_in_vector);
+
+        if (current_element == nullptr) {
+            logger << log4cpp::Priority::ERROR << "Can't allocate memory for counters";
+            return;
+        }
 
         increment_incoming_counters(current_element, current_packet, sampled_number_of_packets, sampled_number_of_bytes);
 
+        latency_trace.checkpoint(latency_stage_t::counter_update);
+
         if (enable_connection_tracking) {
-            increment_incoming_flow_counters(SubnetVectorMapFlow, shift_in_vector, current_packet,
-                                             sampled_number_of_packets, sampled_number_of_bytes, current_subnet);
+            increment_incoming_flow_counters(*flow_counters, shift_in_vector, current_packet, sampled_number_of_packets,
+                                             sampled_number_of_bytes);
+
+            latency_trace.checkpoint(latency_stage_t::flow_tracking);
         }
     } else if (current_packet.packet_direction == INTERNAL) {
     }
 
+    counters_epoch_guard.leave();
+
     // Exceute ban related processing
     if (current_packet.packet_direction == OUTGOING) {
         // Collect data when ban client
-        if (ban_details_records_count != 0 && !ban_list_details.empty() && ban_list_details.count(current_packet.src_ip) > 0 &&
-            ban_list_details[current_packet.src_ip].size() < ban_details_records_count) {
-
-            std::lock_guard<std::mutex> lock_guard(ban_list_details_mutex);
-
-            if (collect_attack_pcap_dumps) {
-                // this code SHOULD NOT be called without mutex!
-                if (current_packet.packet_payload_length > 0 && current_packet.packet_payload_pointer != NULL) {
-                    ban_list[current_packet.src_ip].pcap_attack_dump.write_packet(current_packet.packet_payload_pointer,
-                                                                                  current_packet.packet_payload_length,
-                                                                                  current_packet.packet_payload_length);
-                }
-            }
-
-            ban_list_details[current_packet.src_ip].push_back(current_packet);
+        // Lock free check for the most common case when host is not under collection
+        if (ban_details_records_count != 0 && hosts_under_collection.contains(current_packet.src_ip)) {
+            collect_ban_details_for_host(current_packet.src_ip, current_packet);
         }
     }
 
 
     if (current_packet.packet_direction == INCOMING) {
         // Collect attack details
-        if (ban_details_records_count != 0 && !ban_list_details.empty() && ban_list_details.count(current_packet.dst_ip) > 0 &&
-            ban_list_details[current_packet.dst_ip].size() < ban_details_records_count) {
+        if (ban_details_records_count != 0 && hosts_under_collection.contains(current_packet.dst_ip)) {
+            collect_ban_details_for_host(current_packet.dst_ip, current_packet);
+        }
+    }
 
-            std::lock_guard<std::mutex> lock_guard(ban_list_details_mutex);
+    // Update heavy hitters for hosts under attack
+    if (collect_attack_fingerprints && (current_packet.packet_direction == OUTGOING or current_packet.packet_direction == INCOMING)) {
+        uint32_t attacked_host_ip = current_packet.packet_direction == OUTGOING ? current_packet.src_ip : current_packet.dst_ip;
 
-            if (collect_attack_pcap_dumps) {
-                // this code SHOULD NOT be called without mutex!
-                if (current_packet.packet_payload_length > 0 && current_packet.packet_payload_pointer != NULL) {
-                    ban_list[current_packet.dst_ip].pcap_attack_dump.write_packet(current_packet.packet_payload_pointer,
-                                                                                  current_packet.packet_payload_length,
-                                                                                  current_packet.packet_payload_length);
-                }
-            }
+        // Lock free check to avoid map lookups for hosts without attacks
+        if (hosts_under_fingerprinting.contains(attacked_host_ip)) {
+            // Retired copies of index keep fingerprint alive for grace period and we do not need reference counting here
+            const attack_fingerprints_index_t* fingerprints_index = attack_fingerprints_index.get();
+
+            auto itr = fingerprints_index->find(attacked_host_ip);
 
-            ban_list_details[current_packet.dst_ip].push_back(current_packet);
+            if (itr != fingerprints_index->end()) {
+                itr->second->add_packet(current_packet, sampled_number_of_packets);
+            }
         }
     }
+
+    latency_trace.checkpoint(latency_stage_t::ban_details_capture);
 }
 
 #ifdef USE_NEW_ATOMIC_BUILTINS
@@ -2994,7 +4285,7 @@ void increment_outgoing_counters(subnet_counter_t* current_element,
                                  uint64_t sampled_number_of_bytes) {
 
     // Update last update time
-    current_element->last_update_time = current_inaccurate_time;
+    current_element->last_update_time = current_packet.arrival_time;
 
     // Main packet/bytes counter
     __atomic_add_fetch(&current_element->total.out_packets, sampled_number_of_packets, __ATOMIC_RELAXED);
@@ -3032,7 +4323,7 @@ void increment_outgoing_counters(subnet_counter_t* current_element,
                                  uint64_t sampled_number_of_bytes) {
 
     // Update last update time
-    current_element->last_update_time = current_inaccurate_time;
+    current_element->last_update_time = current_packet.arrival_time;
 
     // Main packet/bytes counter
     __sync_fetch_and_add(&current_element->total.out_packets, sampled_number_of_packets);
@@ -3073,7 +4364,7 @@ void increment_incoming_counters(subnet_counter_t* current_element,
                                  uint64_t sampled_number_of_bytes) {
 
     // Uodate last update time
-    current_element->last_update_time = current_inaccurate_time;
+    current_element->last_update_time = current_packet.arrival_time;
 
     // Main packet/bytes counter
     __atomic_add_fetch(&current_element->total.in_packets, sampled_number_of_packets, __ATOMIC_RELAXED);
@@ -3114,7 +4405,7 @@ void increment_incoming_counters(subnet_counter_t* current_element,
                                  uint64_t sampled_number_of_bytes) {
 
     // Uodate last update time
-    current_element->last_update_time = current_inaccurate_time;
+    current_element->last_update_time = current_packet.arrival_time;
 
     // Main packet/bytes counter
     __sync_fetch_and_add(&current_element->total.in_packets, sampled_number_of_packets);
@@ -3164,99 +4455,35 @@ void system_counters_speed_thread_handler() {
     }
 }
 
-// Generates inaccurate time for fast time operations
-void inaccurate_time_generator() {
-    extern time_t current_inaccurate_time;
-
-    while (true) {
-        boost::this_thread::sleep(boost::posix_time::seconds(1));
-
-        // We use this thread to update time each second
-        time_t current_time = 0;
-        time(&current_time);
-
-        // Update global time, yes, it may became inaccurate due to thread sync but that's OK for our purposes
-        current_inaccurate_time = current_time;
-    }
-}
-
-
-void increment_incoming_flow_counters(map_of_vector_counters_for_flow_t& SubnetVectorMapFlow,
+void increment_incoming_flow_counters(vector_of_flow_counters_t& flow_counters,
                                       int64_t shift_in_vector,
                                       simple_packet_t& current_packet,
                                       uint64_t sampled_number_of_packets,
-                                      uint64_t sampled_number_of_bytes,
-                                      const subnet_cidr_mask_t& current_subnet) {
-
-    map_of_vector_counters_for_flow_t::iterator itr_flow = SubnetVectorMapFlow.find(current_subnet);
+                                      uint64_t sampled_number_of_bytes) {
+    conntrack_main_struct_t* current_element_flow = flow_counters.get_or_allocate(shift_in_vector);
 
-    if (itr_flow == SubnetVectorMapFlow.end()) {
-        logger << log4cpp::Priority::ERROR << "Can't find vector address in subnet flow map";
+    if (current_element_flow == nullptr) {
         return;
     }
 
-    conntrack_main_struct_t* current_element_flow = &itr_flow->second[shift_in_vector];
-
-    packed_conntrack_hash_t flow_tracking_structure;
-    flow_tracking_structure.opposite_ip = current_packet.src_ip;
-    flow_tracking_structure.src_port    = current_packet.source_port;
-    flow_tracking_structure.dst_port    = current_packet.destination_port;
-
-    // convert this struct to 64 bit integer
-    uint64_t connection_tracking_hash = convert_conntrack_hash_struct_to_integer(&flow_tracking_structure);
-
-    if (current_packet.protocol == IPPROTO_TCP) {
-        std::lock_guard<std::mutex> lock_guard(flow_counter);
-        conntrack_key_struct_t* conntrack_key_struct_ptr = &current_element_flow->in_tcp[connection_tracking_hash];
-
-        conntrack_key_struct_ptr->packets += sampled_number_of_packets;
-        conntrack_key_struct_ptr->bytes += sampled_number_of_bytes;
-    } else if (current_packet.protocol == IPPROTO_UDP) {
-        std::lock_guard<std::mutex> lock_guard(flow_counter);
-        conntrack_key_struct_t* conntrack_key_struct_ptr = &current_element_flow->in_udp[connection_tracking_hash];
-
-        conntrack_key_struct_ptr->packets += sampled_number_of_packets;
-        conntrack_key_struct_ptr->bytes += sampled_number_of_bytes;
-    }
+    increment_flow_tracking_table(*current_element_flow, INCOMING, current_packet, sampled_number_of_packets,
+                                  sampled_number_of_bytes, flow_counter);
 }
 
 // Increment all flow counters using specified packet
-void increment_outgoing_flow_counters(map_of_vector_counters_for_flow_t& SubnetVectorMapFlow,
+void increment_outgoing_flow_counters(vector_of_flow_counters_t& flow_counters,
                                       int64_t shift_in_vector,
                                       simple_packet_t& current_packet,
                                       uint64_t sampled_number_of_packets,
-                                      uint64_t sampled_number_of_bytes,
-                                      const subnet_cidr_mask_t& current_subnet) {
-    map_of_vector_counters_for_flow_t::iterator itr_flow = SubnetVectorMapFlow.find(current_subnet);
+                                      uint64_t sampled_number_of_bytes) {
+    conntrack_main_struct_t* current_element_flow = flow_counters.get_or_allocate(shift_in_vector);
 
-    if (itr_flow == SubnetVectorMapFlow.end()) {
-        logger << log4cpp::Priority::ERROR << "Can't find vector address in subnet flow map";
+    if (current_element_flow == nullptr) {
         return;
     }
 
-    conntrack_main_struct_t* current_element_flow = &itr_flow->second[shift_in_vector];
-
-    packed_conntrack_hash_t flow_tracking_structure;
-    flow_tracking_structure.opposite_ip = current_packet.dst_ip;
-    flow_tracking_structure.src_port    = current_packet.source_port;
-    flow_tracking_structure.dst_port    = current_packet.destination_port;
-
-    // convert this struct to 64 bit integer
-    uint64_t connection_tracking_hash = convert_conntrack_hash_struct_to_integer(&flow_tracking_structure);
-
-    if (current_packet.protocol == IPPROTO_TCP) {
-        std::lock_guard<std::mutex> lock_guard(flow_counter);
-        conntrack_key_struct_t* conntrack_key_struct_ptr = &current_element_flow->out_tcp[connection_tracking_hash];
-
-        conntrack_key_struct_ptr->packets += sampled_number_of_packets;
-        conntrack_key_struct_ptr->bytes += sampled_number_of_bytes;
-    } else if (current_packet.protocol == IPPROTO_UDP) {
-        std::lock_guard<std::mutex> lock_guard(flow_counter);
-        conntrack_key_struct_t* conntrack_key_struct_ptr = &current_element_flow->out_udp[connection_tracking_hash];
-
-        conntrack_key_struct_ptr->packets += sampled_number_of_packets;
-        conntrack_key_struct_ptr->bytes += sampled_number_of_bytes;
-    }
+    increment_flow_tracking_table(*current_element_flow, OUTGOING, current_packet, sampled_number_of_packets,
+                                  sampled_number_of_bytes, flow_counter);
 }
 
 // pretty print channel speed in pps and MBit
@@ -3321,8 +4548,8 @@ void remove_orphaned_buckets(packet_buckets_storage_t<TemplateKeyType>* packet_s
         // Stop packet collection ASAP
         bucket->we_could_receive_new_data = false;
 
-        // Remove it completely from map
-        packet_storage->packet_buckets_map.erase(client_ip);
+        // Remove it completely from map and return its packets to slab
+        packet_storage->remove_bucket_without_lock(client_ip);
     }
 
     return;
@@ -3405,8 +4632,8 @@ void process_filled_buckets_ipv6() {
         // Stop packet collection ASAP
         bucket->we_could_receive_new_data = false;
 
-        // Remove it completely from map
-        packet_buckets_ipv6_storage.packet_buckets_map.erase(ipv6_address);
+        // Remove it completely from map and return its packets to slab
+        packet_buckets_ipv6_storage.remove_bucket_without_lock(ipv6_address);
     }
 }
 
@@ -3414,10 +4641,14 @@ void process_filled_buckets_ipv6() {
 // This functions will check for packet buckets availible for processing
 void check_traffic_buckets() {
     while (true) {
-        // Process buckets which haven't filled by packets
-        remove_orphaned_buckets(&packet_buckets_ipv6_storage, "ipv6");
+        {
+            stage_latency_scope_t stage_latency_scope(latency_stage_t::traffic_buckets_check);
+
+            // Process buckets which haven't filled by packets
+            remove_orphaned_buckets(&packet_buckets_ipv6_storage, "ipv6");
 
-        process_filled_buckets_ipv6();
+            process_filled_buckets_ipv6();
+        }
 
         boost::this_thread::sleep(boost::posix_time::seconds(check_for_availible_for_processing_packets_buckets));
     }
@@ -3435,7 +4666,7 @@ bool should_remove_orphaned_bucket(const std::pair<TemplatedKeyType, packet_buck
         return false;
     }
 
-    std::chrono::duration<double> elapsed_from_start_seconds = std::chrono::system_clock::now() - pair.second.collection_start_time;
+    std::chrono::duration<double> elapsed_from_start_seconds = get_fast_time_point() - pair.second.collection_start_time;
 
     // We do cleanup for them in another function
     if (pair.second.we_collected_full_buffer_least_once) {
@@ -3468,16 +4699,24 @@ bool get_statistics(std::vector<system_counter_t>& system_counters) {
     extern std::string total_number_of_hosts_in_our_networks_desc;
     extern std::string influxdb_writes_total_desc;
     extern std::string influxdb_writes_failed_desc;
-
-    system_counters.push_back(system_counter_t("total_simple_packets_processed", total_simple_packets_processed,
+    extern std::string networks_reloads_desc;
+    extern std::string networks_reload_errors_desc;
+    extern std::string networks_added_on_reload_desc;
+    extern std::string networks_removed_on_reload_desc;
+    extern uint64_t networks_reloads;
+    extern uint64_t networks_reload_errors;
+    extern uint64_t networks_added_on_reload;
+    extern uint64_t networks_removed_on_reload;
+
+    system_counters.push_back(system_counter_t("total_simple_packets_processed", total_simple_packets_processed.get(),
                                                metric_type_t::counter, total_simple_packets_processed_desc));
 
-    system_counters.push_back(system_counter_t("total_ipv4_packets", total_ipv4_packets, metric_type_t::counter, total_ipv4_packets_desc));
-    system_counters.push_back(system_counter_t("total_ipv6_packets", total_ipv6_packets, metric_type_t::counter, total_ipv6_packets_desc));
-    system_counters.push_back(system_counter_t("unknown_ip_version_packets", unknown_ip_version_packets,
+    system_counters.push_back(system_counter_t("total_ipv4_packets", total_ipv4_packets.get(), metric_type_t::counter, total_ipv4_packets_desc));
+    system_counters.push_back(system_counter_t("total_ipv6_packets", total_ipv6_packets.get(), metric_type_t::counter, total_ipv6_packets_desc));
+    system_counters.push_back(system_counter_t("unknown_ip_version_packets", unknown_ip_version_packets.get(),
                                                metric_type_t::counter, unknown_ip_version_packets_desc));
 
-    system_counters.push_back(system_counter_t("total_unparsed_packets", total_unparsed_packets, metric_type_t::counter,
+    system_counters.push_back(system_counter_t("total_unparsed_packets", total_unparsed_packets.get(), metric_type_t::counter,
                                                total_unparsed_packets_desc));
     system_counters.push_back(system_counter_t("total_unparsed_packets_speed", total_unparsed_packets_speed,
                                                metric_type_t::gauge, total_unparsed_packets_speed_desc));
@@ -3488,6 +4727,9 @@ bool get_statistics(std::vector<system_counter_t>& system_counters) {
     system_counters.push_back(system_counter_t("speed_recalculation_time_microseconds", speed_calculation_time.tv_usec,
                                                metric_type_t::gauge, speed_calculation_time_desc));
 
+    extern std::string recalculated_hosts_desc;
+    system_counters.push_back(system_counter_t("recalculated_hosts", recalculated_hosts, metric_type_t::gauge, recalculated_hosts_desc));
+
 
     system_counters.push_back(system_counter_t("total_number_of_hosts", total_number_of_hosts_in_our_networks,
                                                metric_type_t::gauge, total_number_of_hosts_in_our_networks_desc));
@@ -3497,12 +4739,109 @@ bool get_statistics(std::vector<system_counter_t>& system_counters) {
     system_counters.push_back(system_counter_t("influxdb_writes_failed", influxdb_writes_failed, metric_type_t::counter,
                                                influxdb_writes_failed_desc));
 
+    system_counters.push_back(system_counter_t("state_checkpoint_writes", state_checkpoint_writes, metric_type_t::counter,
+                                               state_checkpoint_writes_desc));
+    system_counters.push_back(system_counter_t("state_checkpoint_write_errors", state_checkpoint_write_errors,
+                                               metric_type_t::counter, state_checkpoint_write_errors_desc));
+    system_counters.push_back(system_counter_t("state_checkpoint_last_duration_microseconds",
+                                               state_checkpoint_last_duration_microseconds, metric_type_t::gauge,
+                                               state_checkpoint_last_duration_microseconds_desc));
+
+    system_counters.push_back(system_counter_t("networks_reloads", networks_reloads, metric_type_t::counter, networks_reloads_desc));
+    system_counters.push_back(system_counter_t("networks_reload_errors", networks_reload_errors, metric_type_t::counter,
+                                               networks_reload_errors_desc));
+    system_counters.push_back(system_counter_t("networks_added_on_reload", networks_added_on_reload,
+                                               metric_type_t::counter, networks_added_on_reload_desc));
+    system_counters.push_back(system_counter_t("networks_removed_on_reload", networks_removed_on_reload,
+                                               metric_type_t::counter, networks_removed_on_reload_desc));
+
+    counters_memory_t& counters_memory = get_counters_memory();
+
+    system_counters.push_back(system_counter_t("counters_memory_huge_pages_bytes", counters_memory.huge_pages_bytes,
+                                               metric_type_t::gauge, "Memory for per host counters on huge pages"));
+    system_counters.push_back(system_counter_t("counters_memory_transparent_huge_pages_bytes",
+                                               counters_memory.transparent_huge_pages_bytes, metric_type_t::gauge,
+                                               "Memory for per host counters on transparent huge pages"));
+    system_counters.push_back(system_counter_t("counters_memory_regular_bytes", counters_memory.regular_bytes,
+                                               metric_type_t::gauge, "Memory for per host counters on regular pages"));
+    system_counters.push_back(system_counter_t("counters_huge_pages_allocation_failures",
+                                               counters_memory.huge_pages_allocation_failures, metric_type_t::counter,
+                                               "Number of times when we could not get huge pages for counters"));
+    system_counters.push_back(system_counter_t("counters_numa_bind_failures", counters_memory.numa_bind_failures,
+                                               metric_type_t::counter, "Number of times when we could not bind counters to NUMA node"));
+    system_counters.push_back(system_counter_t("counters_sparse_blocks", counters_memory.sparse_blocks, metric_type_t::gauge,
+                                               "Number of /24 blocks of counters allocated on traffic in sparse mode"));
+    system_counters.push_back(system_counter_t("counters_sparse_blocks_retired", counters_memory.sparse_blocks_retired,
+                                               metric_type_t::counter, "Number of /24 blocks of counters freed after long idle time"));
+
+    extern packet_capture_slab_t packet_capture_slab;
+
+    if (packet_capture_slab.is_allocated()) {
+        system_counters.push_back(system_counter_t("packet_capture_slab_free_chunks", packet_capture_slab.get_number_of_free_chunks(),
+                                                   metric_type_t::gauge, "Number of free chunks for captured packets"));
+        system_counters.push_back(system_counter_t("packet_capture_slab_chunks", packet_capture_slab.get_number_of_chunks(),
+                                                   metric_type_t::gauge, "Total number of chunks for captured packets"));
+        system_counters.push_back(system_counter_t("packet_capture_slab_overflows", packet_buckets_ipv6_storage.get_slab_overflows(),
+                                                   metric_type_t::counter, "Number of captured packets dropped because slab was full"));
+    }
+
+    extern bool packet_pipeline_enabled;
+
+    if (packet_pipeline_enabled) {
+        auto packet_pipeline_stats = get_packet_pipeline_stats();
+
+        system_counters.insert(system_counters.end(), packet_pipeline_stats.begin(), packet_pipeline_stats.end());
+    }
+
+    extern bool pcap_offline;
+
+    if (pcap_offline) {
+        auto offline_pcap_ingestion_stats = get_offline_pcap_ingestion_stats();
+
+        system_counters.insert(system_counters.end(), offline_pcap_ingestion_stats.begin(), offline_pcap_ingestion_stats.end());
+    }
+
+    auto action_dispatcher_stats = action_dispatcher.get_statistics();
+    system_counters.insert(system_counters.end(), action_dispatcher_stats.begin(), action_dispatcher_stats.end());
+
+#ifdef KAFKA
+    extern bool kafka_traffic_export;
+
+    if (kafka_traffic_export) {
+        auto kafka_traffic_export_stats = get_kafka_traffic_export_stats();
+
+        system_counters.insert(system_counters.end(), kafka_traffic_export_stats.begin(), kafka_traffic_export_stats.end());
+    }
+#endif
+
+#ifdef ENABLE_GOBGP
+    if (gobgp_enabled) {
+        auto gobgp_stats = get_gobgp_stats();
+
+        system_counters.insert(system_counters.end(), gobgp_stats.begin(), gobgp_stats.end());
+    }
+#endif
+
+#ifdef FASTNETMON_ENABLE_AFPACKET
+    if (enable_afpacket_collection) {
+        auto afpacket_stats = get_afpacket_stats();
+
+        system_counters.insert(system_counters.end(), afpacket_stats.begin(), afpacket_stats.end());
+    }
+#endif
+
     if (enable_netflow_collection) {
         auto netflow_stats = get_netflow_stats();
 
         system_counters.insert(system_counters.end(), netflow_stats.begin(), netflow_stats.end());
     }
 
+    if (enable_traffic_generator_collection) {
+        auto traffic_generator_stats = get_traffic_generator_stats();
+
+        system_counters.insert(system_counters.end(), traffic_generator_stats.begin(), traffic_generator_stats.end());
+    }
+
     return true;
 }
 
@@ -3526,6 +4865,10 @@ std::vector<std::string> generate_list_of_enabled_capture_engines() {
         list.push_back("af_xdp");
     }
 
+    if (configuration_map.count("traffic_generator") != 0 && configuration_map["traffic_generator"] == "on") {
+        list.push_back("traffic_generator");
+    }
+
     return list;
 }
 
@@ -3561,7 +4904,7 @@ void send_usage_data_to_reporting_server() {
         ssize_t hosts_hash_size_ipv6 = 0;
 
         {
-            std::lock_guard<std::mutex> lock_guard(ipv6_host_counters.counter_map_mutex);
+            std::lock_guard<std::mutex> lock_guard(ipv6_host_counters.speed_maps_mutex);
             hosts_hash_size_ipv6 = ipv6_host_counters.average_speed_map.size();
         }
 
@@ -3575,7 +4918,7 @@ void send_usage_data_to_reporting_server() {
 
         stats["bgp"] = gobgp;
 
-        stats["bgp_flow_spec"] = false;
+        stats["bgp_flow_spec"] = flow_spec_announces;
 
         bool influxdb = false;
 
@@ -3723,6 +5066,52 @@ void add_total_traffic_to_prometheus(const total_speed_counters_t& total_counter
     }
 }
 
+// Adds histograms for stages of packet processing and loops of background threads to Prometheus endpoint
+void add_stage_latency_to_prometheus(std::stringstream& output) {
+    // We do not expose buckets below 16 nanoseconds, they're just noise from counter resolution
+    const size_t first_exposed_bucket = 4;
+
+    std::vector<stage_latency_histogram_t> histograms = stage_latency_registry.get_histograms();
+
+    for (bool packet_stages : { true, false }) {
+        std::string metric_name = packet_stages ? "fastnetmon_stage_latency_nanoseconds" : "fastnetmon_thread_loop_duration_nanoseconds";
+        std::string label_name = packet_stages ? "stage" : "thread_loop";
+
+        if (packet_stages) {
+            output << "# HELP " << metric_name << " Time spent by sampled packets in each stage of processing\n";
+        } else {
+            output << "# HELP " << metric_name << " Time spent by each iteration of background thread loop\n";
+        }
+
+        output << "# TYPE " << metric_name << " histogram\n";
+
+        for (const auto& histogram : histograms) {
+            if (is_packet_processing_stage(histogram.stage) != packet_stages) {
+                continue;
+            }
+
+            std::string label = label_name + "=\"" + get_latency_stage_name(histogram.stage) + "\"";
+
+            uint64_t cumulative_samples = 0;
+
+            for (size_t bucket_index = 0; bucket_index < number_of_latency_buckets - 1; bucket_index++) {
+                cumulative_samples += histogram.buckets[bucket_index];
+
+                if (bucket_index < first_exposed_bucket) {
+                    continue;
+                }
+
+                output << metric_name << "_bucket{" << label << ",le=\""
+                       << stage_latency_histogram_t::get_bucket_upper_bound(bucket_index) << "\"} " << cumulative_samples << "\n";
+            }
+
+            output << metric_name << "_bucket{" << label << ",le=\"+Inf\"} " << histogram.samples << "\n";
+            output << metric_name << "_sum{" << label << "} " << histogram.total_nanoseconds << "\n";
+            output << metric_name << "_count{" << label << "} " << histogram.samples << "\n";
+        }
+    }
+}
+
 
 // This function produces an HTTP response for the given
 // request. The type of the response object depends on the
@@ -3820,6 +5209,10 @@ void handle_prometheus_http_request(boost::beast::http::request<Body, boost::bea
 
     add_total_traffic_to_prometheus(total_counters_ipv6, output, "ipv6");
 
+    if (stage_latency_registry.is_enabled()) {
+        add_stage_latency_to_prometheus(output);
+    }
+
     res.body() = output.str();
 
     res.keep_alive(req.keep_alive());
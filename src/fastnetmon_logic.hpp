@@ -5,7 +5,9 @@
 #include <hiredis/hiredis.h>
 #endif
 
+#include "action_dispatcher.hpp"
 #include "all_logcpp_libraries.hpp"
+#include "attack_fingerprint.hpp"
 #include "packet_bucket.hpp"
 
 #include "fastnetmon.grpc.pb.h"
@@ -18,11 +20,14 @@ void build_average_speed_counters_from_speed_counters(subnet_counter_t* current_
                                                       double exp_value,
                                                       double exp_power);
 
+double get_speed_window_exp_value(double speed_calc_period);
+uint64_t get_windowed_speed(uint64_t current_speed, double new_speed, double window_exp_value);
+void build_windowed_speed_counters(subnet_counter_t* current_speed_element, subnet_counter_t& new_speed_element, double speed_calc_period);
+
 std::string get_amplification_attack_type(amplification_attack_type_t attack_type);
-std::string generate_flow_spec_for_amplification_attack(amplification_attack_type_t amplification_attack_type, std::string destination_ip);
 
 bool we_should_ban_this_entity(subnet_counter_t* average_speed_element,
-                               ban_settings_t& current_ban_settings,
+                               const ban_settings_t& current_ban_settings,
                                attack_detection_threshold_type_t& attack_detection_source,
                                attack_detection_direction_type_t& attack_detection_direction);
 
@@ -40,8 +45,19 @@ std::string print_flow_tracking_for_specified_protocol(contrack_map_type& protoc
 
 void convert_integer_to_conntrack_hash_struct(packed_session* packed_connection_data, packed_conntrack_hash_t* unpacked_data);
 
+void execute_unban_operation();
 void cleanup_ban_list();
 
+bool write_state_checkpoint(const std::string& file_path);
+bool load_state_checkpoint(const std::string& file_path);
+void state_checkpoint_thread();
+
+#ifdef KAFKA
+void export_to_kafka(const simple_packet_t& current_packet);
+void kafka_traffic_export_thread();
+std::vector<system_counter_t> get_kafka_traffic_export_stats();
+#endif
+
 void call_unban_handlers(uint32_t client_ip,
                          subnet_ipv6_cidr_mask_t client_ipv6,
                          bool ipv6,
@@ -54,12 +70,19 @@ std::string print_ddos_attack_details();
 std::string get_attack_description(uint32_t client_ip, attack_details_t& current_attack);
 
 std::string get_attack_description_in_json(uint32_t client_ip, attack_details_t& current_attack);
+std::string get_attack_description_in_json_for_web_hooks(uint32_t client_ip,
+                                                         const subnet_ipv6_cidr_mask_t& client_ipv6,
+                                                         bool ipv6,
+                                                         const std::string& action_type,
+                                                         const attack_details_t& current_attack);
 
 std::string generate_simple_packets_dump(std::vector<simple_packet_t>& ban_list_details);
 
 void send_attack_details(uint32_t client_ip, attack_details_t current_attack_details);
 
 void call_attack_details_handlers(uint32_t client_ip, attack_details_t& current_attack, std::string attack_fingerprint);
+void announce_flow_spec_rules(uint32_t client_ip, const std::vector<simple_packet_t>& simple_packets);
+void withdraw_flow_spec_rules(uint32_t client_ip);
 uint64_t convert_conntrack_hash_struct_to_integer(packed_conntrack_hash_t* struct_value);
 bool process_flow_tracking_table(conntrack_main_struct_t& conntrack_element, std::string client_ip);
 bool exec_with_stdin_params(std::string cmd, std::string params);
@@ -68,9 +91,18 @@ void exabgp_prefix_ban_manage(std::string action, std::string prefix_as_string_w
 
 #ifdef REDIS
 void store_data_in_redis(std::string key_name, std::string attack_details);
+void store_data_in_redis_batch(const std::vector<action_batch_element_t>& batch_elements);
 redisContext* redis_init_connection();
 #endif
 
+void publish_hosts_under_collection();
+void publish_hosts_under_fingerprinting();
+void collect_ban_details_for_host(uint32_t client_ip, simple_packet_t& current_packet);
+void start_attack_fingerprint_collection(uint32_t client_ip);
+void stop_attack_fingerprint_collection(uint32_t client_ip);
+std::shared_ptr<attack_fingerprint_t> get_attack_fingerprint(uint32_t client_ip);
+bool serialize_attack_fingerprint_to_json(const attack_fingerprint_t& attack_fingerprint, nlohmann::json& json_details);
+
 void execute_ip_ban(uint32_t client_ip, subnet_counter_t average_speed_element, std::string flow_attack_details, subnet_cidr_mask_t customer_subnet);
 
 void call_ban_handlers(uint32_t client_ip,
@@ -90,11 +122,17 @@ std::string print_channel_speed_ipv6(std::string traffic_type, direction_t packe
 std::string print_channel_speed(std::string traffic_type, direction_t packet_direction);
 void traffic_draw_ipv4_program();
 void recalculate_speed();
+void recalculate_speed_for_period(double speed_calc_period);
 std::string draw_table_ipv4(direction_t data_direction, bool do_redis_update, sort_type_t sort_item);
 std::string draw_table_ipv6(direction_t data_direction, bool do_redis_update, sort_type_t sort_item);
 void print_screen_contents_into_file(std::string screen_data_stats_param, std::string file_path);
 void zeroify_all_flow_counters();
 void process_packet(simple_packet_t& current_packet);
+void set_packet_arrival_time(simple_packet_t& current_packet);
+void push_packet_to_pipeline(simple_packet_t& current_packet);
+std::vector<system_counter_t> get_packet_pipeline_stats();
+void run_offline_pcap_ingestion();
+std::vector<system_counter_t> get_offline_pcap_ingestion_stats();
 
 void increment_outgoing_counters(subnet_counter_t* current_element,
                                  simple_packet_t& current_packet,
@@ -118,26 +156,23 @@ void increment_incoming_counters(subnet_counter_t* current_element,
                                  uint64_t sampled_number_of_packets,
                                  uint64_t sampled_number_of_bytes);
 
-void increment_outgoing_flow_counters(map_of_vector_counters_for_flow_t& SubnetVectorMapFlow,
+void increment_outgoing_flow_counters(vector_of_flow_counters_t& flow_counters,
                                       int64_t shift_in_vector,
                                       simple_packet_t& packet,
                                       uint64_t sampled_number_of_packets,
-                                      uint64_t sampled_number_of_bytes,
-                                      const subnet_cidr_mask_t& current_subnet);
+                                      uint64_t sampled_number_of_bytes);
 
-void increment_incoming_flow_counters(map_of_vector_counters_for_flow_t& SubnetVectorMapFlow,
+void increment_incoming_flow_counters(vector_of_flow_counters_t& flow_counters,
                                       int64_t shift_in_vector,
                                       simple_packet_t& packet,
                                       uint64_t sampled_number_of_packets,
-                                      uint64_t sampled_number_of_bytes,
-                                      const subnet_cidr_mask_t& current_subnet);
+                                      uint64_t sampled_number_of_bytes);
 
 void traffic_draw_ipv6_program();
 void check_traffic_buckets();
 void process_filled_buckets_ipv6();
 template <typename TemplatedKeyType>
 bool should_remove_orphaned_bucket(const std::pair<TemplatedKeyType, packet_bucket_t>& pair);
-void inaccurate_time_generator();
 void collect_stats();
 void start_prometheus_web_server();
 
@@ -159,4 +194,10 @@ class FastnetmonApiServiceImpl final : public Fastnetmon::Service {
     Status ExecuteUnBan(ServerContext* context,
                         const fastmitigation::ExecuteBanRequest* request,
                         fastmitigation::ExecuteBanReply* reply) override;
+    Status ReloadNetworks(ServerContext* context,
+                          const fastmitigation::ReloadNetworksRequest* request,
+                          fastmitigation::ReloadNetworksReply* reply) override;
+    Status GetStageLatency(ServerContext* context,
+                           const fastmitigation::StageLatencyRequest* request,
+                           ::grpc::ServerWriter<fastmitigation::StageLatencyReply>* writer) override;
 };
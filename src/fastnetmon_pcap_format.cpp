@@ -1,81 +1,382 @@
 #include "fastnetmon_pcap_format.hpp"
+#include <byteswap.h>
 #include <errno.h>
 #include <string.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <vector>
 
 int pcap_reader(const char* pcap_file_path, pcap_packet_parser_callback pcap_parse_packet_function_ptr) {
-    int filedesc = open(pcap_file_path, O_RDONLY);
+    pcap_file_mapping_t pcap_file_mapping;
+    std::string error_text;
 
-    if (filedesc <= 0) {
-        printf("Can't open dump file, error: %s\n", strerror(errno));
+    // We map whole file instead of two read calls for each packet
+    if (!pcap_file_mapping.open(pcap_file_path, error_text)) {
+        printf("%s\n", error_text.c_str());
         return -1;
     }
 
-    struct fastnetmon_pcap_file_header pcap_header;
-    ssize_t file_header_readed_bytes = read(filedesc, &pcap_header, sizeof(struct fastnetmon_pcap_file_header));
+    unsigned int read_packets = 0;
+
+    bool dump_is_complete =
+        pcap_file_mapping.for_each_packet([&](const fastnetmon_pcap_pkthdr& packet_header, uint8_t* packet) {
+            pcap_parse_packet_function_ptr((char*)packet, packet_header.orig_len, packet_header.incl_len);
+            read_packets++;
+        });
+
+    if (!dump_is_complete) {
+        printf("Dump ends in the middle of packet\n");
+        return -3;
+    }
+
+    printf("I correctly read %d packets from this dump\n", read_packets);
+
+    return 0;
+}
+
+bool fill_pcap_header(struct fastnetmon_pcap_file_header* pcap_header, bpf_u_int32 snap_length) {
+    pcap_header->magic         = 0xa1b2c3d4;
+    pcap_header->version_major = 2;
+    pcap_header->version_minor = 4;
+    pcap_header->thiszone      = 0;
+    pcap_header->sigfigs       = 0;
+    // TODO: fix this!!!
+    pcap_header->snaplen = snap_length;
+    // http://www.tcpdump.org/linktypes.html
+    // DLT_EN10MB = 1
+    pcap_header->linktype = 1;
+
+    return true;
+}
+
+// pcapng format: https://www.ietf.org/archive/id/draft-ietf-opsawg-pcapng-01.html
+const uint32_t pcapng_section_header_block        = 0x0A0D0D0A;
+const uint32_t pcapng_interface_block             = 0x00000001;
+const uint32_t pcapng_simple_packet_block         = 0x00000003;
+const uint32_t pcapng_enhanced_packet_block       = 0x00000006;
+const uint32_t pcapng_byte_order_magic            = 0x1A2B3C4D;
+const uint16_t pcapng_option_end                  = 0;
+const uint16_t pcapng_option_timestamp_resolution = 9;
+
+// Information about capture interface from interface description block
+class pcapng_interface_t {
+    public:
+    uint32_t linktype = 0;
+    uint32_t snaplen  = 0;
+
+    // Timestamp units per second
+    uint64_t timestamp_units = 1000000;
+};
+
+pcap_file_mapping_t::~pcap_file_mapping_t() {
+    if (mapping != nullptr) {
+        munmap(mapping, mapping_size);
+    }
+}
+
+bool pcap_file_mapping_t::open(const std::string& pcap_file_path, std::string& error_text) {
+    int file_descriptor = ::open(pcap_file_path.c_str(), O_RDONLY);
 
-    if (file_header_readed_bytes != sizeof(struct fastnetmon_pcap_file_header)) {
-        printf("Can't read pcap file header");
+    if (file_descriptor < 0) {
+        error_text = "Can't open dump file, error: " + std::string(strerror(errno));
+        return false;
+    }
+
+    struct stat file_stat;
+
+    if (fstat(file_descriptor, &file_stat) != 0) {
+        error_text = "Can't get size of dump file, error: " + std::string(strerror(errno));
+        close(file_descriptor);
+        return false;
+    }
+
+    if (size_t(file_stat.st_size) < sizeof(fastnetmon_pcap_file_header)) {
+        error_text = "Dump file is shorter than pcap file header";
+        close(file_descriptor);
+        return false;
+    }
+
+    void* file_mapping = mmap(NULL, file_stat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file_descriptor, 0);
+
+    // Mapping keeps file open for us
+    close(file_descriptor);
+
+    if (file_mapping == MAP_FAILED) {
+        error_text = "Can't map dump file, error: " + std::string(strerror(errno));
+        return false;
+    }
+
+    mapping      = (uint8_t*)file_mapping;
+    mapping_size = file_stat.st_size;
+
+    // We read file sequentially
+    madvise(mapping, mapping_size, MADV_SEQUENTIAL);
+
+    memcpy(&file_header, mapping, sizeof(file_header));
+
+    if (file_header.magic == pcapng_section_header_block) {
+        pcapng = true;
+
+        return read_pcapng_first_interface(error_text);
     }
 
     // http://www.tcpdump.org/manpages/pcap-savefile.5.html
-    if (pcap_header.magic == 0xa1b2c3d4 or pcap_header.magic == 0xd4c3b2a1) {
-        // printf("Magic readed correctly\n");
+    if (file_header.magic == 0xa1b2c3d4 || file_header.magic == 0xa1b23c4d) {
+        swapped_byte_order = false;
+    } else if (file_header.magic == 0xd4c3b2a1 || file_header.magic == 0x4d3cb2a1) {
+        swapped_byte_order   = true;
+        file_header.magic    = bswap_32(file_header.magic);
+        file_header.snaplen  = bswap_32(file_header.snaplen);
+        file_header.linktype = bswap_32(file_header.linktype);
     } else {
-        printf("Magic in file header broken\n");
-        return -2;
+        error_text = "Magic in file header broken";
+        return false;
     }
 
-    // Buffer for packets
-    char packet_buffer[pcap_header.snaplen];
+    nanosecond_timestamps = file_header.magic == 0xa1b23c4d;
 
-    unsigned int read_packets = 0;
-    while (1) {
-        // printf("Start packet %d processing\n", read_packets);
-        struct fastnetmon_pcap_pkthdr pcap_packet_header;
-        ssize_t packet_header_readed_bytes = read(filedesc, &pcap_packet_header, sizeof(struct fastnetmon_pcap_pkthdr));
+    return true;
+}
 
-        if (packet_header_readed_bytes != sizeof(struct fastnetmon_pcap_pkthdr)) {
-            // We haven't any packets
-            break;
+bool pcap_file_mapping_t::for_each_packet(const packet_callback_t& callback) {
+    if (pcapng) {
+        return for_each_pcapng_packet(callback);
+    }
+
+    return for_each_pcap_packet(callback);
+}
+
+void pcap_file_mapping_t::release_processed_data(const uint8_t* processed_until) {
+    if (processed_until < mapping || processed_until > mapping + mapping_size) {
+        return;
+    }
+
+    size_t page_size = sysconf(_SC_PAGESIZE);
+
+    // We could release only whole pages
+    size_t processed_size = (processed_until - mapping) / page_size * page_size;
+
+    if (processed_size <= released_size) {
+        return;
+    }
+
+    // For private mapping kernel drops our modified copies and we will read file again if we touch these pages
+    madvise(mapping + released_size, processed_size - released_size, MADV_DONTNEED);
+
+    released_size = processed_size;
+}
+
+bool pcap_file_mapping_t::for_each_pcap_packet(const packet_callback_t& callback) {
+    size_t offset = sizeof(fastnetmon_pcap_file_header);
+
+    while (offset < mapping_size) {
+        if (offset + sizeof(fastnetmon_pcap_pkthdr) > mapping_size) {
+            return false;
+        }
+
+        fastnetmon_pcap_pkthdr packet_header;
+        memcpy(&packet_header, mapping + offset, sizeof(packet_header));
+
+        if (swapped_byte_order) {
+            packet_header.ts_sec   = bswap_32(packet_header.ts_sec);
+            packet_header.ts_usec  = bswap_32(packet_header.ts_usec);
+            packet_header.incl_len = bswap_32(packet_header.incl_len);
+            packet_header.orig_len = bswap_32(packet_header.orig_len);
         }
 
-        if (pcap_packet_header.incl_len > pcap_header.snaplen) {
-            printf("Please enlarge packet buffer! We got packet with size: %d but our buffer is %d "
-                   "bytes\n",
-                   pcap_packet_header.incl_len, pcap_header.snaplen);
-            return -4;
+        if (nanosecond_timestamps) {
+            packet_header.ts_usec /= 1000;
         }
 
-        ssize_t packet_payload_readed_bytes = read(filedesc, packet_buffer, pcap_packet_header.incl_len);
+        offset += sizeof(fastnetmon_pcap_pkthdr);
 
-        if (pcap_packet_header.incl_len != packet_payload_readed_bytes) {
-            printf("I read packet header but can't read packet payload\n");
-            return -3;
+        if (offset + packet_header.incl_len > mapping_size) {
+            return false;
         }
 
-        // printf("packet payload read\n");
-        pcap_parse_packet_function_ptr(packet_buffer, pcap_packet_header.orig_len, pcap_packet_header.incl_len);
+        callback(packet_header, mapping + offset);
 
-        // printf("Process packet %d\n", read_packets);
-        read_packets++;
+        offset += packet_header.incl_len;
     }
 
-    printf("I correctly read %d packets from this dump\n", read_packets);
+    return true;
+}
 
-    return 0;
+// Reads 32 bit field of pcapng block
+static uint32_t read_pcapng_uint32(const uint8_t* pointer, bool swapped_byte_order) {
+    uint32_t value = 0;
+    memcpy(&value, pointer, sizeof(value));
+
+    return swapped_byte_order ? bswap_32(value) : value;
 }
 
-bool fill_pcap_header(struct fastnetmon_pcap_file_header* pcap_header, bpf_u_int32 snap_length) {
-    pcap_header->magic         = 0xa1b2c3d4;
-    pcap_header->version_major = 2;
-    pcap_header->version_minor = 4;
-    pcap_header->thiszone      = 0;
-    pcap_header->sigfigs       = 0;
-    // TODO: fix this!!!
-    pcap_header->snaplen = snap_length;
-    // http://www.tcpdump.org/linktypes.html
-    // DLT_EN10MB = 1
-    pcap_header->linktype = 1;
+static uint16_t read_pcapng_uint16(const uint8_t* pointer, bool swapped_byte_order) {
+    uint16_t value = 0;
+    memcpy(&value, pointer, sizeof(value));
+
+    return swapped_byte_order ? bswap_16(value) : value;
+}
+
+// Parses interface description block body
+static void parse_pcapng_interface(const uint8_t* body, size_t body_length, bool swapped_byte_order, pcapng_interface_t& pcapng_interface) {
+    if (body_length < 8) {
+        return;
+    }
+
+    pcapng_interface.linktype = read_pcapng_uint16(body, swapped_byte_order);
+    pcapng_interface.snaplen  = read_pcapng_uint32(body + 4, swapped_byte_order);
+
+    size_t option_offset = 8;
+
+    while (option_offset + 4 <= body_length) {
+        uint16_t option_code   = read_pcapng_uint16(body + option_offset, swapped_byte_order);
+        uint16_t option_length = read_pcapng_uint16(body + option_offset + 2, swapped_byte_order);
+
+        if (option_code == pcapng_option_end || option_offset + 4 + option_length > body_length) {
+            break;
+        }
+
+        if (option_code == pcapng_option_timestamp_resolution && option_length >= 1) {
+            uint8_t resolution = body[option_offset + 4];
+
+            // Most significant bit selects power of 2 instead of power of 10
+            uint64_t base    = resolution & 0x80 ? 2 : 10;
+            uint8_t exponent = resolution & 0x7f;
+            uint64_t units   = 1;
+
+            for (uint8_t i = 0; i < exponent && units < UINT64_MAX / base; i++) {
+                units *= base;
+            }
+
+            pcapng_interface.timestamp_units = units;
+        }
+
+        // Options are padded to 32 bits
+        option_offset += 4 + ((option_length + 3) & ~3);
+    }
+}
+
+bool pcap_file_mapping_t::read_pcapng_first_interface(std::string& error_text) {
+    bool section_swapped_byte_order = false;
+    size_t offset                   = 0;
+
+    while (offset + 12 <= mapping_size) {
+        uint32_t block_type = read_pcapng_uint32(mapping + offset, false);
+
+        if (block_type == pcapng_section_header_block) {
+            uint32_t byte_order_magic = read_pcapng_uint32(mapping + offset + 8, false);
+
+            if (byte_order_magic == pcapng_byte_order_magic) {
+                section_swapped_byte_order = false;
+            } else if (byte_order_magic == bswap_32(pcapng_byte_order_magic)) {
+                section_swapped_byte_order = true;
+            } else {
+                error_text = "Byte order magic in pcapng section header broken";
+                return false;
+            }
+        }
+
+        uint32_t block_length = read_pcapng_uint32(mapping + offset + 4, section_swapped_byte_order);
+
+        if (block_length < 12 || offset + block_length > mapping_size) {
+            error_text = "pcapng block with broken length";
+            return false;
+        }
+
+        if (block_type == pcapng_interface_block) {
+            pcapng_interface_t pcapng_interface;
+            parse_pcapng_interface(mapping + offset + 8, block_length - 12, section_swapped_byte_order, pcapng_interface);
+
+            file_header.linktype = pcapng_interface.linktype;
+            file_header.snaplen  = pcapng_interface.snaplen;
+
+            return true;
+        }
+
+        offset += block_length;
+    }
+
+    error_text = "pcapng file has no interface description blocks";
+    return false;
+}
+
+bool pcap_file_mapping_t::for_each_pcapng_packet(const packet_callback_t& callback) {
+    // Each section has own byte order and interfaces
+    bool section_swapped_byte_order = false;
+    std::vector<pcapng_interface_t> interfaces;
+
+    size_t offset = 0;
+
+    while (offset < mapping_size) {
+        if (offset + 12 > mapping_size) {
+            return false;
+        }
+
+        uint32_t block_type = read_pcapng_uint32(mapping + offset, false);
+
+        if (block_type == pcapng_section_header_block) {
+            uint32_t byte_order_magic = read_pcapng_uint32(mapping + offset + 8, false);
+
+            section_swapped_byte_order = byte_order_magic != pcapng_byte_order_magic;
+            interfaces.clear();
+        } else if (section_swapped_byte_order) {
+            block_type = bswap_32(block_type);
+        }
+
+        uint32_t block_length = read_pcapng_uint32(mapping + offset + 4, section_swapped_byte_order);
+
+        if (block_length < 12 || offset + block_length > mapping_size) {
+            return false;
+        }
+
+        uint8_t* body      = mapping + offset + 8;
+        size_t body_length = block_length - 12;
+
+        if (block_type == pcapng_interface_block) {
+            pcapng_interface_t pcapng_interface;
+            parse_pcapng_interface(body, body_length, section_swapped_byte_order, pcapng_interface);
+
+            interfaces.push_back(pcapng_interface);
+        } else if (block_type == pcapng_enhanced_packet_block && body_length >= 20) {
+            uint32_t interface_id = read_pcapng_uint32(body, section_swapped_byte_order);
+
+            uint64_t timestamp = (uint64_t(read_pcapng_uint32(body + 4, section_swapped_byte_order)) << 32) |
+                                 read_pcapng_uint32(body + 8, section_swapped_byte_order);
+
+            fastnetmon_pcap_pkthdr packet_header;
+            packet_header.incl_len = read_pcapng_uint32(body + 12, section_swapped_byte_order);
+            packet_header.orig_len = read_pcapng_uint32(body + 16, section_swapped_byte_order);
+
+            if (packet_header.incl_len > body_length - 20) {
+                return false;
+            }
+
+            if (interface_id >= interfaces.size() || interfaces[interface_id].linktype != file_header.linktype) {
+                skipped_packets++;
+            } else {
+                uint64_t timestamp_units = interfaces[interface_id].timestamp_units;
+
+                packet_header.ts_sec  = uint32_t(timestamp / timestamp_units);
+                packet_header.ts_usec = uint32_t((unsigned __int128)(timestamp % timestamp_units) * 1000000 / timestamp_units);
+
+                callback(packet_header, body + 20);
+            }
+        } else if (block_type == pcapng_simple_packet_block && body_length >= 4) {
+            // Simple packets have no timestamps and belong to first interface
+            fastnetmon_pcap_pkthdr packet_header{};
+            packet_header.orig_len = read_pcapng_uint32(body, section_swapped_byte_order);
+            packet_header.incl_len = std::min(packet_header.orig_len, uint32_t(body_length - 4));
+
+            if (interfaces.empty() || interfaces[0].linktype != file_header.linktype) {
+                skipped_packets++;
+            } else {
+                callback(packet_header, body + 4);
+            }
+        }
+
+        offset += block_length;
+    }
 
     return true;
 }
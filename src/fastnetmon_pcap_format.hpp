@@ -10,6 +10,9 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <functional>
+#include <string>
+
 /*
    pcap dump format:
     global header: struct pcap_file_header
@@ -65,4 +68,66 @@ int pcap_reader(const char* pcap_file_path, pcap_packet_parser_callback pcap_par
 
 bool fill_pcap_header(struct fastnetmon_pcap_file_header* pcap_header, bpf_u_int32 snap_length);
 
+// Whole pcap or pcapng file mapped to memory for offline processing without copies
+// We map it as private copy because our parsers convert headers in place
+class pcap_file_mapping_t {
+    public:
+    typedef std::function<void(const fastnetmon_pcap_pkthdr& packet_header, uint8_t* packet)> packet_callback_t;
+
+    pcap_file_mapping_t() {
+    }
+
+    ~pcap_file_mapping_t();
+
+    pcap_file_mapping_t(const pcap_file_mapping_t&) = delete;
+    pcap_file_mapping_t& operator=(const pcap_file_mapping_t&) = delete;
+
+    bool open(const std::string& pcap_file_path, std::string& error_text);
+
+    // For pcapng we report link type and snaplen of first interface
+    const fastnetmon_pcap_file_header& get_file_header() const {
+        return file_header;
+    }
+
+    // Calls callback for each packet in file, returns false when file ends in the middle of packet
+    // Packet headers are converted to host byte order and timestamps to microseconds
+    // For pcapng we skip packets from interfaces with link type different from link type of first interface
+    bool for_each_packet(const packet_callback_t& callback);
+
+    // Returns pages of our private copy which we do not need anymore back to kernel
+    // Without it all pages modified by parsers stay in memory until we unmap file
+    void release_processed_data(const uint8_t* processed_until);
+
+    bool is_pcapng() const {
+        return pcapng;
+    }
+
+    uint64_t get_skipped_packets() const {
+        return skipped_packets;
+    }
+
+    private:
+    bool for_each_pcap_packet(const packet_callback_t& callback);
+    bool for_each_pcapng_packet(const packet_callback_t& callback);
+    bool read_pcapng_first_interface(std::string& error_text);
+
+    uint8_t* mapping    = nullptr;
+    size_t mapping_size = 0;
+
+    // Size of prefix of mapping which we returned to kernel
+    size_t released_size = 0;
+
+    // File was written on host with another byte order
+    bool swapped_byte_order = false;
+
+    // pcap file with nanosecond timestamps
+    bool nanosecond_timestamps = false;
+
+    bool pcapng = false;
+
+    uint64_t skipped_packets = 0;
+
+    fastnetmon_pcap_file_header file_header{};
+};
+
 #endif
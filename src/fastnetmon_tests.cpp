@@ -5,7 +5,32 @@
 
 #include "bgp_protocol.hpp"
 
+#include "action_dispatcher.hpp"
+#include "attack_fingerprint.hpp"
+#include "ban_list.hpp"
+#include "compact_packet_record.hpp"
+#include "counters_allocator.hpp"
+#include "counters_epoch.hpp"
+#include "counters_storage.hpp"
+#include "fast_time.hpp"
+#include "fastnetmon_pcap_format.hpp"
+#include "flow_spec_generator.hpp"
+#include "flow_tracking.hpp"
+#include "ipfix_rfc.hpp"
+#include "netflow_plugin/netflow.hpp"
+#include "packet_capture_slab.hpp"
+#include "ipv4_host_set.hpp"
+#include "packet_pipeline.hpp"
+#include "parallel_executor.hpp"
+#include "per_thread_counters.hpp"
+#include "rcu_pointer.hpp"
+#include "stage_latency.hpp"
+#include "state_checkpoint.hpp"
+#include "timer_wheel.hpp"
+#include "traffic_generator_plugin/traffic_generator.hpp"
+
 #include <fstream>
+#include <thread>
 
 #include "log4cpp/Appender.hh"
 #include "log4cpp/BasicLayout.hh"
@@ -20,6 +45,9 @@
 
 log4cpp::Category& logger = log4cpp::Category::getRoot();
 
+// Netflow code uses it to print templates
+ipfix_information_database ipfix_db_instance;
+
 // Flow Spec actions tests
 
 TEST(BgpFlowSpecAction, rate_limit) {
@@ -50,6 +78,79 @@ TEST(BgpFlowSpecAction, default_constructor) {
     EXPECT_EQ(my_action.serialize(), "accept;");
 }
 
+TEST(BgpFlowSpecRule, exabgp_serialization) {
+    flow_spec_rule_t rule;
+
+    rule.set_destination_subnet(subnet_cidr_mask_t(inet_addr("10.0.0.1"), 32));
+    rule.add_protocol(FLOW_SPEC_PROTOCOL_UDP);
+    rule.add_source_port(123);
+    rule.add_packet_length_range(400, 500);
+
+    bgp_flow_spec_action_t action;
+    action.set_type(FLOW_SPEC_ACTION_DISCARD);
+    rule.set_action(action);
+
+    EXPECT_EQ(serialize_flow_spec_rule_for_exabgp(rule, false),
+              "announce flow route { match { destination 10.0.0.1/32; protocol [ udp ]; source-port [ =123 ]; "
+              "packet-length [ >=400&<=500 ]; } then { discard; } }\n");
+}
+
+TEST(flow_spec_generator, amplification_and_fragments) {
+    std::vector<simple_packet_t> packets;
+
+    // NTP amplification to random ports with some fragments and small amount of legitimate traffic
+    for (unsigned int i = 0; i < 80; i++) {
+        simple_packet_t packet;
+        packet.protocol         = IPPROTO_UDP;
+        packet.source_port      = 123;
+        packet.destination_port = 1024 + i;
+        packet.ip_length        = 468 + i % 2;
+        packets.push_back(packet);
+    }
+
+    for (unsigned int i = 0; i < 17; i++) {
+        simple_packet_t packet;
+        packet.protocol      = IPPROTO_UDP;
+        packet.ip_fragmented = true;
+        packet.ip_length     = 1500;
+        packets.push_back(packet);
+    }
+
+    for (unsigned int i = 0; i < 3; i++) {
+        simple_packet_t packet;
+        packet.protocol         = IPPROTO_TCP;
+        packet.source_port      = 50000 + i;
+        packet.destination_port = 443;
+        packet.ip_length        = 60;
+        packets.push_back(packet);
+    }
+
+    flow_spec_generator_configuration_t configuration;
+    flow_spec_generator_t flow_spec_generator(configuration);
+
+    std::vector<flow_spec_signature_t> signatures = flow_spec_generator.get_signatures(packets);
+
+    // TCP traffic is below coverage threshold and we do not need rule for it
+    ASSERT_EQ(signatures.size(), 2);
+
+    EXPECT_EQ(signatures[0].protocol, IPPROTO_UDP);
+    EXPECT_TRUE(signatures[0].source_port_used);
+    EXPECT_EQ(signatures[0].source_port, 123);
+    EXPECT_FALSE(signatures[0].destination_port_used);
+    EXPECT_EQ(signatures[0].minimum_packet_length, 468);
+    EXPECT_EQ(signatures[0].maximum_packet_length, 469);
+    EXPECT_EQ(signatures[0].packets, 80);
+
+    EXPECT_TRUE(signatures[1].fragmented);
+    EXPECT_FALSE(signatures[1].source_port_used);
+
+    std::vector<flow_spec_rule_t> rules =
+        flow_spec_generator.get_rules(signatures, subnet_cidr_mask_t(inet_addr("10.0.0.1"), 32), bgp_flow_spec_action_t{});
+
+    ASSERT_EQ(rules.size(), 2);
+    EXPECT_EQ(rules[1].get_fragmentation_flags().size(), 1);
+}
+
 // Serializers tests
 
 TEST(serialize_vector_by_string, single_element) {
@@ -146,3 +247,1160 @@ TEST(serialize_attack_description, blank_attack) {
                       "packets per second\nOutgoing icmp pps: 0 packets per second\n");
 }
 
+
+TEST(space_saving_sketch, keeps_heavy_hitters) {
+    space_saving_sketch_t<uint32_t> sketch(4);
+
+    // Two heavy hitters mixed with many rare elements
+    for (uint32_t i = 0; i < 1000; i++) {
+        sketch.add(1, 10);
+        sketch.add(2, 5);
+        sketch.add(1000 + i, 1);
+    }
+
+    auto top_elements = sketch.get_top(2);
+
+    ASSERT_EQ(top_elements.size(), 2);
+    EXPECT_EQ(top_elements[0].key, 1);
+    EXPECT_EQ(top_elements[1].key, 2);
+    EXPECT_EQ(sketch.get_total_weight(), 16000);
+}
+
+TEST(space_saving_sketch, exact_for_small_number_of_keys) {
+    space_saving_sketch_t<uint16_t> sketch(16);
+
+    sketch.add(53, 3);
+    sketch.add(123, 7);
+    sketch.add(53, 1);
+
+    auto top_elements = sketch.get_top(10);
+
+    ASSERT_EQ(top_elements.size(), 2);
+    EXPECT_EQ(top_elements[0].key, 123);
+    EXPECT_EQ(top_elements[0].count, 7);
+    EXPECT_EQ(top_elements[1].count, 4);
+    EXPECT_EQ(top_elements[1].error, 0);
+}
+
+TEST(space_saving_sketch, bounds_after_replacements) {
+    space_saving_sketch_t<uint32_t> sketch(8);
+    std::map<uint32_t, uint64_t> real_counts;
+
+    // Skewed stream with lots of replacements
+    for (uint32_t i = 0; i < 10000; i++) {
+        uint32_t key = i % 3 == 0 ? i % 5 : (i * 2654435761u) % 97;
+
+        sketch.add(key, 1 + key % 3);
+        real_counts[key] += 1 + key % 3;
+    }
+
+    for (const auto& element : sketch.get_top(8)) {
+        EXPECT_GE(element.count, real_counts[element.key]);
+        EXPECT_LE(element.count - element.error, real_counts[element.key]);
+    }
+
+    // Each key below it would be evicted earlier
+    EXPECT_GT(sketch.get_minimal_count(), 0);
+}
+
+TEST(space_saving_sketch, merge_snapshots) {
+    space_saving_sketch_t<uint16_t> first_sketch(3);
+    space_saving_sketch_t<uint16_t> second_sketch(3);
+
+    first_sketch.add(80, 10);
+    first_sketch.add(443, 5);
+    first_sketch.add(22, 1);
+
+    second_sketch.add(80, 7);
+    second_sketch.add(53, 2);
+    second_sketch.add(123, 1);
+
+    auto top_elements =
+        merge_heavy_hitters_snapshots<uint16_t>({ first_sketch.get_snapshot(), second_sketch.get_snapshot() }, 2);
+
+    ASSERT_EQ(top_elements.size(), 2);
+    EXPECT_EQ(top_elements[0].key, 80);
+    EXPECT_EQ(top_elements[0].count, 17);
+    EXPECT_EQ(top_elements[0].error, 0);
+
+    // Second sketch is full and 443 could be evicted from it with up to 1 packet
+    EXPECT_EQ(top_elements[1].key, 443);
+    EXPECT_EQ(top_elements[1].count, 6);
+    EXPECT_EQ(top_elements[1].error, 1);
+}
+
+TEST(attack_fingerprint, merges_thread_copies) {
+    attack_fingerprint_t attack_fingerprint(16);
+
+    std::vector<std::thread> threads;
+
+    for (unsigned int thread_number = 0; thread_number < 4; thread_number++) {
+        threads.emplace_back([&attack_fingerprint, thread_number]() {
+            simple_packet_t packet;
+            packet.packet_direction = INCOMING;
+            packet.protocol         = IPPROTO_UDP;
+            packet.source_port      = 53;
+            packet.destination_port = 1024 + thread_number;
+
+            for (uint32_t i = 0; i < 1000; i++) {
+                packet.src_ip = i % 2 == 0 ? 1 : 100 + i % 10;
+                attack_fingerprint.add_packet(packet, 1);
+            }
+        });
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    attack_fingerprint_summary_t summary = attack_fingerprint.get_summary(3);
+
+    EXPECT_EQ(summary.total_packets, 4000);
+
+    ASSERT_EQ(summary.top_peer_ips.size(), 3);
+    EXPECT_EQ(summary.top_peer_ips[0].key, 1);
+    EXPECT_EQ(summary.top_peer_ips[0].count, 2000);
+
+    ASSERT_EQ(summary.top_source_ports.size(), 1);
+    EXPECT_EQ(summary.top_source_ports[0].count, 4000);
+}
+
+TEST(ipv4_host_set, lookup) {
+    std::vector<uint32_t> hosts;
+
+    for (uint32_t i = 1; i <= 100; i++) {
+        hosts.push_back(i * 7);
+    }
+
+    ipv4_host_set_t host_set(hosts);
+
+    EXPECT_EQ(host_set.size(), 100);
+    EXPECT_TRUE(host_set.contains(7));
+    EXPECT_TRUE(host_set.contains(700));
+    EXPECT_FALSE(host_set.contains(8));
+    EXPECT_FALSE(host_set.contains(0));
+}
+
+TEST(rcu_ipv4_host_set, publish) {
+    rcu_ipv4_host_set_t host_set;
+
+    EXPECT_TRUE(host_set.empty());
+    EXPECT_FALSE(host_set.contains(1));
+
+    host_set.publish({ 1, 2 });
+    EXPECT_TRUE(host_set.contains(2));
+
+    host_set.publish({ 3 });
+    EXPECT_FALSE(host_set.contains(2));
+    EXPECT_TRUE(host_set.contains(3));
+}
+
+TEST(parallel_executor, runs_all_tasks) {
+    parallel_executor_t executor;
+    executor.set_number_of_workers(3);
+
+    boost::thread_group workers;
+
+    for (size_t worker_index = 1; worker_index < 3; worker_index++) {
+        workers.create_thread([&executor, worker_index]() { executor.run_worker(worker_index); });
+    }
+
+    std::vector<std::atomic<uint64_t>> results(1000);
+
+    // Second batch checks that workers wait for new batch
+    for (int batch = 0; batch < 2; batch++) {
+        executor.run(results.size(), [&](size_t task_index, size_t worker_index) { results[task_index] += task_index; });
+    }
+
+    workers.interrupt_all();
+    workers.join_all();
+
+    EXPECT_EQ(results[999], 999 * 2);
+}
+
+TEST(action_dispatcher, ordered_backend_is_not_blocked_by_scripts) {
+    action_dispatcher_t action_dispatcher;
+    action_dispatcher.set_maximum_batch_size(1);
+
+    std::mutex exabgp_messages_mutex;
+    std::vector<std::string> exabgp_messages;
+
+    action_dispatcher.register_batch_handler(action_backend_t::ExaBGP, [&](const std::vector<action_batch_element_t>& batch_elements) {
+        std::lock_guard<std::mutex> lock_guard(exabgp_messages_mutex);
+
+        for (const auto& batch_element : batch_elements) {
+            exabgp_messages.push_back(batch_element.value);
+        }
+    });
+
+    boost::thread_group workers;
+
+    for (auto backend : { action_backend_t::Script, action_backend_t::ExaBGP }) {
+        workers.create_thread([&action_dispatcher, backend]() { action_dispatcher.run_worker(backend); });
+    }
+
+    // Hung notify script
+    std::atomic<bool> script_released{ false };
+
+    action_dispatcher.enqueue(action_backend_t::Script, [&script_released]() {
+        while (!script_released) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    for (int i = 0; i < 10; i++) {
+        action_dispatcher.enqueue_batched(action_backend_t::ExaBGP, action_batch_element_t("", "announce " + std::to_string(i)));
+        action_dispatcher.enqueue_batched(action_backend_t::ExaBGP, action_batch_element_t("", "withdraw " + std::to_string(i)));
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+    while (std::chrono::steady_clock::now() < deadline) {
+        {
+            std::lock_guard<std::mutex> lock_guard(exabgp_messages_mutex);
+
+            if (exabgp_messages.size() == 20) {
+                break;
+            }
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    script_released = true;
+
+    workers.interrupt_all();
+    workers.join_all();
+
+    ASSERT_EQ(exabgp_messages.size(), 20);
+
+    for (int i = 0; i < 10; i++) {
+        EXPECT_EQ(exabgp_messages[i * 2], "announce " + std::to_string(i));
+        EXPECT_EQ(exabgp_messages[i * 2 + 1], "withdraw " + std::to_string(i));
+    }
+}
+
+TEST(action_dispatcher, full_queue_does_not_drop_withdrawals) {
+    action_dispatcher_t action_dispatcher;
+    action_dispatcher.set_queue_capacity(2);
+    action_dispatcher.set_maximum_batch_size(1);
+
+    std::mutex exabgp_messages_mutex;
+    std::vector<std::string> exabgp_messages;
+
+    // Slow ExaBGP pipe
+    action_dispatcher.register_batch_handler(action_backend_t::ExaBGP, [&](const std::vector<action_batch_element_t>& batch_elements) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        std::lock_guard<std::mutex> lock_guard(exabgp_messages_mutex);
+
+        for (const auto& batch_element : batch_elements) {
+            exabgp_messages.push_back(batch_element.value);
+        }
+    });
+
+    boost::thread worker([&action_dispatcher]() { action_dispatcher.run_worker(action_backend_t::ExaBGP); });
+
+    for (int i = 0; i < 20; i++) {
+        EXPECT_TRUE(action_dispatcher.enqueue_batched(action_backend_t::ExaBGP, action_batch_element_t("", "announce " + std::to_string(i))));
+        EXPECT_TRUE(action_dispatcher.enqueue_batched(action_backend_t::ExaBGP, action_batch_element_t("", "withdraw " + std::to_string(i))));
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+    while (std::chrono::steady_clock::now() < deadline) {
+        {
+            std::lock_guard<std::mutex> lock_guard(exabgp_messages_mutex);
+
+            if (exabgp_messages.size() == 40) {
+                break;
+            }
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    worker.interrupt();
+    worker.join();
+
+    ASSERT_EQ(exabgp_messages.size(), 40);
+    EXPECT_EQ(exabgp_messages.back(), "withdraw 19");
+
+    // Notify scripts are still dropped when queue is full
+    EXPECT_TRUE(action_dispatcher.enqueue(action_backend_t::Script, []() {}));
+    EXPECT_TRUE(action_dispatcher.enqueue(action_backend_t::Script, []() {}));
+    EXPECT_FALSE(action_dispatcher.enqueue(action_backend_t::Script, []() {}));
+}
+
+TEST(counters_epoch, flip) {
+    counters_epoch_t counters_epoch;
+    std::atomic<uint64_t> counters[2]{};
+
+    std::thread writer([&]() {
+        for (int i = 0; i < 100000; i++) {
+            counters_epoch_guard_t counters_epoch_guard(counters_epoch);
+            counters[counters_epoch_guard.get_generation()]++;
+        }
+    });
+
+    uint64_t total = 0;
+
+    // Nobody increments previous generation after flip and we could reset it
+    for (int i = 0; i < 100; i++) {
+        unsigned int inactive_generation = counters_epoch.flip();
+        total += counters[inactive_generation].exchange(0);
+    }
+
+    writer.join();
+
+    total += counters[0] + counters[1];
+
+    EXPECT_EQ(total, 100000);
+}
+
+std::atomic<uint64_t> packet_pipeline_processed_bytes{ 0 };
+
+void count_packet_pipeline_bytes(simple_packet_t& current_packet) {
+    packet_pipeline_processed_bytes += current_packet.length;
+}
+
+TEST(packet_pipeline, processes_all_packets) {
+    packet_pipeline_t packet_pipeline;
+    packet_pipeline.set_configuration(2, 1024);
+
+    boost::thread_group processing_threads;
+
+    for (size_t processing_thread_index = 0; processing_thread_index < 2; processing_thread_index++) {
+        processing_threads.create_thread([&packet_pipeline, processing_thread_index]() {
+            packet_pipeline.run_processing_thread(processing_thread_index, count_packet_pipeline_bytes);
+        });
+    }
+
+    simple_packet_t current_packet;
+    current_packet.length = 1;
+
+    for (uint32_t i = 0; i < 1000; i++) {
+        current_packet.dst_ip = i;
+        packet_pipeline.push(current_packet);
+    }
+
+    while (packet_pipeline.get_processed_packets() < 1000) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+
+    processing_threads.interrupt_all();
+    processing_threads.join_all();
+
+    EXPECT_EQ(packet_pipeline.get_pushed_packets(), 1000);
+    EXPECT_EQ(packet_pipeline.get_dropped_packets(), 0);
+    EXPECT_EQ(packet_pipeline_processed_bytes, 1000);
+}
+
+TEST(packet_pipeline, removes_producers_of_finished_threads) {
+    packet_pipeline_t packet_pipeline;
+    packet_pipeline.set_configuration(2, 1024);
+
+    simple_packet_t current_packet;
+    current_packet.dst_ip = 1;
+
+    boost::thread capture_thread([&packet_pipeline, current_packet]() {
+        for (int i = 0; i < 10; i++) {
+            packet_pipeline.push(current_packet);
+        }
+    });
+
+    capture_thread.join();
+
+    // Current thread has own producer
+    packet_pipeline.push(current_packet);
+
+    EXPECT_EQ(packet_pipeline.get_number_of_producers(), 2);
+
+    // Rings of finished thread are not drained yet
+    EXPECT_EQ(packet_pipeline.remove_finished_producers(), 0);
+
+    boost::thread processing_thread([&packet_pipeline]() {
+        packet_pipeline.run_processing_thread(0, count_packet_pipeline_bytes);
+    });
+
+    boost::thread second_processing_thread([&packet_pipeline]() {
+        packet_pipeline.run_processing_thread(1, count_packet_pipeline_bytes);
+    });
+
+    while (packet_pipeline.get_processed_packets() < 11) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+
+    processing_thread.interrupt();
+    second_processing_thread.interrupt();
+    processing_thread.join();
+    second_processing_thread.join();
+
+    packet_pipeline.remove_finished_producers();
+
+    EXPECT_EQ(packet_pipeline.get_number_of_producers(), 1);
+    EXPECT_EQ(packet_pipeline.get_pushed_packets(), 11);
+}
+
+TEST(packet_pipeline, pipelines_do_not_share_thread_state) {
+    packet_pipeline_t first_pipeline;
+    first_pipeline.set_configuration(1, 16);
+
+    packet_pipeline_t second_pipeline;
+    second_pipeline.set_configuration(1, 16);
+
+    simple_packet_t current_packet;
+
+    first_pipeline.push(current_packet);
+    second_pipeline.push(current_packet);
+    second_pipeline.push(current_packet);
+
+    EXPECT_EQ(first_pipeline.get_pushed_packets(), 1);
+    EXPECT_EQ(second_pipeline.get_pushed_packets(), 2);
+}
+
+TEST(pcap_file_mapping, reads_packets) {
+    std::string file_path = "/tmp/fastnetmon_tests_dump.pcap";
+
+    fastnetmon_pcap_file_header pcap_header;
+    fill_pcap_header(&pcap_header, 1500);
+
+    uint8_t packet[64] = { 1 };
+
+    fastnetmon_pcap_pkthdr packet_header{};
+    packet_header.incl_len = sizeof(packet);
+    packet_header.orig_len = 1500;
+
+    {
+        std::ofstream dump(file_path, std::ios::binary);
+        dump.write((char*)&pcap_header, sizeof(pcap_header));
+
+        for (int i = 0; i < 2; i++) {
+            dump.write((char*)&packet_header, sizeof(packet_header));
+            dump.write((char*)packet, sizeof(packet));
+        }
+    }
+
+    pcap_file_mapping_t pcap_file_mapping;
+    std::string error_text;
+
+    ASSERT_TRUE(pcap_file_mapping.open(file_path, error_text));
+
+    unsigned int number_of_packets = 0;
+
+    bool read_result = pcap_file_mapping.for_each_packet([&](const fastnetmon_pcap_pkthdr& header, uint8_t* packet_pointer) {
+        EXPECT_EQ(header.orig_len, 1500);
+        EXPECT_EQ(packet_pointer[0], 1);
+        number_of_packets++;
+    });
+
+    EXPECT_TRUE(read_result);
+    EXPECT_EQ(number_of_packets, 2);
+
+    unlink(file_path.c_str());
+}
+
+TEST(pcap_file_mapping, reads_pcapng_packets) {
+    std::string file_path = "/tmp/fastnetmon_tests_dump.pcapng";
+
+    // Section header, interface with nanosecond resolution and one enhanced packet
+    uint32_t section_header[7]  = { 0x0A0D0D0A, 28, 0x1A2B3C4D, 1, 0xFFFFFFFF, 0xFFFFFFFF, 28 };
+    uint32_t interface_block[8] = { 1, 32, 1, 1500, 0x00010009, 9, 0, 32 };
+
+    uint64_t timestamp        = 1600000000ull * 1000000000 + 250000000;
+    uint32_t packet_block[15] = { 6, 60, 0, uint32_t(timestamp >> 32), uint32_t(timestamp), 28, 1500 };
+    packet_block[7]           = 0x01;
+    packet_block[14]          = 60;
+
+    {
+        std::ofstream dump(file_path, std::ios::binary);
+        dump.write((char*)section_header, sizeof(section_header));
+        dump.write((char*)interface_block, sizeof(interface_block));
+        dump.write((char*)packet_block, sizeof(packet_block));
+    }
+
+    pcap_file_mapping_t pcap_file_mapping;
+    std::string error_text;
+
+    ASSERT_TRUE(pcap_file_mapping.open(file_path, error_text));
+    EXPECT_TRUE(pcap_file_mapping.is_pcapng());
+    EXPECT_EQ(pcap_file_mapping.get_file_header().linktype, 1);
+
+    unsigned int number_of_packets = 0;
+
+    bool read_result = pcap_file_mapping.for_each_packet([&](const fastnetmon_pcap_pkthdr& header, uint8_t* packet_pointer) {
+        EXPECT_EQ(header.ts_sec, 1600000000);
+        EXPECT_EQ(header.ts_usec, 250000);
+        EXPECT_EQ(header.incl_len, 28);
+        EXPECT_EQ(header.orig_len, 1500);
+        EXPECT_EQ(packet_pointer[0], 1);
+        number_of_packets++;
+    });
+
+    EXPECT_TRUE(read_result);
+    EXPECT_EQ(number_of_packets, 1);
+
+    unlink(file_path.c_str());
+}
+
+TEST(traffic_generator, destinations_in_networks) {
+    traffic_generator_configuration_t configuration;
+
+    // 10.10.0.0/22 in host byte order
+    configuration.networks.push_back(subnet_cidr_mask_t(0x0A0A0000, 22));
+    configuration.destinations = traffic_generator_destinations_t::zipf;
+    configuration.mix          = traffic_generator_mix_t::syn_flood;
+
+    traffic_generator_t traffic_generator;
+    ASSERT_TRUE(traffic_generator.set_configuration(configuration, 1));
+    EXPECT_EQ(traffic_generator.get_total_hosts(), 1024);
+
+    std::map<uint32_t, uint64_t> packets_by_host;
+
+    simple_packet_t current_packet;
+
+    for (int i = 0; i < 100000; i++) {
+        traffic_generator.generate(current_packet);
+
+        EXPECT_EQ(ntohl(current_packet.dst_ip) & 0xFFFFFC00, 0x0A0A0000);
+        EXPECT_EQ(current_packet.protocol, IPPROTO_TCP);
+        EXPECT_EQ(current_packet.flags, 0x02);
+
+        packets_by_host[current_packet.dst_ip]++;
+    }
+
+    uint64_t maximum_packets = 0;
+
+    for (const auto& host : packets_by_host) {
+        maximum_packets = std::max(maximum_packets, host.second);
+    }
+
+    // Most popular host receives much more than average
+    EXPECT_GT(maximum_packets, 100000 / 1024 * 20);
+}
+
+TEST(rcu_pointer, publish) {
+    rcu_pointer_t<std::vector<int>> numbers;
+
+    EXPECT_TRUE(numbers.get()->empty());
+
+    const std::vector<int>* old_numbers = numbers.get();
+
+    numbers.publish(new std::vector<int>{ 1, 2 });
+    EXPECT_EQ(numbers.get()->size(), 2);
+
+    // Readers which got old copy before publish still could use it
+    EXPECT_TRUE(old_numbers->empty());
+}
+
+TEST(counters_allocator, large_array) {
+    // 4MB array gets own mapping
+    std::vector<uint64_t, counters_allocator_t<uint64_t>> counters(512 * 1024, 1);
+
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(counters.data()) % 64, 0);
+    EXPECT_EQ(counters.back(), 1);
+    EXPECT_GT(get_counters_memory().transparent_huge_pages_bytes + get_counters_memory().huge_pages_bytes, 0);
+
+    counters.clear();
+    counters.shrink_to_fit();
+
+    EXPECT_EQ(get_counters_memory().transparent_huge_pages_bytes + get_counters_memory().huge_pages_bytes, 0);
+}
+
+TEST(counters_storage, sparse_blocks) {
+    // /23 network
+    counters_storage_t<uint64_t> counters(512, true);
+
+    EXPECT_EQ(counters.get_number_of_blocks(), 2);
+    EXPECT_EQ(counters.get(300), nullptr);
+
+    *counters.get_or_allocate(300) = 5;
+
+    EXPECT_EQ(counters.get_block(0), nullptr);
+    EXPECT_EQ(*counters.get(300), 5);
+    EXPECT_FALSE(counters.is_block_active(0));
+    EXPECT_TRUE(counters.clear_block_activity(1));
+    EXPECT_FALSE(counters.is_block_active(1));
+
+    uint64_t number_of_elements = 0;
+    counters.for_each_allocated_element([&](size_t, uint64_t&) { number_of_elements++; });
+
+    EXPECT_EQ(number_of_elements, 256);
+}
+
+TEST(counters_storage, retire_idle_block) {
+    counters_storage_t<uint64_t> counters(512, true);
+
+    *counters.get_or_allocate(300) = 5;
+
+    EXPECT_EQ(counters.increment_idle_periods(1), 1);
+    EXPECT_EQ(counters.increment_idle_periods(1), 2);
+
+    EXPECT_TRUE(counters.retire_block(1));
+    EXPECT_FALSE(counters.retire_block(0));
+    EXPECT_EQ(counters.get(300), nullptr);
+    EXPECT_EQ(counters.increment_idle_periods(1), 1);
+
+    // New traffic gets clean block
+    EXPECT_EQ(*counters.get_or_allocate(300), 0);
+
+    auto now = std::chrono::steady_clock::now();
+
+    // Readers may still use retired block
+    counters.free_retired_blocks(now);
+    EXPECT_EQ(counters.get_number_of_retired_blocks(), 1);
+
+    counters.free_retired_blocks(now + std::chrono::seconds(10));
+    EXPECT_EQ(counters.get_number_of_retired_blocks(), 0);
+
+    // Dense storage keeps all elements in single array
+    counters_storage_t<uint64_t> dense_counters(512, false);
+    EXPECT_FALSE(dense_counters.retire_block(1));
+}
+
+TEST(ban_list, uses_time_from_packets) {
+    // Ban list is created before we switch clock to time from packets
+    blackhole_ban_list_t<uint32_t> ban_list;
+
+    // Time of packets from dump is far behind of wall clock
+    struct timeval packet_time = { 1000000, 0 };
+    set_fast_time_override(packet_time);
+
+    attack_details_t current_attack;
+    current_attack.ban_timestamp = get_fast_time_seconds();
+    current_attack.ban_time      = 10;
+    current_attack.unban_enabled = true;
+
+    ban_list.add_to_blackhole(1, current_attack);
+
+    std::vector<std::pair<uint32_t, banlist_item_t>> expired_bans;
+
+    ban_list.get_expired_blackholes(packet_time.tv_sec + 5, expired_bans);
+    EXPECT_EQ(expired_bans.size(), 0);
+
+    ban_list.get_expired_blackholes(packet_time.tv_sec + 11, expired_bans);
+    EXPECT_EQ(expired_bans.size(), 1);
+
+    disable_fast_time_override();
+}
+
+TEST(flow_tracking, increments_tables) {
+    conntrack_main_struct_t conntrack_element;
+    std::mutex flow_tracking_mutex;
+
+    simple_packet_t current_packet;
+    current_packet.protocol    = IPPROTO_TCP;
+    current_packet.src_ip      = 1;
+    current_packet.dst_ip      = 2;
+    current_packet.source_port = 1024;
+
+    increment_flow_tracking_table(conntrack_element, INCOMING, current_packet, 1, 100, flow_tracking_mutex);
+    increment_flow_tracking_table(conntrack_element, INCOMING, current_packet, 2, 200, flow_tracking_mutex);
+    increment_flow_tracking_table(conntrack_element, OUTGOING, current_packet, 1, 100, flow_tracking_mutex);
+
+    current_packet.protocol = IPPROTO_ICMP;
+    increment_flow_tracking_table(conntrack_element, INCOMING, current_packet, 1, 100, flow_tracking_mutex);
+
+    ASSERT_EQ(conntrack_element.in_tcp.size(), 1);
+    EXPECT_EQ(conntrack_element.in_tcp.begin()->second.packets, 3);
+    EXPECT_EQ(conntrack_element.in_tcp.begin()->second.bytes, 300);
+    EXPECT_EQ(conntrack_element.out_tcp.size(), 1);
+    EXPECT_EQ(conntrack_element.in_icmp.size(), 0);
+}
+
+TEST(timer_wheel, expires_in_order) {
+    timer_wheel_t<uint32_t> timer_wheel;
+    timer_wheel.set_current_time(1000);
+
+    timer_wheel.insert(1, 1010);
+    timer_wheel.insert(2, 1000 + 5000);
+    timer_wheel.insert(3, 1000 + 3600 * 24 * 365);
+    timer_wheel.insert(4, 900);
+
+    std::vector<std::pair<uint32_t, time_t>> expired_elements;
+
+    timer_wheel.advance(1009, expired_elements);
+    ASSERT_EQ(expired_elements.size(), 1);
+    EXPECT_EQ(expired_elements[0].first, 4);
+
+    expired_elements.clear();
+    timer_wheel.advance(1010, expired_elements);
+    ASSERT_EQ(expired_elements.size(), 1);
+    EXPECT_EQ(expired_elements[0].first, 1);
+
+    expired_elements.clear();
+    timer_wheel.advance(1000 + 4999, expired_elements);
+    EXPECT_EQ(expired_elements.size(), 0);
+
+    timer_wheel.advance(1000 + 5000, expired_elements);
+    ASSERT_EQ(expired_elements.size(), 1);
+    EXPECT_EQ(expired_elements[0].first, 2);
+
+    expired_elements.clear();
+    timer_wheel.advance(1000 + 3600 * 24 * 365, expired_elements);
+    ASSERT_EQ(expired_elements.size(), 1);
+    EXPECT_EQ(expired_elements[0].first, 3);
+    EXPECT_EQ(timer_wheel.size(), 0);
+}
+
+TEST(compact_packet_record, convert_and_queue) {
+    simple_packet_t current_packet;
+    current_packet.src_ip              = 0x01020304;
+    current_packet.dst_ip              = 0x05060708;
+    current_packet.source_port         = 53;
+    current_packet.destination_port    = 4444;
+    current_packet.protocol            = IPPROTO_UDP;
+    current_packet.length              = 1500;
+    current_packet.sample_ratio        = 1000;
+    current_packet.vlan                = 10;
+    current_packet.ip_more_fragments   = true;
+    current_packet.packet_direction    = INCOMING;
+    current_packet.src_country         = "NL";
+    current_packet.ip_protocol_version = 4;
+
+    compact_packet_record_queue_t queue(2);
+
+    compact_packet_record_t record;
+    convert_simple_packet_to_compact_record(current_packet, record);
+
+    EXPECT_TRUE(queue.push(record));
+    EXPECT_TRUE(queue.push(record));
+
+    // Queue is full
+    EXPECT_FALSE(queue.push(record));
+    EXPECT_EQ(queue.read_available(), 2);
+
+    compact_packet_record_t queued_record;
+    EXPECT_TRUE(queue.pop(queued_record));
+
+    simple_packet_t restored_packet;
+    convert_compact_record_to_simple_packet(queued_record, restored_packet);
+
+    EXPECT_EQ(restored_packet.src_ip, current_packet.src_ip);
+    EXPECT_EQ(restored_packet.dst_ip, current_packet.dst_ip);
+    EXPECT_EQ(restored_packet.source_port, current_packet.source_port);
+    EXPECT_EQ(restored_packet.destination_port, current_packet.destination_port);
+    EXPECT_EQ(restored_packet.protocol, current_packet.protocol);
+    EXPECT_EQ(restored_packet.length, current_packet.length);
+    EXPECT_EQ(restored_packet.sample_ratio, current_packet.sample_ratio);
+    EXPECT_EQ(restored_packet.vlan, current_packet.vlan);
+    EXPECT_TRUE(restored_packet.ip_more_fragments);
+    EXPECT_EQ(restored_packet.packet_direction, INCOMING);
+    EXPECT_EQ(restored_packet.src_country, "NL");
+    EXPECT_EQ(restored_packet.dst_country, "");
+}
+
+TEST(state_checkpoint, write_and_read) {
+    std::string file_path = "/tmp/fastnetmon_tests_checkpoint.dat";
+    std::string error_text;
+
+    bool write_result = write_checkpoint_file(
+        file_path,
+        [](checkpoint_writer_t& writer) {
+            writer.write<uint32_t>(42);
+            writer.write_string("fastnetmon");
+        },
+        error_text);
+
+    ASSERT_TRUE(write_result);
+
+    uint32_t number = 0;
+    std::string text;
+
+    bool read_result = read_checkpoint_file(
+        file_path, [&](checkpoint_reader_t& reader) { return reader.read(number) && reader.read_string(text); }, error_text);
+
+    EXPECT_TRUE(read_result);
+    EXPECT_EQ(number, 42);
+    EXPECT_EQ(text, "fastnetmon");
+
+    // Truncated data should be rejected
+    read_result = read_checkpoint_file(
+        file_path, [&](checkpoint_reader_t& reader) { return reader.read(number) && reader.read_string(text) && reader.read(number); },
+        error_text);
+
+    EXPECT_FALSE(read_result);
+
+    unlink(file_path.c_str());
+}
+
+TEST(state_checkpoint, counters_storage) {
+    std::string file_path = "/tmp/fastnetmon_tests_checkpoint_counters.dat";
+    std::string error_text;
+
+    // /24 network with all hosts and /22 network with traffic only to single /24
+    counters_storage_t<subnet_counter_t> dense_counters(256, false);
+    counters_storage_t<subnet_counter_t> sparse_counters(1024, true);
+
+    for (size_t i = 0; i < dense_counters.size(); i++) {
+        dense_counters.get(i)->total.in_bytes     = i * 1500;
+        dense_counters.get(i)->tcp_syn.in_packets = i;
+    }
+
+    sparse_counters.get_or_allocate(600)->total.out_packets = 42;
+    sparse_counters.get_or_allocate(700)->in_flows          = 7;
+
+    typedef checkpoint_layout_t<subnet_counter_t, uint64_t> layout_t;
+
+    std::vector<uint64_t> dense_blocks  = get_counters_storage_blocks_for_checkpoint(dense_counters);
+    std::vector<uint64_t> sparse_blocks = get_counters_storage_blocks_for_checkpoint(sparse_counters);
+
+    unsigned int serialiser_calls = 0;
+
+    bool write_result = write_checkpoint_file(
+        file_path,
+        [&](checkpoint_writer_t& writer) {
+            layout_t::write(writer);
+            write_counters_storage_to_checkpoint(writer, dense_counters, dense_blocks);
+            write_counters_storage_to_checkpoint(writer, sparse_counters, sparse_blocks);
+
+            // Processing threads allocate blocks for new hosts after we calculated size of checkpoint
+            if (serialiser_calls++ == 0) {
+                sparse_counters.get_or_allocate(100)->total.in_packets = 1;
+            }
+        },
+        error_text);
+
+    ASSERT_TRUE(write_result) << error_text;
+
+    counters_storage_t<subnet_counter_t> restored_dense_counters(256, false);
+    counters_storage_t<subnet_counter_t> restored_sparse_counters(1024, true);
+
+    bool dense_restored  = false;
+    bool sparse_restored = false;
+
+    bool read_result = read_checkpoint_file(
+        file_path,
+        [&](checkpoint_reader_t& reader) {
+            return layout_t::read_and_compare(reader) &&
+                   read_counters_storage_from_checkpoint(reader, &restored_dense_counters, dense_restored) &&
+                   read_counters_storage_from_checkpoint(reader, &restored_sparse_counters, sparse_restored);
+        },
+        error_text);
+
+    ASSERT_TRUE(read_result);
+    EXPECT_TRUE(dense_restored);
+    EXPECT_TRUE(sparse_restored);
+
+    EXPECT_EQ(memcmp(restored_dense_counters.get_block(0), dense_counters.get_block(0), 256 * sizeof(subnet_counter_t)), 0);
+
+    // Block allocated during checkpoint is not saved
+    EXPECT_EQ(restored_sparse_counters.get_block(0), nullptr);
+    EXPECT_EQ(restored_sparse_counters.get_block(1), nullptr);
+    EXPECT_EQ(restored_sparse_counters.get_block(3), nullptr);
+    EXPECT_EQ(memcmp(restored_sparse_counters.get_block(2), sparse_counters.get_block(2), 256 * sizeof(subnet_counter_t)), 0);
+    EXPECT_EQ(restored_sparse_counters.get(600)->total.out_packets, 42);
+    EXPECT_EQ(restored_sparse_counters.get(700)->in_flows, 7);
+
+    // Network with different size keeps own counters
+    counters_storage_t<subnet_counter_t> resized_counters(512, false);
+
+    read_result = read_checkpoint_file(
+        file_path,
+        [&](checkpoint_reader_t& reader) {
+            return layout_t::read_and_compare(reader) &&
+                   read_counters_storage_from_checkpoint(reader, &resized_counters, dense_restored);
+        },
+        error_text);
+
+    EXPECT_TRUE(read_result);
+    EXPECT_FALSE(dense_restored);
+    EXPECT_EQ(resized_counters.get(100)->total.in_bytes, 0);
+
+    // Checkpoint from build with different structures must be rejected
+    read_result = read_checkpoint_file(
+        file_path, [&](checkpoint_reader_t& reader) { return checkpoint_layout_t<subnet_counter_t, uint32_t>::read_and_compare(reader); },
+        error_text);
+
+    EXPECT_FALSE(read_result);
+
+    read_result = read_checkpoint_file(
+        file_path, [&](checkpoint_reader_t& reader) { return checkpoint_layout_t<subnet_counter_t>::read_and_compare(reader); },
+        error_text);
+
+    EXPECT_FALSE(read_result);
+
+    unlink(file_path.c_str());
+}
+
+TEST(stage_latency, sampling_and_histograms) {
+    stage_latency_registry_t registry;
+
+    EXPECT_FALSE(registry.should_measure(latency_stage_t::speed_recalculation));
+
+    registry.enable(4);
+
+    unsigned int sampled_packets = 0;
+
+    for (unsigned int i = 0; i < 100; i++) {
+        if (registry.should_measure(latency_stage_t::counter_update)) {
+            sampled_packets++;
+        }
+    }
+
+    EXPECT_EQ(sampled_packets, 25);
+
+    // Background loops are not sampled
+    EXPECT_TRUE(registry.should_measure(latency_stage_t::speed_recalculation));
+
+    // It's ticks but we need nanoseconds to check buckets
+    double ticks_per_nanosecond = 1 / registry.get_nanoseconds_per_tick();
+
+    for (unsigned int i = 0; i < 9; i++) {
+        registry.record(latency_stage_t::counter_update, uint64_t(100 * ticks_per_nanosecond));
+    }
+
+    registry.record(latency_stage_t::counter_update, uint64_t(5000 * ticks_per_nanosecond));
+
+    stage_latency_histogram_t histogram = registry.get_histograms()[size_t(latency_stage_t::counter_update)];
+
+    EXPECT_EQ(histogram.samples, 10);
+    EXPECT_EQ(histogram.get_percentile(0.5), 128);
+    EXPECT_EQ(histogram.get_percentile(0.99), 8192);
+
+    EXPECT_EQ(registry.get_histograms()[size_t(latency_stage_t::packet_parse)].samples, 0);
+}
+
+TEST(stage_latency, registries_do_not_share_thread_state) {
+    // Thread must not keep histograms of registry destroyed before
+    for (unsigned int attempt = 0; attempt < 2; attempt++) {
+        stage_latency_registry_t registry;
+        registry.enable(1);
+
+        EXPECT_TRUE(registry.should_measure(latency_stage_t::counter_update));
+        registry.record(latency_stage_t::counter_update, 1);
+
+        EXPECT_EQ(registry.get_histograms()[size_t(latency_stage_t::counter_update)].samples, 1);
+    }
+
+    stage_latency_registry_t first_registry;
+    stage_latency_registry_t second_registry;
+
+    first_registry.enable(2);
+    second_registry.enable(2);
+
+    // Each registry samples own packets
+    EXPECT_TRUE(first_registry.should_measure(latency_stage_t::counter_update));
+    EXPECT_TRUE(second_registry.should_measure(latency_stage_t::counter_update));
+
+    first_registry.record(latency_stage_t::counter_update, 1);
+
+    EXPECT_EQ(second_registry.get_histograms()[size_t(latency_stage_t::counter_update)].samples, 0);
+}
+
+TEST(per_thread_counters, sum_of_threads) {
+    per_thread_counters_t<2> counters;
+    per_thread_counter_t counter;
+
+    std::vector<std::thread> threads;
+
+    for (unsigned int thread_index = 0; thread_index < 4; thread_index++) {
+        threads.emplace_back([&]() {
+            for (unsigned int i = 0; i < 1000; i++) {
+                counters.increment(0, 1);
+                counters.increment(1, 10);
+                counter.increment();
+            }
+        });
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Counters of finished threads are still here
+    EXPECT_EQ(counters.get(0), 4000);
+    EXPECT_EQ(counters.get(1), 40000);
+    EXPECT_EQ(counter.get(), 4000);
+
+    auto all_counters = counters.get_all();
+    EXPECT_EQ(all_counters[1], 40000);
+}
+
+TEST(fast_time, clock_and_override) {
+    time_t wall_clock_time = time(NULL);
+
+    // Coarse clock may be behind by one tick
+    EXPECT_LE(std::abs(int64_t(get_fast_time_seconds()) - int64_t(wall_clock_time)), 1);
+
+    int64_t first_milliseconds = get_fast_time_milliseconds();
+    EXPECT_GE(get_fast_time_milliseconds(), first_milliseconds);
+
+    struct timeval packet_time = { 1600000000, 250000 };
+    set_fast_time_override(packet_time);
+
+    struct timeval current_time;
+    get_fast_time(current_time);
+
+    EXPECT_EQ(current_time.tv_sec, 1600000000);
+    EXPECT_EQ(current_time.tv_usec, 250000);
+    EXPECT_EQ(get_fast_time_milliseconds(), 1600000000250);
+
+    disable_fast_time_override();
+    EXPECT_LE(std::abs(int64_t(get_fast_time_seconds()) - int64_t(wall_clock_time)), 1);
+}
+
+TEST(packet_capture_slab, variable_length_and_budget) {
+    packet_capture_slab_t slab;
+
+    // Four chunks with links
+    EXPECT_TRUE(slab.allocate(4 * (packet_capture_slab_t::chunk_size + sizeof(uint32_t)), 300));
+    EXPECT_EQ(slab.get_number_of_chunks(), 4);
+
+    std::vector<uint8_t> large_packet(1500);
+
+    for (size_t index = 0; index < large_packet.size(); index++) {
+        large_packet[index] = uint8_t(index);
+    }
+
+    struct timeval packet_time = { 1600000000, 1000 };
+
+    // Snaplen cuts it to three chunks
+    packet_capture_slot_t large_slot;
+    EXPECT_TRUE(slab.store_packet(large_packet.data(), large_packet.size(), large_packet.size(), packet_time, large_slot));
+    EXPECT_EQ(large_slot.packet_metadata.incl_len, 300);
+    EXPECT_EQ(large_slot.packet_metadata.orig_len, 1500);
+    EXPECT_EQ(slab.get_number_of_free_chunks(), 1);
+
+    uint8_t small_packet[64] = { 1, 2, 3 };
+
+    packet_capture_slot_t small_slot;
+    EXPECT_TRUE(slab.store_packet(small_packet, sizeof(small_packet), sizeof(small_packet), packet_time, small_slot));
+    EXPECT_EQ(slab.get_number_of_free_chunks(), 0);
+
+    // Budget is exhausted
+    packet_capture_slot_t overflow_slot;
+    EXPECT_FALSE(slab.store_packet(small_packet, sizeof(small_packet), sizeof(small_packet), packet_time, overflow_slot));
+
+    std::vector<uint8_t> payload;
+    EXPECT_TRUE(slab.read_packet(large_slot, payload));
+    EXPECT_EQ(payload, std::vector<uint8_t>(large_packet.begin(), large_packet.begin() + 300));
+
+    slab.release_packet(large_slot);
+    EXPECT_EQ(slab.get_number_of_free_chunks(), 3);
+    EXPECT_FALSE(slab.read_packet(large_slot, payload));
+
+    EXPECT_TRUE(slab.read_packet(small_slot, payload));
+    EXPECT_EQ(payload, std::vector<uint8_t>(small_packet, small_packet + sizeof(small_packet)));
+
+    slab.release_packet(small_slot);
+    EXPECT_EQ(slab.get_number_of_free_chunks(), 4);
+}
+
+TEST(packet_capture_slab, free_chunks_after_partial_store) {
+    packet_capture_slab_t slab;
+
+    EXPECT_TRUE(slab.allocate(10 * (packet_capture_slab_t::chunk_size + sizeof(uint32_t)), 2048));
+    EXPECT_EQ(slab.get_number_of_chunks(), 10);
+
+    // Each packet takes three chunks and last one could get only one chunk before failure
+    std::vector<uint8_t> packet(packet_capture_slab_t::chunk_size * 3, 1);
+
+    struct timeval packet_time = { 1600000000, 0 };
+
+    std::vector<packet_capture_slot_t> slots;
+
+    for (int i = 0; i < 10; i++) {
+        packet_capture_slot_t slot;
+
+        if (slab.store_packet(packet.data(), packet.size(), packet.size(), packet_time, slot)) {
+            slots.push_back(slot);
+        }
+
+        EXPECT_EQ(slab.get_number_of_free_chunks() + slots.size() * 3, slab.get_number_of_chunks());
+    }
+
+    EXPECT_EQ(slots.size(), 3);
+    EXPECT_EQ(slab.get_number_of_free_chunks(), 1);
+
+    for (auto& slot : slots) {
+        slab.release_packet(slot);
+    }
+
+    EXPECT_EQ(slab.get_number_of_free_chunks(), slab.get_number_of_chunks());
+}
+
+TEST(packet_capture_slab, concurrent_store_and_release) {
+    packet_capture_slab_t slab;
+
+    // Less chunks than threads need in same time and some stores fail
+    EXPECT_TRUE(slab.allocate(16 * (packet_capture_slab_t::chunk_size + sizeof(uint32_t)), 500));
+
+    std::atomic<uint64_t> corrupted_packets{ 0 };
+    std::vector<std::thread> threads;
+
+    for (unsigned int thread_index = 0; thread_index < 4; thread_index++) {
+        threads.emplace_back([&slab, &corrupted_packets, thread_index]() {
+            std::vector<uint8_t> packet(300, uint8_t(thread_index));
+            std::vector<uint8_t> payload;
+
+            struct timeval packet_time = { 1600000000, 0 };
+
+            for (int i = 0; i < 100000; i++) {
+                packet_capture_slot_t slot;
+
+                if (!slab.store_packet(packet.data(), packet.size(), packet.size(), packet_time, slot)) {
+                    continue;
+                }
+
+                if (!slab.read_packet(slot, payload) || payload != packet) {
+                    corrupted_packets++;
+                }
+
+                slab.release_packet(slot);
+            }
+        });
+    }
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(corrupted_packets, 0);
+    EXPECT_EQ(slab.get_number_of_free_chunks(), 16);
+}
+
+TEST(netflow_templates_snapshot, serialize_and_deserialize) {
+    peer_nf9_template field_template;
+    field_template.template_id = 256;
+    field_template.num_records = 2;
+    field_template.total_len   = 8;
+    field_template.type        = netflow9_template_type::Data;
+    field_template.records     = { peer_nf9_record_t(8, 4), peer_nf9_record_t(12, 4) };
+
+    netflow_templates_snapshot_t snapshot;
+    snapshot.save_time                             = 1600000000;
+    snapshot.netflow9_templates["10.0.0.1_0"][256] = field_template;
+    snapshot.ipfix_templates["10.0.0.2_1"][256]    = field_template;
+    snapshot.netflow9_sampling_rates["10.0.0.1"]   = 1000;
+    snapshot.ipfix_sampling_rates["10.0.0.2"]      = 2000;
+
+    std::string serialized_snapshot;
+    ASSERT_TRUE(serialize_netflow_templates_snapshot(snapshot, serialized_snapshot));
+
+    netflow_templates_snapshot_t loaded_snapshot;
+    ASSERT_TRUE(deserialize_netflow_templates_snapshot(serialized_snapshot, loaded_snapshot));
+
+    EXPECT_EQ(loaded_snapshot.save_time, snapshot.save_time);
+    EXPECT_TRUE(loaded_snapshot.netflow9_templates == snapshot.netflow9_templates);
+    EXPECT_TRUE(loaded_snapshot.ipfix_templates == snapshot.ipfix_templates);
+    EXPECT_EQ(loaded_snapshot.netflow9_sampling_rates, snapshot.netflow9_sampling_rates);
+    EXPECT_EQ(loaded_snapshot.ipfix_sampling_rates, snapshot.ipfix_sampling_rates);
+
+    // Truncated file must not be loaded
+    netflow_templates_snapshot_t broken_snapshot;
+    EXPECT_FALSE(deserialize_netflow_templates_snapshot(serialized_snapshot.substr(0, serialized_snapshot.size() / 2),
+                                                        broken_snapshot));
+}
+
+TEST(netflow_templates_snapshot, max_age) {
+    netflow_templates_snapshot_t snapshot;
+    snapshot.save_time = 1600000000;
+
+    EXPECT_FALSE(netflow_templates_snapshot_is_stale(snapshot, 1600000000, 3600));
+    EXPECT_FALSE(netflow_templates_snapshot_is_stale(snapshot, 1600003600, 3600));
+    EXPECT_TRUE(netflow_templates_snapshot_is_stale(snapshot, 1600003601, 3600));
+
+    // Snapshot from future
+    EXPECT_TRUE(netflow_templates_snapshot_is_stale(snapshot, 1599999999, 3600));
+}
@@ -17,6 +17,9 @@
 
 #include "subnet_counter.hpp"
 
+#include "counters_storage.hpp"
+#include "per_thread_counters.hpp"
+
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
@@ -29,7 +32,7 @@ enum attack_severity_t { ATTACK_SEVERITY_LOW, ATTACK_SEVERITY_MIDDLE, ATTACK_SEV
 // Kafka traffic export formats
 enum class kafka_traffic_export_format_t : uint32_t { Unknown = 0, JSON = 1, Protobuf = 2 };
 
-typedef std::vector<subnet_counter_t> vector_of_counters_t;
+typedef counters_storage_t<subnet_counter_t> vector_of_counters_t;
 
 typedef std::map<std::string, std::string> configuration_map_t;
 typedef std::map<std::string, uint64_t> graphite_data_t;
@@ -202,6 +205,32 @@ class total_speed_counters_t {
     }
 };
 
+// Total traffic from capture threads, packets and bytes for each direction
+class total_traffic_counters_t {
+    public:
+    void increment(direction_t packet_direction, uint64_t packets, uint64_t bytes) {
+        counters.increment(packet_direction * 2, packets);
+        counters.increment(packet_direction * 2 + 1, bytes);
+    }
+
+    // Returns traffic since previous call, it should be called only from recalculation thread
+    void get_increments(total_counter_element_t (&increments)[4]) {
+        std::array<uint64_t, 8> current_counters = counters.get_all();
+
+        for (unsigned int index = 0; index < 4; index++) {
+            increments[index].packets = current_counters[index * 2] - previous_counters[index * 2];
+            increments[index].bytes   = current_counters[index * 2 + 1] - previous_counters[index * 2 + 1];
+            increments[index].flows   = 0;
+        }
+
+        previous_counters = current_counters;
+    }
+
+    private:
+    per_thread_counters_t<8> counters;
+    std::array<uint64_t, 8> previous_counters{};
+};
+
 
 // structure with attack details
 class attack_details_t : public subnet_counter_t {
@@ -309,12 +338,12 @@ class conntrack_main_struct_t {
 };
 
 typedef std::map<uint32_t, subnet_counter_t> map_for_counters;
-typedef std::vector<subnet_counter_t> vector_of_counters;
+typedef counters_storage_t<subnet_counter_t> vector_of_counters;
 
 typedef std::map<subnet_cidr_mask_t, vector_of_counters> map_of_vector_counters_t;
 
 // Flow tracking structures
-typedef std::vector<conntrack_main_struct_t> vector_of_flow_counters_t;
+typedef counters_storage_t<conntrack_main_struct_t> vector_of_flow_counters_t;
 typedef std::map<subnet_cidr_mask_t, vector_of_flow_counters_t> map_of_vector_counters_for_flow_t;
 
 
@@ -381,6 +410,17 @@ class ban_settings_t {
 
 typedef std::map<std::string, ban_settings_t> host_group_ban_settings_map_t;
 
+// Host groups with their ban settings, we replace them as whole on reload
+class host_groups_configuration_t {
+    public:
+    host_group_map_t host_groups;
+
+    // Here we store assignment from subnet to certain host group for fast lookup
+    subnet_to_host_group_map_t subnet_to_host_groups;
+
+    host_group_ban_settings_map_t host_group_ban_settings_map;
+};
+
 // data structure for storing data in Vector
 typedef std::pair<uint32_t, subnet_counter_t> pair_of_map_elements;
 
@@ -1,23 +1,17 @@
 #pragma once
 #include "fastnetmon_pcap_format.hpp"
 
+#include <string.h>
+#include <sys/time.h>
+
 // We are using this class for storing packet meta information with their payload into fixed size memory region
 class fixed_size_packet_storage_t {
     public:
     fixed_size_packet_storage_t() = default;
-    fixed_size_packet_storage_t(void* payload_pointer, unsigned int captured_length, unsigned int real_packet_length) {
-        // TODO: performance killer! Check it!
-        bool we_do_timestamps = true;
-
-        struct timeval current_time;
-        current_time.tv_sec  = 0;
-        current_time.tv_usec = 0;
-
-        if (we_do_timestamps) {
-            gettimeofday(&current_time, NULL);
-        }
-
-
+    fixed_size_packet_storage_t(void* payload_pointer,
+                                unsigned int captured_length,
+                                unsigned int real_packet_length,
+                                const struct timeval& current_time) {
         packet_metadata.ts_sec  = current_time.tv_sec;
         packet_metadata.ts_usec = current_time.tv_usec;
 
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "bgp_protocol.hpp"
+#include "fastnetmon_simple_packet.hpp"
+
+// Builds flow spec rules which match most of traffic from packets captured for host under attack
+// We group packets by protocol and fragmentation in single pass and use port only when most of group's traffic has it.
+// Reflection attacks have same source port and random destination ports, floods to service have same destination port
+
+class flow_spec_generator_configuration_t {
+    public:
+    // Share of group's traffic which should have same port to add this port to rule
+    double dominant_port_share = 0.8;
+
+    // We stop adding rules when they match this share of traffic
+    double traffic_coverage = 0.9;
+
+    // We do not add rules for groups with smaller share of traffic
+    double minimal_group_share = 0.05;
+
+    unsigned int maximum_number_of_rules = 4;
+
+    // Match range of packet lengths we've seen in group
+    bool match_packet_length = true;
+};
+
+// Traffic signature for single rule
+class flow_spec_signature_t {
+    public:
+    uint32_t protocol = 0;
+
+    // Non first fragments have no ports and we match them by fragment flag
+    bool fragmented = false;
+
+    bool source_port_used = false;
+    uint16_t source_port  = 0;
+
+    bool destination_port_used = false;
+    uint16_t destination_port  = 0;
+
+    uint16_t minimum_packet_length = 0;
+    uint16_t maximum_packet_length = 0;
+
+    // Number of packets from sample matched by this signature, we use sampling rates of packets as weight
+    uint64_t packets = 0;
+};
+
+class flow_spec_generator_t {
+    public:
+    explicit flow_spec_generator_t(const flow_spec_generator_configuration_t& configuration)
+    : configuration(configuration) {
+    }
+
+    // Works for any container with simple_packet_t: vector from ban details or circular buffer from packet buckets
+    template <typename TemplatePacketsContainer> std::vector<flow_spec_signature_t> get_signatures(const TemplatePacketsContainer& packets) {
+        std::unordered_map<uint64_t, group_t> groups;
+        uint64_t total_packets = 0;
+
+        for (const simple_packet_t& current_packet : packets) {
+            uint64_t packets_weight = current_packet.number_of_packets * current_packet.sample_ratio;
+
+            if (packets_weight == 0) {
+                continue;
+            }
+
+            uint16_t packet_length = get_packet_length(current_packet);
+
+            group_t& group = groups[uint64_t(current_packet.protocol) << 1 | uint64_t(current_packet.ip_fragmented)];
+
+            group.protocol   = current_packet.protocol;
+            group.fragmented = current_packet.ip_fragmented;
+
+            group.total.add(packet_length, packets_weight);
+
+            // Non first fragments carry zero ports
+            if (!current_packet.ip_fragmented && (current_packet.protocol == IPPROTO_TCP or current_packet.protocol == IPPROTO_UDP)) {
+                group.source_ports[current_packet.source_port].add(packet_length, packets_weight);
+                group.destination_ports[current_packet.destination_port].add(packet_length, packets_weight);
+            }
+
+            total_packets += packets_weight;
+        }
+
+        std::vector<flow_spec_signature_t> signatures;
+
+        for (const auto& group_element : groups) {
+            const group_t& group = group_element.second;
+
+            if (group.total.packets < configuration.minimal_group_share * total_packets) {
+                continue;
+            }
+
+            signatures.push_back(build_signature(group));
+        }
+
+        std::sort(signatures.begin(), signatures.end(),
+                  [](const flow_spec_signature_t& a, const flow_spec_signature_t& b) { return a.packets > b.packets; });
+
+        // Minimal set of rules which match requested share of traffic
+        std::vector<flow_spec_signature_t> selected_signatures;
+        uint64_t covered_packets = 0;
+
+        for (const auto& signature : signatures) {
+            if (selected_signatures.size() >= configuration.maximum_number_of_rules or
+                covered_packets >= configuration.traffic_coverage * total_packets) {
+                break;
+            }
+
+            selected_signatures.push_back(signature);
+            covered_packets += signature.packets;
+        }
+
+        return selected_signatures;
+    }
+
+    // Creates rules for traffic to host, signatures for protocols which flow spec does not support are skipped
+    std::vector<flow_spec_rule_t> get_rules(const std::vector<flow_spec_signature_t>& signatures,
+                                            const subnet_cidr_mask_t& destination_host,
+                                            const bgp_flow_spec_action_t& action) {
+        std::vector<flow_spec_rule_t> rules;
+
+        for (const auto& signature : signatures) {
+            bgp_flow_spec_protocol_t flow_spec_protocol;
+
+            if (!convert_ip_protocol_to_flow_spec_protocol(signature.protocol, flow_spec_protocol)) {
+                continue;
+            }
+
+            flow_spec_rule_t rule;
+
+            rule.set_destination_subnet(destination_host);
+            rule.add_protocol(flow_spec_protocol);
+
+            if (signature.fragmented) {
+                rule.add_fragmentation_flag(FLOW_SPEC_IS_A_FRAGMENT);
+            }
+
+            if (signature.source_port_used) {
+                rule.add_source_port(signature.source_port);
+            }
+
+            if (signature.destination_port_used) {
+                rule.add_destination_port(signature.destination_port);
+            }
+
+            if (configuration.match_packet_length && signature.maximum_packet_length > 0) {
+                rule.add_packet_length_range(signature.minimum_packet_length, signature.maximum_packet_length);
+            }
+
+            rule.set_action(action);
+
+            rules.push_back(rule);
+        }
+
+        return rules;
+    }
+
+    private:
+    class traffic_share_t {
+        public:
+        void add(uint16_t packet_length, uint64_t packets_weight) {
+            if (packets == 0) {
+                minimum_packet_length = packet_length;
+                maximum_packet_length = packet_length;
+            } else {
+                minimum_packet_length = std::min(minimum_packet_length, packet_length);
+                maximum_packet_length = std::max(maximum_packet_length, packet_length);
+            }
+
+            packets += packets_weight;
+        }
+
+        uint64_t packets               = 0;
+        uint16_t minimum_packet_length = 0;
+        uint16_t maximum_packet_length = 0;
+    };
+
+    class group_t {
+        public:
+        uint32_t protocol = 0;
+        bool fragmented   = false;
+
+        traffic_share_t total;
+
+        std::unordered_map<uint16_t, traffic_share_t> source_ports;
+        std::unordered_map<uint16_t, traffic_share_t> destination_ports;
+    };
+
+    // Flow spec matches total length of IP packet
+    static uint16_t get_packet_length(const simple_packet_t& current_packet) {
+        uint64_t packet_length = current_packet.ip_length;
+
+        // Flow collectors provide only total length of all packets in flow
+        if (packet_length == 0 && current_packet.number_of_packets > 0) {
+            packet_length = current_packet.length / current_packet.number_of_packets;
+        }
+
+        return uint16_t(std::min(packet_length, uint64_t(UINT16_MAX)));
+    }
+
+    static std::pair<uint16_t, const traffic_share_t*> get_top_port(const std::unordered_map<uint16_t, traffic_share_t>& ports) {
+        std::pair<uint16_t, const traffic_share_t*> top_port(0, nullptr);
+
+        for (const auto& port : ports) {
+            if (top_port.second == nullptr or port.second.packets > top_port.second->packets) {
+                top_port = std::make_pair(port.first, &port.second);
+            }
+        }
+
+        return top_port;
+    }
+
+    flow_spec_signature_t build_signature(const group_t& group) {
+        flow_spec_signature_t signature;
+
+        signature.protocol              = group.protocol;
+        signature.fragmented            = group.fragmented;
+        signature.packets               = group.total.packets;
+        signature.minimum_packet_length = group.total.minimum_packet_length;
+        signature.maximum_packet_length = group.total.maximum_packet_length;
+
+        auto top_source_port      = get_top_port(group.source_ports);
+        auto top_destination_port = get_top_port(group.destination_ports);
+
+        double dominant_port_packets = configuration.dominant_port_share * group.total.packets;
+
+        bool source_port_dominates = top_source_port.second != nullptr && top_source_port.second->packets >= dominant_port_packets;
+        bool destination_port_dominates =
+            top_destination_port.second != nullptr && top_destination_port.second->packets >= dominant_port_packets;
+
+        // Rule matches only packets with this port and we use its length range and traffic
+        if (source_port_dominates) {
+            signature.source_port_used      = true;
+            signature.source_port           = top_source_port.first;
+            signature.packets               = top_source_port.second->packets;
+            signature.minimum_packet_length = top_source_port.second->minimum_packet_length;
+            signature.maximum_packet_length = top_source_port.second->maximum_packet_length;
+        }
+
+        // When both ports are same for most of traffic we have single flow and use both of them
+        if (destination_port_dominates) {
+            signature.destination_port_used = true;
+            signature.destination_port      = top_destination_port.first;
+
+            if (!source_port_dominates) {
+                signature.packets               = top_destination_port.second->packets;
+                signature.minimum_packet_length = top_destination_port.second->minimum_packet_length;
+                signature.maximum_packet_length = top_destination_port.second->maximum_packet_length;
+            } else {
+                signature.packets = std::min(signature.packets, top_destination_port.second->packets);
+            }
+        }
+
+        return signature;
+    }
+
+    flow_spec_generator_configuration_t configuration;
+};
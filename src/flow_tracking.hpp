@@ -0,0 +1,42 @@
+#pragma once
+
+#include <mutex>
+#include <netinet/in.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "fastnetmon_types.hpp"
+
+// Adds packet to flow tracking table of our host, opposite host is source for incoming traffic and destination for outgoing
+// process_packet and microbenchmarks use it and we keep it in header
+inline void increment_flow_tracking_table(conntrack_main_struct_t& conntrack_element,
+                                          direction_t packet_direction,
+                                          const simple_packet_t& current_packet,
+                                          uint64_t sampled_number_of_packets,
+                                          uint64_t sampled_number_of_bytes,
+                                          std::mutex& flow_tracking_mutex) {
+    packed_conntrack_hash_t flow_tracking_structure;
+    flow_tracking_structure.opposite_ip = packet_direction == INCOMING ? current_packet.src_ip : current_packet.dst_ip;
+    flow_tracking_structure.src_port    = current_packet.source_port;
+    flow_tracking_structure.dst_port    = current_packet.destination_port;
+
+    // convert this struct to 64 bit integer
+    uint64_t connection_tracking_hash = 0;
+    memcpy(&connection_tracking_hash, &flow_tracking_structure, sizeof(connection_tracking_hash));
+
+    contrack_map_type* flow_table = nullptr;
+
+    if (current_packet.protocol == IPPROTO_TCP) {
+        flow_table = packet_direction == INCOMING ? &conntrack_element.in_tcp : &conntrack_element.out_tcp;
+    } else if (current_packet.protocol == IPPROTO_UDP) {
+        flow_table = packet_direction == INCOMING ? &conntrack_element.in_udp : &conntrack_element.out_udp;
+    } else {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock_guard(flow_tracking_mutex);
+    conntrack_key_struct_t& conntrack_key_struct = (*flow_table)[connection_tracking_hash];
+
+    conntrack_key_struct.packets += sampled_number_of_packets;
+    conntrack_key_struct.bytes += sampled_number_of_bytes;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "rcu_pointer.hpp"
+
+// Immutable set of IPv4 addresses with open addressing
+// It's built once and then only read, so lookups do not need any locks
+class ipv4_host_set_t {
+    public:
+    ipv4_host_set_t() {
+    }
+
+    ipv4_host_set_t(const std::vector<uint32_t>& hosts) {
+        // Keep load factor below 0.5 to keep probe chains short
+        size_t number_of_slots = 16;
+
+        while (number_of_slots < hosts.size() * 2) {
+            number_of_slots *= 2;
+        }
+
+        slots.resize(number_of_slots, 0);
+        slots_mask = number_of_slots - 1;
+
+        for (auto host : hosts) {
+            insert(host);
+        }
+    }
+
+    bool contains(uint32_t host) const {
+        if (number_of_elements == 0) {
+            return false;
+        }
+
+        // We use zero as marker for empty slot
+        if (host == 0) {
+            return contains_zero_address;
+        }
+
+        for (size_t position = hash(host) & slots_mask;; position = (position + 1) & slots_mask) {
+            if (slots[position] == host) {
+                return true;
+            }
+
+            if (slots[position] == 0) {
+                return false;
+            }
+        }
+    }
+
+    size_t size() const {
+        return number_of_elements;
+    }
+
+    bool empty() const {
+        return number_of_elements == 0;
+    }
+
+    private:
+    void insert(uint32_t host) {
+        if (host == 0) {
+            if (!contains_zero_address) {
+                contains_zero_address = true;
+                number_of_elements++;
+            }
+
+            return;
+        }
+
+        for (size_t position = hash(host) & slots_mask;; position = (position + 1) & slots_mask) {
+            if (slots[position] == host) {
+                return;
+            }
+
+            if (slots[position] == 0) {
+                slots[position] = host;
+                number_of_elements++;
+                return;
+            }
+        }
+    }
+
+    // Multiplicative hashing spreads addresses from same subnet over whole table
+    static size_t hash(uint32_t host) {
+        return (size_t)((uint64_t(host) * 0x9E3779B97F4A7C15ULL) >> 32);
+    }
+
+    std::vector<uint32_t> slots;
+    size_t slots_mask          = 0;
+    size_t number_of_elements  = 0;
+    bool contains_zero_address = false;
+};
+
+// Set of IPv4 hosts which could be read from hot path without locks
+// Writers build new copy of set and publish it with rcu_pointer_t, lookup from process_packet takes nanoseconds
+// and fits grace period with big margin
+class rcu_ipv4_host_set_t {
+    public:
+    bool contains(uint32_t host) const {
+        return current_set.get()->contains(host);
+    }
+
+    bool empty() const {
+        return current_set.get()->empty();
+    }
+
+    // Replaces whole content of set
+    void publish(const std::vector<uint32_t>& hosts) {
+        current_set.publish(new ipv4_host_set_t(hosts));
+    }
+
+    private:
+    rcu_pointer_t<ipv4_host_set_t> current_set;
+};
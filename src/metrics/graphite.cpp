@@ -4,6 +4,7 @@
 #include "../fast_library.hpp"
 #include "../fastnetmon_types.hpp"
 
+#include <shared_mutex>
 #include <vector>
 
 #include "../all_logcpp_libraries.hpp"
@@ -13,6 +14,7 @@
 extern log4cpp::Category& logger;
 extern map_of_vector_counters_t SubnetVectorMapSpeed;
 extern map_of_vector_counters_t SubnetVectorMapSpeedAverage;
+extern std::shared_mutex subnet_vector_maps_mutex;
 extern uint64_t incoming_total_flows_speed;
 extern uint64_t outgoing_total_flows_speed;
 extern abstract_subnet_counters_t<subnet_cidr_mask_t> ipv4_network_counters;
@@ -33,13 +35,15 @@ bool push_hosts_traffic_counters_to_graphite() {
 
     map_of_vector_counters_t* current_speed_map = &SubnetVectorMapSpeedAverage;
 
+    // Reload could not add or remove networks while we iterate over them
+    std::shared_lock<std::shared_mutex> lock(subnet_vector_maps_mutex);
+
     // Iterate over all networks
     for (map_of_vector_counters_t::iterator itr = current_speed_map->begin(); itr != current_speed_map->end(); ++itr) {
 
         // Iterate over all hosts in network
-        for (vector_of_counters_t::iterator vector_itr = itr->second.begin(); vector_itr != itr->second.end(); ++vector_itr) {
-            int current_index = vector_itr - itr->second.begin();
-
+        // In sparse mode we have counters only for blocks with traffic
+        itr->second.for_each_allocated_element([&](size_t current_index, subnet_counter_t& current_element) {
             // convert to host order for math operations
             uint32_t subnet_ip                     = ntohl(itr->first.subnet_address);
             uint32_t client_ip_in_host_bytes_order = subnet_ip + current_index;
@@ -54,7 +58,7 @@ bool push_hosts_traffic_counters_to_graphite() {
             std::replace(ip_as_string_with_dash_delimiters.begin(), ip_as_string_with_dash_delimiters.end(), '.', '_');
 
             // Here we could have average or instantaneous speed
-            subnet_counter_t* current_speed_element = &*vector_itr;
+            subnet_counter_t* current_speed_element = &current_element;
 
             for (auto data_direction : processed_directions) {
                 std::string direction_as_string;
@@ -103,7 +107,7 @@ bool push_hosts_traffic_counters_to_graphite() {
                     }
                 }
             }
-        }
+        });
 
         bool graphite_put_result = store_data_to_graphite(graphite_port, graphite_host, graphite_data);
 
@@ -8,11 +8,13 @@
 
 #include "../abstract_subnet_counters.hpp"
 
+#include <shared_mutex>
 #include <vector>
 
 extern struct timeval graphite_thread_execution_time;
 extern map_of_vector_counters_t SubnetVectorMapSpeed;
 extern map_of_vector_counters_t SubnetVectorMapSpeedAverage;
+extern std::shared_mutex subnet_vector_maps_mutex;
 extern uint64_t incoming_total_flows_speed;
 extern uint64_t outgoing_total_flows_speed;
 extern abstract_subnet_counters_t<subnet_cidr_mask_t> ipv4_network_counters;
@@ -257,16 +259,18 @@ bool push_hosts_traffic_counters_to_influxdb(std::string influx_database,
 
     map_of_vector_counters_t* current_speed_map = &SubnetVectorMapSpeedAverage;
 
+    // Reload could not add or remove networks while we iterate over them
+    std::shared_lock<std::shared_mutex> lock(subnet_vector_maps_mutex);
+
     // Iterate over all networks
     for (map_of_vector_counters_t::iterator itr = current_speed_map->begin(); itr != current_speed_map->end(); ++itr) {
         std::vector<std::pair<std::string, std::map<std::string, uint64_t>>> hosts_vector;
 
         // Iterate over all hosts in network
-        for (vector_of_counters_t::iterator vector_itr = itr->second.begin(); vector_itr != itr->second.end(); ++vector_itr) {
+        // In sparse mode we have counters only for blocks with traffic
+        itr->second.for_each_allocated_element([&](size_t current_index, subnet_counter_t& current_element) {
             std::map<std::string, uint64_t> plain_total_counters_map;
 
-            int current_index = vector_itr - itr->second.begin();
-
             // Convert to host order for math operations
             uint32_t subnet_ip                     = ntohl(itr->first.subnet_address);
             uint32_t client_ip_in_host_bytes_order = subnet_ip + current_index;
@@ -277,18 +281,18 @@ bool push_hosts_traffic_counters_to_influxdb(std::string influx_database,
             std::string client_ip_as_string = convert_ip_as_uint_to_string(client_ip);
 
             // Here we could have average or instantaneous speed
-            subnet_counter_t* current_speed_element = &*vector_itr;
+            subnet_counter_t* current_speed_element = &current_element;
 
             // Skip elements with zero speed
             if (current_speed_element->is_zero()) {
-                continue;
+                return;
             }
 
             fill_main_counters_for_influxdb(current_speed_element, plain_total_counters_map, true);
 
             // Key: client_ip_as_string
             hosts_vector.push_back(std::make_pair(client_ip_as_string, plain_total_counters_map));
-        }
+        });
 
         if (hosts_vector.size() > 0) {
             bool result = write_batch_of_data_to_influxdb(influx_database, influx_host, influx_port, enable_auth, influx_user,
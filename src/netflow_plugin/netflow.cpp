@@ -1,8 +1,16 @@
 #include "netflow.hpp"
 
 #include "../ipfix_rfc.hpp"
+#include <string.h>
 #include <vector>
 
+#include <boost/serialization/map.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+
 extern ipfix_information_database ipfix_db_instance;
 
 bool operator==(const peer_nf9_template& lhs, const peer_nf9_template& rhs) {
@@ -61,3 +69,42 @@ std::string print_peer_nf9_template(const peer_nf9_template& field_template) {
 
     return buffer.str();
 }
+
+bool serialize_netflow_templates_snapshot(const netflow_templates_snapshot_t& snapshot, std::string& output) {
+    try {
+        std::stringstream buffer;
+
+        {
+            // Archive flushes data in destructor
+            boost::archive::binary_oarchive archive(buffer);
+            archive << BOOST_SERIALIZATION_NVP(snapshot);
+        }
+
+        output = buffer.str();
+    } catch (const std::exception& e) {
+        return false;
+    }
+
+    return true;
+}
+
+bool deserialize_netflow_templates_snapshot(const std::string& input, netflow_templates_snapshot_t& snapshot) {
+    try {
+        std::stringstream buffer(input);
+
+        boost::archive::binary_iarchive archive(buffer);
+        archive >> BOOST_SERIALIZATION_NVP(snapshot);
+    } catch (const std::exception& e) {
+        // Broken file or file from incompatible version of Boost
+        return false;
+    }
+
+    return true;
+}
+
+bool netflow_templates_snapshot_is_stale(const netflow_templates_snapshot_t& snapshot, int64_t current_time, int64_t max_age) {
+    int64_t snapshot_age = current_time - snapshot.save_time;
+
+    // Time went backwards or router could change templates while we were down
+    return snapshot_age < 0 || snapshot_age > max_age;
+}
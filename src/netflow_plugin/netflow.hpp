@@ -377,4 +377,30 @@ class __attribute__((__packed__)) nf9_options_header_t {
 typedef std::map<uint32_t, peer_nf9_template> template_storage_t;
 typedef std::map<std::string, template_storage_t> global_template_storage_t;
 
+// Templates and sampling rates which we keep on disk to decode data from first packets after restart
+class netflow_templates_snapshot_t {
+    public:
+    // Unix time when we saved snapshot, we use it to ignore stale templates on load
+    int64_t save_time = 0;
+
+    global_template_storage_t netflow9_templates;
+    global_template_storage_t ipfix_templates;
+
+    std::map<std::string, uint32_t> netflow9_sampling_rates;
+    std::map<std::string, uint32_t> ipfix_sampling_rates;
+
+    // For boost serialize
+    template <typename Archive> void serialize(Archive& ar, const unsigned int version) {
+        ar& BOOST_SERIALIZATION_NVP(save_time);
+        ar& BOOST_SERIALIZATION_NVP(netflow9_templates);
+        ar& BOOST_SERIALIZATION_NVP(ipfix_templates);
+        ar& BOOST_SERIALIZATION_NVP(netflow9_sampling_rates);
+        ar& BOOST_SERIALIZATION_NVP(ipfix_sampling_rates);
+    }
+};
+
+bool serialize_netflow_templates_snapshot(const netflow_templates_snapshot_t& snapshot, std::string& output);
+bool deserialize_netflow_templates_snapshot(const std::string& input, netflow_templates_snapshot_t& snapshot);
+bool netflow_templates_snapshot_is_stale(const netflow_templates_snapshot_t& snapshot, int64_t current_time, int64_t max_age);
+
 std::string get_netflow9_template_type_as_string(netflow9_template_type type);
@@ -1,13 +1,12 @@
 /* netflow plugin body */
 
-// TODO: add timestamp to netflow templates stored at disk
-// TODO: do not kill disk with netflow template writes to disk
-
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
+#include <unistd.h>
 
+#include <atomic>
 #include <fstream>
 #include <map>
 #include <mutex>
@@ -15,6 +14,7 @@
 
 #include "../fast_library.hpp"
 #include "../ipfix_rfc.hpp"
+#include "../rcu_pointer.hpp"
 
 #include "../all_logcpp_libraries.hpp"
 
@@ -47,6 +47,19 @@ std::map<std::string, uint32_t> netflow9_sampling_rates;
 std::mutex ipfix_sampling_rates_mutex;
 std::map<std::string, uint32_t> ipfix_sampling_rates;
 
+// We store templates on disk to decode traffic immediately after restart
+bool netflow_templates_cache = true;
+std::string netflow_templates_cache_path = "/var/tmp/fastnetmon_netflow_templates.dat";
+
+// We ignore saved templates older than this as router may have changed them while we were down
+unsigned int netflow_templates_cache_max_age = 3600;
+
+// Templates writer checks this flag and writes all templates to disk when it's set
+std::atomic<bool> netflow_templates_changed{ false };
+
+// Serialises writers of template storages, readers do not use it
+std::mutex global_netflow_templates_mutex;
+
 std::string netflow_plugin_name       = "netflow";
 std::string netflow_plugin_log_prefix = netflow_plugin_name + ": ";
 
@@ -264,6 +277,10 @@ std::string template_netflow_ipfix_disk_writes_desc =
     "Number of times when we write Netflow or ipfix templates to disk";
 uint64_t template_netflow_ipfix_disk_writes = 0;
 
+std::string template_netflow_ipfix_disk_write_errors_desc =
+    "Number of times when we failed to write Netflow or ipfix templates to disk";
+uint64_t template_netflow_ipfix_disk_write_errors = 0;
+
 
 std::string netflow_ignored_long_flows_desc = "Number of flows which exceed specified limit in configuration";
 uint64_t netflow_ignored_long_flows         = 0;
@@ -309,8 +326,10 @@ uint64_t flowsets_per_packet_maximum_number = 256;
 // TODO: add per source uniq templates support
 process_packet_pointer netflow_process_func_ptr = NULL;
 
-global_template_storage_t global_netflow9_templates;
-global_template_storage_t global_netflow10_templates;
+// Templates change rarely and we look them up for each data flowset
+// Writers publish new copy of storage and collector threads read it without locks
+rcu_pointer_t<global_template_storage_t> global_netflow9_templates;
+rcu_pointer_t<global_template_storage_t> global_netflow10_templates;
 
 std::vector<system_counter_t> get_netflow_stats() {
     std::vector<system_counter_t> system_counter;
@@ -487,12 +506,14 @@ std::vector<system_counter_t> get_netflow_stats() {
 
     system_counter.push_back(system_counter_t("template_netflow_ipfix_disk_writes", template_netflow_ipfix_disk_writes,
                                               metric_type_t::counter, template_netflow_ipfix_disk_writes_desc));
+    system_counter.push_back(system_counter_t("template_netflow_ipfix_disk_write_errors", template_netflow_ipfix_disk_write_errors,
+                                              metric_type_t::counter, template_netflow_ipfix_disk_write_errors_desc));
 
     return system_counter;
 }
 
 /* Prototypes */
-void add_update_peer_template(global_template_storage_t& table_for_add,
+void add_update_peer_template(rcu_pointer_t<global_template_storage_t>& table_for_add,
                               uint32_t source_id,
                               uint32_t template_id,
                               const std::string& client_addres_in_string_format,
@@ -527,34 +548,42 @@ int nf9_rec_to_flow(uint32_t record_type,
                     std::vector<peer_nf9_record_t>& template_records,
                     netflow_meta_info_t& flow_meta);
 
-peer_nf9_template* peer_find_template(global_template_storage_t& table_for_lookup,
-                                      uint32_t source_id,
-                                      uint32_t template_id,
-                                      std::string client_addres_in_string_format) {
+// Returns template from current copy of storage, we do not take locks here as writers never change published copy
+// Caller must not keep pointer after processing of packet
+const peer_nf9_template* peer_find_template(const rcu_pointer_t<global_template_storage_t>& table_for_lookup,
+                                            uint32_t source_id,
+                                            uint32_t template_id,
+                                            const std::string& client_addres_in_string_format) {
 
     // We use source_id for distinguish multiple netflow agents with same IP
     std::string key = client_addres_in_string_format + "_" + std::to_string(source_id);
 
-    global_template_storage_t::iterator itr = table_for_lookup.find(key);
+    const global_template_storage_t* templates = table_for_lookup.get();
+
+    auto itr = templates->find(key);
 
-    if (itr == table_for_lookup.end()) {
-        return NULL;
+    if (itr == templates->end()) {
+        return nullptr;
     }
 
-    // Well, we found it!
-    if (itr->second.count(template_id) > 0) {
-        return &itr->second[template_id];
-    } else {
-        return NULL;
+    auto template_itr = itr->second.find(template_id);
+
+    if (template_itr == itr->second.end()) {
+        return nullptr;
     }
+
+    // Well, we found it!
+    return &template_itr->second;
 }
 
 // Wrapper functions
-peer_nf9_template* peer_nf9_find_template(uint32_t source_id, uint32_t template_id, std::string client_addres_in_string_format) {
+const peer_nf9_template*
+peer_nf9_find_template(uint32_t source_id, uint32_t template_id, const std::string& client_addres_in_string_format) {
     return peer_find_template(global_netflow9_templates, source_id, template_id, client_addres_in_string_format);
 }
 
-peer_nf9_template* peer_nf10_find_template(uint32_t source_id, uint32_t template_id, std::string client_addres_in_string_format) {
+const peer_nf9_template*
+peer_nf10_find_template(uint32_t source_id, uint32_t template_id, const std::string& client_addres_in_string_format) {
     return peer_find_template(global_netflow10_templates, source_id, template_id, client_addres_in_string_format);
 }
 
@@ -967,7 +996,7 @@ bool process_netflow_v9_template(uint8_t* pkt, size_t len, uint32_t source_id, c
     return true;
 }
 
-void add_update_peer_template(global_template_storage_t& table_for_add,
+void add_update_peer_template(rcu_pointer_t<global_template_storage_t>& table_for_add,
                               uint32_t source_id,
                               uint32_t template_id,
                               const std::string& client_addres_in_string_format,
@@ -976,47 +1005,31 @@ void add_update_peer_template(global_template_storage_t& table_for_add,
 
     std::string key = client_addres_in_string_format + "_" + std::to_string(source_id);
 
-    // logger<< log4cpp::Priority::INFO<<"It's new option template
-    // "<<template_id<<" for host:
-    // "<<client_addres_in_string_format
-    //    <<" with source id: "<<source_id;
-
-    global_template_storage_t::iterator itr = table_for_add.find(key);
+    std::lock_guard<std::mutex> lock_guard(global_netflow_templates_mutex);
 
-    if (itr != table_for_add.end()) {
-        // We have information block about this agent
+    const global_template_storage_t* current_templates = table_for_add.get();
 
-        // Try to find actual template id here
-        if (itr->second.count(template_id) > 0) {
-            // logger<< log4cpp::Priority::INFO<<"We already have information about
-            // this template
-            // with id:"
-            //    <<template_id<<" for host: "<<client_addres_in_string_format;
+    auto itr = current_templates->find(key);
 
-            // Should I track timestamp here and drop old templates after some time?
-            if (itr->second[template_id] != field_template) {
-                itr->second[template_id] = field_template;
+    if (itr != current_templates->end()) {
+        auto template_itr = itr->second.find(template_id);
 
-                updated = true;
-            } else {
-                template_update_attempts_with_same_template_data++;
-            }
-        } else {
-            // logger<< log4cpp::Priority::INFO<<"It's new option template
-            // "<<template_id<<" for
-            // host: "<<client_addres_in_string_format;
-            itr->second[template_id] = field_template;
-            updated                  = true;
+        // Routers send same templates every few seconds and we do not copy storage for them
+        if (template_itr != itr->second.end() && template_itr->second == field_template) {
+            template_update_attempts_with_same_template_data++;
+            return;
         }
-    } else {
-        // We do not have any information about this Netflow agent
-        template_storage_t temp_template_storage;
-        temp_template_storage[template_id] = field_template;
-
-        table_for_add[key] = temp_template_storage;
-        updated            = true;
     }
 
+    // It's new template or template was changed by agent
+    global_template_storage_t* new_templates = new global_template_storage_t(*current_templates);
+    (*new_templates)[key][template_id]       = field_template;
+
+    table_for_add.publish(new_templates);
+
+    updated                   = true;
+    netflow_templates_changed = true;
+
     return;
 }
 
@@ -1437,11 +1450,11 @@ bool nf10_rec_to_flow(uint32_t record_type, uint32_t record_length, uint8_t* dat
 }
 
 // Read options data packet with known templat
-bool nf10_options_flowset_to_store(uint8_t* pkt, size_t len, nf10_header_t* nf10_hdr, peer_nf9_template* flow_template, std::string client_addres_in_string_format) {
+bool nf10_options_flowset_to_store(uint8_t* pkt, size_t len, nf10_header_t* nf10_hdr, const peer_nf9_template* flow_template, std::string client_addres_in_string_format) {
     // Skip scope fields, I really do not want to parse this informations
     pkt += flow_template->option_scope_length;
 
-    auto template_records = flow_template->records;
+    const auto& template_records = flow_template->records;
 
     uint32_t sampling_rate = 0;
     uint32_t offset        = 0;
@@ -1499,6 +1512,7 @@ bool nf10_options_flowset_to_store(uint8_t* pkt, size_t len, nf10_header_t* nf10
             ipfix_sampling_rates[client_addres_in_string_format] = new_sampling_rate;
 
             ipfix_sampling_rate_changes++;
+            netflow_templates_changed = true;
 
             logger << log4cpp::Priority::DEBUG << "Change IPFIX sampling rate from " << old_sampling_rate << " to "
                    << new_sampling_rate << " for " << client_addres_in_string_format;
@@ -1512,7 +1526,7 @@ bool nf10_options_flowset_to_store(uint8_t* pkt, size_t len, nf10_header_t* nf10
 void nf10_flowset_to_store(uint8_t* pkt,
                            size_t len,
                            nf10_header_t* nf10_hdr,
-                           peer_nf9_template* field_template,
+                           const peer_nf9_template* field_template,
                            uint32_t client_ipv4_address,
                            const std::string& client_addres_in_string_format) {
     uint32_t offset = 0;
@@ -1548,7 +1562,7 @@ void nf10_flowset_to_store(uint8_t* pkt,
     // But code below can switch it to IPv6
     packet.ip_protocol_version = 4;
 
-    for (std::vector<peer_nf9_record_t>::iterator iter = field_template->records.begin();
+    for (std::vector<peer_nf9_record_t>::const_iterator iter = field_template->records.begin();
          iter != field_template->records.end(); iter++) {
 
         uint32_t record_type   = iter->record_type;
@@ -1621,13 +1635,13 @@ void nf10_flowset_to_store(uint8_t* pkt,
 }
 
 // Read options data packet with known template
-void nf9_options_flowset_to_store(uint8_t* pkt, size_t len, nf9_header_t* nf9_hdr, peer_nf9_template* flow_template, std::string client_addres_in_string_format) {
+void nf9_options_flowset_to_store(uint8_t* pkt, size_t len, nf9_header_t* nf9_hdr, const peer_nf9_template* flow_template, std::string client_addres_in_string_format) {
     // Skip scope fields, I really do not want to parse this informations
     pkt += flow_template->option_scope_length;
     // logger << log4cpp::Priority::ERROR << "We have following length for option_scope_length " <<
     // flow_template->option_scope_length;
 
-    auto template_records = flow_template->records;
+    const auto& template_records = flow_template->records;
 
     uint32_t sampling_rate = 0;
     uint32_t offset        = 0;
@@ -1686,6 +1700,7 @@ void nf9_options_flowset_to_store(uint8_t* pkt, size_t len, nf9_header_t* nf9_hd
             netflow9_sampling_rates[client_addres_in_string_format] = new_sampling_rate;
 
             netflow9_sampling_rate_changes++;
+            netflow_templates_changed = true;
 
             logger << log4cpp::Priority::DEBUG << "Change sampling rate from " << old_sampling_rate << " to "
                    << new_sampling_rate << " for " << client_addres_in_string_format;
@@ -1754,7 +1769,7 @@ void increment_duration_counters_netflow_v5(int64_t duration) {
 void nf9_flowset_to_store(uint8_t* pkt,
                           size_t len,
                           nf9_header_t* nf9_hdr,
-                          std::vector<peer_nf9_record_t>& template_records,
+                          const std::vector<peer_nf9_record_t>& template_records,
                           std::string& client_addres_in_string_format,
                           uint32_t client_ipv4_address) {
     // Should be done according to
@@ -1794,7 +1809,7 @@ void nf9_flowset_to_store(uint8_t* pkt,
     netflow_meta_info_t flow_meta;
 
     // We should iterate over all available template fields
-    for (std::vector<peer_nf9_record_t>::iterator iter = template_records.begin(); iter != template_records.end(); iter++) {
+    for (std::vector<peer_nf9_record_t>::const_iterator iter = template_records.begin(); iter != template_records.end(); iter++) {
         uint32_t record_type   = iter->record_type;
         uint32_t record_length = iter->record_length;
 
@@ -1924,9 +1939,10 @@ bool process_netflow_v10_data(uint8_t* pkt,
 
     uint32_t flowset_id = ntohs(dath->c.flowset_id);
 
-    peer_nf9_template* flowset_template = peer_nf10_find_template(source_id, flowset_id, client_addres_in_string_format);
+    const peer_nf9_template* flowset_template =
+        peer_nf10_find_template(source_id, flowset_id, client_addres_in_string_format);
 
-    if (flowset_template == NULL) {
+    if (flowset_template == nullptr) {
         ipfix_packets_with_unknown_templates++;
 
         logger << log4cpp::Priority::DEBUG << "We don't have a IPFIX template for flowset_id: " << flowset_id
@@ -2001,9 +2017,10 @@ int process_netflow_v9_data(uint8_t* pkt,
     // "<<flowset_id;
 
     // We should find template here
-    peer_nf9_template* flowset_template = peer_nf9_find_template(source_id, flowset_id, client_addres_in_string_format);
+    const peer_nf9_template* flowset_template =
+        peer_nf9_find_template(source_id, flowset_id, client_addres_in_string_format);
 
-    if (flowset_template == NULL) {
+    if (flowset_template == nullptr) {
         netflow9_packets_with_unknown_templates++;
 
         logger << log4cpp::Priority::DEBUG << "We don't have a Netflow 9 template for flowset_id: " << flowset_id
@@ -2402,6 +2419,136 @@ bool process_netflow_packet(uint8_t* packet, uint32_t len, std::string& client_a
 
 void start_netflow_collector(std::string netflow_host, unsigned int netflow_port, bool reuse_port);
 
+// Loads templates and sampling rates saved by previous run
+bool load_netflow_templates_from_disk(const std::string& file_path) {
+    std::ifstream templates_file(file_path, std::ios::binary);
+
+    if (!templates_file.is_open()) {
+        logger << log4cpp::Priority::INFO << netflow_plugin_log_prefix << "We have no saved templates in " << file_path;
+        return false;
+    }
+
+    std::string templates_data((std::istreambuf_iterator<char>(templates_file)), std::istreambuf_iterator<char>());
+
+    netflow_templates_snapshot_t snapshot;
+
+    if (!deserialize_netflow_templates_snapshot(templates_data, snapshot)) {
+        logger << log4cpp::Priority::ERROR << netflow_plugin_log_prefix << "Cannot decode templates from " << file_path;
+        return false;
+    }
+
+    int64_t current_time = time(NULL);
+
+    // Router could change templates while we were down and we will decode traffic incorrectly with old ones
+    if (netflow_templates_snapshot_is_stale(snapshot, current_time, netflow_templates_cache_max_age)) {
+        logger << log4cpp::Priority::INFO << netflow_plugin_log_prefix << "We ignore templates from " << file_path
+               << " as they were saved " << current_time - snapshot.save_time << " seconds ago";
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock_guard(global_netflow_templates_mutex);
+
+        global_netflow9_templates.publish(new global_template_storage_t(snapshot.netflow9_templates));
+        global_netflow10_templates.publish(new global_template_storage_t(snapshot.ipfix_templates));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(netflow9_sampling_rates_mutex);
+        netflow9_sampling_rates = snapshot.netflow9_sampling_rates;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(ipfix_sampling_rates_mutex);
+        ipfix_sampling_rates = snapshot.ipfix_sampling_rates;
+    }
+
+    logger << log4cpp::Priority::INFO << netflow_plugin_log_prefix << "Loaded templates for "
+           << snapshot.netflow9_templates.size() << " Netflow v9 and " << snapshot.ipfix_templates.size()
+           << " IPFIX agents from " << file_path;
+
+    return true;
+}
+
+// Writes templates to temporary file and replaces old file with it to avoid partially written file on crash
+bool write_netflow_templates_to_disk(const std::string& file_path) {
+    netflow_templates_snapshot_t snapshot;
+    snapshot.save_time = time(NULL);
+
+    {
+        std::lock_guard<std::mutex> lock_guard(global_netflow_templates_mutex);
+
+        snapshot.netflow9_templates = *global_netflow9_templates.get();
+        snapshot.ipfix_templates    = *global_netflow10_templates.get();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(netflow9_sampling_rates_mutex);
+        snapshot.netflow9_sampling_rates = netflow9_sampling_rates;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(ipfix_sampling_rates_mutex);
+        snapshot.ipfix_sampling_rates = ipfix_sampling_rates;
+    }
+
+    std::string templates_data;
+
+    if (!serialize_netflow_templates_snapshot(snapshot, templates_data)) {
+        return false;
+    }
+
+    std::string temporary_file_path = file_path + ".tmp";
+
+    FILE* templates_file = fopen(temporary_file_path.c_str(), "wb");
+
+    if (templates_file == NULL) {
+        logger << log4cpp::Priority::ERROR << netflow_plugin_log_prefix << "Cannot open " << temporary_file_path
+               << " for writing: " << strerror(errno);
+        return false;
+    }
+
+    bool write_result = fwrite(templates_data.data(), 1, templates_data.size(), templates_file) == templates_data.size();
+
+    // We need data on disk before rename
+    write_result = write_result && fflush(templates_file) == 0 && fsync(fileno(templates_file)) == 0;
+
+    fclose(templates_file);
+
+    if (!write_result) {
+        logger << log4cpp::Priority::ERROR << netflow_plugin_log_prefix << "Cannot write templates to " << temporary_file_path;
+        unlink(temporary_file_path.c_str());
+        return false;
+    }
+
+    if (rename(temporary_file_path.c_str(), file_path.c_str()) != 0) {
+        logger << log4cpp::Priority::ERROR << netflow_plugin_log_prefix << "Cannot rename " << temporary_file_path << " to "
+               << file_path << ": " << strerror(errno);
+        unlink(temporary_file_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// Writes templates to disk when they change, we do it from separate thread to keep disk operations away from parsers
+void netflow_templates_writer_thread() {
+    while (true) {
+        // It's interruption point for boost threads and limits number of writes when router sends many templates
+        boost::this_thread::sleep(boost::posix_time::seconds(1));
+
+        if (!netflow_templates_changed.exchange(false)) {
+            continue;
+        }
+
+        if (write_netflow_templates_to_disk(netflow_templates_cache_path)) {
+            template_netflow_ipfix_disk_writes++;
+        } else {
+            template_netflow_ipfix_disk_write_errors++;
+        }
+    }
+}
+
 void start_netflow_collection(process_packet_pointer func_ptr) {
     logger << log4cpp::Priority::INFO << "netflow plugin started";
 
@@ -2426,6 +2573,18 @@ void start_netflow_collection(process_packet_pointer func_ptr) {
         logger << log4cpp::Priority::INFO << "Using custom sampling ratio for Netflow v9 and IPFIX: " << netflow_sampling_ratio;
     }
 
+    if (configuration_map.count("netflow_templates_cache") != 0) {
+        netflow_templates_cache = configuration_map["netflow_templates_cache"] == "on";
+    }
+
+    if (configuration_map.count("netflow_templates_cache_path") != 0) {
+        netflow_templates_cache_path = configuration_map["netflow_templates_cache_path"];
+    }
+
+    if (configuration_map.count("netflow_templates_cache_max_age") != 0) {
+        netflow_templates_cache_max_age = convert_string_to_integer(configuration_map["netflow_templates_cache_max_age"]);
+    }
+
     std::vector<std::string> ports_for_listen;
     boost::split(ports_for_listen, netflow_ports_string, boost::is_any_of(","), boost::token_compress_on);
 
@@ -2444,6 +2603,16 @@ void start_netflow_collection(process_packet_pointer func_ptr) {
 
     boost::thread_group netflow_collector_threads;
 
+    if (netflow_templates_cache) {
+        // We do it before we start collectors to decode data from first packets
+        load_netflow_templates_from_disk(netflow_templates_cache_path);
+
+        auto netflow_templates_writer = new boost::thread(netflow_templates_writer_thread);
+        set_boost_process_name(netflow_templates_writer, "netflow_tmpl");
+
+        netflow_collector_threads.add_thread(netflow_templates_writer);
+    }
+
     logger << log4cpp::Priority::INFO << netflow_plugin_log_prefix << "We will listen on " << netflow_ports.size() << " ports";
 
     for (const auto& netflow_port : netflow_ports) {
@@ -4,6 +4,7 @@
 #include <boost/version.hpp>
 
 #include "../fast_library.hpp"
+#include "../fast_time.hpp"
 
 // For support uint32_t, uint16_t
 #include <sys/types.h>
@@ -52,13 +53,13 @@ uint32_t netmap_sampling_ratio = 1;
 
 /* prototypes */
 void netmap_thread(struct nm_desc* netmap_descriptor, int netmap_thread);
-void consume_pkt(u_char* buffer, int len, int thread_number);
+void consume_pkt(u_char* buffer, int len, int thread_number, const struct timeval& ring_time);
 
 // Get log4cpp logger from main program
 extern log4cpp::Category& logger;
 
 // Pass unparsed packets number to main program
-extern uint64_t total_unparsed_packets;
+extern per_thread_counter_t total_unparsed_packets;
 
 // Global configuration map
 extern std::map<std::string, std::string> configuration_map;
@@ -76,12 +77,20 @@ int receive_packets(struct netmap_ring* ring, int thread_number) {
     cur = ring->cur;
     n   = nm_ring_space(ring);
 
+    // Netmap sets time of last synchronisation only when NR_TIMESTAMP is enabled for ring and we read clock once for
+    // all packets otherwise
+    struct timeval ring_time = ring->ts;
+
+    if (ring_time.tv_sec == 0) {
+        get_fast_time(ring_time);
+    }
+
     for (rx = 0; rx < n; rx++) {
         struct netmap_slot* slot = &ring->slot[cur];
         char* p                  = NETMAP_BUF(ring, slot->buf_idx);
 
         // process data
-        consume_pkt((u_char*)p, slot->len, thread_number);
+        consume_pkt((u_char*)p, slot->len, thread_number, ring_time);
 
         cur = nm_ring_next(ring, cur);
     }
@@ -90,10 +99,13 @@ int receive_packets(struct netmap_ring* ring, int thread_number) {
     return (rx);
 }
 
-void consume_pkt(u_char* buffer, int len, int thread_number) {
+void consume_pkt(u_char* buffer, int len, int thread_number, const struct timeval& ring_time) {
     // We should fill this structure for passing to FastNetMon
     simple_packet_t packet;
 
+    packet.ts           = ring_time;
+    packet.arrival_time = ring_time.tv_sec;
+
     packet.sample_ratio = netmap_sampling_ratio;
 
     bool netmap_extract_tunnel_traffic = false;
@@ -102,7 +114,7 @@ void consume_pkt(u_char* buffer, int len, int thread_number) {
                                                             netmap_read_packet_length_from_ip_header);
 
     if (result != network_data_stuctures::parser_code_t::success) {
-        total_unparsed_packets++;
+        total_unparsed_packets.increment();
 
         return;
     }
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <map>
+
+#include "fastnetmon_types.hpp"
+#include "libpatricia/patricia.hpp"
+
+// Lookup structures for our networks which we use from packet processing threads
+// They are built once and then only read. On reload we build new copy and publish it with rcu_pointer_t
+class networks_lookup_t {
+    public:
+    networks_lookup_t() {
+        lookup_tree_ipv4 = New_Patricia(32);
+        lookup_tree_ipv6 = New_Patricia(128);
+    }
+
+    ~networks_lookup_t() {
+        Destroy_Patricia(lookup_tree_ipv4);
+        Destroy_Patricia(lookup_tree_ipv6);
+    }
+
+    networks_lookup_t(const networks_lookup_t&) = delete;
+    networks_lookup_t& operator=(const networks_lookup_t&) = delete;
+
+    patricia_tree_t* lookup_tree_ipv4 = nullptr;
+    patricia_tree_t* lookup_tree_ipv6 = nullptr;
+
+    // Counters are owned by SubnetVectorMap and SubnetVectorMapFlow and we keep only pointers to them
+    // Counters for removed subnets live longer than any copy of lookup which references them
+    // Traffic counters for both generations of ipv4_host_counters_epoch
+    std::map<subnet_cidr_mask_t, vector_of_counters*> counters[2];
+    std::map<subnet_cidr_mask_t, vector_of_flow_counters_t*> flow_counters;
+};
@@ -0,0 +1,178 @@
+#include "offline_pcap_ingestion.hpp"
+
+#include <cmath>
+
+#include <boost/thread.hpp>
+
+#include "all_logcpp_libraries.hpp"
+#include "fast_time.hpp"
+#include "simple_packet_parser_ng.hpp"
+
+extern log4cpp::Category& logger;
+
+// http://www.tcpdump.org/linktypes.html
+const uint32_t offline_pcap_ethernet_linktype = 1;
+
+bool offline_pcap_ingestion_t::run(const std::vector<std::string>& pcap_file_paths,
+                                   packet_processor_t packet_processor,
+                                   const recalculation_callback_t& recalculation_callback) {
+    executor.set_number_of_workers(number_of_threads);
+
+    // Calling thread is first worker
+    boost::thread_group workers;
+
+    for (unsigned int worker_index = 1; worker_index < number_of_threads; worker_index++) {
+        workers.create_thread([this, worker_index]() { executor.run_worker(worker_index); });
+    }
+
+    bool all_files_processed = true;
+
+    for (const auto& pcap_file_path : pcap_file_paths) {
+        if (!process_file(pcap_file_path, packet_processor, recalculation_callback)) {
+            all_files_processed = false;
+        }
+    }
+
+    // Last slice could be incomplete but we use full length for it because very short period inflates speed a lot
+    if (slice_started) {
+        recalculation_callback(slice_length);
+        slices++;
+    }
+
+    workers.interrupt_all();
+    workers.join_all();
+
+    finished = true;
+
+    return all_files_processed;
+}
+
+bool offline_pcap_ingestion_t::process_file(const std::string& pcap_file_path,
+                                            packet_processor_t packet_processor,
+                                            const recalculation_callback_t& recalculation_callback) {
+    pcap_file_mapping_t pcap_file_mapping;
+    std::string error_text;
+
+    if (!pcap_file_mapping.open(pcap_file_path, error_text)) {
+        logger << log4cpp::Priority::ERROR << "Can't open dump " << pcap_file_path << ": " << error_text;
+        return false;
+    }
+
+    if (pcap_file_mapping.get_file_header().linktype != offline_pcap_ethernet_linktype) {
+        logger << log4cpp::Priority::ERROR << "Dump " << pcap_file_path << " has link type "
+               << pcap_file_mapping.get_file_header().linktype << " but we support only Ethernet";
+        return false;
+    }
+
+    logger << log4cpp::Priority::INFO << "Start processing of dump " << pcap_file_path;
+
+    bool dump_is_complete = pcap_file_mapping.for_each_packet([&](const fastnetmon_pcap_pkthdr& packet_header, uint8_t* packet) {
+        frames++;
+
+        double current_packet_time = double(packet_header.ts_sec) + double(packet_header.ts_usec) / 1000000;
+
+        if (!slice_started) {
+            slice_end     = current_packet_time + slice_length;
+            slice_started = true;
+        }
+
+        // Packets with slightly older timestamps are common in dumps from multiple queues and we keep them in current slice
+        if (current_packet_time >= slice_end) {
+            process_batch(packet_processor);
+
+            // Nobody needs packets before this one
+            pcap_file_mapping.release_processed_data(packet);
+
+            recalculation_callback(slice_length);
+            slices++;
+
+            // We have no packets for multiple slices and calculate speed for all of them at once
+            double empty_slices = std::floor((current_packet_time - slice_end) / slice_length);
+
+            if (empty_slices > 0) {
+                recalculation_callback(empty_slices * slice_length);
+                slices++;
+
+                slice_end += empty_slices * slice_length;
+            }
+
+            slice_end += slice_length;
+        }
+
+        packet_time.store(packet_header.ts_sec, std::memory_order_relaxed);
+
+        batch.push_back(offline_packet_t{ packet_header, packet });
+
+        if (batch.size() >= max_batch_size) {
+            process_batch(packet_processor);
+
+            pcap_file_mapping.release_processed_data(packet + packet_header.incl_len);
+        }
+    });
+
+    // Packets from next dump may belong to current slice and we process them together
+    process_batch(packet_processor);
+
+    if (pcap_file_mapping.get_skipped_packets() > 0) {
+        logger << log4cpp::Priority::WARN << "We skipped " << pcap_file_mapping.get_skipped_packets()
+               << " packets from non Ethernet interfaces in dump " << pcap_file_path;
+    }
+
+    if (!dump_is_complete) {
+        logger << log4cpp::Priority::ERROR << "Dump " << pcap_file_path << " ends in the middle of packet";
+        return false;
+    }
+
+    logger << log4cpp::Priority::INFO << "Finished processing of dump " << pcap_file_path;
+
+    return true;
+}
+
+void offline_pcap_ingestion_t::process_batch(packet_processor_t packet_processor) {
+    if (batch.empty()) {
+        return;
+    }
+
+    // Cleanup of counters and packet buckets use same clock as packets and we move it to time of last packet in batch
+    struct timeval batch_time;
+    batch_time.tv_sec  = batch.back().header.ts_sec;
+    batch_time.tv_usec = batch.back().header.ts_usec;
+
+    set_fast_time_override(batch_time);
+
+    size_t number_of_tasks = (batch.size() + packets_per_task - 1) / packets_per_task;
+
+    executor.run(number_of_tasks, [&](size_t task_index, size_t worker_index) {
+        size_t first_packet = task_index * packets_per_task;
+        size_t last_packet  = std::min(batch.size(), first_packet + packets_per_task);
+
+        uint64_t task_parsed_packets   = 0;
+        uint64_t task_unparsed_packets = 0;
+
+        for (size_t index = first_packet; index < last_packet; index++) {
+            const offline_packet_t& offline_packet = batch[index];
+
+            simple_packet_t current_packet;
+
+            auto result = parse_raw_packet_to_simple_packet_full_ng(offline_packet.packet, offline_packet.header.orig_len,
+                                                                    offline_packet.header.incl_len, current_packet, false, false);
+
+            if (result != network_data_stuctures::parser_code_t::success) {
+                task_unparsed_packets++;
+                continue;
+            }
+
+            current_packet.ts.tv_sec    = offline_packet.header.ts_sec;
+            current_packet.ts.tv_usec   = offline_packet.header.ts_usec;
+            current_packet.arrival_time = offline_packet.header.ts_sec;
+
+            packet_processor(current_packet);
+            task_parsed_packets++;
+        }
+
+        parsed_packets += task_parsed_packets;
+        unparsed_packets += task_unparsed_packets;
+    });
+
+    batch.clear();
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "fastnetmon_pcap_format.hpp"
+#include "fastnetmon_simple_packet.hpp"
+#include "parallel_executor.hpp"
+
+// Processes pcap and pcapng dumps instead of live traffic
+// We split traffic into slices using time from packets, parse and process packets of slice in parallel and
+// recalculate speed after each slice. In this case detection works same way as for live traffic but we do not wait for
+// wall clock and could process hours of traffic in minutes
+class offline_pcap_ingestion_t {
+    public:
+    typedef void (*packet_processor_t)(simple_packet_t&);
+
+    // Receives length of slice in seconds
+    typedef std::function<void(double period)> recalculation_callback_t;
+
+    // Should be called before run()
+    void set_configuration(unsigned int number_of_threads, double slice_length) {
+        this->number_of_threads = number_of_threads == 0 ? 1 : number_of_threads;
+        this->slice_length      = slice_length;
+    }
+
+    // Processes all dumps one by one, returns false when we failed to process any of them
+    bool run(const std::vector<std::string>& pcap_file_paths,
+             packet_processor_t packet_processor,
+             const recalculation_callback_t& recalculation_callback);
+
+    uint64_t get_frames() const {
+        return frames.load(std::memory_order_relaxed);
+    }
+
+    uint64_t get_parsed_packets() const {
+        return parsed_packets.load(std::memory_order_relaxed);
+    }
+
+    uint64_t get_unparsed_packets() const {
+        return unparsed_packets.load(std::memory_order_relaxed);
+    }
+
+    uint64_t get_slices() const {
+        return slices.load(std::memory_order_relaxed);
+    }
+
+    // Time from last processed packet
+    uint64_t get_packet_time() const {
+        return packet_time.load(std::memory_order_relaxed);
+    }
+
+    bool is_finished() const {
+        return finished.load(std::memory_order_relaxed);
+    }
+
+    private:
+    // Packet from mapped dump which waits for processing
+    class offline_packet_t {
+        public:
+        fastnetmon_pcap_pkthdr header;
+        uint8_t* packet = nullptr;
+    };
+
+    bool process_file(const std::string& pcap_file_path, packet_processor_t packet_processor, const recalculation_callback_t& recalculation_callback);
+
+    // Parses and processes collected packets in all threads
+    void process_batch(packet_processor_t packet_processor);
+
+    // Each task processes this number of packets
+    static constexpr size_t packets_per_task = 1024;
+
+    // We process packets in the middle of slice when we have too many of them
+    static constexpr size_t max_batch_size = 1024 * 1024;
+
+    unsigned int number_of_threads = 1;
+    double slice_length            = 1;
+
+    parallel_executor_t executor;
+
+    std::vector<offline_packet_t> batch;
+
+    // End of current slice in seconds
+    double slice_end   = 0;
+    bool slice_started = false;
+
+    std::atomic<uint64_t> frames{ 0 };
+    std::atomic<uint64_t> parsed_packets{ 0 };
+    std::atomic<uint64_t> unparsed_packets{ 0 };
+    std::atomic<uint64_t> slices{ 0 };
+    std::atomic<uint64_t> packet_time{ 0 };
+    std::atomic<bool> finished{ false };
+};
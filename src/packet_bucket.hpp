@@ -1,7 +1,14 @@
 #pragma once
 
+#include <atomic>
+#include <set>
+
 #include <boost/circular_buffer.hpp>
 
+#include "fast_time.hpp"
+#include "packet_capture_slab.hpp"
+#include "rcu_pointer.hpp"
+
 extern log4cpp::Category& logger;
 
 // Pattern of packet collection
@@ -42,8 +49,8 @@ class packet_bucket_t {
     std::chrono::time_point<std::chrono::system_clock> collection_start_time;
     std::chrono::time_point<std::chrono::system_clock> collection_finished_time;
 
-    // Here we are storing raw packets if they are availible (sflow, mirror)
-    boost::circular_buffer<fixed_size_packet_storage_t> raw_packets_circular_buffer;
+    // Here we are storing references to raw packets in shared slab if they are availible (sflow, mirror)
+    boost::circular_buffer<packet_capture_slot_t> raw_packets_circular_buffer;
 
     // Attack details information extracted at time when we detected attack
     attack_details_t attack_details;
@@ -56,6 +63,45 @@ template <typename TemplateKeyType> class packet_buckets_storage_t {
         buffers_maximum_capacity = capacity;
     }
 
+    // Without slab we keep only parsed packets
+    void set_packet_capture_slab(packet_capture_slab_t* slab) {
+        packet_capture_slab = slab;
+    }
+
+    // Lock free check for hot path, it may miss first packets after we enabled capture
+    bool host_is_under_capture(const TemplateKeyType& lookup_ip) const {
+        if (number_of_capturing_buckets.load(std::memory_order_acquire) == 0) {
+            return false;
+        }
+
+        return capturing_hosts.get()->count(lookup_ip) > 0;
+    }
+
+    // Removes bucket and returns its packets to slab, caller should hold packet_buckets_map_mutex
+    void remove_bucket_without_lock(const TemplateKeyType& client_ip) {
+        auto itr = packet_buckets_map.find(client_ip);
+
+        if (itr == packet_buckets_map.end()) {
+            return;
+        }
+
+        release_raw_packets(itr->second);
+        packet_buckets_map.erase(itr);
+
+        publish_capturing_hosts();
+    }
+
+    // Stops collection for bucket, caller should hold packet_buckets_map_mutex
+    void stop_collection_without_lock(packet_bucket_t& bucket) {
+        if (!bucket.we_could_receive_new_data) {
+            return;
+        }
+
+        bucket.we_could_receive_new_data = false;
+
+        publish_capturing_hosts();
+    }
+
     bool we_want_to_capture_data_for_this_ip(TemplateKeyType lookup_ip) {
         std::lock_guard<std::mutex> lock_guard(packet_buckets_map_mutex);
 
@@ -80,7 +126,7 @@ template <typename TemplateKeyType> class packet_buckets_storage_t {
     bool remove_packet_capture_for_ip(TemplateKeyType lookup_ip) {
         std::lock_guard<std::mutex> lock_guard(packet_buckets_map_mutex);
 
-        packet_buckets_map.erase(lookup_ip);
+        remove_bucket_without_lock(lookup_ip);
         return true;
     }
 
@@ -97,13 +143,13 @@ template <typename TemplateKeyType> class packet_buckets_storage_t {
         new_packet_bucket.set_capacity(buffers_maximum_capacity);
 
         // Specify start time
-        new_packet_bucket.collection_start_time = std::chrono::system_clock::now();
+        new_packet_bucket.collection_start_time = get_fast_time_point();
 
         if (buffers_maximum_capacity == 0) {
             // In this case we mark this bucket as already collected to trigger immediate detection without tpacket capture
             new_packet_bucket.we_could_receive_new_data           = false;
             new_packet_bucket.we_collected_full_buffer_least_once = true;
-            new_packet_bucket.collection_finished_time            = std::chrono::system_clock::now();
+            new_packet_bucket.collection_finished_time            = get_fast_time_point();
         } else {
             new_packet_bucket.we_could_receive_new_data = true;
         }
@@ -113,6 +159,8 @@ template <typename TemplateKeyType> class packet_buckets_storage_t {
 
         packet_buckets_map[client_ip] = new_packet_bucket;
 
+        publish_capturing_hosts();
+
         return true;
     }
 
@@ -127,13 +175,33 @@ template <typename TemplateKeyType> class packet_buckets_storage_t {
         }
 
         // Just disable capture
-        itr->second.we_could_receive_new_data = false;
+        stop_collection_without_lock(itr->second);
 
         return true;
     }
 
     // Add packet to storage if we want to receive this packet
     bool add_packet_to_storage(TemplateKeyType client_ip, simple_packet_t& current_packet) {
+        // Almost all packets are for hosts without capture and we do not touch mutex for them
+        if (!host_is_under_capture(client_ip)) {
+            return false;
+        }
+
+        // Slab is lock free and we copy payload before we take lock to keep critical section short
+        packet_capture_slot_t slot;
+
+        if (current_packet.packet_payload_length > 0 && current_packet.packet_payload_pointer != NULL &&
+            packet_capture_slab != nullptr && packet_capture_slab->is_allocated()) {
+            logger << log4cpp::Priority::DEBUG << "Add raw packet to storage with packet_payload_length "
+                   << current_packet.packet_payload_length << " and packet_payload_full_length "
+                   << current_packet.packet_payload_full_length;
+
+            if (!packet_capture_slab->store_packet(current_packet.packet_payload_pointer, current_packet.packet_payload_length,
+                                                   current_packet.packet_payload_full_length, current_packet.ts, slot)) {
+                slab_overflows.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
         std::lock_guard<std::mutex> lock_guard(packet_buckets_map_mutex);
 
         // We should explicitly add map element here before starting collection
@@ -143,10 +211,12 @@ template <typename TemplateKeyType> class packet_buckets_storage_t {
             // logger << log4cpp::Priority::ERROR << "We could not find bucket for IP " << convert_any_ip_to_string(client_ip);
             // logger << log4cpp::Priority::ERROR << "Element in map should be created before any append operations";
 
+            release_slot(slot);
             return false;
         }
 
         if (!itr->second.we_could_receive_new_data) {
+            release_slot(slot);
             return false;
         }
 
@@ -157,12 +227,12 @@ template <typename TemplateKeyType> class packet_buckets_storage_t {
                 itr->second.raw_packets_circular_buffer.size() + 1 == itr->second.raw_packets_circular_buffer.capacity()) {
 
                 // Just switch off traffic new collection
-                itr->second.we_could_receive_new_data = false;
+                stop_collection_without_lock(itr->second);
 
                 // Specify flag about correctly filled buffer
                 itr->second.we_collected_full_buffer_least_once = true;
 
-                itr->second.collection_finished_time = std::chrono::system_clock::now();
+                itr->second.collection_finished_time = get_fast_time_point();
 
                 // TODO: we could not print IP in pretty form here because we will got circullar dependency in this
                 // case...
@@ -187,15 +257,9 @@ template <typename TemplateKeyType> class packet_buckets_storage_t {
 
         itr->second.parsed_packets_circular_buffer.push_back(current_packet);
 
-        // If we have packet payload for this packet add it to storage too
-        if (current_packet.packet_payload_length > 0 && current_packet.packet_payload_pointer != NULL) {
-            logger << log4cpp::Priority::DEBUG << "Add raw packet to storage with packet_payload_length "
-                   << current_packet.packet_payload_length << " and packet_payload_full_length "
-                   << current_packet.packet_payload_full_length;
-
-            itr->second.raw_packets_circular_buffer.push_back(
-                fixed_size_packet_storage_t(current_packet.packet_payload_pointer, current_packet.packet_payload_length,
-                                            current_packet.packet_payload_full_length));
+        // If we stored packet payload add reference to it too
+        if (slot.first_chunk != UINT32_MAX) {
+            add_raw_packet(itr->second, slot);
         }
 
         logger << log4cpp::Priority::DEBUG << "Buffer size after adding packet for "
@@ -205,6 +269,69 @@ template <typename TemplateKeyType> class packet_buckets_storage_t {
         return true;
     }
 
+    // Number of raw packets which we did not store because slab was full
+    uint64_t get_slab_overflows() const {
+        return slab_overflows.load(std::memory_order_relaxed);
+    }
+
+    private:
+    // Bucket takes ownership of slot, caller should hold packet_buckets_map_mutex
+    void add_raw_packet(packet_bucket_t& bucket, packet_capture_slot_t& slot) {
+        if (bucket.raw_packets_circular_buffer.capacity() == 0) {
+            release_slot(slot);
+            return;
+        }
+
+        // Circular buffer drops oldest element and we should return its chunks first
+        if (bucket.raw_packets_circular_buffer.full()) {
+            packet_capture_slab->release_packet(bucket.raw_packets_circular_buffer.front());
+            bucket.raw_packets_circular_buffer.pop_front();
+        }
+
+        bucket.raw_packets_circular_buffer.push_back(slot);
+    }
+
+    void release_slot(packet_capture_slot_t& slot) {
+        if (packet_capture_slab != nullptr) {
+            packet_capture_slab->release_packet(slot);
+        }
+    }
+
+    void release_raw_packets(packet_bucket_t& bucket) {
+        if (packet_capture_slab == nullptr) {
+            return;
+        }
+
+        for (auto& slot : bucket.raw_packets_circular_buffer) {
+            packet_capture_slab->release_packet(slot);
+        }
+
+        bucket.raw_packets_circular_buffer.clear();
+    }
+
+    // Publishes copy of keys for buckets which receive packets, caller should hold packet_buckets_map_mutex
+    void publish_capturing_hosts() {
+        std::set<TemplateKeyType>* hosts = new std::set<TemplateKeyType>;
+
+        for (const auto& bucket : packet_buckets_map) {
+            if (bucket.second.we_could_receive_new_data) {
+                hosts->insert(bucket.first);
+            }
+        }
+
+        size_t number_of_hosts = hosts->size();
+
+        capturing_hosts.publish(hosts);
+        number_of_capturing_buckets.store(number_of_hosts, std::memory_order_release);
+    }
+
+    packet_capture_slab_t* packet_capture_slab = nullptr;
+
+    rcu_pointer_t<std::set<TemplateKeyType>> capturing_hosts;
+    std::atomic<size_t> number_of_capturing_buckets{ 0 };
+
+    std::atomic<uint64_t> slab_overflows{ 0 };
+
     // Because we could need mutexes somewhere
     public:
     unsigned int buffers_maximum_capacity = 500;
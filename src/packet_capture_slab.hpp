@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <stdint.h>
+#include <string.h>
+#include <sys/time.h>
+#include <vector>
+
+#include "fastnetmon_pcap_format.hpp"
+
+// Shared memory for raw packets captured by all packet buckets
+// We allocate it once using memory budget from configuration and split it into small chunks. Each packet takes only
+// as many chunks as it needs for bytes captured up to snaplen and buckets keep only index of first chunk
+
+// Reference to packet stored in slab
+class packet_capture_slot_t {
+    public:
+    fastnetmon_pcap_pkthdr packet_metadata{};
+
+    uint32_t first_chunk = UINT32_MAX;
+};
+
+class packet_capture_slab_t {
+    public:
+    // Payload bytes in single chunk, minimal IPv6 packet fits into one chunk
+    static constexpr uint32_t chunk_size = 128;
+
+    packet_capture_slab_t() = default;
+
+    packet_capture_slab_t(const packet_capture_slab_t&) = delete;
+    packet_capture_slab_t& operator=(const packet_capture_slab_t&) = delete;
+
+    // It could be called only before first capture
+    bool allocate(uint64_t memory_budget_bytes, unsigned int snaplen) {
+        // Each chunk needs index for link to next chunk
+        uint64_t number_of_chunks = memory_budget_bytes / (chunk_size + sizeof(uint32_t));
+
+        if (number_of_chunks == 0 || snaplen == 0) {
+            return false;
+        }
+
+        // We use UINT32_MAX as end of list
+        number_of_chunks = std::min(number_of_chunks, uint64_t(UINT32_MAX - 1));
+
+        try {
+            chunks.resize(number_of_chunks * chunk_size);
+            next_chunk.reset(new std::atomic<uint32_t>[number_of_chunks]);
+        } catch (std::bad_alloc&) {
+            chunks.clear();
+            next_chunk.reset();
+            return false;
+        }
+
+        this->number_of_chunks = number_of_chunks;
+        this->snaplen          = snaplen;
+
+        // All chunks are free
+        for (uint64_t chunk_index = 0; chunk_index < number_of_chunks; chunk_index++) {
+            next_chunk[chunk_index].store(chunk_index + 1 == number_of_chunks ? UINT32_MAX : chunk_index + 1, std::memory_order_relaxed);
+        }
+
+        free_list_head.store(make_free_list_head(0, 0), std::memory_order_release);
+        number_of_free_chunks.store(number_of_chunks, std::memory_order_relaxed);
+
+        return true;
+    }
+
+    bool is_allocated() const {
+        return number_of_chunks > 0;
+    }
+
+    unsigned int get_snaplen() const {
+        return snaplen;
+    }
+
+    uint64_t get_number_of_chunks() const {
+        return number_of_chunks;
+    }
+
+    uint64_t get_number_of_free_chunks() const {
+        return number_of_free_chunks.load(std::memory_order_relaxed);
+    }
+
+    // Returns false when we do not have enough free chunks and packet was not stored
+    // It's lock free and many threads could store packets at same time
+    bool store_packet(const void* payload_pointer,
+                      unsigned int captured_length,
+                      unsigned int real_packet_length,
+                      const struct timeval& current_time,
+                      packet_capture_slot_t& slot) {
+        unsigned int length_for_storing = std::min(captured_length, snaplen);
+
+        // We keep at least one chunk for empty packets to have valid reference
+        uint32_t required_chunks = std::max((length_for_storing + chunk_size - 1) / chunk_size, 1u);
+
+        uint32_t first_chunk = UINT32_MAX;
+        uint32_t last_chunk  = UINT32_MAX;
+
+        // We take chunks one by one from free list and link them into chain for packet
+        for (uint32_t chunk_number = 0; chunk_number < required_chunks; chunk_number++) {
+            uint32_t chunk = pop_free_chunk();
+
+            if (chunk == UINT32_MAX) {
+                // Return what we took, pop_free_chunk already subtracted these chunks from free ones
+                if (first_chunk != UINT32_MAX) {
+                    push_free_chain(first_chunk, last_chunk, chunk_number);
+                }
+
+                return false;
+            }
+
+            if (first_chunk == UINT32_MAX) {
+                first_chunk = chunk;
+            } else {
+                next_chunk[last_chunk].store(chunk, std::memory_order_relaxed);
+            }
+
+            last_chunk = chunk;
+        }
+
+        next_chunk[last_chunk].store(UINT32_MAX, std::memory_order_relaxed);
+
+        slot.packet_metadata.ts_sec   = current_time.tv_sec;
+        slot.packet_metadata.ts_usec  = current_time.tv_usec;
+        slot.packet_metadata.incl_len = length_for_storing;
+        slot.packet_metadata.orig_len = real_packet_length;
+
+        slot.first_chunk = first_chunk;
+
+        // Chunks belong only to this slot now and we copy payload without locks
+        const uint8_t* payload        = static_cast<const uint8_t*>(payload_pointer);
+        unsigned int remaining_length = length_for_storing;
+        uint32_t current_chunk        = first_chunk;
+
+        while (remaining_length > 0 && current_chunk != UINT32_MAX) {
+            unsigned int length_in_chunk = std::min(remaining_length, chunk_size);
+
+            memcpy(&chunks[uint64_t(current_chunk) * chunk_size], payload, length_in_chunk);
+
+            payload += length_in_chunk;
+            remaining_length -= length_in_chunk;
+            current_chunk = next_chunk[current_chunk].load(std::memory_order_relaxed);
+        }
+
+        return true;
+    }
+
+    // Returns chunks of packet to free list
+    void release_packet(packet_capture_slot_t& slot) {
+        if (slot.first_chunk == UINT32_MAX) {
+            return;
+        }
+
+        uint32_t last_chunk      = slot.first_chunk;
+        uint64_t released_chunks = 1;
+
+        while (next_chunk[last_chunk].load(std::memory_order_relaxed) != UINT32_MAX) {
+            last_chunk = next_chunk[last_chunk].load(std::memory_order_relaxed);
+            released_chunks++;
+        }
+
+        push_free_chain(slot.first_chunk, last_chunk, released_chunks);
+
+        slot.first_chunk = UINT32_MAX;
+    }
+
+    // Copies payload of packet into buffer, caller should own slot and release it only after this call
+    bool read_packet(const packet_capture_slot_t& slot, std::vector<uint8_t>& payload) const {
+        if (slot.first_chunk == UINT32_MAX) {
+            return false;
+        }
+
+        payload.resize(slot.packet_metadata.incl_len);
+
+        uint32_t current_chunk = slot.first_chunk;
+        uint64_t copied_length = 0;
+
+        while (copied_length < payload.size() && current_chunk != UINT32_MAX) {
+            uint64_t length_in_chunk = std::min(uint64_t(chunk_size), payload.size() - copied_length);
+
+            memcpy(&payload[copied_length], &chunks[uint64_t(current_chunk) * chunk_size], length_in_chunk);
+
+            copied_length += length_in_chunk;
+            current_chunk = next_chunk[current_chunk].load(std::memory_order_relaxed);
+        }
+
+        return true;
+    }
+
+    private:
+    // Head of free list keeps index of first chunk in low 32 bits and counter of changes in high 32 bits
+    // Counter protects us from ABA when chunk was taken and returned back while other thread tried to take it
+    static uint64_t make_free_list_head(uint32_t chunk, uint32_t tag) {
+        return (uint64_t(tag) << 32) | chunk;
+    }
+
+    // Lock free pop from stack of free chunks, returns UINT32_MAX when we have no free chunks
+    uint32_t pop_free_chunk() {
+        uint64_t current_head = free_list_head.load(std::memory_order_acquire);
+
+        while (true) {
+            uint32_t chunk = uint32_t(current_head);
+
+            if (chunk == UINT32_MAX) {
+                return UINT32_MAX;
+            }
+
+            // Chunk may be taken by other thread in same time and we may read wrong link but tag will not match then
+            uint32_t next = next_chunk[chunk].load(std::memory_order_relaxed);
+
+            if (free_list_head.compare_exchange_weak(current_head, make_free_list_head(next, uint32_t(current_head >> 32) + 1),
+                                                     std::memory_order_acquire, std::memory_order_acquire)) {
+                number_of_free_chunks.fetch_sub(1, std::memory_order_relaxed);
+                return chunk;
+            }
+        }
+    }
+
+    // Lock free push of linked chain of chunks to stack of free chunks
+    void push_free_chain(uint32_t first_chunk, uint32_t last_chunk, uint64_t number_of_chunks_in_chain) {
+        uint64_t current_head = free_list_head.load(std::memory_order_relaxed);
+
+        do {
+            next_chunk[last_chunk].store(uint32_t(current_head), std::memory_order_relaxed);
+        } while (!free_list_head.compare_exchange_weak(current_head, make_free_list_head(first_chunk, uint32_t(current_head >> 32) + 1),
+                                                       std::memory_order_release, std::memory_order_relaxed));
+
+        number_of_free_chunks.fetch_add(number_of_chunks_in_chain, std::memory_order_relaxed);
+    }
+
+    std::vector<uint8_t> chunks;
+
+    // Links chunks of same packet and free chunks
+    std::unique_ptr<std::atomic<uint32_t>[]> next_chunk;
+    uint64_t number_of_chunks = 0;
+
+    std::atomic<uint64_t> free_list_head{ make_free_list_head(UINT32_MAX, 0) };
+
+    // Could be slightly behind of real value when other threads take or return chunks
+    std::atomic<uint64_t> number_of_free_chunks{ 0 };
+
+    unsigned int snaplen = 0;
+};
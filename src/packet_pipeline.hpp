@@ -0,0 +1,322 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include "compact_packet_record.hpp"
+#include "fastnetmon_simple_packet.hpp"
+
+typedef compact_packet_record_queue_t pipeline_ring_t;
+
+// Rings and counters of single capture thread
+class pipeline_producer_t {
+    public:
+    // Ring for each processing thread
+    std::vector<std::shared_ptr<pipeline_ring_t>> rings;
+
+    // Set when capture thread exits, we remove producer after processing threads drained its rings
+    std::atomic<bool> producer_finished{ false };
+
+    alignas(64) std::atomic<uint64_t> pushed_packets{ 0 };
+    std::atomic<uint64_t> dropped_packets{ 0 };
+};
+
+// Producers of current thread for all pipelines, it marks them as finished when thread exits
+class pipeline_producers_of_thread_t {
+    public:
+    ~pipeline_producers_of_thread_t() {
+        for (auto& producer : producers) {
+            if (producer) {
+                producer->producer_finished.store(true, std::memory_order_release);
+            }
+        }
+    }
+
+    std::vector<std::shared_ptr<pipeline_producer_t>> producers;
+};
+
+// Identifiers for all pipelines, they're never reused
+inline std::atomic<size_t> packet_pipeline_instances{ 0 };
+
+// Producers of current thread indexed by identifier of pipeline
+inline thread_local pipeline_producers_of_thread_t pipeline_producers_of_current_thread;
+
+// Moves parsed packets from capture threads to processing threads
+// Each capture thread has own ring for each processing thread and we select processing thread by our host:
+// destination for incoming traffic and source for outgoing. Capture thread should set packet_direction before push
+// In this case all packets of same host are processed by same thread and slow processing never blocks capture
+class packet_pipeline_t {
+    public:
+    typedef void (*packet_processor_t)(simple_packet_t&);
+
+    packet_pipeline_t() : instance_id(packet_pipeline_instances++) {
+    }
+
+    packet_pipeline_t(const packet_pipeline_t&) = delete;
+    packet_pipeline_t& operator=(const packet_pipeline_t&) = delete;
+
+    // Should be called before we start any threads
+    void set_configuration(size_t number_of_processing_threads, size_t ring_size) {
+        this->number_of_processing_threads = number_of_processing_threads == 0 ? 1 : number_of_processing_threads;
+        this->ring_size                    = ring_size;
+
+        rings_by_processing_thread.resize(this->number_of_processing_threads);
+        processing_threads_stats.reset(new processing_thread_stats_t[this->number_of_processing_threads]);
+    }
+
+    size_t get_number_of_processing_threads() const {
+        return number_of_processing_threads;
+    }
+
+    // Called from capture threads, it never blocks them and drops packet when ring is full
+    void push(const simple_packet_t& current_packet) {
+        pipeline_producer_t* producer = get_producer();
+
+        compact_packet_record_t record;
+        convert_simple_packet_to_compact_record(current_packet, record);
+
+        // Only owner thread writes these counters and we avoid atomic increments
+        if (producer->rings[get_processing_thread_index(current_packet)]->push(record)) {
+            producer->pushed_packets.store(producer->pushed_packets.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        } else {
+            producer->dropped_packets.store(producer->dropped_packets.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+
+    // Thread body for processing thread, it should be interrupted to stop
+    void run_processing_thread(size_t processing_thread_index, packet_processor_t packet_processor) {
+        std::vector<std::shared_ptr<pipeline_ring_t>> rings;
+        uint64_t known_rings_version = 0;
+
+        processing_thread_stats_t& stats = processing_threads_stats[processing_thread_index];
+
+        compact_packet_record_t record;
+        simple_packet_t current_packet;
+
+        auto last_cleanup_time = std::chrono::steady_clock::now();
+
+        while (true) {
+            // Capture threads add and remove rings for us
+            if (rings_version.load(std::memory_order_acquire) != known_rings_version) {
+                std::lock_guard<std::mutex> lock_guard(rings_mutex);
+
+                rings               = rings_by_processing_thread[processing_thread_index];
+                known_rings_version = rings_version.load(std::memory_order_relaxed);
+            }
+
+            uint64_t processed_packets = 0;
+
+            for (auto& ring : rings) {
+                // We limit number of packets from single ring to keep other capture threads served
+                for (size_t i = 0; i < max_packets_per_ring && ring->pop(record); i++) {
+                    convert_compact_record_to_simple_packet(record, current_packet);
+                    packet_processor(current_packet);
+                    processed_packets++;
+                }
+            }
+
+            stats.processed_packets.store(stats.processed_packets.load(std::memory_order_relaxed) + processed_packets,
+                                          std::memory_order_relaxed);
+
+            // Only first processing thread removes producers of finished capture threads
+            if (processing_thread_index == 0) {
+                auto now = std::chrono::steady_clock::now();
+
+                if (now - last_cleanup_time >= std::chrono::seconds(producers_cleanup_interval_seconds)) {
+                    remove_finished_producers();
+                    last_cleanup_time = now;
+                }
+            }
+
+            if (processed_packets == 0) {
+                // It's interruption point for boost threads
+                boost::this_thread::sleep(boost::posix_time::microseconds(idle_sleep_microseconds));
+            }
+        }
+    }
+
+    // Removes rings and producers of finished capture threads when processing threads drained all their rings
+    // We keep their counters in totals of removed producers
+    size_t remove_finished_producers() {
+        std::lock_guard<std::mutex> lock_guard(rings_mutex);
+
+        size_t removed_producers = 0;
+
+        for (auto producer_itr = producers.begin(); producer_itr != producers.end();) {
+            auto& producer = *producer_itr;
+
+            // We read flag before rings and exited thread could not push anything after it
+            bool drained = producer->producer_finished.load(std::memory_order_acquire);
+
+            // Other processing threads consume these rings and we could only overestimate number of elements in them
+            for (const auto& ring : producer->rings) {
+                drained = drained && ring->read_available() == 0;
+            }
+
+            if (!drained) {
+                ++producer_itr;
+                continue;
+            }
+
+            for (size_t index = 0; index < number_of_processing_threads; index++) {
+                auto& rings = rings_by_processing_thread[index];
+
+                rings.erase(std::remove(rings.begin(), rings.end(), producer->rings[index]), rings.end());
+            }
+
+            removed_producers_pushed_packets += producer->pushed_packets.load(std::memory_order_relaxed);
+            removed_producers_dropped_packets += producer->dropped_packets.load(std::memory_order_relaxed);
+
+            producer_itr = producers.erase(producer_itr);
+            removed_producers++;
+        }
+
+        if (removed_producers > 0) {
+            rings_version++;
+        }
+
+        return removed_producers;
+    }
+
+    size_t get_number_of_producers() {
+        std::lock_guard<std::mutex> lock_guard(rings_mutex);
+
+        return producers.size();
+    }
+
+    uint64_t get_pushed_packets() {
+        std::lock_guard<std::mutex> lock_guard(rings_mutex);
+
+        uint64_t pushed_packets = removed_producers_pushed_packets;
+
+        for (const auto& producer : producers) {
+            pushed_packets += producer->pushed_packets.load(std::memory_order_relaxed);
+        }
+
+        return pushed_packets;
+    }
+
+    uint64_t get_dropped_packets() {
+        std::lock_guard<std::mutex> lock_guard(rings_mutex);
+
+        uint64_t dropped_packets = removed_producers_dropped_packets;
+
+        for (const auto& producer : producers) {
+            dropped_packets += producer->dropped_packets.load(std::memory_order_relaxed);
+        }
+
+        return dropped_packets;
+    }
+
+    uint64_t get_processed_packets() const {
+        uint64_t processed_packets = 0;
+
+        for (size_t index = 0; index < number_of_processing_threads; index++) {
+            processed_packets += processing_threads_stats[index].processed_packets.load(std::memory_order_relaxed);
+        }
+
+        return processed_packets;
+    }
+
+    // Returns number of packets in all rings and occupancy of most loaded ring in percents
+    void get_rings_occupancy(uint64_t& queued_packets, uint64_t& maximum_occupancy_percent) {
+        queued_packets            = 0;
+        maximum_occupancy_percent = 0;
+
+        std::lock_guard<std::mutex> lock_guard(rings_mutex);
+
+        for (const auto& rings : rings_by_processing_thread) {
+            for (const auto& ring : rings) {
+                size_t ring_elements = ring->read_available();
+
+                queued_packets += ring_elements;
+                maximum_occupancy_percent = std::max(maximum_occupancy_percent, uint64_t(ring_elements * 100 / ring_size));
+            }
+        }
+    }
+
+    private:
+    class alignas(64) processing_thread_stats_t {
+        public:
+        std::atomic<uint64_t> processed_packets{ 0 };
+    };
+
+    // Returns rings of current thread for this pipeline, we create them on first call
+    pipeline_producer_t* get_producer() {
+        auto& thread_producers = pipeline_producers_of_current_thread.producers;
+
+        if (instance_id < thread_producers.size() && thread_producers[instance_id]) {
+            return thread_producers[instance_id].get();
+        }
+
+        auto new_producer = std::make_shared<pipeline_producer_t>();
+
+        for (size_t index = 0; index < number_of_processing_threads; index++) {
+            new_producer->rings.push_back(std::make_shared<pipeline_ring_t>(ring_size));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock_guard(rings_mutex);
+
+            for (size_t index = 0; index < number_of_processing_threads; index++) {
+                rings_by_processing_thread[index].push_back(new_producer->rings[index]);
+            }
+
+            producers.push_back(new_producer);
+            rings_version++;
+        }
+
+        if (thread_producers.size() <= instance_id) {
+            thread_producers.resize(instance_id + 1);
+        }
+
+        thread_producers[instance_id] = new_producer;
+
+        return new_producer.get();
+    }
+
+    // We select thread by our host and all counters of host are updated from single thread
+    size_t get_processing_thread_index(const simple_packet_t& current_packet) const {
+        bool use_source = current_packet.packet_direction == OUTGOING;
+
+        uint32_t host_key = use_source ? current_packet.src_ip : current_packet.dst_ip;
+
+        if (current_packet.ip_protocol_version == 6) {
+            const in6_addr& host_address = use_source ? current_packet.src_ipv6 : current_packet.dst_ipv6;
+
+            // Last 32 bits of address are enough to spread hosts
+            memcpy(&host_key, host_address.s6_addr + 12, sizeof(host_key));
+        }
+
+        // Multiplicative hashing spreads hosts from same network
+        return (uint64_t(host_key * 2654435761u) * number_of_processing_threads) >> 32;
+    }
+
+    static constexpr size_t max_packets_per_ring                     = 1024;
+    static constexpr unsigned int idle_sleep_microseconds            = 100;
+    static constexpr unsigned int producers_cleanup_interval_seconds = 1;
+
+    size_t instance_id = 0;
+
+    size_t number_of_processing_threads = 1;
+    size_t ring_size                    = 16384;
+
+    std::mutex rings_mutex;
+    std::vector<std::vector<std::shared_ptr<pipeline_ring_t>>> rings_by_processing_thread;
+    std::vector<std::shared_ptr<pipeline_producer_t>> producers;
+    std::atomic<uint64_t> rings_version{ 0 };
+
+    // Counters of removed producers
+    uint64_t removed_producers_pushed_packets  = 0;
+    uint64_t removed_producers_dropped_packets = 0;
+
+    std::unique_ptr<processing_thread_stats_t[]> processing_threads_stats;
+};
@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "fast_time.hpp"
 #include "fastnetmon_types.hpp"
 #include "fixed_size_packet_storage.hpp"
 
@@ -51,17 +52,14 @@ class packet_storage_t {
     }
 
     bool write_packet(void* payload_pointer, unsigned int captured_length, unsigned int real_packet_length) {
-        // TODO: performance killer! Check it!
-        bool we_do_timestamps = true;
-
         struct timeval current_time;
-        current_time.tv_sec  = 0;
-        current_time.tv_usec = 0;
+        get_fast_time(current_time);
 
-        if (we_do_timestamps) {
-            gettimeofday(&current_time, NULL);
-        }
+        return write_packet(payload_pointer, captured_length, real_packet_length, current_time);
+    }
 
+    // Stores packet with time when we received it
+    bool write_packet(void* payload_pointer, unsigned int captured_length, unsigned int real_packet_length, const struct timeval& current_time) {
         fastnetmon_pcap_pkthdr pcap_packet_header;
 
         pcap_packet_header.ts_sec  = current_time.tv_sec;
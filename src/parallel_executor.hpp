@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+
+#include <boost/thread.hpp>
+
+// Runs batch of tasks on fixed set of workers and calling thread
+// Workers take tasks one by one from shared counter and faster workers take more tasks
+// Only one thread could call run() at same time
+class parallel_executor_t {
+    public:
+    typedef std::function<void(size_t task_index, size_t worker_index)> task_t;
+
+    // Calling thread of run() is worker with index 0 and we need threads with run_worker() for other workers
+    // Should be called before we start workers
+    void set_number_of_workers(size_t number_of_workers) {
+        this->number_of_workers = number_of_workers == 0 ? 1 : number_of_workers;
+    }
+
+    size_t get_number_of_workers() const {
+        return number_of_workers;
+    }
+
+    // Returns when all tasks are finished
+    void run(size_t number_of_tasks, const task_t& task) {
+        if (number_of_workers == 1 || number_of_tasks <= 1) {
+            for (size_t task_index = 0; task_index < number_of_tasks; task_index++) {
+                task(task_index, 0);
+            }
+
+            return;
+        }
+
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+
+            current_task          = &task;
+            this->number_of_tasks = number_of_tasks;
+            next_task_index       = 0;
+            running_workers       = number_of_workers - 1;
+            batch_generation++;
+        }
+
+        new_batch_condition.notify_all();
+
+        execute_tasks(0);
+
+        boost::unique_lock<boost::mutex> lock(mutex);
+
+        while (running_workers > 0) {
+            batch_finished_condition.wait(lock);
+        }
+
+        current_task = nullptr;
+    }
+
+    // Thread body for worker, it should be interrupted to stop
+    void run_worker(size_t worker_index) {
+        uint64_t processed_batch_generation = 0;
+
+        while (true) {
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+
+                while (batch_generation == processed_batch_generation) {
+                    new_batch_condition.wait(lock);
+                }
+
+                processed_batch_generation = batch_generation;
+            }
+
+            execute_tasks(worker_index);
+
+            boost::unique_lock<boost::mutex> lock(mutex);
+            running_workers--;
+
+            if (running_workers == 0) {
+                batch_finished_condition.notify_one();
+            }
+        }
+    }
+
+    private:
+    void execute_tasks(size_t worker_index) {
+        while (true) {
+            size_t task_index = next_task_index.fetch_add(1, std::memory_order_relaxed);
+
+            if (task_index >= number_of_tasks) {
+                return;
+            }
+
+            (*current_task)(task_index, worker_index);
+        }
+    }
+
+    size_t number_of_workers = 1;
+
+    boost::mutex mutex;
+    boost::condition_variable new_batch_condition;
+    boost::condition_variable batch_finished_condition;
+
+    uint64_t batch_generation = 0;
+    size_t running_workers    = 0;
+
+    // Batch fields are written under mutex before workers wake up
+    const task_t* current_task = nullptr;
+    size_t number_of_tasks     = 0;
+    std::atomic<size_t> next_task_index{ 0 };
+};
@@ -156,6 +156,10 @@ void parse_packet(u_char* user, struct pcap_pkthdr* packethdr, const u_char* pac
     current_packet.dst_ip   = dst_ip;
     current_packet.length   = packet_length;
 
+    // libpcap provides time of capture
+    current_packet.ts           = packethdr->ts;
+    current_packet.arrival_time = packethdr->ts.tv_sec;
+
     // Do packet processing
     pcap_process_func_ptr(current_packet);
 }
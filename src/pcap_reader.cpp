@@ -1,4 +1,5 @@
 #include <fcntl.h>
+#include <inttypes.h>
 #include <iostream>
 #include <sstream>
 #include <stdint.h>
@@ -10,20 +11,17 @@
 #include <sys/types.h>
 #include <unistd.h>
 
-#include "fastnetmon_pcap_format.h"
+#include "fastnetmon_pcap_format.hpp"
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <sys/socket.h>
 
-#include "netflow_plugin/netflow_collector.h"
-#include "sflow_plugin/sflow_collector.h"
+#include "netflow_plugin/netflow_collector.hpp"
+#include "sflow_plugin/sflow_collector.hpp"
 
-#include "sflow_plugin/sflow.h"
-#include "sflow_plugin/sflow_data.h"
-
-#include "fast_library.h"
-#include "fastnetmon_types.h"
+#include "fast_library.hpp"
+#include "fastnetmon_types.hpp"
 
 #include "log4cpp/Appender.hh"
 #include "log4cpp/BasicLayout.hh"
@@ -34,7 +32,7 @@
 #include "log4cpp/PatternLayout.hh"
 #include "log4cpp/Priority.hh"
 
-#include "../simple_packet_parser_ng.hpp"
+#include "simple_packet_parser_ng.hpp"
 
 // Fake config
 std::map<std::string, std::string> configuration_map;
@@ -42,7 +40,7 @@ std::map<std::string, std::string> configuration_map;
 std::string log_file_path = "/tmp/fastnetmon_pcap_reader.log";
 log4cpp::Category& logger = log4cpp::Category::getRoot();
 
-uint64_t total_unparsed_packets = 0;
+per_thread_counter_t total_unparsed_packets;
 
 uint64_t dns_amplification_packets  = 0;
 uint64_t ntp_amplification_packets  = 0;
@@ -66,8 +64,6 @@ void init_logging() {
     logger.info("Logger initialized!");
 }
 
-void pcap_parse_packet(const char* flow_type, char* buffer, uint32_t len);
-
 void my_fastnetmon_packet_handler(simple_packet_t& current_packet) {
     std::cout << print_simple_packet(current_packet);
 }
@@ -78,51 +74,36 @@ extern process_packet_pointer sflow_process_func_ptr;
 char* flow_type = NULL;
 
 void pcap_parse_packet(char* buffer, uint32_t len, uint32_t snap_len) {
-    struct pfring_pkthdr packet_header;
-    memset(&packet_header, 0, sizeof(packet_header));
-    packet_header.len    = len;
-    packet_header.caplen = snap_len;
-
-    fastnetmon_parse_pkt((u_char*)buffer, &packet_header, 4, 1, 0);
-
-    // char print_buffer[512];
-    // fastnetmon_print_parsed_pkt(print_buffer, 512, (u_char*)buffer, &packet_header);
-    // logger.info("%s", print_buffer);
-
-    char* payload_ptr = packet_header.extended_hdr.parsed_pkt.offset.payload_offset + buffer;
-
-    if (packet_header.len < packet_header.extended_hdr.parsed_pkt.offset.payload_offset) {
-        printf("Something goes wrong! Offset %u is bigger than total packet length %u\n",
-               packet_header.extended_hdr.parsed_pkt.offset.payload_offset, packet_header.len);
-        return;
-    }
-
-    unsigned int payload_length = packet_header.len - packet_header.extended_hdr.parsed_pkt.offset.payload_offset;
-
-    if (strcmp(flow_type, "netflow") == 0) {
-        netflow_process_func_ptr = my_fastnetmon_packet_handler;
-
-        std::string fake_peer_ip = "10.0.1.2";
-        process_netflow_packet((u_int8_t*)payload_ptr, payload_length, fake_peer_ip);
-    } else if (strcmp(flow_type, "sflow") == 0) {
-        sflow_process_func_ptr = my_fastnetmon_packet_handler;
+    if (strcmp(flow_type, "netflow") == 0 || strcmp(flow_type, "sflow") == 0) {
+        uint8_t* payload_ptr         = nullptr;
+        unsigned int payload_length  = 0;
+        uint32_t client_ipv4_address = 0;
+
+        if (!get_udp_payload_from_raw_packet((uint8_t*)buffer, snap_len, payload_ptr, payload_length, client_ipv4_address)) {
+            printf("Can't find UDP payload in packet\n");
+            return;
+        }
 
-        SFSample sample;
-        memset(&sample, 0, sizeof(sample));
+        if (strcmp(flow_type, "netflow") == 0) {
+            netflow_process_func_ptr = my_fastnetmon_packet_handler;
 
-        sample.rawSample     = (uint8_t*)payload_ptr;
-        sample.rawSampleLen  = payload_length;
-        sample.sourceIP.type = SFLADDRESSTYPE_IP_V4;
+            std::string client_address_in_string_format = convert_ip_as_uint_to_string(client_ipv4_address);
+            process_netflow_packet(payload_ptr, payload_length, client_address_in_string_format, client_ipv4_address);
+        } else {
+            sflow_process_func_ptr = my_fastnetmon_packet_handler;
 
-        read_sflow_datagram(&sample);
+            parse_sflow_v5_packet(payload_ptr, payload_length, client_ipv4_address);
+        }
     } else if (strcmp(flow_type, "raw") == 0) {
         simple_packet_t packet;
-        // TODO: add support for caplen here!
-        auto result = parse_raw_packet_to_simple_packet_full_ng((u_char*)buffer, len, len, packet, false, false);
+
+        auto result = parse_raw_packet_to_simple_packet_full_ng((u_char*)buffer, len, snap_len, packet, false, false);
 
         if (result == network_data_stuctures::parser_code_t::success) {
+            raw_parsed_packets++;
             std::cout << "High level parser: " << print_simple_packet(packet) << std::endl;
         } else {
+            raw_unparsed_packets++;
             printf("High level parser failed\n");
         }
     } else {
@@ -144,9 +125,9 @@ int main(int argc, char** argv) {
     pcap_reader(argv[2], pcap_parse_packet);
 
     if (strcmp(flow_type, "raw") == 0) {
-        printf("Parsed packets: %llu\n", raw_parsed_packets);
-        printf("Unparsed packets: %llu\n", raw_unparsed_packets);
+        printf("Parsed packets: %" PRIu64 "\n", raw_parsed_packets);
+        printf("Unparsed packets: %" PRIu64 "\n", raw_unparsed_packets);
 
-        printf("Total packets: %llu\n", raw_parsed_packets + raw_unparsed_packets);
+        printf("Total packets: %" PRIu64 "\n", raw_parsed_packets + raw_unparsed_packets);
     }
 }
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+// Counters which are incremented by many threads on each packet and read rarely
+// Each thread increments own copy on separate cache line without locked instructions and readers sum all copies
+// Copies of finished threads stay in place and we do not lose their increments
+
+// Identifiers for all counters, they're never reused
+inline std::atomic<size_t> per_thread_counters_instances{ 0 };
+
+// Copies of counters for current thread indexed by identifier of counters
+inline thread_local std::vector<void*> per_thread_counters_of_current_thread;
+
+template <size_t number_of_counters> class per_thread_counters_t {
+    public:
+    per_thread_counters_t() : instance_id(per_thread_counters_instances++) {
+    }
+
+    per_thread_counters_t(const per_thread_counters_t&) = delete;
+    per_thread_counters_t& operator=(const per_thread_counters_t&) = delete;
+
+    void increment(size_t counter_index, uint64_t value) {
+        std::atomic<uint64_t>& counter = get_thread_counters()->values[counter_index];
+
+        // Only current thread writes it and we do not need locked add
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    uint64_t get(size_t counter_index) const {
+        uint64_t sum = 0;
+
+        std::lock_guard<std::mutex> lock_guard(threads_counters_mutex);
+
+        for (const auto& thread_counters : threads_counters) {
+            sum += thread_counters->values[counter_index].load(std::memory_order_relaxed);
+        }
+
+        return sum;
+    }
+
+    std::array<uint64_t, number_of_counters> get_all() const {
+        std::array<uint64_t, number_of_counters> sums{};
+
+        std::lock_guard<std::mutex> lock_guard(threads_counters_mutex);
+
+        for (const auto& thread_counters : threads_counters) {
+            for (size_t counter_index = 0; counter_index < number_of_counters; counter_index++) {
+                sums[counter_index] += thread_counters->values[counter_index].load(std::memory_order_relaxed);
+            }
+        }
+
+        return sums;
+    }
+
+    private:
+    class alignas(64) thread_counters_t {
+        public:
+        std::atomic<uint64_t> values[number_of_counters]{};
+    };
+
+    thread_counters_t* get_thread_counters() {
+        if (instance_id < per_thread_counters_of_current_thread.size() &&
+            per_thread_counters_of_current_thread[instance_id] != nullptr) {
+            return static_cast<thread_counters_t*>(per_thread_counters_of_current_thread[instance_id]);
+        }
+
+        // First increment from this thread
+        thread_counters_t* thread_counters = new thread_counters_t;
+
+        {
+            std::lock_guard<std::mutex> lock_guard(threads_counters_mutex);
+            threads_counters.emplace_back(thread_counters);
+        }
+
+        if (per_thread_counters_of_current_thread.size() <= instance_id) {
+            per_thread_counters_of_current_thread.resize(instance_id + 1, nullptr);
+        }
+
+        per_thread_counters_of_current_thread[instance_id] = thread_counters;
+
+        return thread_counters;
+    }
+
+    size_t instance_id = 0;
+
+    mutable std::mutex threads_counters_mutex;
+    std::vector<std::unique_ptr<thread_counters_t>> threads_counters;
+};
+
+// Single counter
+class per_thread_counter_t : public per_thread_counters_t<1> {
+    public:
+    void increment(uint64_t value = 1) {
+        per_thread_counters_t<1>::increment(0, value);
+    }
+
+    uint64_t get() const {
+        return per_thread_counters_t<1>::get(0);
+    }
+};
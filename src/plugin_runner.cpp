@@ -39,7 +39,7 @@
 
 using namespace std;
 
-uint64_t total_unparsed_packets = 0;
+per_thread_counter_t total_unparsed_packets;
 
 std::string log_file_path = "/tmp/fastnetmon_plugin_tester.log";
 log4cpp::Category& logger = log4cpp::Category::getRoot();
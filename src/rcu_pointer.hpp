@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+// Pointer to read only object which could be replaced without blocking readers
+// Writers publish new object with single atomic store. Old objects are kept for grace period
+// to let readers finish their work with them and then we free them on next publish
+// Readers must not keep pointer returned by get() for longer than grace period
+template <typename TemplateObjectType> class rcu_pointer_t {
+    public:
+    rcu_pointer_t() {
+        current_object.store(new TemplateObjectType(), std::memory_order_release);
+    }
+
+    ~rcu_pointer_t() {
+        delete current_object.load(std::memory_order_acquire);
+
+        for (auto& retired_object : retired_objects) {
+            delete retired_object.object;
+        }
+    }
+
+    rcu_pointer_t(const rcu_pointer_t&) = delete;
+    rcu_pointer_t& operator=(const rcu_pointer_t&) = delete;
+
+    const TemplateObjectType* get() const {
+        return current_object.load(std::memory_order_acquire);
+    }
+
+    // Takes ownership of new object
+    void publish(TemplateObjectType* new_object) {
+        std::lock_guard<std::mutex> lock_guard(writers_mutex);
+
+        TemplateObjectType* old_object = current_object.exchange(new_object, std::memory_order_acq_rel);
+
+        auto now = std::chrono::steady_clock::now();
+
+        // Free copies which nobody could read anymore
+        std::vector<retired_object_t> still_retired_objects;
+
+        for (auto& retired_object : retired_objects) {
+            if (now - retired_object.retire_time > grace_period) {
+                delete retired_object.object;
+            } else {
+                still_retired_objects.push_back(retired_object);
+            }
+        }
+
+        still_retired_objects.push_back({ old_object, now });
+        retired_objects = still_retired_objects;
+    }
+
+    private:
+    class retired_object_t {
+        public:
+        TemplateObjectType* object = nullptr;
+        std::chrono::steady_clock::time_point retire_time;
+    };
+
+    const std::chrono::seconds grace_period{ 5 };
+
+    std::atomic<TemplateObjectType*> current_object{ nullptr };
+
+    std::mutex writers_mutex;
+    std::vector<retired_object_t> retired_objects;
+};
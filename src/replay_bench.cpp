@@ -0,0 +1,207 @@
+#include "replay_bench.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include "all_logcpp_libraries.hpp"
+#include "fastnetmon_logic.hpp"
+#include "fastnetmon_pcap_format.hpp"
+#include "netflow_plugin/netflow_collector.hpp"
+#include "parallel_executor.hpp"
+#include "sflow_plugin/sflow_collector.hpp"
+#include "simple_packet_parser_ng.hpp"
+#include "stage_latency.hpp"
+
+extern log4cpp::Category& logger;
+
+extern process_packet_pointer sflow_process_func_ptr;
+extern process_packet_pointer netflow_process_func_ptr;
+
+extern unsigned int speed_calculation_threads;
+extern parallel_executor_t speed_calculation_executor;
+extern double recalculate_speed_timeout;
+extern std::chrono::steady_clock::time_point last_call_of_traffic_recalculation;
+
+// Packets produced by sFlow and NetFlow parsers, parsers call us from single thread
+std::vector<simple_packet_t> replay_bench_parsed_packets;
+
+void store_replay_bench_packet(simple_packet_t& current_packet) {
+    replay_bench_parsed_packets.push_back(current_packet);
+}
+
+// Parses all packets from dump into simple packets, returns false for unknown format
+bool parse_replay_bench_dump(pcap_file_mapping_t& pcap_file_mapping, const std::string& format, uint64_t& number_of_frames) {
+    sflow_process_func_ptr   = store_replay_bench_packet;
+    netflow_process_func_ptr = store_replay_bench_packet;
+
+    if (format != "raw" && format != "sflow" && format != "netflow") {
+        return false;
+    }
+
+    std::string client_address_in_string_format;
+
+    pcap_file_mapping.for_each_packet([&](const fastnetmon_pcap_pkthdr& packet_header, uint8_t* packet) {
+        number_of_frames++;
+
+        if (format == "raw") {
+            simple_packet_t current_packet;
+
+            auto result = parse_raw_packet_to_simple_packet_full_ng(packet, packet_header.orig_len, packet_header.incl_len,
+                                                                    current_packet, false, false);
+
+            if (result != network_data_stuctures::parser_code_t::success) {
+                return;
+            }
+
+            current_packet.ts.tv_sec    = packet_header.ts_sec;
+            current_packet.ts.tv_usec   = packet_header.ts_usec;
+            current_packet.arrival_time = packet_header.ts_sec;
+            replay_bench_parsed_packets.push_back(current_packet);
+
+            return;
+        }
+
+        uint8_t* payload_pointer    = nullptr;
+        unsigned int payload_length = 0;
+        uint32_t source_ip          = 0;
+
+        if (!get_udp_payload_from_raw_packet(packet, packet_header.incl_len, payload_pointer, payload_length, source_ip)) {
+            return;
+        }
+
+        if (format == "sflow") {
+            parse_sflow_v5_packet(payload_pointer, payload_length, source_ip);
+        } else {
+            client_address_in_string_format = convert_ip_as_uint_to_string(source_ip);
+            process_netflow_packet(payload_pointer, payload_length, client_address_in_string_format, source_ip);
+        }
+    });
+
+    return true;
+}
+
+int run_replay_bench(const replay_bench_options_t& options) {
+    pcap_file_mapping_t pcap_file_mapping;
+    std::string error_text;
+
+    if (!pcap_file_mapping.open(options.pcap_file_path, error_text)) {
+        std::cerr << "Can't open dump " << options.pcap_file_path << ": " << error_text << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    unsigned int threads = std::max(options.threads, 1u);
+    unsigned int loops   = std::max(options.loops, 1u);
+
+    uint64_t number_of_frames = 0;
+
+    // We measure each packet to get latency of all stages, it adds few time stamp counter reads to each stage
+    stage_latency_registry.enable(1);
+
+    auto parse_start_time = std::chrono::steady_clock::now();
+
+    if (!parse_replay_bench_dump(pcap_file_mapping, options.format, number_of_frames)) {
+        std::cerr << "Unknown dump format " << options.format << ", please use raw, sflow or netflow" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::chrono::duration<double> parse_time = std::chrono::steady_clock::now() - parse_start_time;
+
+    const std::vector<simple_packet_t>& packets = replay_bench_parsed_packets;
+
+    if (packets.empty()) {
+        std::cerr << "We have no packets after parsing of " << number_of_frames << " frames" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Recalculation uses same workers as in daemon
+    boost::thread_group speed_calculation_workers;
+    speed_calculation_executor.set_number_of_workers(speed_calculation_threads);
+
+    for (unsigned int worker_index = 1; worker_index < speed_calculation_threads; worker_index++) {
+        speed_calculation_workers.create_thread([worker_index]() { speed_calculation_executor.run_worker(worker_index); });
+    }
+
+    // Each thread processes own contiguous part of packets
+    size_t packets_per_thread = (packets.size() + threads - 1) / threads;
+
+    std::chrono::duration<double> processing_time{ 0 };
+    std::chrono::duration<double> recalculation_time{ 0 };
+    std::chrono::duration<double> maximum_recalculation_time{ 0 };
+
+    for (unsigned int loop = 0; loop < loops; loop++) {
+        boost::thread_group processing_threads;
+
+        auto processing_start_time = std::chrono::steady_clock::now();
+
+        for (unsigned int thread_index = 0; thread_index < threads; thread_index++) {
+            size_t first_packet = std::min(packets.size(), thread_index * packets_per_thread);
+            size_t last_packet  = std::min(packets.size(), first_packet + packets_per_thread);
+
+            processing_threads.create_thread([&packets, first_packet, last_packet]() {
+                for (size_t index = first_packet; index < last_packet; index++) {
+                    // process_packet changes packet
+                    simple_packet_t current_packet = packets[index];
+                    process_packet(current_packet);
+                }
+            });
+        }
+
+        processing_threads.join_all();
+
+        processing_time += std::chrono::steady_clock::now() - processing_start_time;
+
+        // We pretend that full period passed because we replay dump much faster than real time
+        last_call_of_traffic_recalculation =
+            std::chrono::steady_clock::now() - std::chrono::microseconds(int64_t(recalculate_speed_timeout * 1000000));
+
+        auto recalculation_start_time = std::chrono::steady_clock::now();
+
+        recalculate_speed();
+
+        std::chrono::duration<double> current_recalculation_time = std::chrono::steady_clock::now() - recalculation_start_time;
+
+        recalculation_time += current_recalculation_time;
+        maximum_recalculation_time = std::max(maximum_recalculation_time, current_recalculation_time);
+    }
+
+    speed_calculation_workers.interrupt_all();
+    speed_calculation_workers.join_all();
+
+    uint64_t processed_packets = packets.size() * loops;
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "Dump: " << options.pcap_file_path << " format: " << options.format << std::endl;
+    std::cout << "Frames in dump: " << number_of_frames << " parsed packets: " << packets.size() << std::endl;
+    std::cout << "Threads: " << threads << " loops: " << loops << std::endl;
+
+    std::cout << "Parsing: " << parse_time.count() * 1000000000 / number_of_frames << " ns per frame, "
+              << number_of_frames / parse_time.count() / 1000000 << " Mpps" << std::endl;
+
+    // Time per packet for single thread, it shows cost of process_packet
+    std::cout << "Processing: " << processing_time.count() * threads * 1000000000 / processed_packets
+              << " ns per packet per thread, " << processed_packets / processing_time.count() / 1000000 << " Mpps" << std::endl;
+
+    std::cout << "Recalculation: " << recalculation_time.count() * 1000 / loops << " ms average, "
+              << maximum_recalculation_time.count() * 1000 << " ms maximum" << std::endl;
+
+    // Percentiles are upper bounds of log2 buckets
+    std::cout << "Stage latency in nanoseconds:" << std::endl;
+
+    for (const auto& histogram : stage_latency_registry.get_histograms()) {
+        if (histogram.samples == 0) {
+            continue;
+        }
+
+        std::cout << "  " << std::left << std::setw(24) << get_latency_stage_name(histogram.stage) << std::right
+                  << " samples: " << histogram.samples << " mean: " << double(histogram.total_nanoseconds) / histogram.samples
+                  << " p50: " << histogram.get_percentile(0.5) << " p90: " << histogram.get_percentile(0.9)
+                  << " p99: " << histogram.get_percentile(0.99) << std::endl;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+
+// Options for replay of pcap dump through parsers and process_packet
+class replay_bench_options_t {
+    public:
+    std::string pcap_file_path;
+
+    // raw, sflow or netflow
+    std::string format = "raw";
+
+    // Number of threads which call process_packet
+    unsigned int threads = 1;
+
+    // Number of times we process all packets from dump
+    unsigned int loops = 1;
+};
+
+// Runs benchmark and prints results, returns exit code for main
+// Counters and networks should be loaded before this call
+int run_replay_bench(const replay_bench_options_t& options);
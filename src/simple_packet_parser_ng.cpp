@@ -1,6 +1,7 @@
 #include "simple_packet_parser_ng.hpp"
 #include "all_logcpp_libraries.hpp"
 #include "network_data_structures.hpp"
+#include "stage_latency.hpp"
 
 #include <cstring>
 
@@ -18,6 +19,8 @@ parser_code_t parse_raw_packet_to_simple_packet_full_ng(uint8_t* pointer,
                                                         simple_packet_t& packet,
                                                         bool unpack_gre,
                                                         bool read_packet_length_from_ip_header) {
+    stage_latency_scope_t stage_latency_scope(latency_stage_t::packet_parse);
+
     // We are using pointer copy because we are changing it
     uint8_t* local_pointer = pointer;
 
@@ -384,3 +387,65 @@ parser_code_t parse_raw_ipv4_packet_to_simple_packet_full_ng(uint8_t* pointer,
 
     return parser_code_t::success;
 }
+
+bool get_udp_payload_from_raw_packet(uint8_t* pointer,
+                                     int captured_length,
+                                     uint8_t*& payload_pointer,
+                                     unsigned int& payload_length,
+                                     uint32_t& source_ip) {
+    uint8_t* local_pointer = pointer;
+    uint8_t* end_pointer   = pointer + captured_length;
+
+    if (local_pointer + sizeof(ethernet_header_t) > end_pointer) {
+        return false;
+    }
+
+    // We work on copies of headers because caller may parse this packet again
+    ethernet_header_t ethernet_header = *(ethernet_header_t*)local_pointer;
+    ethernet_header.convert();
+
+    local_pointer += sizeof(ethernet_header_t);
+
+    if (ethernet_header.ethertype == IanaEthertypeVLAN) {
+        if (local_pointer + sizeof(ethernet_vlan_header_t) > end_pointer) {
+            return false;
+        }
+
+        ethernet_vlan_header_t ethernet_vlan_header = *(ethernet_vlan_header_t*)local_pointer;
+        ethernet_vlan_header.convert();
+
+        local_pointer += sizeof(ethernet_vlan_header_t);
+
+        ethernet_header.ethertype = ethernet_vlan_header.ethertype;
+    }
+
+    if (ethernet_header.ethertype != IanaEthertypeIPv4) {
+        return false;
+    }
+
+    if (local_pointer + sizeof(ipv4_header_t) > end_pointer) {
+        return false;
+    }
+
+    ipv4_header_t* ipv4_header = (ipv4_header_t*)local_pointer;
+
+    if (ipv4_header->protocol != IpProtocolNumberUDP) {
+        return false;
+    }
+
+    source_ip = ipv4_header->source_ip;
+
+    // Ignore all IP options
+    local_pointer += 4 * ipv4_header->ihl;
+
+    if (local_pointer + sizeof(udp_header_t) > end_pointer) {
+        return false;
+    }
+
+    local_pointer += sizeof(udp_header_t);
+
+    payload_pointer = local_pointer;
+    payload_length  = end_pointer - local_pointer;
+
+    return true;
+}
@@ -14,3 +14,11 @@ network_data_stuctures::parser_code_t parse_raw_ipv4_packet_to_simple_packet_ful
                                                                                      int captured_length,
                                                                                      simple_packet_t& packet,
                                                                                      bool read_packet_length_from_ip_header);
+
+// Finds payload of UDP datagram in IPv4 packet with ethernet header, we use it to read sFlow and NetFlow from dumps
+// It does not change packet
+bool get_udp_payload_from_raw_packet(uint8_t* pointer,
+                                     int captured_length,
+                                     uint8_t*& payload_pointer,
+                                     unsigned int& payload_length,
+                                     uint32_t& source_ip);
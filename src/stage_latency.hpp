@@ -0,0 +1,368 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Low overhead instrumentation for stages of packet processing and loops of background threads
+// We read CPU time stamp counter only for sampled packets and keep log2 histograms for each thread separately
+// to avoid any shared writes from capture threads
+
+enum class latency_stage_t : unsigned int {
+    // Stages of packet processing, they are sampled
+    packet_parse,
+    direction_lookup,
+    counter_update,
+    flow_tracking,
+    ban_details_capture,
+    traffic_export,
+
+    // Loops of background threads, we measure each iteration
+    speed_recalculation,
+    screen_drawing_ipv4,
+    screen_drawing_ipv6,
+    ban_list_cleanup,
+    traffic_buckets_check,
+    state_checkpoint,
+    networks_reload,
+
+    // It should be last element
+    number_of_stages,
+};
+
+constexpr size_t number_of_latency_stages = size_t(latency_stage_t::number_of_stages);
+
+// Bucket N keeps samples from 2^(N-1) to 2^N nanoseconds and last bucket keeps everything longer
+constexpr size_t number_of_latency_buckets = 36;
+
+inline std::string get_latency_stage_name(latency_stage_t stage) {
+    switch (stage) {
+    case latency_stage_t::packet_parse:
+        return "packet_parse";
+    case latency_stage_t::direction_lookup:
+        return "direction_lookup";
+    case latency_stage_t::counter_update:
+        return "counter_update";
+    case latency_stage_t::flow_tracking:
+        return "flow_tracking";
+    case latency_stage_t::ban_details_capture:
+        return "ban_details_capture";
+    case latency_stage_t::traffic_export:
+        return "traffic_export";
+    case latency_stage_t::speed_recalculation:
+        return "speed_recalculation";
+    case latency_stage_t::screen_drawing_ipv4:
+        return "screen_drawing_ipv4";
+    case latency_stage_t::screen_drawing_ipv6:
+        return "screen_drawing_ipv6";
+    case latency_stage_t::ban_list_cleanup:
+        return "ban_list_cleanup";
+    case latency_stage_t::traffic_buckets_check:
+        return "traffic_buckets_check";
+    case latency_stage_t::state_checkpoint:
+        return "state_checkpoint";
+    case latency_stage_t::networks_reload:
+        return "networks_reload";
+    case latency_stage_t::number_of_stages:
+        break;
+    }
+
+    return "unknown";
+}
+
+inline bool is_packet_processing_stage(latency_stage_t stage) {
+    return stage < latency_stage_t::speed_recalculation;
+}
+
+// Reads time stamp counter, it's constant rate and synchronised between cores on all CPUs we care about
+inline uint64_t read_tsc_cpu_register() {
+#if defined(__x86_64__) || defined(__i386__)
+    uint32_t lo_32 = 0;
+    uint32_t hi_32 = 0;
+
+    asm volatile("rdtsc" : "=a"(lo_32), "=d"(hi_32));
+
+    return (uint64_t(hi_32) << 32) | lo_32;
+#elif defined(__aarch64__)
+    uint64_t virtual_counter = 0;
+
+    asm volatile("mrs %0, cntvct_el0" : "=r"(virtual_counter));
+
+    return virtual_counter;
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// Histogram for all threads
+class stage_latency_histogram_t {
+    public:
+    latency_stage_t stage = latency_stage_t::packet_parse;
+
+    uint64_t samples           = 0;
+    uint64_t total_nanoseconds = 0;
+
+    std::array<uint64_t, number_of_latency_buckets> buckets{};
+
+    static uint64_t get_bucket_upper_bound(size_t bucket_index) {
+        return uint64_t(1) << bucket_index;
+    }
+
+    // Returns upper bound of bucket where we reach requested share of samples, it's precise only up to factor of 2
+    uint64_t get_percentile(double percentile) const {
+        if (samples == 0) {
+            return 0;
+        }
+
+        uint64_t required_samples = uint64_t(percentile * samples);
+        uint64_t seen_samples     = 0;
+
+        for (size_t bucket_index = 0; bucket_index < number_of_latency_buckets; bucket_index++) {
+            seen_samples += buckets[bucket_index];
+
+            if (seen_samples > required_samples) {
+                return get_bucket_upper_bound(bucket_index);
+            }
+        }
+
+        return get_bucket_upper_bound(number_of_latency_buckets - 1);
+    }
+};
+
+// Only owner thread writes it and we keep it on separate cache lines
+class alignas(64) stage_latency_thread_histograms_t {
+    public:
+    std::atomic<uint64_t> buckets[number_of_latency_stages][number_of_latency_buckets]{};
+    std::atomic<uint64_t> total_nanoseconds[number_of_latency_stages]{};
+
+    // Parser and processing are called for same packets and we need separate sampling for them
+    unsigned int packets_until_sample[number_of_latency_stages]{};
+};
+
+// Identifiers for all registries, they're never reused and thread never sees histograms of destroyed registry
+inline std::atomic<size_t> stage_latency_registry_instances{ 0 };
+
+// Histograms of current thread indexed by identifier of registry
+inline thread_local std::vector<stage_latency_thread_histograms_t*> stage_latency_histograms_of_current_thread;
+
+class stage_latency_registry_t {
+    public:
+    stage_latency_registry_t() : instance_id(stage_latency_registry_instances++) {
+    }
+
+    stage_latency_registry_t(const stage_latency_registry_t&) = delete;
+    stage_latency_registry_t& operator=(const stage_latency_registry_t&) = delete;
+
+    // We measure one of sampling_rate packets in each thread
+    void enable(unsigned int sampling_rate) {
+        nanoseconds_per_tick = calibrate_tsc();
+        this->sampling_rate  = sampling_rate == 0 ? 1 : sampling_rate;
+
+        enabled.store(true, std::memory_order_release);
+    }
+
+    bool is_enabled() const {
+        return enabled.load(std::memory_order_acquire);
+    }
+
+    unsigned int get_sampling_rate() const {
+        return sampling_rate;
+    }
+
+    double get_nanoseconds_per_tick() const {
+        return nanoseconds_per_tick;
+    }
+
+    // Hot path check, it does not touch any shared cache lines except read only flag
+    bool should_measure(latency_stage_t stage) {
+        if (!is_enabled()) {
+            return false;
+        }
+
+        if (!is_packet_processing_stage(stage)) {
+            return true;
+        }
+
+        stage_latency_thread_histograms_t* thread_histograms = get_thread_histograms();
+
+        if (thread_histograms == nullptr) {
+            return false;
+        }
+
+        unsigned int& stage_packets_until_sample = thread_histograms->packets_until_sample[size_t(stage)];
+
+        if (stage_packets_until_sample == 0) {
+            stage_packets_until_sample = sampling_rate - 1;
+            return true;
+        }
+
+        stage_packets_until_sample--;
+        return false;
+    }
+
+    void record(latency_stage_t stage, uint64_t ticks) {
+        stage_latency_thread_histograms_t* thread_histograms = get_thread_histograms();
+
+        if (thread_histograms == nullptr) {
+            return;
+        }
+
+        uint64_t nanoseconds = uint64_t(ticks * nanoseconds_per_tick);
+
+        size_t bucket_index = nanoseconds <= 1 ? 0 : 64 - __builtin_clzll(nanoseconds - 1);
+
+        if (bucket_index >= number_of_latency_buckets) {
+            bucket_index = number_of_latency_buckets - 1;
+        }
+
+        size_t stage_index = size_t(stage);
+
+        std::atomic<uint64_t>& bucket = thread_histograms->buckets[stage_index][bucket_index];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        std::atomic<uint64_t>& total_nanoseconds = thread_histograms->total_nanoseconds[stage_index];
+        total_nanoseconds.store(total_nanoseconds.load(std::memory_order_relaxed) + nanoseconds, std::memory_order_relaxed);
+    }
+
+    // Sums histograms from all threads
+    std::vector<stage_latency_histogram_t> get_histograms() {
+        std::vector<stage_latency_histogram_t> histograms(number_of_latency_stages);
+
+        for (size_t stage_index = 0; stage_index < number_of_latency_stages; stage_index++) {
+            histograms[stage_index].stage = latency_stage_t(stage_index);
+        }
+
+        std::lock_guard<std::mutex> lock_guard(threads_histograms_mutex);
+
+        for (const auto& thread_histograms : threads_histograms) {
+            for (size_t stage_index = 0; stage_index < number_of_latency_stages; stage_index++) {
+                stage_latency_histogram_t& histogram = histograms[stage_index];
+
+                for (size_t bucket_index = 0; bucket_index < number_of_latency_buckets; bucket_index++) {
+                    uint64_t samples = thread_histograms->buckets[stage_index][bucket_index].load(std::memory_order_relaxed);
+
+                    histogram.buckets[bucket_index] += samples;
+                    histogram.samples += samples;
+                }
+
+                histogram.total_nanoseconds += thread_histograms->total_nanoseconds[stage_index].load(std::memory_order_relaxed);
+            }
+        }
+
+        return histograms;
+    }
+
+    private:
+    // Threads with work loops live until end of process and this limit protects us from threads created on each request
+    static constexpr size_t max_number_of_threads = 512;
+
+    stage_latency_thread_histograms_t* get_thread_histograms() {
+        if (instance_id < stage_latency_histograms_of_current_thread.size() &&
+            stage_latency_histograms_of_current_thread[instance_id] != nullptr) {
+            return stage_latency_histograms_of_current_thread[instance_id];
+        }
+
+        stage_latency_thread_histograms_t* thread_histograms = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock_guard(threads_histograms_mutex);
+
+            if (threads_histograms.size() >= max_number_of_threads) {
+                return nullptr;
+            }
+
+            threads_histograms.emplace_back(new stage_latency_thread_histograms_t);
+            thread_histograms = threads_histograms.back().get();
+        }
+
+        if (stage_latency_histograms_of_current_thread.size() <= instance_id) {
+            stage_latency_histograms_of_current_thread.resize(instance_id + 1, nullptr);
+        }
+
+        stage_latency_histograms_of_current_thread[instance_id] = thread_histograms;
+
+        return thread_histograms;
+    }
+
+    // Compares counter with steady clock, it takes 50 milliseconds
+    static double calibrate_tsc() {
+        auto start_time    = std::chrono::steady_clock::now();
+        uint64_t start_tsc = read_tsc_cpu_register();
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        uint64_t end_tsc = read_tsc_cpu_register();
+        auto end_time    = std::chrono::steady_clock::now();
+
+        uint64_t elapsed_nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count();
+
+        if (end_tsc <= start_tsc) {
+            return 1;
+        }
+
+        return double(elapsed_nanoseconds) / double(end_tsc - start_tsc);
+    }
+
+    size_t instance_id = 0;
+
+    std::atomic<bool> enabled{ false };
+    unsigned int sampling_rate  = 1024;
+    double nanoseconds_per_tick = 1;
+
+    std::mutex threads_histograms_mutex;
+    std::vector<std::unique_ptr<stage_latency_thread_histograms_t>> threads_histograms;
+};
+
+// Capture plugins and parsers are linked to multiple binaries and we keep single instance here
+inline stage_latency_registry_t stage_latency_registry;
+
+// Splits processing of single packet into stages, each checkpoint closes stage which started at previous checkpoint
+class packet_latency_trace_t {
+    public:
+    // All stages after parsing use same sampling decision
+    packet_latency_trace_t() {
+        if (stage_latency_registry.should_measure(latency_stage_t::direction_lookup)) {
+            stage_start = read_tsc_cpu_register();
+        }
+    }
+
+    void checkpoint(latency_stage_t stage) {
+        if (stage_start == 0) {
+            return;
+        }
+
+        stage_latency_registry.record(stage, read_tsc_cpu_register() - stage_start);
+
+        // We do not count recording itself
+        stage_start = read_tsc_cpu_register();
+    }
+
+    private:
+    uint64_t stage_start = 0;
+};
+
+// Measures time until end of scope
+class stage_latency_scope_t {
+    public:
+    explicit stage_latency_scope_t(latency_stage_t stage) : stage(stage) {
+        if (stage_latency_registry.should_measure(stage)) {
+            stage_start = read_tsc_cpu_register();
+        }
+    }
+
+    ~stage_latency_scope_t() {
+        if (stage_start != 0) {
+            stage_latency_registry.record(stage, read_tsc_cpu_register() - stage_start);
+        }
+    }
+
+    private:
+    latency_stage_t stage;
+    uint64_t stage_start = 0;
+};
@@ -0,0 +1,365 @@
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "counters_storage.hpp"
+
+// Writes data into memory block with bounds checks
+// Without memory block it only counts number of bytes we need, it allows us to calculate size of checkpoint file in
+// advance and write data directly to mapped file without intermediate buffers
+class checkpoint_writer_t {
+    public:
+    checkpoint_writer_t() {
+    }
+
+    checkpoint_writer_t(uint8_t* memory, size_t memory_size) : memory(memory), memory_size(memory_size) {
+    }
+
+    void write_bytes(const void* data, size_t length) {
+        if (memory != nullptr) {
+            if (memory_size - position < length) {
+                overflow = true;
+                return;
+            }
+
+            memcpy(memory + position, data, length);
+        }
+
+        position += length;
+    }
+
+    template <typename T> void write(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "We could write only trivially copyable types");
+
+        write_bytes(&value, sizeof(value));
+    }
+
+    void write_zeros(size_t length) {
+        if (memory != nullptr) {
+            if (memory_size - position < length) {
+                overflow = true;
+                return;
+            }
+
+            memset(memory + position, 0, length);
+        }
+
+        position += length;
+    }
+
+    void write_string(const std::string& value) {
+        write<uint32_t>(value.size());
+        write_bytes(value.data(), value.size());
+    }
+
+    size_t get_position() const {
+        return position;
+    }
+
+    bool is_overflow() const {
+        return overflow;
+    }
+
+    private:
+    uint8_t* memory    = nullptr;
+    size_t memory_size = 0;
+    size_t position    = 0;
+    bool overflow      = false;
+};
+
+// Reads data from memory block with bounds checks
+class checkpoint_reader_t {
+    public:
+    checkpoint_reader_t(const uint8_t* memory, size_t memory_size) : memory(memory), memory_size(memory_size) {
+    }
+
+    bool read_bytes(void* data, size_t length) {
+        if (memory_size - position < length) {
+            return false;
+        }
+
+        memcpy(data, memory + position, length);
+        position += length;
+
+        return true;
+    }
+
+    template <typename T> bool read(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "We could read only trivially copyable types");
+
+        return read_bytes(&value, sizeof(value));
+    }
+
+    bool read_string(std::string& value) {
+        uint32_t length = 0;
+
+        if (!read(length) || memory_size - position < length) {
+            return false;
+        }
+
+        value.assign((const char*)memory + position, length);
+        position += length;
+
+        return true;
+    }
+
+    // Returns pointer to data and skips it, it's useful for large arrays
+    const uint8_t* skip_bytes(size_t length) {
+        if (memory_size - position < length) {
+            return nullptr;
+        }
+
+        const uint8_t* data = memory + position;
+        position += length;
+
+        return data;
+    }
+
+    private:
+    const uint8_t* memory = nullptr;
+    size_t memory_size    = 0;
+    size_t position       = 0;
+};
+
+// Sizes of types which we copy to checkpoint as raw memory
+// When any of them changes we reject old checkpoint instead of misreading it
+template <typename... Types> class checkpoint_layout_t {
+    public:
+    static void write(checkpoint_writer_t& writer) {
+        writer.write<uint32_t>(sizeof...(Types));
+        (writer.write<uint32_t>(sizeof(Types)), ...);
+    }
+
+    // Returns false when data is truncated or layout does not match
+    static bool read_and_compare(checkpoint_reader_t& reader) {
+        uint32_t number_of_types = 0;
+
+        if (!reader.read(number_of_types) || number_of_types != sizeof...(Types)) {
+            return false;
+        }
+
+        return (read_and_compare_size(reader, sizeof(Types)) && ...);
+    }
+
+    private:
+    static bool read_and_compare_size(checkpoint_reader_t& reader, uint32_t expected_size) {
+        uint32_t size = 0;
+
+        return reader.read(size) && size == expected_size;
+    }
+};
+
+// Returns indexes of allocated blocks, in sparse mode we have only blocks of hosts with traffic
+// Blocks are allocated and retired by other threads and we take this list once before both passes of serialiser
+template <typename T> std::vector<uint64_t> get_counters_storage_blocks_for_checkpoint(const counters_storage_t<T>& storage) {
+    std::vector<uint64_t> block_indexes;
+
+    for (size_t block_index = 0; block_index < storage.get_number_of_blocks(); block_index++) {
+        if (storage.get_block(block_index) != nullptr) {
+            block_indexes.push_back(block_index);
+        }
+    }
+
+    return block_indexes;
+}
+
+// Writes blocks from list prepared by get_counters_storage_blocks_for_checkpoint
+template <typename T>
+void write_counters_storage_to_checkpoint(checkpoint_writer_t& writer,
+                                          const counters_storage_t<T>& storage,
+                                          const std::vector<uint64_t>& block_indexes) {
+    writer.write<uint64_t>(storage.size());
+    writer.write<uint64_t>(block_indexes.size());
+
+    for (uint64_t block_index : block_indexes) {
+        const T* block = storage.get_block(block_index);
+
+        writer.write<uint64_t>(block_index);
+
+        // Block was retired after we took list, it was idle and we save it as zero counters
+        if (block == nullptr) {
+            writer.write_zeros(storage.get_block_length(block_index) * sizeof(T));
+            continue;
+        }
+
+        // Other threads may update these elements in same time but we do not need exact values here
+        writer.write_bytes(block, storage.get_block_length(block_index) * sizeof(T));
+    }
+}
+
+// Reads counters saved by write_counters_storage_to_checkpoint
+// We skip data when storage is nullptr or has different size and set restored only when we copied data to storage
+template <typename T>
+bool read_counters_storage_from_checkpoint(checkpoint_reader_t& reader, counters_storage_t<T>* storage, bool& restored) {
+    static_assert(std::is_trivially_copyable<T>::value, "We could read only trivially copyable types");
+
+    restored = false;
+
+    uint64_t number_of_elements = 0;
+    uint64_t number_of_blocks   = 0;
+
+    if (!reader.read(number_of_elements) || !reader.read(number_of_blocks) ||
+        number_of_elements > std::numeric_limits<uint32_t>::max()) {
+        return false;
+    }
+
+    bool restore_storage = storage != nullptr && storage->size() == number_of_elements;
+
+    for (uint64_t i = 0; i < number_of_blocks; i++) {
+        uint64_t block_index = 0;
+
+        if (!reader.read(block_index) || block_index >= (number_of_elements + counters_storage_t<T>::block_size - 1) /
+                                                            counters_storage_t<T>::block_size) {
+            return false;
+        }
+
+        size_t block_length =
+            std::min<uint64_t>(counters_storage_t<T>::block_size, number_of_elements - block_index * counters_storage_t<T>::block_size);
+
+        const uint8_t* elements = reader.skip_bytes(block_length * sizeof(T));
+
+        if (elements == nullptr) {
+            return false;
+        }
+
+        if (!restore_storage) {
+            continue;
+        }
+
+        T* block = storage->get_or_allocate_block(block_index);
+
+        if (block == nullptr) {
+            return false;
+        }
+
+        memcpy((void*)block, elements, block_length * sizeof(T));
+
+        // Recalculation will decay these counters
+        storage->mark_block_active(block_index);
+    }
+
+    restored = restore_storage;
+
+    return true;
+}
+
+// Writes checkpoint to temporary file mapped to memory and replaces old checkpoint by it
+// Serialiser is called twice: first time to calculate size and second time to write data
+inline bool write_checkpoint_file(const std::string& file_path,
+                                  std::function<void(checkpoint_writer_t&)> serialiser,
+                                  std::string& error_text) {
+    checkpoint_writer_t size_calculator;
+    serialiser(size_calculator);
+
+    size_t file_size = size_calculator.get_position();
+
+    std::string temporary_file_path = file_path + ".tmp";
+
+    int file_descriptor = open(temporary_file_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+
+    if (file_descriptor < 0) {
+        error_text = "cannot open " + temporary_file_path + ": " + strerror(errno);
+        return false;
+    }
+
+    if (ftruncate(file_descriptor, file_size) != 0) {
+        error_text = "cannot set size of " + temporary_file_path + ": " + strerror(errno);
+        close(file_descriptor);
+        unlink(temporary_file_path.c_str());
+        return false;
+    }
+
+    void* memory = mmap(NULL, file_size, PROT_READ | PROT_WRITE, MAP_SHARED, file_descriptor, 0);
+
+    if (memory == MAP_FAILED) {
+        error_text = "cannot map " + temporary_file_path + ": " + strerror(errno);
+        close(file_descriptor);
+        unlink(temporary_file_path.c_str());
+        return false;
+    }
+
+    checkpoint_writer_t writer((uint8_t*)memory, file_size);
+    serialiser(writer);
+
+    bool write_result = !writer.is_overflow() && writer.get_position() == file_size;
+
+    if (!write_result) {
+        error_text = "data changed during checkpoint";
+    }
+
+    // We need data on disk before rename
+    if (msync(memory, file_size, MS_SYNC) != 0) {
+        error_text   = std::string("cannot sync checkpoint: ") + strerror(errno);
+        write_result = false;
+    }
+
+    munmap(memory, file_size);
+    close(file_descriptor);
+
+    if (!write_result) {
+        unlink(temporary_file_path.c_str());
+        return false;
+    }
+
+    if (rename(temporary_file_path.c_str(), file_path.c_str()) != 0) {
+        error_text = "cannot rename " + temporary_file_path + ": " + strerror(errno);
+        unlink(temporary_file_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// Maps checkpoint file to memory and passes it to deserialiser
+inline bool read_checkpoint_file(const std::string& file_path,
+                                 std::function<bool(checkpoint_reader_t&)> deserialiser,
+                                 std::string& error_text) {
+    int file_descriptor = open(file_path.c_str(), O_RDONLY);
+
+    if (file_descriptor < 0) {
+        error_text = "cannot open " + file_path + ": " + strerror(errno);
+        return false;
+    }
+
+    struct stat file_stat;
+
+    if (fstat(file_descriptor, &file_stat) != 0 || file_stat.st_size == 0) {
+        error_text = "cannot get size of " + file_path;
+        close(file_descriptor);
+        return false;
+    }
+
+    void* memory = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+
+    close(file_descriptor);
+
+    if (memory == MAP_FAILED) {
+        error_text = "cannot map " + file_path + ": " + strerror(errno);
+        return false;
+    }
+
+    checkpoint_reader_t reader((const uint8_t*)memory, file_stat.st_size);
+
+    bool read_result = deserialiser(reader);
+
+    if (!read_result) {
+        error_text = "checkpoint data in " + file_path + " is broken";
+    }
+
+    munmap(memory, file_stat.st_size);
+
+    return read_result;
+}
@@ -0,0 +1,869 @@
+// Microbenchmarks for components of packet processing path
+// Each case runs fixed number of operations and we report median of repetitions
+// JSON output could be saved for each build and compared to find regressions:
+// fastnetmon_microbenchmarks --json results.json
+// fastnetmon_microbenchmarks --filter parser --repetitions 10
+// fastnetmon_microbenchmarks --filter traffic_structures --hosts-file ip_addresses.txt
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+
+#include <boost/container/flat_map.hpp>
+#include <boost/program_options.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "../all_logcpp_libraries.hpp"
+#include "../counters_epoch.hpp"
+#include "../fast_library.hpp"
+#include "../fast_platform.hpp"
+#include "../fast_time.hpp"
+#include "../fastnetmon_types.hpp"
+#include "../flow_tracking.hpp"
+#include "../libpatricia/patricia.hpp"
+#include "../netflow_plugin/netflow_collector.hpp"
+#include "../nlohmann/json.hpp"
+#include "../sflow_plugin/sflow_collector.hpp"
+#include "../simple_packet_parser_ng.hpp"
+#include "../traffic_output_formats/protobuf/protobuf_traffic_format.hpp"
+
+#include "../traffic_data.pb.h"
+
+// Globals which plugins expect from daemon
+std::map<std::string, std::string> configuration_map;
+log4cpp::Category& logger = log4cpp::Category::getRoot();
+
+per_thread_counter_t total_unparsed_packets;
+
+uint64_t dns_amplification_packets  = 0;
+uint64_t ntp_amplification_packets  = 0;
+uint64_t ssdp_amplification_packets = 0;
+
+uint64_t raw_parsed_packets   = 0;
+uint64_t raw_unparsed_packets = 0;
+
+extern process_packet_pointer netflow_process_func_ptr;
+extern process_packet_pointer sflow_process_func_ptr;
+
+// Packets from flow parsers
+uint64_t benchmark_decoded_packets = 0;
+
+void benchmark_store_decoded_packet(simple_packet_t& current_packet) {
+    benchmark_decoded_packets++;
+}
+
+// Compiler should not remove calculations which produce this value
+template <typename T> inline void benchmark_do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class benchmark_case_t {
+    public:
+    std::string name;
+    std::string description;
+
+    // Total number of operations for all threads
+    uint64_t operations = 0;
+
+    unsigned int threads = 1;
+
+    // Runs operations for single thread
+    std::function<void(unsigned int thread_index, uint64_t operations)> run;
+};
+
+class benchmark_result_t {
+    public:
+    std::string name;
+    unsigned int threads = 1;
+    uint64_t operations  = 0;
+
+    double median_ns_per_operation  = 0;
+    double minimum_ns_per_operation = 0;
+    double maximum_ns_per_operation = 0;
+};
+
+// Writes fields in network byte order as sFlow and NetFlow agents do
+class network_packet_builder_t {
+    public:
+    void add_uint8(uint8_t value) {
+        data.push_back(value);
+    }
+
+    void add_uint16(uint16_t value) {
+        add_uint8(value >> 8);
+        add_uint8(value & 0xFF);
+    }
+
+    void add_uint32(uint32_t value) {
+        add_uint16(value >> 16);
+        add_uint16(value & 0xFFFF);
+    }
+
+    void add_bytes(const std::vector<uint8_t>& bytes) {
+        data.insert(data.end(), bytes.begin(), bytes.end());
+    }
+
+    std::vector<uint8_t> data;
+};
+
+// Ethernet, IPv4 and TCP headers for packet from 198.18.0.1 to 10.10.0.1
+std::vector<uint8_t> build_ipv4_tcp_packet() {
+    network_packet_builder_t packet;
+
+    // Ethernet
+    for (int i = 0; i < 12; i++) {
+        packet.add_uint8(i);
+    }
+
+    packet.add_uint16(0x0800);
+
+    // IPv4
+    packet.add_uint8(0x45);
+    packet.add_uint8(0);
+    packet.add_uint16(1500);
+    packet.add_uint16(0);
+    packet.add_uint16(0x4000);
+    packet.add_uint8(64);
+    packet.add_uint8(IPPROTO_TCP);
+    packet.add_uint16(0);
+    packet.add_uint32(0xC6120001);
+    packet.add_uint32(0x0A0A0001);
+
+    // TCP with ACK
+    packet.add_uint16(51234);
+    packet.add_uint16(443);
+    packet.add_uint32(1);
+    packet.add_uint32(1);
+    packet.add_uint8(0x50);
+    packet.add_uint8(0x10);
+    packet.add_uint16(1024);
+    packet.add_uint32(0);
+
+    return packet.data;
+}
+
+// Ethernet, IPv6 and UDP headers
+std::vector<uint8_t> build_ipv6_udp_packet() {
+    network_packet_builder_t packet;
+
+    for (int i = 0; i < 12; i++) {
+        packet.add_uint8(i);
+    }
+
+    packet.add_uint16(0x86DD);
+
+    packet.add_uint32(0x60000000);
+    packet.add_uint16(512);
+    packet.add_uint8(IPPROTO_UDP);
+    packet.add_uint8(64);
+
+    // 2001:db8::1 and 2001:db8::2
+    for (uint8_t last_byte : { 1, 2 }) {
+        packet.add_uint32(0x20010DB8);
+        packet.add_uint32(0);
+        packet.add_uint32(0);
+        packet.add_uint32(last_byte);
+    }
+
+    packet.add_uint16(53);
+    packet.add_uint16(40000);
+    packet.add_uint16(512);
+    packet.add_uint16(0);
+
+    return packet.data;
+}
+
+// NetFlow v5 packet with number_of_flows flows
+std::vector<uint8_t> build_netflow_v5_packet(unsigned int number_of_flows) {
+    network_packet_builder_t packet;
+
+    packet.add_uint16(5);
+    packet.add_uint16(number_of_flows);
+    packet.add_uint32(1000000);
+    packet.add_uint32(1600000000);
+    packet.add_uint32(0);
+    packet.add_uint32(1);
+    packet.add_uint8(0);
+    packet.add_uint8(0);
+    packet.add_uint16(0);
+
+    for (unsigned int flow = 0; flow < number_of_flows; flow++) {
+        packet.add_uint32(0xC6120000 + flow);
+        packet.add_uint32(0x0A0A0000 + flow);
+        packet.add_uint32(0);
+        packet.add_uint16(1);
+        packet.add_uint16(2);
+        packet.add_uint32(10);
+        packet.add_uint32(15000);
+        packet.add_uint32(990000);
+        packet.add_uint32(999000);
+        packet.add_uint16(40000 + flow);
+        packet.add_uint16(443);
+        packet.add_uint8(0);
+        packet.add_uint8(0x10);
+        packet.add_uint8(IPPROTO_TCP);
+        packet.add_uint8(0);
+        packet.add_uint16(64500);
+        packet.add_uint16(64501);
+        packet.add_uint8(24);
+        packet.add_uint8(22);
+        packet.add_uint16(0);
+    }
+
+    return packet.data;
+}
+
+// sFlow v5 datagram with flow samples which carry raw packet headers
+std::vector<uint8_t> build_sflow_v5_packet(unsigned int number_of_samples) {
+    std::vector<uint8_t> sampled_packet = build_ipv4_tcp_packet();
+
+    network_packet_builder_t packet;
+
+    packet.add_uint32(5);
+    packet.add_uint32(1);
+    packet.add_uint32(0x0A000001);
+    packet.add_uint32(0);
+    packet.add_uint32(1);
+    packet.add_uint32(1000000);
+    packet.add_uint32(number_of_samples);
+
+    for (unsigned int sample = 0; sample < number_of_samples; sample++) {
+        network_packet_builder_t raw_header_record;
+
+        // Ethernet, frame length, stripped bytes and header length
+        raw_header_record.add_uint32(1);
+        raw_header_record.add_uint32(1514);
+        raw_header_record.add_uint32(4);
+        raw_header_record.add_uint32(sampled_packet.size());
+        raw_header_record.add_bytes(sampled_packet);
+
+        // Records are padded to 4 bytes
+        while (raw_header_record.data.size() % 4 != 0) {
+            raw_header_record.add_uint8(0);
+        }
+
+        network_packet_builder_t flow_sample;
+
+        flow_sample.add_uint32(sample);
+        flow_sample.add_uint32(1);
+        flow_sample.add_uint32(1000);
+        flow_sample.add_uint32(sample * 1000);
+        flow_sample.add_uint32(0);
+        flow_sample.add_uint32(1);
+        flow_sample.add_uint32(2);
+        flow_sample.add_uint32(1);
+
+        flow_sample.add_uint32(1);
+        flow_sample.add_uint32(raw_header_record.data.size());
+        flow_sample.add_bytes(raw_header_record.data);
+
+        packet.add_uint32(1);
+        packet.add_uint32(flow_sample.data.size());
+        packet.add_bytes(flow_sample.data);
+    }
+
+    return packet.data;
+}
+
+// Update and full scan of per host counters stored in container, hosts are in big endian as in process_packet
+// Elements are created during warm up run and measured runs update existing elements
+template <typename TemplateContainerType>
+void add_traffic_structure_cases(std::vector<benchmark_case_t>& cases,
+                                 const std::string& container_name,
+                                 std::shared_ptr<std::vector<uint32_t>> hosts) {
+    auto container = std::make_shared<TemplateContainerType>();
+
+    benchmark_case_t benchmark_case;
+    benchmark_case.name = "traffic_structures_" + container_name;
+    benchmark_case.description =
+        "Increment of per host counters in " + container_name + " for " + std::to_string(hosts->size()) + " hosts";
+    benchmark_case.operations = 10000000;
+    benchmark_case.run        = [container, hosts](unsigned int thread_index, uint64_t operations) {
+        for (uint64_t i = 0; i < operations; i++) {
+            (*container)[(*hosts)[i % hosts->size()]].udp.in_bytes++;
+        }
+    };
+
+    cases.push_back(benchmark_case);
+
+    benchmark_case.name        = "traffic_structures_" + container_name + "_full_scan";
+    benchmark_case.description = "Full scan of per host counters in " + container_name + ", operation is one host";
+    benchmark_case.operations  = hosts->size();
+    benchmark_case.run         = [container, hosts](unsigned int thread_index, uint64_t operations) {
+        // Update case could be filtered out and we create elements here
+        if (container->empty()) {
+            for (uint32_t host : *hosts) {
+                (*container)[host].udp.in_bytes++;
+            }
+        }
+
+        uint64_t total_bytes = 0;
+
+        for (const auto& element : *container) {
+            total_bytes += element.second.udp.in_bytes;
+        }
+
+        benchmark_do_not_optimize(total_bytes);
+    };
+
+    cases.push_back(benchmark_case);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+inline uint64_t read_tsc_cpu_register() {
+    uint32_t lo_32 = 0;
+    uint32_t hi_32 = 0;
+
+    asm volatile("rdtsc" : "=a"(lo_32), "=d"(hi_32));
+    return (uint64_t(hi_32) << 32) | lo_32;
+}
+#endif
+
+std::vector<benchmark_case_t> build_benchmark_cases(unsigned int threads, std::shared_ptr<std::vector<uint32_t>> hosts) {
+    std::vector<benchmark_case_t> cases;
+
+    // Parsers change packets in place and each iteration works with fresh copy
+    for (auto& packet_type : { std::string("ipv4_tcp"), std::string("ipv6_udp") }) {
+        auto packet = std::make_shared<std::vector<uint8_t>>(packet_type == "ipv4_tcp" ? build_ipv4_tcp_packet() : build_ipv6_udp_packet());
+
+        benchmark_case_t benchmark_case;
+        benchmark_case.name        = "parser_ng_" + packet_type;
+        benchmark_case.description = "parse_raw_packet_to_simple_packet_full_ng for single packet";
+        benchmark_case.operations  = 10000000;
+        benchmark_case.run         = [packet](unsigned int thread_index, uint64_t operations) {
+            uint8_t buffer[128];
+            simple_packet_t current_packet;
+
+            for (uint64_t i = 0; i < operations; i++) {
+                memcpy(buffer, packet->data(), packet->size());
+
+                auto result = parse_raw_packet_to_simple_packet_full_ng(buffer, 1500, packet->size(), current_packet, false, false);
+                benchmark_do_not_optimize(result);
+            }
+        };
+
+        cases.push_back(benchmark_case);
+    }
+
+    {
+        // Table similar to full view with prefixes from /8 to /24
+        std::shared_ptr<patricia_tree_t> lookup_tree(New_Patricia(32), [](patricia_tree_t* tree) { Destroy_Patricia(tree); });
+
+        std::mt19937 generator(1);
+
+        for (int i = 0; i < 100000; i++) {
+            unsigned int prefix_length = 8 + generator() % 17;
+            uint32_t network           = generator() & (0xFFFFFFFF << (32 - prefix_length));
+
+            std::string prefix = convert_ip_as_uint_to_string(htonl(network)) + "/" + std::to_string(prefix_length);
+            make_and_lookup(lookup_tree.get(), (char*)prefix.c_str());
+        }
+
+        auto addresses = std::make_shared<std::vector<uint32_t>>();
+
+        for (int i = 0; i < 65536; i++) {
+            addresses->push_back(generator());
+        }
+
+        benchmark_case_t benchmark_case;
+        benchmark_case.name        = "lpm_patricia_ipv4";
+        benchmark_case.description = "get_packet_direction with 100k prefixes, two lookups per operation";
+        benchmark_case.operations  = 5000000;
+        benchmark_case.threads     = threads;
+        benchmark_case.run         = [lookup_tree, addresses](unsigned int thread_index, uint64_t operations) {
+            subnet_cidr_mask_t subnet;
+
+            for (uint64_t i = 0; i < operations; i++) {
+                uint32_t src_ip = (*addresses)[i & 0xFFFF];
+                uint32_t dst_ip = (*addresses)[(i * 7 + thread_index) & 0xFFFF];
+
+                direction_t direction = get_packet_direction(lookup_tree.get(), src_ip, dst_ip, subnet);
+                benchmark_do_not_optimize(direction);
+            }
+        };
+
+        cases.push_back(benchmark_case);
+    }
+
+    {
+        auto shared_counter = std::make_shared<std::atomic<uint64_t>>(0);
+
+        benchmark_case_t benchmark_case;
+        benchmark_case.name        = "counter_increment_atomic";
+        benchmark_case.description = "All threads increment same atomic counter";
+        benchmark_case.operations  = 50000000;
+        benchmark_case.threads     = threads;
+        benchmark_case.run         = [shared_counter](unsigned int thread_index, uint64_t operations) {
+            for (uint64_t i = 0; i < operations; i++) {
+                shared_counter->fetch_add(1, std::memory_order_relaxed);
+            }
+        };
+
+        cases.push_back(benchmark_case);
+    }
+
+    {
+        class alignas(64) counter_shard_t {
+            public:
+            std::atomic<uint64_t> value{ 0 };
+        };
+
+        auto counter_shards = std::shared_ptr<counter_shard_t[]>(new counter_shard_t[threads]);
+
+        benchmark_case_t benchmark_case;
+        benchmark_case.name        = "counter_increment_sharded";
+        benchmark_case.description = "Each thread increments own counter on separate cache line without atomic increments";
+        benchmark_case.operations  = 50000000;
+        benchmark_case.threads     = threads;
+        benchmark_case.run         = [counter_shards](unsigned int thread_index, uint64_t operations) {
+            std::atomic<uint64_t>& counter = counter_shards[thread_index].value;
+
+            for (uint64_t i = 0; i < operations; i++) {
+                counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+        };
+
+        cases.push_back(benchmark_case);
+    }
+
+    {
+        auto per_thread_counter = std::make_shared<per_thread_counter_t>();
+
+        benchmark_case_t benchmark_case;
+        benchmark_case.name        = "counter_increment_per_thread";
+        benchmark_case.description = "per_thread_counter_t as process_packet uses it, it includes lookup of thread copy";
+        benchmark_case.operations  = 50000000;
+        benchmark_case.threads     = threads;
+        benchmark_case.run         = [per_thread_counter](unsigned int thread_index, uint64_t operations) {
+            for (uint64_t i = 0; i < operations; i++) {
+                per_thread_counter->increment();
+            }
+        };
+
+        cases.push_back(benchmark_case);
+    }
+
+    {
+        benchmark_case_t benchmark_case;
+        benchmark_case.name        = "clock_gettimeofday";
+        benchmark_case.description = "gettimeofday which we used for each stored packet before";
+        benchmark_case.operations  = 20000000;
+        benchmark_case.run         = [](unsigned int thread_index, uint64_t operations) {
+            struct timeval current_time;
+
+            for (uint64_t i = 0; i < operations; i++) {
+                gettimeofday(&current_time, NULL);
+                benchmark_do_not_optimize(current_time.tv_usec);
+            }
+        };
+
+        cases.push_back(benchmark_case);
+    }
+
+    {
+        benchmark_case_t benchmark_case;
+        benchmark_case.name        = "clock_fast_time";
+        benchmark_case.description = "get_fast_time as plugins and process_packet use it for timestamps of packets";
+        benchmark_case.operations  = 20000000;
+        benchmark_case.run         = [](unsigned int thread_index, uint64_t operations) {
+            struct timeval current_time;
+
+            for (uint64_t i = 0; i < operations; i++) {
+                get_fast_time(current_time);
+                benchmark_do_not_optimize(current_time.tv_usec);
+            }
+        };
+
+        cases.push_back(benchmark_case);
+    }
+
+    {
+        benchmark_case_t benchmark_case;
+        benchmark_case.name        = "clock_monotonic_raw";
+        benchmark_case.description = "clock_gettime with CLOCK_MONOTONIC_RAW which is not served from vDSO on some kernels";
+        benchmark_case.operations  = 20000000;
+        benchmark_case.run         = [](unsigned int thread_index, uint64_t operations) {
+            struct timespec current_time;
+
+            for (uint64_t i = 0; i < operations; i++) {
+                clock_gettime(CLOCK_MONOTONIC_RAW, &current_time);
+                benchmark_do_not_optimize(current_time.tv_nsec);
+            }
+        };
+
+        cases.push_back(benchmark_case);
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    {
+        benchmark_case_t benchmark_case;
+        benchmark_case.name        = "clock_rdtsc";
+        benchmark_case.description = "Read of TSC register, it needs calibration to convert it to time";
+        benchmark_case.operations  = 20000000;
+        benchmark_case.run         = [](unsigned int thread_index, uint64_t operations) {
+            for (uint64_t i = 0; i < operations; i++) {
+                uint64_t tsc = read_tsc_cpu_register();
+                benchmark_do_not_optimize(tsc);
+            }
+        };
+
+        cases.push_back(benchmark_case);
+    }
+#endif
+
+    {
+        auto counters_epoch = std::make_shared<counters_epoch_t>();
+
+        benchmark_case_t benchmark_case;
+        benchmark_case.name        = "counters_epoch_guard";
+        benchmark_case.description = "Enter and leave of counters generation as process_packet does for each packet";
+        benchmark_case.operations  = 20000000;
+        benchmark_case.threads     = threads;
+        benchmark_case.run         = [counters_epoch](unsigned int thread_index, uint64_t operations) {
+            for (uint64_t i = 0; i < operations; i++) {
+                counters_epoch_guard_t counters_epoch_guard(*counters_epoch);
+                benchmark_do_not_optimize(counters_epoch_guard.get_generation());
+            }
+        };
+
+        cases.push_back(benchmark_case);
+    }
+
+    {
+        auto flow_tracking_mutex = std::make_shared<std::mutex>();
+
+        benchmark_case_t benchmark_case;
+        benchmark_case.name        = "flow_tracking_tcp";
+        benchmark_case.description = "increment_flow_tracking_table for host with 64k TCP flows as process_packet does";
+        benchmark_case.operations  = 5000000;
+        benchmark_case.run         = [flow_tracking_mutex](unsigned int thread_index, uint64_t operations) {
+            conntrack_main_struct_t conntrack_element;
+            std::mt19937 generator(1);
+
+            simple_packet_t current_packet;
+            current_packet.protocol         = IPPROTO_TCP;
+            current_packet.destination_port = 443;
+
+            for (uint64_t i = 0; i < operations; i++) {
+                current_packet.src_ip      = 0xC6120000 + (generator() & 0xFF);
+                current_packet.source_port = 1024 + (generator() & 0xFF);
+
+                increment_flow_tracking_table(conntrack_element, INCOMING, current_packet, 1, 1500, *flow_tracking_mutex);
+            }
+
+            benchmark_do_not_optimize(conntrack_element.in_tcp.size());
+        };
+
+        cases.push_back(benchmark_case);
+    }
+
+    // Containers which we used or considered for per host counters
+    add_traffic_structure_cases<std::map<uint32_t, subnet_counter_t>>(cases, "std_map", hosts);
+    add_traffic_structure_cases<std::unordered_map<uint32_t, subnet_counter_t>>(cases, "std_unordered_map", hosts);
+    add_traffic_structure_cases<boost::unordered_map<uint32_t, subnet_counter_t>>(cases, "boost_unordered_map", hosts);
+    add_traffic_structure_cases<boost::container::flat_map<uint32_t, subnet_counter_t>>(cases, "boost_flat_map", hosts);
+
+    {
+        unsigned int number_of_flows = 30;
+        auto packet                  = std::make_shared<std::vector<uint8_t>>(build_netflow_v5_packet(number_of_flows));
+
+        benchmark_case_t benchmark_case;
+        benchmark_case.name        = "netflow_v5_decoding";
+        benchmark_case.description = "process_netflow_packet for packet with 30 flows, operation is one flow";
+        benchmark_case.operations  = 10000000;
+        benchmark_case.run         = [packet, number_of_flows](unsigned int thread_index, uint64_t operations) {
+            netflow_process_func_ptr = benchmark_store_decoded_packet;
+
+            std::string client_address = "10.0.0.1";
+            std::vector<uint8_t> buffer(packet->size());
+
+            for (uint64_t i = 0; i < operations; i += number_of_flows) {
+                memcpy(buffer.data(), packet->data(), packet->size());
+                process_netflow_packet(buffer.data(), buffer.size(), client_address, 0x0100000A);
+            }
+        };
+
+        cases.push_back(benchmark_case);
+    }
+
+    {
+        unsigned int number_of_samples = 8;
+        auto packet                    = std::make_shared<std::vector<uint8_t>>(build_sflow_v5_packet(number_of_samples));
+
+        benchmark_case_t benchmark_case;
+        benchmark_case.name        = "sflow_v5_decoding";
+        benchmark_case.description = "parse_sflow_v5_packet for datagram with 8 flow samples, operation is one sample";
+        benchmark_case.operations  = 10000000;
+        benchmark_case.run         = [packet, number_of_samples](unsigned int thread_index, uint64_t operations) {
+            sflow_process_func_ptr = benchmark_store_decoded_packet;
+
+            std::vector<uint8_t> buffer(packet->size());
+
+            for (uint64_t i = 0; i < operations; i += number_of_samples) {
+                memcpy(buffer.data(), packet->data(), packet->size());
+                parse_sflow_v5_packet(buffer.data(), buffer.size(), 0x0100000A);
+            }
+        };
+
+        cases.push_back(benchmark_case);
+    }
+
+    {
+        auto packet = std::make_shared<simple_packet_t>();
+
+        std::vector<uint8_t> raw_packet = build_ipv4_tcp_packet();
+        parse_raw_packet_to_simple_packet_full_ng(raw_packet.data(), 1500, raw_packet.size(), *packet, false, false);
+
+        benchmark_case_t benchmark_case;
+        benchmark_case.name        = "export_json";
+        benchmark_case.description = "serialize_simple_packet_to_json and dump to string";
+        benchmark_case.operations  = 1000000;
+        benchmark_case.run         = [packet](unsigned int thread_index, uint64_t operations) {
+            for (uint64_t i = 0; i < operations; i++) {
+                nlohmann::json json_packet;
+                serialize_simple_packet_to_json(*packet, json_packet);
+
+                std::string serialized_packet = json_packet.dump();
+                benchmark_do_not_optimize(serialized_packet.size());
+            }
+        };
+
+        cases.push_back(benchmark_case);
+
+        benchmark_case.name        = "export_protobuf";
+        benchmark_case.description = "write_simple_packet_to_protobuf and serialize to string";
+        benchmark_case.operations  = 5000000;
+        benchmark_case.run         = [packet](unsigned int thread_index, uint64_t operations) {
+            std::string serialized_packet;
+
+            for (uint64_t i = 0; i < operations; i++) {
+                TrafficData traffic_data;
+                write_simple_packet_to_protobuf(*packet, traffic_data);
+
+                traffic_data.SerializeToString(&serialized_packet);
+                benchmark_do_not_optimize(serialized_packet.size());
+            }
+        };
+
+        cases.push_back(benchmark_case);
+    }
+
+    return cases;
+}
+
+// Returns time in nanoseconds for all operations of case
+double run_benchmark_case_once(const benchmark_case_t& benchmark_case) {
+    if (benchmark_case.threads == 1) {
+        auto start_time = std::chrono::steady_clock::now();
+
+        benchmark_case.run(0, benchmark_case.operations);
+
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_time).count();
+    }
+
+    std::atomic<bool> start{ false };
+    std::vector<std::thread> threads;
+
+    uint64_t operations_per_thread = benchmark_case.operations / benchmark_case.threads;
+
+    for (unsigned int thread_index = 0; thread_index < benchmark_case.threads; thread_index++) {
+        threads.emplace_back([&, thread_index]() {
+            while (!start.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+
+            benchmark_case.run(thread_index, operations_per_thread);
+        });
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    start.store(true, std::memory_order_release);
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start_time).count();
+}
+
+benchmark_result_t run_benchmark_case(const benchmark_case_t& benchmark_case, unsigned int repetitions) {
+    // Warm up caches and allocators
+    run_benchmark_case_once(benchmark_case);
+
+    std::vector<double> ns_per_operation;
+
+    for (unsigned int repetition = 0; repetition < repetitions; repetition++) {
+        ns_per_operation.push_back(run_benchmark_case_once(benchmark_case) / benchmark_case.operations);
+    }
+
+    std::sort(ns_per_operation.begin(), ns_per_operation.end());
+
+    benchmark_result_t result;
+    result.name                     = benchmark_case.name;
+    result.threads                  = benchmark_case.threads;
+    result.operations               = benchmark_case.operations;
+    result.median_ns_per_operation  = ns_per_operation[ns_per_operation.size() / 2];
+    result.minimum_ns_per_operation = ns_per_operation.front();
+    result.maximum_ns_per_operation = ns_per_operation.back();
+
+    return result;
+}
+
+int main(int argc, char** argv) {
+    namespace po = boost::program_options;
+
+    std::string filter;
+    std::string json_path;
+    std::string hosts_file_path;
+    unsigned int repetitions = 5;
+    unsigned int threads     = 4;
+
+    po::options_description desc("Allowed options");
+    desc.add_options()("help", "produce help message")("list", "list benchmark cases")(
+        "filter", po::value<std::string>(&filter), "run only cases with this substring in name")(
+        "json", po::value<std::string>(&json_path), "write results to JSON file")(
+        "hosts-file", po::value<std::string>(&hosts_file_path),
+        "file with IP address on each line for traffic_structures cases, we use 1M consecutive hosts by default")(
+        "repetitions", po::value<unsigned int>(&repetitions), "number of measured runs for each case, default 5")(
+        "threads", po::value<unsigned int>(&threads), "number of threads for multi thread cases, default 4");
+
+    po::variables_map vm;
+
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+    } catch (po::error& e) {
+        std::cerr << "Could not parse command line: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    if (vm.count("help")) {
+        std::cout << desc << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    repetitions = std::max(repetitions, 1u);
+    threads     = std::max(threads, 1u);
+
+    // Parsers log errors and we do not want them on screen
+    logger.setPriority(log4cpp::Priority::FATAL);
+
+    // Hosts in big endian for per host counters
+    auto hosts = std::make_shared<std::vector<uint32_t>>();
+
+    if (hosts_file_path.empty()) {
+        for (uint32_t i = 0; i < 1000000; i++) {
+            hosts->push_back(fast_hton(i));
+        }
+    } else {
+        std::ifstream hosts_file(hosts_file_path);
+
+        if (!hosts_file.is_open()) {
+            std::cerr << "Could not open file with IP list: " << hosts_file_path << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        std::string line;
+
+        while (getline(hosts_file, line)) {
+            uint32_t ip = 0;
+
+            if (!convert_ip_as_string_to_uint_safe(line, ip)) {
+                std::cerr << "Cannot parse IP " << line << std::endl;
+                continue;
+            }
+
+            hosts->push_back(ip);
+        }
+
+        if (hosts->empty()) {
+            std::cerr << "File " << hosts_file_path << " has no IP addresses" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    auto benchmark_cases = build_benchmark_cases(threads, hosts);
+
+    if (vm.count("list")) {
+        for (const auto& benchmark_case : benchmark_cases) {
+            std::cout << benchmark_case.name << ": " << benchmark_case.description << std::endl;
+        }
+
+        return EXIT_SUCCESS;
+    }
+
+    std::vector<benchmark_result_t> results;
+
+    std::cout << std::fixed << std::setprecision(2);
+
+    for (const auto& benchmark_case : benchmark_cases) {
+        if (!filter.empty() && benchmark_case.name.find(filter) == std::string::npos) {
+            continue;
+        }
+
+        benchmark_result_t result = run_benchmark_case(benchmark_case, repetitions);
+
+        std::cout << std::left << std::setw(30) << result.name << " threads: " << result.threads
+                  << " median: " << result.median_ns_per_operation << " ns/op min: " << result.minimum_ns_per_operation
+                  << " ns/op max: " << result.maximum_ns_per_operation << " ns/op" << std::endl;
+
+        results.push_back(result);
+    }
+
+    if (json_path.empty()) {
+        return EXIT_SUCCESS;
+    }
+
+    FastnetmonPlatformConfigurtion fastnetmon_platform_configuration;
+
+    std::string kernel_version = "unknown";
+    get_kernel_version(kernel_version);
+
+    nlohmann::json json_results;
+    json_results["fastnetmon_version"] = fastnetmon_platform_configuration.fastnetmon_version;
+    json_results["cpu"]                = get_cpu_model();
+    json_results["kernel"]             = kernel_version;
+    json_results["timestamp"]          = time(NULL);
+    json_results["repetitions"]        = repetitions;
+    json_results["results"]            = nlohmann::json::array();
+
+    for (const auto& result : results) {
+        nlohmann::json json_result;
+
+        json_result["name"]                     = result.name;
+        json_result["threads"]                  = result.threads;
+        json_result["operations"]               = result.operations;
+        json_result["median_ns_per_operation"]  = result.median_ns_per_operation;
+        json_result["minimum_ns_per_operation"] = result.minimum_ns_per_operation;
+        json_result["maximum_ns_per_operation"] = result.maximum_ns_per_operation;
+
+        json_results["results"].push_back(json_result);
+    }
+
+    std::ofstream json_file(json_path);
+
+    if (!json_file.is_open()) {
+        std::cerr << "Could not open " << json_path << " for writing" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    json_file << json_results.dump(4) << std::endl;
+
+    return EXIT_SUCCESS;
+}
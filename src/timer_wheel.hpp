@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+#include <utility>
+#include <vector>
+
+// Hierarchical timer wheel with one second resolution
+// Insert is O(1) and advance costs O(number of expired elements) plus cascading of upper levels
+// We do not support removal, callers should check that element is still valid when it expires
+template <typename TemplateKeyType> class timer_wheel_t {
+    public:
+    timer_wheel_t() {
+        for (unsigned int level = 0; level < number_of_levels; level++) {
+            levels[level].resize(slots_per_level);
+        }
+    }
+
+    // Sets time we start counting from, should be called before any inserts
+    void set_current_time(time_t current_time) {
+        this->current_time = current_time;
+    }
+
+    time_t get_current_time() const {
+        return current_time;
+    }
+
+    // Schedules key for expire_time, time in past expires on next advance
+    void insert(const TemplateKeyType& key, time_t expire_time) {
+        number_of_elements++;
+
+        // Slot for current time was already processed and we use next one
+        if (expire_time <= current_time) {
+            expire_time = current_time + 1;
+        }
+
+        place(key, expire_time);
+    }
+
+    // Moves wheel to new_time and returns all keys which expired before or at it
+    void advance(time_t new_time, std::vector<std::pair<TemplateKeyType, time_t>>& expired_elements) {
+        while (current_time < new_time) {
+            current_time++;
+
+            uint64_t tick = uint64_t(current_time);
+
+            // Elements beyond horizon are checked once per turn of top level
+            // and we do it before cascading as they may land to slot we cascade on this tick
+            if ((tick & ((uint64_t(1) << (slot_bits * number_of_levels)) - 1)) == 0) {
+                std::vector<std::pair<TemplateKeyType, time_t>> overflow_elements;
+                overflow_elements.swap(overflow);
+
+                for (auto& element : overflow_elements) {
+                    place(element.first, element.second);
+                }
+            }
+
+            // Move elements from upper levels to lower when lower level made full turn
+            for (unsigned int level = 1; level < number_of_levels; level++) {
+                if ((tick & ((uint64_t(1) << (slot_bits * level)) - 1)) != 0) {
+                    break;
+                }
+
+                cascade(level, (tick >> (slot_bits * level)) & slots_mask);
+            }
+
+            auto& slot = levels[0][tick & slots_mask];
+
+            for (auto& element : slot) {
+                expired_elements.push_back(element);
+            }
+
+            number_of_elements -= slot.size();
+            slot.clear();
+        }
+    }
+
+    size_t size() const {
+        return number_of_elements;
+    }
+
+    private:
+    void place(const TemplateKeyType& key, time_t expire_time) {
+        uint64_t delta = uint64_t(expire_time - current_time);
+        uint64_t tick  = uint64_t(expire_time);
+
+        for (unsigned int level = 0; level < number_of_levels; level++) {
+            if (delta < (uint64_t(1) << (slot_bits * (level + 1)))) {
+                levels[level][(tick >> (slot_bits * level)) & slots_mask].push_back({ key, expire_time });
+                return;
+            }
+        }
+
+        overflow.push_back({ key, expire_time });
+    }
+
+    void cascade(unsigned int level, uint64_t slot_number) {
+        std::vector<std::pair<TemplateKeyType, time_t>> slot_elements;
+        slot_elements.swap(levels[level][slot_number]);
+
+        for (auto& element : slot_elements) {
+            place(element.first, element.second);
+        }
+    }
+
+    // 64 slots per level and 4 levels cover 194 days, everything above goes to overflow list
+    static const unsigned int slot_bits        = 6;
+    static const unsigned int slots_per_level  = 1 << slot_bits;
+    static const uint64_t slots_mask           = slots_per_level - 1;
+    static const unsigned int number_of_levels = 4;
+
+    std::vector<std::vector<std::pair<TemplateKeyType, time_t>>> levels[number_of_levels];
+    std::vector<std::pair<TemplateKeyType, time_t>> overflow;
+
+    time_t current_time       = 0;
+    size_t number_of_elements = 0;
+};
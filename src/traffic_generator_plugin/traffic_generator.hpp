@@ -0,0 +1,220 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+#include <vector>
+
+#include <netinet/in.h>
+
+#include "../fastnetmon_networks.hpp"
+#include "../fastnetmon_simple_packet.hpp"
+
+// How we select destination hosts
+enum class traffic_generator_destinations_t {
+    // All hosts from networks get same share of traffic, it's carpet bombing for floods
+    uniform,
+
+    // Few hosts receive most of traffic as we see for real traffic
+    zipf,
+};
+
+// Which packets we generate
+enum class traffic_generator_mix_t {
+    // Mix of TCP, UDP and ICMP with different sizes
+    normal,
+    syn_flood,
+    udp_flood,
+    icmp_flood,
+};
+
+class traffic_generator_configuration_t {
+    public:
+    // Networks in host byte order
+    std::vector<subnet_cidr_mask_t> networks;
+
+    traffic_generator_destinations_t destinations = traffic_generator_destinations_t::zipf;
+    traffic_generator_mix_t mix                   = traffic_generator_mix_t::normal;
+
+    double zipf_exponent = 1.1;
+
+    // Random source for each packet instead of small set of clients
+    bool spoofed_sources = false;
+};
+
+// Produces synthetic packets, each thread should use own instance
+class traffic_generator_t {
+    public:
+    // Returns false when we have no hosts in networks
+    bool set_configuration(const traffic_generator_configuration_t& configuration, uint64_t seed) {
+        this->configuration = configuration;
+
+        // Seed should not be zero for xorshift
+        random_state = seed * 0x9E3779B97F4A7C15ull + 1;
+
+        network_offsets.clear();
+        total_hosts = 0;
+
+        for (const auto& network : configuration.networks) {
+            network_offsets.push_back(total_hosts);
+            total_hosts += uint64_t(1) << (32 - std::min(network.cidr_prefix_length, uint32_t(32)));
+        }
+
+        if (total_hosts == 0) {
+            return false;
+        }
+
+        zipf_cdf.clear();
+
+        if (configuration.destinations == traffic_generator_destinations_t::zipf) {
+            // Traffic to hosts after this rank is negligible and we do not keep CDF for them
+            size_t ranks = std::min(total_hosts, max_zipf_ranks);
+
+            zipf_cdf.reserve(ranks);
+
+            double sum = 0;
+
+            for (size_t rank = 1; rank <= ranks; rank++) {
+                sum += 1 / std::pow(double(rank), configuration.zipf_exponent);
+                zipf_cdf.push_back(sum);
+            }
+
+            for (auto& value : zipf_cdf) {
+                value /= sum;
+            }
+        }
+
+        return true;
+    }
+
+    void generate(simple_packet_t& current_packet) {
+        current_packet                     = simple_packet_t{};
+        current_packet.source              = MIRROR;
+        current_packet.ip_protocol_version = 4;
+        current_packet.number_of_packets   = 1;
+        current_packet.sample_ratio        = 1;
+
+        current_packet.dst_ip = htonl(get_destination_host());
+        current_packet.src_ip = htonl(get_source_host());
+
+        current_packet.source_port      = uint16_t(1024 + get_random() % 64512);
+        current_packet.destination_port = 443;
+
+        switch (configuration.mix) {
+        case traffic_generator_mix_t::syn_flood:
+            fill_tcp(current_packet, 60, tcp_syn_flag);
+            current_packet.destination_port = 80;
+            break;
+        case traffic_generator_mix_t::udp_flood:
+            // It looks like NTP amplification
+            fill_udp(current_packet, 468);
+            current_packet.source_port = 123;
+            break;
+        case traffic_generator_mix_t::icmp_flood:
+            current_packet.protocol = IPPROTO_ICMP;
+            set_length(current_packet, 1000);
+            break;
+        case traffic_generator_mix_t::normal:
+            fill_normal(current_packet);
+            break;
+        }
+    }
+
+    uint64_t get_total_hosts() const {
+        return total_hosts;
+    }
+
+    private:
+    static constexpr size_t max_zipf_ranks = 1 << 20;
+
+    // Flags as we get them from parsers
+    static constexpr uint8_t tcp_syn_flag = 0x02;
+    static constexpr uint8_t tcp_ack_flag = 0x10;
+
+    // Number of clients when we do not spoof sources, they are from benchmarking network 198.18.0.0/15
+    static constexpr uint32_t number_of_clients = 1024;
+    static constexpr uint32_t clients_network   = 0xC6120000;
+
+    // xorshift64*
+    uint64_t get_random() {
+        random_state ^= random_state >> 12;
+        random_state ^= random_state << 25;
+        random_state ^= random_state >> 27;
+
+        return random_state * 0x2545F4914F6CDD1Dull;
+    }
+
+    // Returns value in range [0, 1)
+    double get_random_double() {
+        return double(get_random() >> 11) / double(uint64_t(1) << 53);
+    }
+
+    // Returns host in host byte order
+    uint32_t get_destination_host() {
+        uint64_t host_index = 0;
+
+        if (configuration.destinations == traffic_generator_destinations_t::zipf) {
+            uint64_t rank = std::lower_bound(zipf_cdf.begin(), zipf_cdf.end(), get_random_double()) - zipf_cdf.begin();
+
+            // Popular hosts are spread over all networks instead of first addresses of first network
+            host_index = (rank * 2654435761ull) % total_hosts;
+        } else {
+            host_index = get_random() % total_hosts;
+        }
+
+        size_t network_index = std::upper_bound(network_offsets.begin(), network_offsets.end(), host_index) - network_offsets.begin() - 1;
+
+        return configuration.networks[network_index].subnet_address + uint32_t(host_index - network_offsets[network_index]);
+    }
+
+    uint32_t get_source_host() {
+        if (configuration.spoofed_sources) {
+            return uint32_t(get_random());
+        }
+
+        return clients_network + uint32_t(get_random() % number_of_clients);
+    }
+
+    void set_length(simple_packet_t& current_packet, uint64_t length) {
+        current_packet.length    = length;
+        current_packet.ip_length = length;
+    }
+
+    void fill_tcp(simple_packet_t& current_packet, uint64_t length, uint8_t flags) {
+        current_packet.protocol = IPPROTO_TCP;
+        current_packet.flags    = flags;
+        set_length(current_packet, length);
+    }
+
+    void fill_udp(simple_packet_t& current_packet, uint64_t length) {
+        current_packet.protocol = IPPROTO_UDP;
+        set_length(current_packet, length);
+    }
+
+    // 80% TCP with full size data packets and small acks, 15% UDP with random size and 5% ICMP
+    void fill_normal(simple_packet_t& current_packet) {
+        uint64_t selector = get_random() % 100;
+
+        if (selector < 48) {
+            fill_tcp(current_packet, 1500, tcp_ack_flag);
+        } else if (selector < 80) {
+            fill_tcp(current_packet, 64, tcp_ack_flag);
+        } else if (selector < 95) {
+            fill_udp(current_packet, 100 + get_random() % 1300);
+            current_packet.destination_port = 53;
+        } else {
+            current_packet.protocol = IPPROTO_ICMP;
+            set_length(current_packet, 84);
+        }
+    }
+
+    traffic_generator_configuration_t configuration;
+
+    uint64_t random_state = 1;
+
+    // Index of first host of each network in list of all hosts
+    std::vector<uint64_t> network_offsets;
+    uint64_t total_hosts = 0;
+
+    std::vector<double> zipf_cdf;
+};
@@ -0,0 +1,202 @@
+#include "traffic_generator_collector.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+#include <arpa/inet.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/thread.hpp>
+
+#include "../all_logcpp_libraries.hpp"
+#include "../fast_library.hpp"
+#include "../fast_time.hpp"
+
+#include "traffic_generator.hpp"
+
+extern log4cpp::Category& logger;
+
+// Global configuration map
+extern std::map<std::string, std::string> configuration_map;
+
+std::string traffic_generator_log_prefix = "traffic_generator: ";
+
+// Only owner thread writes it and we keep it on separate cache line
+class alignas(64) traffic_generator_thread_stats_t {
+    public:
+    std::atomic<uint64_t> generated_packets{ 0 };
+};
+
+std::unique_ptr<traffic_generator_thread_stats_t[]> traffic_generator_threads_stats;
+std::atomic<unsigned int> traffic_generator_number_of_threads{ 0 };
+
+// We generate packets in batches and check rate after each batch
+const unsigned int traffic_generator_batch_size = 1024;
+
+void run_traffic_generator_thread(process_packet_pointer func_ptr,
+                                  traffic_generator_configuration_t configuration,
+                                  unsigned int thread_index,
+                                  double thread_pps) {
+    traffic_generator_t traffic_generator;
+
+    if (!traffic_generator.set_configuration(configuration, thread_index + 1)) {
+        logger << log4cpp::Priority::ERROR << traffic_generator_log_prefix << "we have no hosts for traffic";
+        return;
+    }
+
+    std::atomic<uint64_t>& generated_packets = traffic_generator_threads_stats[thread_index].generated_packets;
+
+    // Delay between batches, zero means as fast as possible
+    std::chrono::nanoseconds batch_delay(thread_pps > 0 ? int64_t(traffic_generator_batch_size * 1000000000.0 / thread_pps) : 0);
+
+    std::chrono::steady_clock::time_point next_batch = std::chrono::steady_clock::now();
+
+    simple_packet_t current_packet;
+
+    while (true) {
+        // All packets of batch are generated within few microseconds and we read clock once
+        struct timeval batch_time;
+        get_fast_time(batch_time);
+
+        for (unsigned int i = 0; i < traffic_generator_batch_size; i++) {
+            traffic_generator.generate(current_packet);
+            current_packet.ts           = batch_time;
+            current_packet.arrival_time = batch_time.tv_sec;
+
+            func_ptr(current_packet);
+        }
+
+        generated_packets.store(generated_packets.load(std::memory_order_relaxed) + traffic_generator_batch_size,
+                                std::memory_order_relaxed);
+
+        next_batch += batch_delay;
+
+        std::chrono::steady_clock::time_point current_time = std::chrono::steady_clock::now();
+
+        if (next_batch > current_time) {
+            boost::this_thread::sleep(boost::posix_time::microseconds(
+                std::chrono::duration_cast<std::chrono::microseconds>(next_batch - current_time).count()));
+        } else {
+            // We could not reach requested rate and do not try to catch up
+            next_batch = current_time;
+            boost::this_thread::interruption_point();
+        }
+    }
+}
+
+void start_traffic_generator_collection(process_packet_pointer func_ptr) {
+    logger << log4cpp::Priority::INFO << traffic_generator_log_prefix << "plugin started";
+
+    traffic_generator_configuration_t configuration;
+
+    unsigned int threads = 1;
+    double pps           = 100000;
+
+    if (configuration_map.count("traffic_generator_networks") != 0) {
+        std::vector<std::string> networks;
+        boost::split(networks, configuration_map["traffic_generator_networks"], boost::is_any_of(","), boost::token_compress_on);
+
+        for (auto network : networks) {
+            boost::algorithm::trim(network);
+
+            subnet_cidr_mask_t subnet = convert_subnet_from_string_to_binary_with_cidr_format(network);
+
+            if (subnet.is_zero_subnet() || subnet.cidr_prefix_length > 32) {
+                logger << log4cpp::Priority::ERROR << traffic_generator_log_prefix << "cannot parse network: " << network;
+                continue;
+            }
+
+            // Generator works with host byte order and we drop host bits from network address
+            uint32_t netmask = subnet.cidr_prefix_length == 0 ? 0 : 0xFFFFFFFF << (32 - subnet.cidr_prefix_length);
+
+            subnet.subnet_address = ntohl(subnet.subnet_address) & netmask;
+
+            configuration.networks.push_back(subnet);
+        }
+    }
+
+    if (configuration.networks.empty()) {
+        logger << log4cpp::Priority::ERROR << traffic_generator_log_prefix << "please specify traffic_generator_networks";
+        return;
+    }
+
+    if (configuration_map.count("traffic_generator_threads") != 0) {
+        threads = convert_string_to_integer(configuration_map["traffic_generator_threads"]);
+    }
+
+    if (configuration_map.count("traffic_generator_pps") != 0) {
+        pps = convert_string_to_double(configuration_map["traffic_generator_pps"]);
+    }
+
+    if (configuration_map.count("traffic_generator_destinations") != 0) {
+        std::string destinations = configuration_map["traffic_generator_destinations"];
+
+        if (destinations == "uniform") {
+            configuration.destinations = traffic_generator_destinations_t::uniform;
+        } else if (destinations == "zipf") {
+            configuration.destinations = traffic_generator_destinations_t::zipf;
+        } else {
+            logger << log4cpp::Priority::ERROR << traffic_generator_log_prefix << "unknown destinations distribution "
+                   << destinations << ", we will use zipf";
+        }
+    }
+
+    if (configuration_map.count("traffic_generator_zipf_exponent") != 0) {
+        configuration.zipf_exponent = convert_string_to_double(configuration_map["traffic_generator_zipf_exponent"]);
+    }
+
+    if (configuration_map.count("traffic_generator_mix") != 0) {
+        std::string mix = configuration_map["traffic_generator_mix"];
+
+        if (mix == "normal") {
+            configuration.mix = traffic_generator_mix_t::normal;
+        } else if (mix == "syn_flood") {
+            configuration.mix = traffic_generator_mix_t::syn_flood;
+        } else if (mix == "udp_flood") {
+            configuration.mix = traffic_generator_mix_t::udp_flood;
+        } else if (mix == "icmp_flood") {
+            configuration.mix = traffic_generator_mix_t::icmp_flood;
+        } else {
+            logger << log4cpp::Priority::ERROR << traffic_generator_log_prefix << "unknown traffic mix " << mix << ", we will use normal";
+        }
+    }
+
+    if (configuration_map.count("traffic_generator_spoofed_sources") != 0) {
+        configuration.spoofed_sources = configuration_map["traffic_generator_spoofed_sources"] == "on";
+    }
+
+    if (threads == 0) {
+        threads = 1;
+    }
+
+    traffic_generator_threads_stats.reset(new traffic_generator_thread_stats_t[threads]);
+    traffic_generator_number_of_threads = threads;
+
+    logger << log4cpp::Priority::INFO << traffic_generator_log_prefix << "we will generate " << pps << " pps from "
+           << threads << " threads for " << configuration.networks.size() << " networks";
+
+    boost::thread_group traffic_generator_threads;
+
+    for (unsigned int thread_index = 0; thread_index < threads; thread_index++) {
+        traffic_generator_threads.add_thread(
+            new boost::thread(run_traffic_generator_thread, func_ptr, configuration, thread_index, pps / threads));
+    }
+
+    traffic_generator_threads.join_all();
+}
+
+std::vector<system_counter_t> get_traffic_generator_stats() {
+    std::vector<system_counter_t> counters;
+
+    uint64_t generated_packets = 0;
+
+    for (unsigned int thread_index = 0; thread_index < traffic_generator_number_of_threads; thread_index++) {
+        generated_packets += traffic_generator_threads_stats[thread_index].generated_packets.load(std::memory_order_relaxed);
+    }
+
+    counters.push_back(system_counter_t("traffic_generator_packets", generated_packets, metric_type_t::counter,
+                                        "Number of synthetic packets passed to processing"));
+
+    return counters;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "../fastnetmon_types.hpp"
+
+#include <vector>
+
+// Generates synthetic traffic instead of capture for load tests
+void start_traffic_generator_collection(process_packet_pointer func_ptr);
+
+std::vector<system_counter_t> get_traffic_generator_stats();
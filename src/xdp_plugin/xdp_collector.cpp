@@ -49,17 +49,18 @@ extern "C" {
 // Our new generation parser
 #include "../simple_packet_parser_ng.hpp"
 
-extern time_t current_inaccurate_time;
+#include "../fast_time.hpp"
 
 // Global configuration map
 extern std::map<std::string, std::string> configuration_map;
 
+// Each capture thread increments own copy of counters
 std::string packets_received_desc = "Total number of packets received by AF_XDP";
-uint64_t packets_received         = 0;
+per_thread_counter_t packets_received;
 
 std::string xdp_packets_unparsed_desc =
     "Total number of packets with parser issues. It may be broken packets or non IP traffic";
-uint64_t xdp_packets_unparsed = 0;
+per_thread_counter_t xdp_packets_unparsed;
 
 // Evern 4.19 kernel does not have this declaration in headers
 #ifndef AF_XDP
@@ -124,8 +125,8 @@ class xsk_memory_configuration {
 std::vector<system_counter_t> get_xdp_stats() {
     std::vector<system_counter_t> system_counter;
 
-    system_counter.push_back(system_counter_t("xdp_packets_received", packets_received, metric_type_t::counter, packets_received_desc));
-    system_counter.push_back(system_counter_t("xdp_packets_unparsed", xdp_packets_unparsed, metric_type_t::counter,
+    system_counter.push_back(system_counter_t("xdp_packets_received", packets_received.get(), metric_type_t::counter, packets_received_desc));
+    system_counter.push_back(system_counter_t("xdp_packets_unparsed", xdp_packets_unparsed.get(), metric_type_t::counter,
                                               xdp_packets_unparsed_desc));
     return system_counter;
 }
@@ -486,13 +487,20 @@ void xdp_process_traffic(int xdp_socket, xsk_memory_configuration* mem_configura
             continue;
         }
 
+        packets_received.increment(received);
+
+        // AF_XDP does not provide timestamps and we use same time for whole batch
+        struct timeval batch_time;
+        get_fast_time(batch_time);
+
         // Iterate over all packets
         for (unsigned int i = 0; i < received; i++) {
             void* packet_data = &mem_configuration->buffer[descs[i].addr];
 
             simple_packet_t packet;
             packet.source       = MIRROR;
-            packet.arrival_time = current_inaccurate_time;
+            packet.ts           = batch_time;
+            packet.arrival_time = batch_time.tv_sec;
 
             bool xdp_extract_tunnel_traffic = false;
 
@@ -501,7 +509,7 @@ void xdp_process_traffic(int xdp_socket, xsk_memory_configuration* mem_configura
                                                                     xdp_read_packet_length_from_ip_header);
 
             if (result != network_data_stuctures::parser_code_t::success) {
-                xdp_packets_unparsed++;
+                xdp_packets_unparsed.increment();
 
                 logger << log4cpp::Priority::DEBUG
                        << "Cannot parse packet using ng parser: " << network_data_stuctures::parser_code_to_string(result);